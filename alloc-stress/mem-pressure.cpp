@@ -1,13 +1,77 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <string>
+#include <vector>
+
+/*
+ * Scenario files describe a sequence of phases, one per line. Blank lines and
+ * lines starting with '#' are ignored. Each phase is a verb followed by
+ * key=value options:
+ *
+ *   ramp     target=SIZE step=SIZE interval=TIME
+ *   sawtooth low=SIZE high=SIZE step=SIZE interval=TIME cycles=N
+ *   burst    size=SIZE hold=TIME gap=TIME count=N
+ *   hold     duration=TIME
+ *   free
+ *
+ * Allocating phases also accept file=PERCENT, the share of each step backed
+ * by page cache (a dirty shared file mapping) instead of anonymous memory,
+ * and fill=zero|random|mixed, the page contents, which decides how well the
+ * pages compress in zram. SIZE takes K/M/G suffixes, TIME takes us/ms/s
+ * suffixes and defaults to microseconds.
+ */
+
+enum phase_type { PHASE_RAMP, PHASE_SAWTOOTH, PHASE_BURST, PHASE_HOLD, PHASE_FREE };
+enum fill_type { FILL_ZERO, FILL_RANDOM, FILL_MIXED };
+
+struct phase {
+    phase_type type;
+    size_t low = 0;
+    size_t high = 0;
+    size_t step = 2 * 1024 * 1024;
+    size_t interval = 1000;
+    size_t hold = 0;
+    size_t gap = 0;
+    int count = 1;
+    int file_percent = 0;
+    fill_type fill = FILL_ZERO;
+};
+
+struct chunk {
+    void* addr;
+    size_t size;
+    bool file;
+};
+
+/* Written by the child, sampled by the parent. */
+struct shared_state {
+    size_t anon;
+    size_t file;
+    int phase;
+};
+
+static const char* tmp_dir =
+#ifdef __ANDROID__
+        "/data/local/tmp";
+#else
+        "/tmp";
+#endif
+
+static std::vector<chunk> chunks;
+static uint64_t rand_state = 0x9e3779b97f4a7c15ULL;
+
 void* alloc_set(size_t size) {
     void* addr = NULL;
 
@@ -20,8 +84,7 @@ void* alloc_set(size_t size) {
     return addr;
 }
 
-void add_pressure(size_t* shared, size_t size, size_t step_size, size_t duration,
-                  const char* oom_score) {
+void set_oom_score(const char* oom_score) {
     int fd, ret;
 
     fd = open("/proc/self/oom_score_adj", O_WRONLY);
@@ -30,6 +93,11 @@ void add_pressure(size_t* shared, size_t size, size_t step_size, size_t duration
         printf("Writing oom_score_adj failed with err %s\n", strerror(errno));
     }
     close(fd);
+}
+
+void add_pressure(size_t* shared, size_t size, size_t step_size, size_t duration,
+                  const char* oom_score) {
+    set_oom_score(oom_score);
 
     if (alloc_set(size)) {
         *shared = size;
@@ -42,17 +110,440 @@ void add_pressure(size_t* shared, size_t size, size_t step_size, size_t duration
     }
 }
 
+static void fill_pages(void* addr, size_t size, fill_type fill) {
+    size_t page_size = getpagesize();
+    uint64_t* words = (uint64_t*)addr;
+    size_t random_words = fill == FILL_MIXED ? page_size / 2 / sizeof(uint64_t)
+                                             : page_size / sizeof(uint64_t);
+
+    for (size_t off = 0; off < size; off += page_size) {
+        uint64_t* page = words + off / sizeof(uint64_t);
+        if (fill == FILL_ZERO) {
+            /* Touch the page so it is actually faulted in. */
+            page[0] = 0;
+            continue;
+        }
+        for (size_t i = 0; i < random_words; i++) {
+            rand_state ^= rand_state << 13;
+            rand_state ^= rand_state >> 7;
+            rand_state ^= rand_state << 17;
+            page[i] = rand_state;
+        }
+    }
+}
+
+static bool alloc_chunk(shared_state* state, size_t size, bool file, fill_type fill) {
+    void* addr;
+
+    if (size == 0) {
+        return true;
+    }
+    if (file) {
+        std::string path = std::string(tmp_dir) + "/mem-pressure-XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd < 0) {
+            printf("Creating file in %s failed with err %s\n", tmp_dir, strerror(errno));
+            return false;
+        }
+        unlink(path.c_str());
+        if (ftruncate(fd, size) < 0) {
+            printf("Extending file to %zd MB failed with err %s\n", size / 1024 / 1024,
+                   strerror(errno));
+            close(fd);
+            return false;
+        }
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+    } else {
+        addr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    }
+    if (addr == MAP_FAILED) {
+        printf("Allocating %zd MB failed\n", size / 1024 / 1024);
+        return false;
+    }
+    fill_pages(addr, size, fill);
+    chunks.push_back({addr, size, file});
+    if (file) {
+        state->file += size;
+    } else {
+        state->anon += size;
+    }
+    return true;
+}
+
+/* Allocates one step, split between anonymous memory and page cache. */
+static bool alloc_step(shared_state* state, const phase& p, size_t size) {
+    size_t page_size = getpagesize();
+    size_t file_size = size * p.file_percent / 100 / page_size * page_size;
+
+    return alloc_chunk(state, size - file_size, false, p.fill) &&
+           alloc_chunk(state, file_size, true, p.fill);
+}
+
+static size_t allocated(const shared_state* state) {
+    return state->anon + state->file;
+}
+
+/* Releases the most recent allocations until at most target bytes remain. */
+static void release(shared_state* state, size_t target) {
+    while (!chunks.empty() && allocated(state) > target) {
+        chunk c = chunks.back();
+        chunks.pop_back();
+        munmap(c.addr, c.size);
+        if (c.file) {
+            state->file -= c.size;
+        } else {
+            state->anon -= c.size;
+        }
+    }
+}
+
+static bool grow(shared_state* state, const phase& p, size_t target) {
+    while (allocated(state) < target) {
+        size_t size = std::min(p.step, target - allocated(state));
+        if (!alloc_step(state, p, size)) {
+            return false;
+        }
+        usleep(p.interval);
+    }
+    return true;
+}
+
+static bool run_phase(shared_state* state, const phase& p) {
+    switch (p.type) {
+        case PHASE_RAMP:
+            return grow(state, p, p.high);
+        case PHASE_SAWTOOTH:
+            for (int i = 0; i < p.count; i++) {
+                if (!grow(state, p, p.high)) {
+                    return false;
+                }
+                while (allocated(state) > p.low) {
+                    size_t next = allocated(state) - std::min(p.step, allocated(state));
+                    release(state, std::max(p.low, next));
+                    usleep(p.interval);
+                }
+            }
+            return true;
+        case PHASE_BURST:
+            for (int i = 0; i < p.count; i++) {
+                size_t base = allocated(state);
+                if (!alloc_step(state, p, p.high)) {
+                    return false;
+                }
+                usleep(p.hold);
+                release(state, base);
+                usleep(p.gap);
+            }
+            return true;
+        case PHASE_HOLD:
+            usleep(p.hold);
+            return true;
+        case PHASE_FREE:
+            release(state, 0);
+            return true;
+    }
+    return true;
+}
+
+void run_scenario(shared_state* state, const std::vector<phase>& phases, const char* oom_score) {
+    set_oom_score(oom_score);
+
+    for (size_t i = 0; i < phases.size(); i++) {
+        state->phase = i;
+        if (!run_phase(state, phases[i])) {
+            printf("Phase %zd stopped at %zd MB\n", i, allocated(state) / 1024 / 1024);
+            return;
+        }
+    }
+}
+
+static bool parse_number(const char* str, size_t* value, const char* const suffixes[],
+                         const size_t multipliers[]) {
+    char* end;
+
+    errno = 0;
+    unsigned long long n = strtoull(str, &end, 10);
+    if (errno || end == str) {
+        return false;
+    }
+    if (*end == '\0') {
+        *value = n;
+        return true;
+    }
+    for (int i = 0; suffixes && suffixes[i]; i++) {
+        if (!strcasecmp(end, suffixes[i])) {
+            *value = n * multipliers[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_size(const char* str, size_t* value) {
+    static const char* const suffixes[] = {"K", "M", "G", NULL};
+    static const size_t multipliers[] = {1024, 1024 * 1024, 1024 * 1024 * 1024};
+    return parse_number(str, value, suffixes, multipliers);
+}
+
+static bool parse_time(const char* str, size_t* value) {
+    static const char* const suffixes[] = {"us", "ms", "s", NULL};
+    static const size_t multipliers[] = {1, 1000, 1000 * 1000};
+    return parse_number(str, value, suffixes, multipliers);
+}
+
+static bool parse_option(phase* p, const char* key, const char* value) {
+    size_t n;
+
+    if (!strcmp(key, "target") || !strcmp(key, "high") || !strcmp(key, "size")) {
+        return parse_size(value, &p->high);
+    } else if (!strcmp(key, "low")) {
+        return parse_size(value, &p->low);
+    } else if (!strcmp(key, "step")) {
+        return parse_size(value, &p->step) && p->step > 0;
+    } else if (!strcmp(key, "interval")) {
+        return parse_time(value, &p->interval);
+    } else if (!strcmp(key, "hold") || !strcmp(key, "duration")) {
+        return parse_time(value, &p->hold);
+    } else if (!strcmp(key, "gap")) {
+        return parse_time(value, &p->gap);
+    } else if (!strcmp(key, "cycles") || !strcmp(key, "count")) {
+        if (!parse_number(value, &n, NULL, NULL)) {
+            return false;
+        }
+        p->count = n;
+        return true;
+    } else if (!strcmp(key, "file")) {
+        if (!parse_number(value, &n, NULL, NULL) || n > 100) {
+            return false;
+        }
+        p->file_percent = n;
+        return true;
+    } else if (!strcmp(key, "fill")) {
+        if (!strcmp(value, "zero")) {
+            p->fill = FILL_ZERO;
+        } else if (!strcmp(value, "random")) {
+            p->fill = FILL_RANDOM;
+        } else if (!strcmp(value, "mixed")) {
+            p->fill = FILL_MIXED;
+        } else {
+            return false;
+        }
+        return true;
+    }
+    return false;
+}
+
+bool load_scenario(const char* path, std::vector<phase>* phases) {
+    FILE* f = fopen(path, "r");
+    char* line = NULL;
+    size_t len = 0;
+    int lineno = 0;
+    bool ok = true;
+
+    if (!f) {
+        printf("Opening %s failed with err %s\n", path, strerror(errno));
+        return false;
+    }
+    while (ok && getline(&line, &len, f) != -1) {
+        char* saveptr;
+        char* word = strtok_r(line, " \t\r\n", &saveptr);
+        phase p;
+
+        lineno++;
+        if (!word || word[0] == '#') {
+            continue;
+        }
+        if (!strcmp(word, "ramp")) {
+            p.type = PHASE_RAMP;
+        } else if (!strcmp(word, "sawtooth")) {
+            p.type = PHASE_SAWTOOTH;
+        } else if (!strcmp(word, "burst")) {
+            p.type = PHASE_BURST;
+        } else if (!strcmp(word, "hold")) {
+            p.type = PHASE_HOLD;
+        } else if (!strcmp(word, "free")) {
+            p.type = PHASE_FREE;
+        } else {
+            printf("%s:%d: unknown phase '%s'\n", path, lineno, word);
+            ok = false;
+            break;
+        }
+        while ((word = strtok_r(NULL, " \t\r\n", &saveptr))) {
+            char* value = strchr(word, '=');
+            if (value) {
+                *value++ = '\0';
+            }
+            if (!value || !parse_option(&p, word, value)) {
+                printf("%s:%d: invalid option '%s'\n", path, lineno, word);
+                ok = false;
+                break;
+            }
+        }
+        if (ok && p.type == PHASE_SAWTOOTH && p.low >= p.high) {
+            printf("%s:%d: sawtooth needs low < high\n", path, lineno);
+            ok = false;
+        }
+        phases->push_back(p);
+    }
+    free(line);
+    fclose(f);
+    return ok;
+}
+
+/*
+ * Cumulative /proc/vmstat counters that describe reclaim activity. Counters
+ * missing from the running kernel are reported as zero.
+ */
+static const char* const vmstat_keys[] = {
+        "pgscan_kswapd",           "pgscan_direct",           "pgsteal_kswapd",
+        "pgsteal_direct",          "workingset_refault_anon", "workingset_refault_file",
+        "pswpin",                  "pswpout",                 "allocstall_normal",
+        "allocstall_movable",      "oom_kill",
+};
+static const int num_vmstat_keys = sizeof(vmstat_keys) / sizeof(vmstat_keys[0]);
+
+struct sample {
+    double some_avg10;
+    double full_avg10;
+    uint64_t some_total;
+    uint64_t full_total;
+    uint64_t vmstat[num_vmstat_keys];
+    uint64_t cg_oom_kill;
+};
+
+class recorder {
+  public:
+    recorder(FILE* out, const char* cgroup) : out_(out), cgroup_(cgroup) {
+        if (cgroup_) {
+            psi_path_ = std::string(cgroup_) + "/memory.pressure";
+            events_path_ = std::string(cgroup_) + "/memory.events";
+        } else {
+            psi_path_ = "/proc/pressure/memory";
+        }
+        clock_gettime(CLOCK_MONOTONIC, &start_);
+        read_sample(&base_);
+        fprintf(out_, "time_ms,iteration,phase,anon_mb,file_mb,some_avg10,full_avg10,"
+                      "some_total_us,full_total_us");
+        for (int i = 0; i < num_vmstat_keys; i++) {
+            fprintf(out_, ",%s", vmstat_keys[i]);
+        }
+        fprintf(out_, ",cgroup_oom_kill\n");
+        fflush(out_);
+    }
+
+    /* Writes one CSV row; counters are relative to the start of recording. */
+    void record(int iteration, const shared_state* state) {
+        sample s;
+
+        read_sample(&s);
+        fprintf(out_, "%" PRIu64 ",%d,%d,%zd,%zd,%.2f,%.2f,%" PRIu64 ",%" PRIu64, elapsed_ms(),
+                iteration, state->phase, state->anon / 1024 / 1024, state->file / 1024 / 1024,
+                s.some_avg10, s.full_avg10, s.some_total - base_.some_total,
+                s.full_total - base_.full_total);
+        for (int i = 0; i < num_vmstat_keys; i++) {
+            fprintf(out_, ",%" PRIu64, s.vmstat[i] - base_.vmstat[i]);
+        }
+        fprintf(out_, ",%" PRIu64 "\n", s.cg_oom_kill - base_.cg_oom_kill);
+        fflush(out_);
+    }
+
+    /* Events are written as comment lines so the output stays valid CSV. */
+    void event(const char* msg) {
+        fprintf(out_, "# %" PRIu64 " %s\n", elapsed_ms(), msg);
+        fflush(out_);
+    }
+
+  private:
+    uint64_t elapsed_ms() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (now.tv_sec - start_.tv_sec) * 1000 + (now.tv_nsec - start_.tv_nsec) / 1000000;
+    }
+
+    void read_sample(sample* s) {
+        FILE* f;
+        char name[64];
+        unsigned long long value;
+
+        memset(s, 0, sizeof(*s));
+        if ((f = fopen(psi_path_.c_str(), "r"))) {
+            char kind[8];
+            double avg10;
+            unsigned long long total;
+            while (fscanf(f, "%7s avg10=%lf avg60=%*f avg300=%*f total=%llu", kind, &avg10,
+                          &total) == 3) {
+                if (!strcmp(kind, "some")) {
+                    s->some_avg10 = avg10;
+                    s->some_total = total;
+                } else if (!strcmp(kind, "full")) {
+                    s->full_avg10 = avg10;
+                    s->full_total = total;
+                }
+            }
+            fclose(f);
+        }
+        if ((f = fopen("/proc/vmstat", "r"))) {
+            while (fscanf(f, "%63s %llu", name, &value) == 2) {
+                for (int i = 0; i < num_vmstat_keys; i++) {
+                    if (!strcmp(name, vmstat_keys[i])) {
+                        s->vmstat[i] = value;
+                        break;
+                    }
+                }
+            }
+            fclose(f);
+        }
+        if (cgroup_ && (f = fopen(events_path_.c_str(), "r"))) {
+            while (fscanf(f, "%63s %llu", name, &value) == 2) {
+                if (!strcmp(name, "oom_kill")) {
+                    s->cg_oom_kill = value;
+                }
+            }
+            fclose(f);
+        }
+    }
+
+    FILE* out_;
+    const char* cgroup_;
+    std::string psi_path_;
+    std::string events_path_;
+    struct timespec start_;
+    sample base_;
+};
+
+static void join_cgroup(const char* cgroup) {
+    std::string path = std::string(cgroup) + "/cgroup.procs";
+    char pid[16];
+    int fd, len;
+
+    fd = open(path.c_str(), O_WRONLY);
+    len = snprintf(pid, sizeof(pid), "%d", getpid());
+    if (fd < 0 || write(fd, pid, len) < 0) {
+        printf("Joining cgroup %s failed with err %s\n", cgroup, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+}
+
 void usage() {
     printf("Usage: [OPTIONS]\n\n"
            "  -d N: Duration in microsecond to sleep between each allocation.\n"
            "  -i N: Number of iterations to run the alloc process.\n"
            "  -o N: The oom_score to set the child process to before alloc.\n"
-           "  -s N: Number of bytes to allocate in an alloc process loop.\n");
+           "  -s N: Number of bytes to allocate in an alloc process loop.\n"
+           "  -f FILE: Run the phases in the scenario FILE instead of a single ramp.\n"
+           "  -r FILE: Record PSI, vmstat reclaim counters and child kills as CSV to FILE\n"
+           "           ('-' for stdout, other messages then go to stderr).\n"
+           "  -p N: Recording period in milliseconds (default 100).\n"
+           "  -g DIR: Run the alloc process in the cgroup v2 directory DIR and record its\n"
+           "          memory.pressure and memory.events instead of the global ones.\n"
+           "  -t DIR: Directory for the files backing page cache allocations.\n");
 }
 
 int main(int argc, char* argv[]) {
     pid_t pid;
-    size_t* shared;
+    shared_state* shared;
     int c, i = 0;
 
     size_t duration = 1000;
@@ -60,8 +551,14 @@ int main(int argc, char* argv[]) {
     const char* oom_score = "899";
     size_t step_size = 2 * 1024 * 1024;  // 2 MB
     size_t size = step_size;
+    const char* scenario_path = NULL;
+    const char* record_path = NULL;
+    const char* cgroup = NULL;
+    int period_ms = 100;
+    std::vector<phase> phases;
+    recorder* rec = NULL;
 
-    while ((c = getopt(argc, argv, "hi:d:o:s:")) != -1) {
+    while ((c = getopt(argc, argv, "hi:d:o:s:f:r:p:g:t:")) != -1) {
         switch (c) {
             case 'i':
                 iterations = atoi(optarg);
@@ -75,6 +572,21 @@ int main(int argc, char* argv[]) {
             case 's':
                 step_size = atoi(optarg);
                 break;
+            case 'f':
+                scenario_path = optarg;
+                break;
+            case 'r':
+                record_path = optarg;
+                break;
+            case 'p':
+                period_ms = atoi(optarg);
+                break;
+            case 'g':
+                cgroup = optarg;
+                break;
+            case 't':
+                tmp_dir = optarg;
+                break;
             case 'h':
                 usage();
                 abort();
@@ -83,21 +595,69 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    shared = (size_t*)mmap(NULL, sizeof(size_t), PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_SHARED,
-                           0, 0);
+    if (scenario_path && !load_scenario(scenario_path, &phases)) {
+        exit(EXIT_FAILURE);
+    }
+    if (record_path) {
+        FILE* out;
+        if (strcmp(record_path, "-")) {
+            out = fopen(record_path, "w");
+        } else {
+            /* Keep stdout for the CSV, and send all other messages to stderr. */
+            out = fdopen(dup(STDOUT_FILENO), "w");
+            if (out) {
+                dup2(STDERR_FILENO, STDOUT_FILENO);
+            }
+        }
+        if (!out) {
+            printf("Opening %s failed with err %s\n", record_path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        rec = new recorder(out, cgroup);
+    }
+
+    shared = (shared_state*)mmap(NULL, sizeof(shared_state), PROT_READ | PROT_WRITE,
+                                 MAP_ANONYMOUS | MAP_SHARED, 0, 0);
 
     while (iterations == 0 || i < iterations) {
-        *shared = 0;
+        int status;
+        char msg[128];
+
+        memset(shared, 0, sizeof(*shared));
+        fflush(stdout);
         pid = fork();
         if (!pid) {
             /* Child */
-            add_pressure(shared, size, step_size, duration, oom_score);
-            /* Shoud not get here */
+            if (cgroup) {
+                join_cgroup(cgroup);
+            }
+            if (scenario_path) {
+                run_scenario(shared, phases, oom_score);
+            } else {
+                add_pressure(&shared->anon, size, step_size, duration, oom_score);
+                /* Shoud not get here */
+            }
             exit(0);
         } else {
-            wait(NULL);
-            printf("Child %d allocated %zd MB\n", i, *shared / 1024 / 1024);
-            size = *shared / 2;
+            if (rec) {
+                while (waitpid(pid, &status, WNOHANG) == 0) {
+                    rec->record(i, shared);
+                    usleep(period_ms * 1000);
+                }
+                rec->record(i, shared);
+            } else {
+                waitpid(pid, &status, 0);
+            }
+            if (WIFSIGNALED(status)) {
+                snprintf(msg, sizeof(msg), "Child %d killed by signal %d in phase %d at %zd MB", i,
+                         WTERMSIG(status), shared->phase, allocated(shared) / 1024 / 1024);
+                if (rec) {
+                    rec->event(msg);
+                }
+                printf("%s\n", msg);
+            }
+            printf("Child %d allocated %zd MB\n", i, allocated(shared) / 1024 / 1024);
+            size = allocated(shared) / 2;
         }
         i++;
     }
@@ -16,71 +16,500 @@
 
 #include <ctype.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/cdefs.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ext4_utils/ext4_utils.h"
 
 #define MAX_PATH 4096
-#define MAX_FILE_VERSION 100
+#define OUTPUT_FLUSH_SIZE (1024 * 1024)
+
+#define BASE_FS_HEADER "Base EXT4 version 1.0\n"
 
-#ifndef __STRING
-#define __STRING(x) #x
+#ifndef EXT4_INLINE_DATA_FL
+#define EXT4_INLINE_DATA_FL 0x10000000
 #endif
-#define ___STRING(x) __STRING(x)
+
+/* Inline data beyond i_block is kept in the in-inode xattr "system.data". */
+#define EXT4_XATTR_INDEX_SYSTEM 7
+#define EXT4_INLINE_DATA_XATTR_NAME "data"
+/* i_block of an inline directory starts with the parent inode number. */
+#define EXT4_INLINE_DOTDOT_SIZE 4
 
 static void usage(char* filename) {
     fprintf(stderr, "Usage: %s input_blk_alloc_file output_base_fs_file \n", filename);
+    fprintf(stderr, "       %s -i [-m mount_point] input_ext4_image output_base_fs_file \n",
+            filename);
+}
+
+static void write_output(FILE* f, std::string* out) {
+    if (!out->empty() && fwrite(out->data(), 1, out->size(), f) != out->size()) {
+        fprintf(stderr, "failed to write output: %s\n", strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    out->clear();
+}
+
+static bool read_file(FILE* f, std::string* data) {
+    char buf[64 * 1024];
+    size_t n;
+
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+        data->append(buf, n);
+    }
+    return !ferror(f);
+}
+
+static const char* skip_space(const char* p, const char* end) {
+    while (p < end && isspace((unsigned char)*p)) p++;
+    return p;
+}
+
+/* Matches `literal' at `p' and returns the position after it, or NULL. */
+static const char* match(const char* p, const char* end, const char* literal) {
+    size_t len = strlen(literal);
+    if ((size_t)(end - p) < len || memcmp(p, literal, len)) return NULL;
+    return p + len;
+}
+
+/* Returns true if the data matches fscanf("Base EXT4 version %s"). */
+static bool is_base_fs(const char* p, const char* end) {
+    p = match(p, end, "Base");
+    if (p) p = match(skip_space(p, end), end, "EXT4");
+    if (p) p = match(skip_space(p, end), end, "version");
+    return p && skip_space(p, end) < end;
+}
+
+/*
+ * Converts the blk_alloc entries in [p, end) to base_fs entries, replacing the
+ * spaces between block ranges with commas. This follows the rules of the
+ * fscanf("%s ") and getline() parser this replaces, so the output is byte for
+ * byte identical; e.g. a file name longer than MAX_PATH is split, and a name
+ * without block ranges takes its ranges from the next line.
+ */
+static void convert_blk_alloc(const char* p, const char* end, FILE* base_fs_file) {
+    std::string out;
+
+    while ((p = skip_space(p, end)) < end) {
+        const char* name = p;
+        while (p < end && !isspace((unsigned char)*p) && p - name < MAX_PATH) p++;
+        out.append(name, strnlen(name, p - name));
+        out.push_back(' ');
+
+        p = skip_space(p, end);
+        if (p == end) {
+            write_output(base_fs_file, &out);
+            fprintf(stderr, "Bad blk_alloc format\n");
+            exit(EXIT_FAILURE);
+        }
+
+        const char* eol = static_cast<const char*>(memchr(p, '\n', end - p));
+        const char* next = eol ? eol + 1 : end;
+        const char* stop = static_cast<const char*>(memchr(p, '\0', next - p));
+        if (!stop) stop = next;
+
+        for (const char* c = p; c < stop;) {
+            const char* space = static_cast<const char*>(memchr(c, ' ', stop - c));
+            if (!space) space = stop;
+            out.append(c, space - c);
+            c = space;
+            if (c < stop) {
+                if (++c == stop || !isspace((unsigned char)*c)) out.push_back(',');
+            }
+        }
+        p = next;
+
+        if (out.size() >= OUTPUT_FLUSH_SIZE) write_output(base_fs_file, &out);
+    }
+    write_output(base_fs_file, &out);
+}
+
+struct image_file {
+    std::string path;
+    u32 inode;
+    std::string ranges;
+};
+
+static bool read_fully_at(int fd, void* buf, size_t len, off_t offset) {
+    char* p = static_cast<char*>(buf);
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        p += n;
+        len -= n;
+        offset += n;
+    }
+    return true;
+}
+
+/* Reads the first `len' bytes of the on-disk inode `inode'. */
+static bool read_inode_data(int fd, u32 inode, void* out, size_t len) {
+    u32 group = (inode - 1) / info.inodes_per_group;
+    u32 index = (inode - 1) % info.inodes_per_group;
+    if (inode == 0 || group >= aux_info.groups) return false;
+
+    off_t offset = (off_t)aux_info.bg_desc[group].bg_inode_table * info.block_size +
+                   (off_t)index * info.inode_size;
+    return read_fully_at(fd, out, len, offset);
+}
+
+static bool read_inode(int fd, u32 inode, struct ext4_inode* out) {
+    memset(out, 0, sizeof(*out));
+    return read_inode_data(fd, inode, out, std::min<size_t>(sizeof(*out), info.inode_size));
+}
+
+/* Physical extents of a file in logical order, as (start, length) pairs. */
+typedef std::vector<std::pair<u64, u64>> extent_list;
+
+static bool map_extent_node(int fd, const struct ext4_extent_header* hdr, size_t size,
+                            int depth, extent_list* extents) {
+    if (hdr->eh_magic != EXT4_EXT_MAGIC || depth > 5 ||
+        sizeof(*hdr) + hdr->eh_entries * sizeof(struct ext4_extent) > size) {
+        return false;
+    }
+
+    if (hdr->eh_depth == 0) {
+        const struct ext4_extent* ext = EXT_FIRST_EXTENT(hdr);
+        for (int i = 0; i < hdr->eh_entries; i++) {
+            u64 len = ext[i].ee_len > EXT_INIT_MAX_LEN ? ext[i].ee_len - EXT_INIT_MAX_LEN
+                                                       : ext[i].ee_len;
+            extents->emplace_back(((u64)ext[i].ee_start_hi << 32) | ext[i].ee_start_lo, len);
+        }
+        return true;
+    }
+
+    std::vector<u8> block(info.block_size);
+    const struct ext4_extent_idx* idx = EXT_FIRST_INDEX(hdr);
+    for (int i = 0; i < hdr->eh_entries; i++) {
+        u64 leaf = ((u64)idx[i].ei_leaf_hi << 32) | idx[i].ei_leaf_lo;
+        if (!read_fully_at(fd, block.data(), block.size(), (off_t)leaf * info.block_size) ||
+            !map_extent_node(fd, reinterpret_cast<struct ext4_extent_header*>(block.data()),
+                             block.size(), depth + 1, extents)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool map_indirect(int fd, u32 block_nr, int level, extent_list* extents) {
+    if (block_nr == 0) return true;
+    if (level == 0) {
+        extents->emplace_back(block_nr, 1);
+        return true;
+    }
+
+    std::vector<u32> blocks(info.block_size / sizeof(u32));
+    if (!read_fully_at(fd, blocks.data(), info.block_size, (off_t)block_nr * info.block_size)) {
+        return false;
+    }
+    for (u32 b : blocks) {
+        if (!map_indirect(fd, b, level - 1, extents)) return false;
+    }
+    return true;
+}
+
+/* Lists the data blocks of `inode', excluding extent tree and indirect blocks. */
+static bool map_inode(int fd, const struct ext4_inode& inode, extent_list* extents) {
+    if (inode.i_flags & EXT4_INLINE_DATA_FL) return true;
+
+    if (inode.i_flags & EXT4_EXTENTS_FL) {
+        return map_extent_node(fd, reinterpret_cast<const struct ext4_extent_header*>(inode.i_block),
+                               sizeof(inode.i_block), 0, extents);
+    }
+
+    for (int i = 0; i < EXT4_NDIR_BLOCKS; i++) {
+        if (!map_indirect(fd, inode.i_block[i], 0, extents)) return false;
+    }
+    return map_indirect(fd, inode.i_block[EXT4_IND_BLOCK], 1, extents) &&
+           map_indirect(fd, inode.i_block[EXT4_DIND_BLOCK], 2, extents) &&
+           map_indirect(fd, inode.i_block[EXT4_TIND_BLOCK], 3, extents);
+}
+
+/* Formats `extents' as base_fs block ranges, merging physically contiguous ones. */
+static std::string format_ranges(const extent_list& extents) {
+    std::string ranges;
+    u64 start = 0, end = 0;
+    bool have_range = false;
+    char buf[64];
+
+    auto flush = [&]() {
+        if (!have_range) return;
+        if (start == end) {
+            snprintf(buf, sizeof(buf), "%s%" PRIu64, ranges.empty() ? "" : ",", (uint64_t)start);
+        } else {
+            snprintf(buf, sizeof(buf), "%s%" PRIu64 "-%" PRIu64, ranges.empty() ? "" : ",",
+                     (uint64_t)start, (uint64_t)end);
+        }
+        ranges += buf;
+    };
+
+    for (const auto& extent : extents) {
+        if (extent.second == 0) continue;
+        if (have_range && extent.first == end + 1) {
+            end += extent.second;
+            continue;
+        }
+        flush();
+        start = extent.first;
+        end = extent.first + extent.second - 1;
+        have_range = true;
+    }
+    flush();
+    return ranges;
+}
+
+/*
+ * Reads the value of the "system.data" xattr, which holds the inline data that
+ * doesn't fit in i_block. It is always stored in the extra space of the inode.
+ */
+static bool read_inline_data_xattr(int fd, u32 inode, std::vector<u8>* value) {
+    std::vector<u8> raw(std::max<size_t>(info.inode_size, sizeof(struct ext4_inode)));
+    if (!read_inode_data(fd, inode, raw.data(), info.inode_size)) return false;
+
+    const auto* in = reinterpret_cast<const struct ext4_inode*>(raw.data());
+    size_t start = EXT4_GOOD_OLD_INODE_SIZE + in->i_extra_isize;
+    if (start + sizeof(struct ext4_xattr_ibody_header) > info.inode_size ||
+        reinterpret_cast<const struct ext4_xattr_ibody_header*>(&raw[start])->h_magic !=
+                EXT4_XATTR_MAGIC) {
+        return false;
+    }
+
+    /* Value offsets are relative to the first entry. */
+    const u8* first = &raw[start + sizeof(struct ext4_xattr_ibody_header)];
+    const u8* end = raw.data() + info.inode_size;
+    for (const u8* p = first; p + sizeof(struct ext4_xattr_entry) <= end;) {
+        const auto* entry = reinterpret_cast<const struct ext4_xattr_entry*>(p);
+        if (IS_LAST_ENTRY(entry) || p + EXT4_XATTR_LEN(entry->e_name_len) > end) break;
+        if (entry->e_name_index == EXT4_XATTR_INDEX_SYSTEM &&
+            entry->e_name_len == strlen(EXT4_INLINE_DATA_XATTR_NAME) &&
+            !memcmp(entry->e_name, EXT4_INLINE_DATA_XATTR_NAME, entry->e_name_len)) {
+            if (entry->e_value_block != 0 ||
+                (size_t)entry->e_value_offs + entry->e_value_size > (size_t)(end - first)) {
+                return false;
+            }
+            value->assign(first + entry->e_value_offs,
+                          first + entry->e_value_offs + entry->e_value_size);
+            return true;
+        }
+        p += EXT4_XATTR_LEN(entry->e_name_len);
+    }
+    return false;
+}
+
+static bool list_dir(int fd, u32 inode, const std::string& path, std::vector<image_file>* files,
+                     int depth);
+
+/* Appends the regular files in the dirents at [data, data + size) to `files'. */
+static bool list_dirents(int fd, const u8* data, size_t size, const std::string& path,
+                         std::vector<image_file>* files, int depth) {
+    for (size_t off = 0; off + 8 <= size;) {
+        auto* de = reinterpret_cast<const struct ext4_dir_entry_2*>(&data[off]);
+        if (de->rec_len < 8 || off + de->rec_len > size || 8 + de->name_len > de->rec_len) {
+            break;
+        }
+        off += de->rec_len;
+
+        if (de->inode == 0) continue;
+        std::string name(de->name, de->name_len);
+        if (name == "." || name == "..") continue;
+
+        if (de->file_type == EXT4_FT_DIR) {
+            if (!list_dir(fd, de->inode, path + "/" + name, files, depth + 1)) {
+                return false;
+            }
+        } else if (de->file_type == EXT4_FT_REG_FILE) {
+            files->push_back({path + "/" + name, de->inode, ""});
+        }
+    }
+    return true;
+}
+
+/* Appends the regular files below directory `inode' to `files'. */
+static bool list_dir(int fd, u32 inode, const std::string& path, std::vector<image_file>* files,
+                     int depth) {
+    struct ext4_inode dir;
+    extent_list extents;
+    const char* dir_path = path.empty() ? "/" : path.c_str();
+
+    if (depth > MAX_PATH / 2 || !read_inode(fd, inode, &dir) || !map_inode(fd, dir, &extents)) {
+        fprintf(stderr, "failed to read directory %s\n", dir_path);
+        return false;
+    }
+
+    if (dir.i_flags & EXT4_INLINE_DATA_FL) {
+        /*
+         * Dirents of an inline directory follow the parent inode number in i_block,
+         * and continue in the "system.data" xattr when they don't fit.
+         */
+        const u8* i_block = reinterpret_cast<const u8*>(dir.i_block);
+        if (!list_dirents(fd, i_block + EXT4_INLINE_DOTDOT_SIZE,
+                          sizeof(dir.i_block) - EXT4_INLINE_DOTDOT_SIZE, path, files, depth)) {
+            return false;
+        }
+        if (dir.i_size_lo <= sizeof(dir.i_block)) return true;
+
+        std::vector<u8> value;
+        if (!read_inline_data_xattr(fd, inode, &value)) {
+            fprintf(stderr, "failed to read inline data of directory %s\n", dir_path);
+            return false;
+        }
+        return list_dirents(fd, value.data(), value.size(), path, files, depth);
+    }
+
+    std::vector<u8> block(info.block_size);
+    for (const auto& extent : extents) {
+        for (u64 b = extent.first; b < extent.first + extent.second; b++) {
+            if (!read_fully_at(fd, block.data(), block.size(), (off_t)b * info.block_size)) {
+                fprintf(stderr, "failed to read block %" PRIu64 ": %s\n", (uint64_t)b,
+                        strerror(errno));
+                return false;
+            }
+            if (!list_dirents(fd, block.data(), block.size(), path, files, depth)) return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Writes the base_fs map of the regular files in an ext4 image. Directories are
+ * walked first, then the block maps of the files are read by parallel workers.
+ * The output matches what this tool produces from the image's blk_alloc file.
+ */
+static void convert_image(int fd, const char* mount_point, FILE* base_fs_file) {
+    if (setjmp(setjmp_env)) exit(EXIT_FAILURE);
+    read_ext(fd, 0);
+
+    std::string prefix(mount_point);
+    while (!prefix.empty() && prefix.back() == '/') prefix.pop_back();
+
+    std::vector<image_file> files;
+    if (!list_dir(fd, EXT4_ROOT_INO, prefix, &files, 0)) exit(EXIT_FAILURE);
+
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());
+    workers = std::min(workers, std::max<size_t>(1, files.size() / 64));
+
+    std::vector<char> ok(workers, true);
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; w++) {
+        threads.emplace_back([&, w]() {
+            for (size_t i = w; i < files.size(); i += workers) {
+                struct ext4_inode inode;
+                extent_list extents;
+                if (!read_inode(fd, files[i].inode, &inode) || !map_inode(fd, inode, &extents)) {
+                    fprintf(stderr, "failed to map %s\n", files[i].path.c_str());
+                    ok[w] = false;
+                    return;
+                }
+                files[i].ranges = format_ranges(extents);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    if (std::find(ok.begin(), ok.end(), false) != ok.end()) exit(EXIT_FAILURE);
+
+    std::string out = BASE_FS_HEADER;
+    for (const auto& file : files) {
+        if (file.ranges.empty()) continue;
+        out += file.path;
+        out += ' ';
+        out += file.ranges;
+        out += '\n';
+        if (out.size() >= OUTPUT_FLUSH_SIZE) write_output(base_fs_file, &out);
+    }
+    write_output(base_fs_file, &out);
 }
 
 int main(int argc, char** argv) {
     FILE *blk_alloc_file = NULL, *base_fs_file = NULL;
-    char filename[MAX_PATH + 1], file_version[MAX_FILE_VERSION + 1], *spaced_allocs = NULL;
-    size_t spaced_allocs_len = 0;
+    const char* mount_point = "";
+    bool image = false;
+    int opt;
+
+    static const struct option long_options[] = {
+        {"image", no_argument, NULL, 'i'},
+        {"mount-point", required_argument, NULL, 'm'},
+        {NULL, 0, NULL, 0},
+    };
 
-    if (argc != 3) {
+    while ((opt = getopt_long(argc, argv, "im:", long_options, NULL)) != -1) {
+        switch (opt) {
+            case 'i':
+                image = true;
+                break;
+            case 'm':
+                mount_point = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (argc - optind != 2) {
         usage(argv[0]);
         exit(EXIT_FAILURE);
     }
-    blk_alloc_file = fopen(argv[1], "r");
+    const char* input = argv[optind];
+    const char* output = argv[optind + 1];
+
+    if (image) {
+        int fd = open(input, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            fprintf(stderr, "failed to open %s: %s\n", input, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        base_fs_file = fopen(output, "w");
+        if (base_fs_file == NULL) {
+            fprintf(stderr, "failed to open %s: %s\n", output, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        printf("Generating *.base_fs from %s as %s...\n", input, output);
+        convert_image(fd, mount_point, base_fs_file);
+        close(fd);
+        fclose(base_fs_file);
+        return 0;
+    }
+
+    blk_alloc_file = fopen(input, "r");
     if (blk_alloc_file == NULL) {
-        fprintf(stderr, "failed to open %s: %s\n", argv[1], strerror(errno));
+        fprintf(stderr, "failed to open %s: %s\n", input, strerror(errno));
         exit(EXIT_FAILURE);
     }
-    base_fs_file = fopen(argv[2], "w");
+    base_fs_file = fopen(output, "w");
     if (base_fs_file == NULL) {
-        fprintf(stderr, "failed to open %s: %s\n", argv[2], strerror(errno));
+        fprintf(stderr, "failed to open %s: %s\n", output, strerror(errno));
         exit(EXIT_FAILURE);
     }
-    if (fscanf(blk_alloc_file, "Base EXT4 version %" ___STRING(MAX_FILE_VERSION) "s",
-               file_version) > 0) {
-        int c;
-        printf("%s is already in *.base_fs format, just copying into %s...\n", argv[1], argv[2]);
-        rewind(blk_alloc_file);
-        while ((c = fgetc(blk_alloc_file)) != EOF) {
-            fputc(c, base_fs_file);
-        }
+
+    std::string data;
+    if (!read_file(blk_alloc_file, &data)) {
+        fprintf(stderr, "failed to read %s: %s\n", input, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+
+    if (is_base_fs(begin, end)) {
+        printf("%s is already in *.base_fs format, just copying into %s...\n", input, output);
+        write_output(base_fs_file, &data);
         return 0;
     } else {
-        printf("Converting %s into *.base_fs format as %s...\n", argv[1], argv[2]);
-        rewind(blk_alloc_file);
-    }
-    fprintf(base_fs_file, "Base EXT4 version 1.0\n");
-    while (fscanf(blk_alloc_file, "%" ___STRING(MAX_PATH) "s ", filename) != EOF) {
-        int i;
-        fprintf(base_fs_file, "%s ", filename);
-        if (getline(&spaced_allocs, &spaced_allocs_len, blk_alloc_file) == -1) {
-            fprintf(stderr, "Bad blk_alloc format\n");
-            exit(EXIT_FAILURE);
-        }
-        for (i = 0; spaced_allocs[i]; i++) {
-            if (spaced_allocs[i] == ' ') {
-                if (!isspace(spaced_allocs[i + 1])) fputc(',', base_fs_file);
-            } else
-                fputc(spaced_allocs[i], base_fs_file);
-        }
+        printf("Converting %s into *.base_fs format as %s...\n", input, output);
     }
-    free(spaced_allocs);
+    fputs(BASE_FS_HEADER, base_fs_file);
+    convert_blk_alloc(begin, end, base_fs_file);
     fclose(blk_alloc_file);
     fclose(base_fs_file);
     return 0;
@@ -0,0 +1,110 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2026 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Times blk_alloc_to_base_fs on generated inputs.
+
+Generates a blk_alloc file with the given number of files and block ranges
+and converts it, reporting the best time of several runs. With --image, also
+populates an ext4 image with the same number of files using mke2fs -d and
+times generating the base_fs map directly from the image.
+"""
+
+import argparse
+import os
+import random
+import shutil
+import subprocess
+import tempfile
+import time
+
+
+def GenerateBlkAlloc(path, files, ranges, seed):
+  rng = random.Random(seed)
+  block = 1000
+  with open(path, "w") as f:
+    for i in range(files):
+      f.write("/system/dir%d/file%d" % (i % 997, i))
+      for _ in range(rng.randint(1, ranges)):
+        length = rng.choice([0, 0, 1, 7, 250])
+        if length:
+          f.write(" %d-%d" % (block, block + length))
+        else:
+          f.write(" %d" % block)
+        block += length + rng.randint(1, 16)
+      f.write("\n")
+
+
+def GenerateImage(path, workdir, files, seed):
+  rng = random.Random(seed)
+  src = os.path.join(workdir, "src")
+  for i in range(files):
+    directory = os.path.join(src, "dir%d" % (i % 997))
+    os.makedirs(directory, exist_ok=True)
+    with open(os.path.join(directory, "file%d" % i), "wb") as f:
+      f.write(os.urandom(rng.choice([1, 4096, 20000, 100000])))
+  size_mb = files * 40 // 1024 + 64
+  subprocess.check_call(["mke2fs", "-q", "-F", "-t", "ext4", "-b", "4096",
+                         "-d", src, path, "%dM" % size_mb])
+  shutil.rmtree(src)
+
+
+def Time(cmd, runs):
+  best = None
+  for _ in range(runs):
+    start = time.monotonic()
+    subprocess.check_call(cmd, stdout=subprocess.DEVNULL)
+    elapsed = time.monotonic() - start
+    best = elapsed if best is None else min(best, elapsed)
+  return best
+
+
+def main():
+  parser = argparse.ArgumentParser(description=__doc__)
+  parser.add_argument("--binary", default="blk_alloc_to_base_fs",
+                      help="path to blk_alloc_to_base_fs")
+  parser.add_argument("--files", type=int, default=500000,
+                      help="number of files in the generated input")
+  parser.add_argument("--ranges", type=int, default=8,
+                      help="maximum number of block ranges per file")
+  parser.add_argument("--runs", type=int, default=5,
+                      help="number of timed runs per input")
+  parser.add_argument("--image", action="store_true",
+                      help="also time conversion from an ext4 image")
+  parser.add_argument("--seed", type=int, default=0)
+  args = parser.parse_args()
+
+  workdir = tempfile.mkdtemp()
+  try:
+    blk_alloc = os.path.join(workdir, "blk_alloc")
+    base_fs = os.path.join(workdir, "base_fs")
+    GenerateBlkAlloc(blk_alloc, args.files, args.ranges, args.seed)
+    size_mb = os.path.getsize(blk_alloc) / (1024.0 * 1024.0)
+    elapsed = Time([args.binary, blk_alloc, base_fs], args.runs)
+    print("blk_alloc: %d files, %.1f MiB: %.3f s (%.1f MiB/s)" %
+          (args.files, size_mb, elapsed, size_mb / elapsed))
+
+    if args.image:
+      image = os.path.join(workdir, "image")
+      GenerateImage(image, workdir, args.files, args.seed)
+      elapsed = Time([args.binary, "-i", "-m", "/system", image, base_fs],
+                     args.runs)
+      print("image: %d files: %.3f s" % (args.files, elapsed))
+  finally:
+    shutil.rmtree(workdir)
+
+
+if __name__ == "__main__":
+  main()
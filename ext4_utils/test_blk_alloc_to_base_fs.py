@@ -0,0 +1,103 @@
+#!/usr/bin/env python3
+#
+# Copyright (C) 2026 The Android Open Source Project
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#      http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+"""Tests blk_alloc_to_base_fs -i on ext4 images made by mke2fs -d.
+
+The binary is found through $BLK_ALLOC_TO_BASE_FS, or on $PATH. Block ranges
+are checked against debugfs.
+"""
+
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+BINARY = os.environ.get("BLK_ALLOC_TO_BASE_FS", "blk_alloc_to_base_fs")
+
+
+def HasTools():
+  return all(shutil.which(tool) for tool in [BINARY, "mke2fs", "debugfs"])
+
+
+@unittest.skipUnless(HasTools(), "needs blk_alloc_to_base_fs, mke2fs and debugfs")
+class BlkAllocToBaseFsImageTest(unittest.TestCase):
+  def setUp(self):
+    self.workdir = tempfile.mkdtemp()
+    self.src = os.path.join(self.workdir, "src")
+    self.image = os.path.join(self.workdir, "image")
+
+  def tearDown(self):
+    shutil.rmtree(self.workdir)
+
+  def AddFile(self, path, size):
+    path = os.path.join(self.src, path)
+    os.makedirs(os.path.dirname(path), exist_ok=True)
+    with open(path, "wb") as f:
+      f.write(os.urandom(size))
+
+  def MakeImage(self, features):
+    cmd = ["mke2fs", "-q", "-F", "-t", "ext4", "-b", "4096", "-I", "256"]
+    if features:
+      cmd += ["-O", features]
+    subprocess.check_call(cmd + ["-d", self.src, self.image, "64M"],
+                          stdout=subprocess.DEVNULL)
+
+  def ReadBaseFs(self):
+    base_fs = os.path.join(self.workdir, "base_fs")
+    subprocess.check_call([BINARY, "-i", "-m", "/system", self.image, base_fs],
+                          stdout=subprocess.DEVNULL)
+    with open(base_fs) as f:
+      lines = f.read().splitlines()
+    self.assertEqual(lines[0], "Base EXT4 version 1.0")
+    return dict(line.split(" ", 1) for line in lines[1:])
+
+  def DebugfsBlocks(self, path):
+    output = subprocess.check_output(
+        ["debugfs", "-R", "blocks " + path, self.image],
+        stderr=subprocess.DEVNULL, universal_newlines=True)
+    return [int(block) for block in output.split()]
+
+  def CheckImage(self, features, files):
+    for path, size in files.items():
+      self.AddFile(path, size)
+    self.MakeImage(features)
+    base_fs = self.ReadBaseFs()
+    for path, size in files.items():
+      blocks = self.DebugfsBlocks("/" + path)
+      if not blocks:
+        # Small files can be stored inline, without data blocks.
+        self.assertNotIn("/system/" + path, base_fs)
+        continue
+      ranges = []
+      for part in base_fs["/system/" + path].split(","):
+        start, _, end = part.partition("-")
+        ranges += range(int(start), int(end or start) + 1)
+      self.assertEqual(ranges, blocks, path)
+
+  def test_image(self):
+    self.CheckImage(None, {"d1/d2/huge": 5 * 1024 * 1024, "d1/mid": 9000,
+                           "d3/x": 7000})
+
+  def test_inline_data_image(self):
+    # d1, d1/d2 and d3 are small enough to be inline directories.
+    self.CheckImage("inline_data", {"d1/d2/huge": 5 * 1024 * 1024,
+                                    "d1/small": 10, "d1/mid": 9000,
+                                    "d3/x": 7000})
+
+
+if __name__ == "__main__":
+  unittest.main()
@@ -30,6 +30,7 @@
 #include <sys/statfs.h>
 #include <sys/resource.h>
 #include <inttypes.h>
+#include <time.h>
 #include "ioshark.h"
 #define IOSHARK_MAIN
 #include "ioshark_bench.h"
@@ -54,6 +55,8 @@ struct thread_state_s {
 	FILE *fp;
 	int num_files;
 	void *db_handle;
+	u_int64_t staging_key;	/* checksum of header + file state table */
+	void *staging;
 };
 
 struct thread_state_s thread_state[MAX_INPUT_FILES];
@@ -66,10 +69,13 @@ pthread_t tid[MAX_THREADS];
  * Global options
  */
 int do_delay = 0;
+int do_pace = 0;		/* absolute deadlines from a shared epoch */
+double replay_speed = 1.0;	/* > 1.0 replays faster than captured */
 int verbose = 0;
 int summary_mode = 0;
 int quick_mode = 0;
 char *blockdev_name = NULL;	/* if user would like to specify blockdev */
+char *staging_dir = NULL;	/* persistent staging dir, files are kept */
 
 #if 0
 static long gettid()
@@ -80,7 +86,7 @@ static long gettid()
 
 void usage()
 {
-	fprintf(stderr, "%s [-b blockdev_name] [-d preserve_delays] [-n num_iterations] [-t num_threads] -q -v | -s <list of parsed input files>\n",
+	fprintf(stderr, "%s [-b blockdev_name] [-d preserve_delays] [-a pace_absolute] [-x speed] [-n num_iterations] [-p staging_dir] [-t num_threads] -q -v | -s <list of parsed input files>\n",
 		progname);
 	fprintf(stderr, "%s -s, -v are mutually exclusive\n",
 		progname);
@@ -96,9 +102,21 @@ struct timeval aggregate_file_remove_time;
 struct timeval aggregate_IO_time;
 struct timeval aggregate_delay_time;
 
+/*
+ * Start of the replay for -a, shared by all the IO threads. Each op is
+ * issued at epoch + (sum of delta_us up to the op) / replay_speed.
+ */
+struct timespec replay_epoch;
+#define PACE_START_LEAD_NS	(10 * 1000 * 1000)
+u_int32_t *aggr_sched_lags;	/* usecs each op was issued late */
+u_int64_t aggr_num_sched_lags;
+
 u_int64_t aggr_op_counts[IOSHARK_MAX_FILE_OP];
 struct rw_bytes_s aggr_io_rw_bytes;
 struct rw_bytes_s aggr_create_rw_bytes;
+int staged_files_created;
+int staged_files_reused;
+u_int64_t staged_bytes_reused;
 
 /*
  * Locking needed here because aggregate_delay_time is updated
@@ -136,6 +154,87 @@ update_byte_counts(struct rw_bytes_s *dest, struct rw_bytes_s *delta)
 	pthread_mutex_unlock(&stats_mutex);
 }
 
+static void
+update_sched_lags(u_int32_t *lags, u_int64_t num_lags)
+{
+	pthread_mutex_lock(&stats_mutex);
+	aggr_sched_lags = realloc(aggr_sched_lags,
+				  (aggr_num_sched_lags + num_lags) *
+				  sizeof(u_int32_t));
+	if (aggr_sched_lags == NULL) {
+		fprintf(stderr, "%s Can't allocate schedule lags\n",
+			progname);
+		exit(EXIT_FAILURE);
+	}
+	memcpy(aggr_sched_lags + aggr_num_sched_lags, lags,
+	       num_lags * sizeof(u_int32_t));
+	aggr_num_sched_lags += num_lags;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+static u_int64_t
+timespec_to_ns(struct timespec *ts)
+{
+	return ((u_int64_t)ts->tv_sec * 1000000000ULL) + ts->tv_nsec;
+}
+
+static void
+ns_to_timespec(u_int64_t ns, struct timespec *ts)
+{
+	ts->tv_sec = ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+}
+
+/*
+ * Sleep until the absolute deadline, returns how late (in usecs) we
+ * actually got to run.
+ */
+static u_int32_t
+pace_until(u_int64_t deadline_ns)
+{
+	struct timespec ts;
+	u_int64_t now_ns;
+
+	ns_to_timespec(deadline_ns, &ts);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts,
+			       NULL) == EINTR)
+		;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	now_ns = timespec_to_ns(&ts);
+	if (now_ns <= deadline_ns)
+		return 0;
+	return MIN((now_ns - deadline_ns) / 1000, UINT32_MAX);
+}
+
+static void
+update_staging_counts(int created, int reused, u_int64_t bytes_reused)
+{
+	pthread_mutex_lock(&stats_mutex);
+	staged_files_created += created;
+	staged_files_reused += reused;
+	staged_bytes_reused += bytes_reused;
+	pthread_mutex_unlock(&stats_mutex);
+}
+
+/*
+ * With -p, the files of each workload live in
+ * <staging_dir>/<workload checksum>/ and are kept across runs.
+ */
+static void
+get_staging_dir(char *path, struct thread_state_s *state)
+{
+	snprintf(path, MAX_IOSHARK_PATHLEN, "%s/%016"PRIx64"",
+		 staging_dir, state->staging_key);
+}
+
+static void
+get_staging_path(char *path, struct thread_state_s *state,
+		 u_int64_t fileno)
+{
+	snprintf(path, MAX_IOSHARK_PATHLEN, "%s/%016"PRIx64"/file.%"PRIu64"",
+		 staging_dir, state->staging_key, fileno);
+}
+
 static int work_next_file;
 static int work_num_files;
 
@@ -171,8 +270,14 @@ create_files(struct thread_state_s *state)
 	struct rw_bytes_s rw_bytes;
 	char *filename;
 	int readonly;
+	int created = 0, reused = 0;
+	u_int64_t bytes_reused = 0;
 
 	memset(&rw_bytes, 0, sizeof(struct rw_bytes_s));
+	if (staging_dir != NULL) {
+		get_staging_dir(path, state);
+		state->staging = staging_open(path, state->num_files);
+	}
 	for (i = 0 ; i < state->num_files ; i++) {
 		if (ioshark_read_file_state(state->fp, &file_state) != 1) {
 			fprintf(stderr, "%s read error tracefile\n",
@@ -190,11 +295,29 @@ create_files(struct thread_state_s *state)
 			assert(filename != NULL);
 		if (quick_mode == 0 ||
 		    is_readonly_mount(filename, file_state.size) == 0) {
-			sprintf(path, "file.%d.%"PRIu64"",
-				(int)(state - thread_state),
-				file_state.fileno);
-			create_file(path, file_state.size,
-				    &rw_bytes);
+			if (staging_dir == NULL) {
+				sprintf(path, "file.%d.%"PRIu64"",
+					(int)(state - thread_state),
+					file_state.fileno);
+				create_file(path, file_state.size,
+					    &rw_bytes);
+			} else {
+				get_staging_path(path, state,
+						 file_state.fileno);
+				if (staging_lookup(state->staging, i,
+						   file_state.fileno,
+						   file_state.size, path)) {
+					reused++;
+					bytes_reused += file_state.size;
+				} else {
+					stage_file(path, file_state.size,
+						   &rw_bytes);
+					staging_record(state->staging, i,
+						       file_state.fileno,
+						       file_state.size, path);
+					created++;
+				}
+			}
 			filename = path;
 			readonly = 0;
 		} else {
@@ -207,6 +330,49 @@ create_files(struct thread_state_s *state)
 		files_db_update_filename(db_node, filename);
 	}
 	update_byte_counts(&aggr_create_rw_bytes, &rw_bytes);
+	if (staging_dir != NULL) {
+		staging_commit(state->staging);
+		update_staging_counts(created, reused, bytes_reused);
+	}
+}
+
+/*
+ * Instead of unlinking the staged files, record their state after the
+ * replay so the next run can tell which ones are still usable.
+ */
+static void
+update_staged_files(struct thread_state_s *state)
+{
+	int i;
+	struct ioshark_header header;
+	struct ioshark_file_state file_state;
+	char path[MAX_IOSHARK_PATHLEN];
+	void *db_node;
+
+	files_db_close_files(state->db_handle);
+	rewind(state->fp);
+	if (ioshark_read_header(state->fp, &header) != 1) {
+		fprintf(stderr, "%s read error %s\n",
+			progname, state->filename);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0 ; i < state->num_files ; i++) {
+		if (ioshark_read_file_state(state->fp, &file_state) != 1) {
+			fprintf(stderr, "%s read error tracefile\n",
+				progname);
+			exit(EXIT_FAILURE);
+		}
+		db_node = files_db_lookup_byfileno(state->db_handle,
+						   file_state.fileno);
+		if (db_node == NULL || files_db_readonly(db_node))
+			continue;
+		get_staging_path(path, state, file_state.fileno);
+		staging_record(state->staging, i, file_state.fileno,
+			       file_state.size, path);
+	}
+	staging_commit(state->staging);
+	staging_free(state->staging);
+	state->staging = NULL;
 }
 
 static void
@@ -404,6 +570,10 @@ do_io(struct thread_state_s *state)
 	struct timeval total_delay_time;
 	u_int64_t op_counts[IOSHARK_MAX_FILE_OP];
 	struct rw_bytes_s rw_bytes;
+	struct timespec now;
+	u_int64_t start_ns = 0, trace_us = 0;
+	u_int32_t *lags = NULL;
+	u_int64_t num_lags = 0;
 
 	rewind(state->fp);
 	if (ioshark_read_header(state->fp, &header) != 1) {
@@ -421,6 +591,23 @@ do_io(struct thread_state_s *state)
 	      sizeof(struct ioshark_header) +
 	      header.num_files * sizeof(struct ioshark_file_state),
 	      SEEK_SET);
+	if (do_pace) {
+		/*
+		 * Workloads started together are paced from the shared
+		 * epoch. If there are fewer threads than workloads, the
+		 * later ones start from whenever a thread picks them up.
+		 */
+		lags = malloc(MAX(header.num_io_operations, 1) *
+			      sizeof(u_int32_t));
+		if (lags == NULL) {
+			fprintf(stderr, "%s Can't allocate schedule lags\n",
+				progname);
+			exit(EXIT_FAILURE);
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		start_ns = MAX(timespec_to_ns(&replay_epoch),
+			       timespec_to_ns(&now));
+	}
 	/*
 	 * Loop over all the IOs, and launch each
 	 */
@@ -430,11 +617,25 @@ do_io(struct thread_state_s *state)
 				progname);
 			goto fail;
 		}
-		if (do_delay) {
+		if (do_pace) {
 			struct timeval start;
 
+			/*
+			 * Deadlines are absolute, so time spent doing the
+			 * IO and oversleeping is not carried forward.
+			 */
+			trace_us += file_op.delta_us;
 			(void)gettimeofday(&start, (struct timezone *)NULL);
-			usleep(file_op.delta_us);
+			lags[num_lags++] =
+				pace_until(start_ns +
+					   (u_int64_t)(trace_us * 1000.0 /
+						       replay_speed));
+			update_delta_time(&start, &total_delay_time);
+		} else if (do_delay) {
+			struct timeval start;
+
+			(void)gettimeofday(&start, (struct timezone *)NULL);
+			usleep(file_op.delta_us / replay_speed);
 			update_delta_time(&start, &total_delay_time);
 		}
 		db_node = files_db_lookup_byfileno(state->db_handle,
@@ -480,6 +681,10 @@ do_io(struct thread_state_s *state)
 	free(buf);
 	files_db_fsync_discard_files(state->db_handle);
 	files_db_close_files(state->db_handle);
+	if (do_pace) {
+		update_sched_lags(lags, num_lags);
+		free(lags);
+	}
 	update_time(&aggregate_delay_time, &total_delay_time);
 	update_op_counts(op_counts);
 	update_byte_counts(&aggr_io_rw_bytes, &rw_bytes);
@@ -487,6 +692,7 @@ do_io(struct thread_state_s *state)
 
 fail:
 	free(buf);
+	free(lags);
 	exit(EXIT_FAILURE);
 }
 
@@ -538,6 +744,8 @@ get_start_end(int *start_ix)
 	struct ioshark_header header;
 	struct ioshark_file_state file_state;
 	struct statfs fsstat;
+	struct stat st;
+	char path[MAX_IOSHARK_PATHLEN];
 	static int fssize_clamp_next_index = 0;
 	static int chunk = 0;
 
@@ -572,6 +780,15 @@ get_start_end(int *start_ix)
 			    !is_readonly_mount(
 				    get_ro_filename(file_state.global_filename_ix),
 				    file_state.size)) {
+				/* Already staged files need no more space */
+				if (staging_dir != NULL) {
+					get_staging_path(path, &thread_state[i],
+							 file_state.fileno);
+					if (stat(path, &st) == 0 &&
+					    (u_int64_t)st.st_size >=
+					    file_state.size)
+						continue;
+				}
 				if (file_state.size > free_fs_bytes) {
 					fclose(fp);
 					goto out;
@@ -669,8 +886,17 @@ main(int argc, char **argv)
 	struct thread_state_s *state;
 
 	progname = argv[0];
-        while ((c = getopt(argc, argv, "b:dn:st:qv")) != EOF) {
+        while ((c = getopt(argc, argv, "ab:dn:p:st:qvx:")) != EOF) {
                 switch (c) {
+                case 'a':
+			/*
+			 * Preserve the delays, but as absolute deadlines
+			 * from a start time shared by all the threads, so
+			 * IO and oversleep don't accumulate into drift.
+			 */
+			do_pace = 1;
+			do_delay = 1;
+			break;
                 case 'b':
 			blockdev_name = strdup(optarg);
 			break;
@@ -680,6 +906,9 @@ main(int argc, char **argv)
                 case 'n':
 			num_iterations = atoi(optarg);
 			break;
+                case 'p':
+			staging_dir = strdup(optarg);
+			break;
                 case 's':
 			/* Non-verbose summary mode for nightly runs */
 			summary_mode = 1;
@@ -698,6 +927,11 @@ main(int argc, char **argv)
                 case 'v':
 			verbose = 1;
 			break;
+                case 'x':
+			replay_speed = atof(optarg);
+			if (replay_speed <= 0)
+				usage();
+			break;
  	        default:
 			usage();
 		}
@@ -714,6 +948,13 @@ main(int argc, char **argv)
 
 	sizeup_fd_limits();
 
+	if (staging_dir != NULL &&
+	    mkdir(staging_dir, 0755) < 0 && errno != EEXIST) {
+		fprintf(stderr, "%s: Can't create staging dir %s: %m\n",
+			progname, staging_dir);
+		exit(EXIT_FAILURE);
+	}
+
 	for (i = optind; i < argc; i++) {
 		infile = argv[i];
 		if (stat(infile, &st) < 0) {
@@ -734,6 +975,9 @@ main(int argc, char **argv)
 		}
 		thread_state[num_input_files].filename = infile;
 		thread_state[num_input_files].fp = fp;
+		if (staging_dir != NULL)
+			thread_state[num_input_files].staging_key =
+				ioshark_workload_checksum(fp);
 		num_input_files++;
 	}
 
@@ -767,7 +1011,9 @@ main(int argc, char **argv)
 		struct timeval time_for_pass;
 
 		/* Create files once */
-		if (!summary_mode)
+		if (!summary_mode && staging_dir != NULL)
+			printf("Doing Staging of Files in %s\n", staging_dir);
+		else if (!summary_mode)
 			printf("Doing Pre-creation of Files\n");
 		if (quick_mode && !summary_mode)
 			printf("Skipping Pre-creation of read-only Files\n");
@@ -801,6 +1047,13 @@ main(int argc, char **argv)
 			init_work(start_file, num_files);
 			(void)gettimeofday(&time_for_pass,
 					   (struct timezone *)NULL);
+			if (do_pace) {
+				/* Leave the threads time to get going */
+				clock_gettime(CLOCK_MONOTONIC, &replay_epoch);
+				ns_to_timespec(timespec_to_ns(&replay_epoch) +
+					       PACE_START_LEAD_NS,
+					       &replay_epoch);
+			}
 			for (c = 0; c < num_threads; c++) {
 				if (ioshark_pthread_create(&(tid[c]),
 							   io_thread)) {
@@ -817,22 +1070,33 @@ main(int argc, char **argv)
 
 		/*
 		 * We are done with the N iterations of IO.
-		 * Destroy the files we pre-created.
+		 * Destroy the files we pre-created (staged files are kept).
 		 */
 		init_work(start_file, num_files);
 		while ((state = get_work())) {
 			struct timeval start;
 
 			(void)gettimeofday(&start, (struct timezone *)NULL);
-			files_db_unlink_files(state->db_handle);
+			if (staging_dir != NULL)
+				update_staged_files(state);
+			else
+				files_db_unlink_files(state->db_handle);
 			update_delta_time(&start, &aggregate_file_remove_time);
 			files_db_free_memory(state->db_handle);
 		}
 	}
 	if (!summary_mode) {
-		printf("Total Creation time = %ju.%ju (msecs.usecs)\n",
-		       get_msecs(&aggregate_file_create_time),
-		       get_usecs(&aggregate_file_create_time));
+		if (staging_dir != NULL) {
+			printf("Total Staging time = %ju.%ju (msecs.usecs)\n",
+			       get_msecs(&aggregate_file_create_time),
+			       get_usecs(&aggregate_file_create_time));
+			printf("Staged Files : %d created, %d reused (%ju KB)\n",
+			       staged_files_created, staged_files_reused,
+			       staged_bytes_reused / 1024);
+		} else
+			printf("Total Creation time = %ju.%ju (msecs.usecs)\n",
+			       get_msecs(&aggregate_file_create_time),
+			       get_usecs(&aggregate_file_create_time));
 		printf("Total Remove time = %ju.%ju (msecs.usecs)\n",
 		       get_msecs(&aggregate_file_remove_time),
 		       get_usecs(&aggregate_file_remove_time));
@@ -840,6 +1104,9 @@ main(int argc, char **argv)
 			printf("Total delay time = %ju.%ju (msecs.usecs)\n",
 			       get_msecs(&aggregate_delay_time),
 			       get_usecs(&aggregate_delay_time));
+		if (do_pace)
+			print_sched_lags("Schedule lag", aggr_sched_lags,
+					 aggr_num_sched_lags);
 		printf("Total Test (IO) time = %ju.%ju (msecs.usecs)\n",
 		       get_msecs(&aggregate_IO_time),
 		       get_usecs(&aggregate_IO_time));
@@ -861,6 +1128,9 @@ main(int argc, char **argv)
 			printf("%ju.%ju ",
 			       get_msecs(&aggregate_delay_time),
 			       get_usecs(&aggregate_delay_time));
+		if (do_pace)
+			print_sched_lags(NULL, aggr_sched_lags,
+					 aggr_num_sched_lags);
 		printf("%ju.%ju ",
 		       get_msecs(&aggregate_IO_time),
 		       get_usecs(&aggregate_IO_time));
@@ -868,6 +1138,7 @@ main(int argc, char **argv)
 		report_cpu_disk_util();
 		printf("\n");
 	}
+	free(aggr_sched_lags);
 	if (quick_mode)
 		free_filename_cache();
 }
@@ -38,6 +38,7 @@ const char *IO_op[] = {
 #define MIN(A, B)	((A) < (B) ? (A) : (B))
 
 #define MINBUFLEN	(16*1024)
+#define STAGEBUFLEN	(1024*1024)
 
 #define FILE_DB_HASHSIZE	8192
 
@@ -55,6 +56,20 @@ struct files_db_handle {
 	struct files_db_s *files_db_buckets[FILE_DB_HASHSIZE];
 };
 
+struct staged_file_s {
+	int valid;
+	u_int64_t fileno;
+	u_int64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+};
+
+struct staging_handle {
+	char *dir;
+	u_int64_t num_files;
+	struct staged_file_s *files;	/* indexed like the file state table */
+};
+
 struct IO_operation_s {
 	char *IO_op;
 };
@@ -137,10 +152,21 @@ void files_db_close_fd(void *node);
 void files_db_free_memory(void *handle);
 void create_file(char *path, size_t size,
 		 struct rw_bytes_s *rw_bytes);
+void stage_file(char *path, size_t size,
+		struct rw_bytes_s *rw_bytes);
+u_int64_t ioshark_workload_checksum(FILE *fp);
+void *staging_open(char *dir, u_int64_t num_files);
+int staging_lookup(void *handle, u_int64_t ix, u_int64_t fileno, size_t size,
+		   char *path);
+void staging_record(void *handle, u_int64_t ix, u_int64_t fileno, size_t size,
+		    char *path);
+void staging_commit(void *handle);
+void staging_free(void *handle);
 char *get_buf(char **buf, int *buflen, int len, int do_fill);
 void files_db_fsync_discard_files(void *handle);
 void print_op_stats(u_int64_t *op_counts);
 void print_bytes(char *desc, struct rw_bytes_s *rw_bytes);
+void print_sched_lags(char *desc, u_int32_t *lags, u_int64_t num_lags);
 void ioshark_handle_mmap(void *db_node,
 			 struct ioshark_file_operation *file_op,
 			 char **bufp, int *buflen, u_int64_t *op_counts,
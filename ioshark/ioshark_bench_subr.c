@@ -304,6 +304,267 @@ create_file(char *path, size_t size, struct rw_bytes_s *rw_bytes)
 	close(fd);
 }
 
+static int
+compare_lags(const void *a, const void *b)
+{
+	u_int32_t x = *(const u_int32_t *)a, y = *(const u_int32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/*
+ * Percentiles of how late ops were issued relative to their deadline
+ * (in usecs). Sorts lags in place.
+ */
+void
+print_sched_lags(char *desc, u_int32_t *lags, u_int64_t num_lags)
+{
+	u_int32_t p50 = 0, p90 = 0, p99 = 0, p999 = 0, max = 0;
+
+	if (num_lags > 0) {
+		qsort(lags, num_lags, sizeof(u_int32_t), compare_lags);
+		p50 = lags[(num_lags - 1) * 50 / 100];
+		p90 = lags[(num_lags - 1) * 90 / 100];
+		p99 = lags[(num_lags - 1) * 99 / 100];
+		p999 = lags[(num_lags - 1) * 999 / 1000];
+		max = lags[num_lags - 1];
+	}
+	if (!summary_mode)
+		printf("%s (usecs): p50 = %u, p90 = %u, p99 = %u, p99.9 = %u, max = %u\n",
+		       desc, p50, p90, p99, p999, max);
+	else
+		printf("%u %u %u ", p50, p99, max);
+}
+
+/*
+ * Used for creating files in a persistent staging directory. Unlike
+ * create_file(), the blocks are reserved up front with fallocate() and the
+ * data is written in large chunks without a per file fsync. The caller
+ * syncs the whole filesystem once staging is done (staging_commit()).
+ * Note that the data is still written, reads from unwritten extents
+ * would never hit the disk.
+ */
+void
+stage_file(char *path, size_t size, struct rw_bytes_s *rw_bytes)
+{
+	int fd, n;
+	char *buf = NULL;
+	int buflen = 0;
+
+	fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "%s Cannot create file %s: %m\n", progname, path);
+		exit(EXIT_FAILURE);
+	}
+	if (size > 0 && fallocate(fd, 0, 0, size) < 0 &&
+	    errno != EOPNOTSUPP) {
+		fprintf(stderr, "%s Cannot fallocate file %s: %m\n",
+			progname, path);
+		exit(EXIT_FAILURE);
+	}
+	while (size > 0) {
+		n = MIN(size, STAGEBUFLEN);
+		buf = get_buf(&buf, &buflen, n, 1);
+		if (write(fd, buf, n) < n) {
+			fprintf(stderr,
+				"%s Cannot write file %s: %m\n", progname, path);
+			free(buf);
+			exit(EXIT_FAILURE);
+		}
+		rw_bytes->bytes_written += n;
+		size -= n;
+	}
+	free(buf);
+	close(fd);
+}
+
+/*
+ * FNV-1a over the raw (on disk) header and file state table of a
+ * workload file. This identifies the set of files the workload needs,
+ * and so names its staging directory. Leaves fp rewound.
+ */
+u_int64_t
+ioshark_workload_checksum(FILE *fp)
+{
+	struct ioshark_header header;
+	struct ioshark_file_state file_state;
+	u_int64_t checksum = 0xcbf29ce484222325ULL;
+	u_int64_t i, num_files;
+	unsigned char *p;
+	size_t j;
+
+	rewind(fp);
+	if (fread(&header, sizeof(struct ioshark_header), 1, fp) != 1)
+		return 0;
+	p = (unsigned char *)&header;
+	for (j = 0 ; j < sizeof(struct ioshark_header) ; j++) {
+		checksum ^= p[j];
+		checksum *= 0x100000001b3ULL;
+	}
+	num_files = be64toh(header.num_files);
+	for (i = 0 ; i < num_files ; i++) {
+		if (fread(&file_state, sizeof(struct ioshark_file_state),
+			  1, fp) != 1)
+			break;
+		p = (unsigned char *)&file_state;
+		for (j = 0 ; j < sizeof(struct ioshark_file_state) ; j++) {
+			checksum ^= p[j];
+			checksum *= 0x100000001b3ULL;
+		}
+	}
+	rewind(fp);
+	return checksum;
+}
+
+/*
+ * A staging directory holds the files of one workload, plus a MANIFEST
+ * with one line per entry in the file state table : valid flag, fileno,
+ * size and mtime of the staged file. A staged file is reused if its size and
+ * mtime still match the manifest.
+ */
+void *
+staging_open(char *dir, u_int64_t num_files)
+{
+	struct staging_handle *h;
+	char path[MAX_IOSHARK_PATHLEN];
+	FILE *fp;
+	u_int64_t i;
+
+	if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+		fprintf(stderr, "%s Cannot create staging dir %s: %m\n",
+			progname, dir);
+		exit(EXIT_FAILURE);
+	}
+	h = malloc(sizeof(struct staging_handle));
+	if (h == NULL) {
+		fprintf(stderr, "%s Can't allocate staging handle\n",
+			progname);
+		exit(EXIT_FAILURE);
+	}
+	h->dir = strdup(dir);
+	if (h->dir == NULL) {
+		fprintf(stderr, "%s Can't allocate staging dir name\n",
+			progname);
+		exit(EXIT_FAILURE);
+	}
+	h->num_files = num_files;
+	h->files = calloc(num_files, sizeof(struct staged_file_s));
+	if (num_files > 0 && h->files == NULL) {
+		fprintf(stderr, "%s Can't allocate staging manifest\n",
+			progname);
+		exit(EXIT_FAILURE);
+	}
+	snprintf(path, sizeof(path), "%s/MANIFEST", dir);
+	fp = fopen(path, "r");
+	if (fp == NULL)
+		return h;
+	for (i = 0 ; i < num_files ; i++) {
+		struct staged_file_s *f = &h->files[i];
+
+		if (fscanf(fp, "%d %"SCNu64" %"SCNu64" %"SCNd64" %"SCNd64"\n",
+			   &f->valid, &f->fileno, &f->size, &f->mtime_sec,
+			   &f->mtime_nsec) != 5) {
+			memset(f, 0, sizeof(struct staged_file_s));
+			break;
+		}
+	}
+	fclose(fp);
+	return h;
+}
+
+int
+staging_lookup(void *handle, u_int64_t ix, u_int64_t fileno, size_t size,
+	       char *path)
+{
+	struct staging_handle *h = (struct staging_handle *)handle;
+	struct staged_file_s *f = &h->files[ix];
+	struct stat st;
+
+	if (!f->valid || f->fileno != fileno || f->size != size)
+		return 0;
+	if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+		return 0;
+	return ((u_int64_t)st.st_size == size &&
+		st.st_mtim.tv_sec == f->mtime_sec &&
+		st.st_mtim.tv_nsec == f->mtime_nsec);
+}
+
+/*
+ * Record the current state of a staged file. Files the replay truncated
+ * or extended are dropped from the manifest and get staged again.
+ */
+void
+staging_record(void *handle, u_int64_t ix, u_int64_t fileno, size_t size,
+	       char *path)
+{
+	struct staging_handle *h = (struct staging_handle *)handle;
+	struct staged_file_s *f = &h->files[ix];
+	struct stat st;
+
+	memset(f, 0, sizeof(struct staged_file_s));
+	if (stat(path, &st) < 0 || (u_int64_t)st.st_size != size)
+		return;
+	f->fileno = fileno;
+	f->size = size;
+	f->mtime_sec = st.st_mtim.tv_sec;
+	f->mtime_nsec = st.st_mtim.tv_nsec;
+	f->valid = 1;
+}
+
+/*
+ * Flush the staged data and atomically replace the manifest.
+ */
+void
+staging_commit(void *handle)
+{
+	struct staging_handle *h = (struct staging_handle *)handle;
+	char path[MAX_IOSHARK_PATHLEN], tmp_path[MAX_IOSHARK_PATHLEN];
+	FILE *fp;
+	u_int64_t i;
+	int fd;
+
+	fd = open(h->dir, O_RDONLY|O_DIRECTORY);
+	if (fd < 0 || syncfs(fd) < 0) {
+		fprintf(stderr, "%s Cannot sync staging dir %s: %m\n",
+			progname, h->dir);
+		exit(EXIT_FAILURE);
+	}
+	close(fd);
+	snprintf(path, sizeof(path), "%s/MANIFEST", h->dir);
+	snprintf(tmp_path, sizeof(tmp_path), "%s/MANIFEST.tmp", h->dir);
+	fp = fopen(tmp_path, "w");
+	if (fp == NULL) {
+		fprintf(stderr, "%s Cannot create %s: %m\n",
+			progname, tmp_path);
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0 ; i < h->num_files ; i++)
+		fprintf(fp, "%d %"PRIu64" %"PRIu64" %"PRId64" %"PRId64"\n",
+			h->files[i].valid, h->files[i].fileno, h->files[i].size,
+			h->files[i].mtime_sec, h->files[i].mtime_nsec);
+	if (fflush(fp) != 0 || fsync(fileno(fp)) < 0) {
+		fprintf(stderr, "%s Cannot write %s: %m\n",
+			progname, tmp_path);
+		exit(EXIT_FAILURE);
+	}
+	fclose(fp);
+	if (rename(tmp_path, path) < 0) {
+		fprintf(stderr, "%s Cannot rename %s: %m\n",
+			progname, tmp_path);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+staging_free(void *handle)
+{
+	struct staging_handle *h = (struct staging_handle *)handle;
+
+	free(h->files);
+	free(h->dir);
+	free(h);
+}
+
 void
 print_op_stats(u_int64_t *op_counts)
 {
@@ -131,6 +131,7 @@ int parse_avb_image(fec_handle *f, const std::vector<uint8_t> &vbmeta) {
     f->ecc.start = hashtree_descriptor.fec_offset;
     // TODO(xunchang) verify the integrity of the ecc data.
     f->ecc.valid = true;
+    f->ecc.validated = true;
 
     std::string hash_algorithm =
         reinterpret_cast<char *>(hashtree_descriptor.hash_algorithm);
@@ -18,6 +18,8 @@
 #include <sys/ioctl.h>
 #include <sys/stat.h>
 
+#include <algorithm>
+
 #include <ext4_utils/ext4_sb.h>
 #include <squashfs_utils.h>
 
@@ -159,38 +161,87 @@ static int parse_ecc_header(fec_handle *f, uint64_t offset)
     f->ecc.size = header.fec_size;
     f->ecc.start = header.inp_size;
 
-    /* validate encoding data; caller may opt not to use it if invalid */
+    f->ecc.validated = false;
+    memcpy(f->ecc.hash, header.hash, SHA256_DIGEST_LENGTH);
+
+    if (f->flags & FEC_ECC_DEFER_VALIDATION) {
+        /* decoding does not depend on `f->ecc.valid', so the data is only
+           hashed once the caller asks for it in `fec_ecc_get_metadata' */
+        return 0;
+    }
+
+    return ecc_validate(f);
+}
+
+/* computes the SHA-256 digest of `size' bytes of ecc data starting from
+   `offset' in `fd' and stores it in `hash' */
+static int hash_ecc_data(int fd, uint64_t offset, uint32_t size, uint8_t *hash)
+{
+#if defined(__linux__)
+    /* start readahead for the whole region, so that the kernel keeps the
+       device busy while we are hashing the previous chunk */
+    posix_fadvise(fd, offset, size, POSIX_FADV_WILLNEED);
+#endif
+
+    uint32_t len = std::min<uint32_t>(size, FEC_ECC_HASH_CHUNK);
+    std::unique_ptr<uint8_t[]> buf(new (std::nothrow) uint8_t[len]);
+
+    if (unlikely(!buf)) {
+        error("failed to allocate ecc buffer");
+        errno = ENOMEM;
+        return -1;
+    }
+
     SHA256_CTX ctx;
     SHA256_Init(&ctx);
 
-    uint8_t buf[FEC_BLOCKSIZE];
     uint32_t n = 0;
-    uint32_t len = FEC_BLOCKSIZE;
 
-    while (n < f->ecc.size) {
-        if (len > f->ecc.size - n) {
-            len = f->ecc.size - n;
+    while (n < size) {
+        if (len > size - n) {
+            len = size - n;
         }
 
-        if (!raw_pread(f->fd, buf, len, f->ecc.start + n)) {
+        if (!raw_pread(fd, buf.get(), len, offset + n)) {
             error("failed to read ecc: %s", strerror(errno));
             return -1;
         }
 
-        SHA256_Update(&ctx, buf, len);
+        SHA256_Update(&ctx, buf.get(), len);
         n += len;
     }
 
-    uint8_t hash[SHA256_DIGEST_LENGTH];
     SHA256_Final(hash, &ctx);
+    return 0;
+}
+
+/* validates encoding data against the hash in the ecc header unless already
+   done; caller may opt not to use the data if invalid */
+int ecc_validate(fec_handle *f)
+{
+    check(f);
+
+    pthread_mutex_lock(&f->mutex);
+
+    int rc = 0;
+
+    if (!f->ecc.validated) {
+        uint8_t hash[SHA256_DIGEST_LENGTH];
 
-    f->ecc.valid = !memcmp(hash, header.hash, SHA256_DIGEST_LENGTH);
+        rc = hash_ecc_data(f->fd, f->ecc.start, f->ecc.size, hash);
 
-    if (!f->ecc.valid) {
-        warn("ecc data not valid");
+        if (rc == 0) {
+            f->ecc.valid = !memcmp(hash, f->ecc.hash, SHA256_DIGEST_LENGTH);
+            f->ecc.validated = true;
+
+            if (!f->ecc.valid) {
+                warn("ecc data not valid");
+            }
+        }
     }
 
-    return 0;
+    pthread_mutex_unlock(&f->mutex);
+    return rc;
 }
 
 /* attempts to read an ecc header from `offset', and checks for a backup copy
@@ -397,6 +448,7 @@ static void reset_handle(fec_handle *f)
     f->flags = 0;
     f->mode = 0;
     f->errors = 0;
+    f->readers = 0;
     f->data_size = 0;
     f->pos = 0;
     f->size = 0;
@@ -470,6 +522,10 @@ int fec_ecc_get_metadata(struct fec_handle *f, struct fec_ecc_metadata *data)
     check(f->ecc.start < f->size);
     check(f->ecc.start % FEC_BLOCKSIZE == 0);
 
+    if (ecc_validate(f) == -1) {
+        return -1;
+    }
+
     data->valid = f->ecc.valid;
     data->roots = f->ecc.roots;
     data->blocks = f->ecc.blocks;
@@ -25,6 +25,7 @@
 #include <sys/syscall.h>
 #include <unistd.h>
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -41,6 +42,9 @@
 #define WORK_MIN_THREADS 1
 #define WORK_MAX_THREADS 64
 
+/* ecc validation parameters */
+#define FEC_ECC_HASH_CHUNK (1024 * 1024)
+
 /* verity parameters */
 #define VERITY_CACHE_BLOCKS 4096
 #define VERITY_NO_CACHE UINT64_MAX
@@ -68,6 +72,8 @@ struct verity_header {
 /* file handle */
 struct ecc_info {
     bool valid;
+    bool validated;
+    uint8_t hash[SHA256_DIGEST_LENGTH]; /* from the ecc header */
     int roots;
     int rsn;
     uint32_t size;
@@ -93,7 +99,8 @@ struct hashtree_info {
 
     // Checks if the bytes in 'block' has the expected hash. And the 'index' is
     // the block number of is the input block in the filesystem.
-    bool check_block_hash_with_index(uint64_t index, const uint8_t *block);
+    bool check_block_hash_with_index(uint64_t index,
+                                     const uint8_t *block) const;
 
     // Reads the verity hash tree, validates it against the root hash in `root',
     // corrects errors if necessary, and copies valid data blocks for later use
@@ -106,10 +113,10 @@ struct hashtree_info {
 
     // Computes the hash for FEC_BLOCKSIZE bytes from buffer 'block' and
     // compares it to the expected value in 'expected'.
-    bool check_block_hash(const uint8_t *expected, const uint8_t *block);
+    bool check_block_hash(const uint8_t *expected, const uint8_t *block) const;
 
     // Computes the hash of 'block' and put the result in 'hash'.
-    int get_hash(const uint8_t *block, uint8_t *hash);
+    int get_hash(const uint8_t *block, uint8_t *hash) const;
 
     int nid_;  // NID for the hash algorithm.
     uint32_t digest_length_;
@@ -137,15 +144,17 @@ struct fec_handle {
     int flags; /* additional flags passed to fec_open */
     int mode; /* mode for open(2) */
     pthread_mutex_t mutex;
-    uint64_t errors;
+    std::atomic<uint64_t> errors;
+    std::atomic<int> readers; /* concurrent fec_pread calls */
     uint64_t data_size;
-    uint64_t pos;
+    uint64_t pos; /* for fec_read and fec_seek, which are not thread-safe */
     uint64_t size;
     // TODO(xunchang) switch to std::optional
     verity_info verity;
     avb_info avb;
 
-    hashtree_info hashtree() const {
+    /* returns a reference to avoid copying the hash data on every read */
+    const hashtree_info &hashtree() const {
         return avb.valid ? avb.hashtree : verity.hashtree;
     }
 };
@@ -154,6 +163,9 @@ struct fec_handle {
 extern bool raw_pread(int fd, void *buf, size_t count, uint64_t offset);
 extern bool raw_pwrite(int fd, const void *buf, size_t count, uint64_t offset);
 
+/* ecc functions */
+extern int ecc_validate(fec_handle *f);
+
 /* processing functions */
 typedef ssize_t (*read_func)(fec_handle *f, uint8_t *dest, size_t count,
         uint64_t offset, size_t *errors);
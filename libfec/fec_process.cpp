@@ -27,6 +27,19 @@ struct process_info {
     size_t errors;
 };
 
+/* counts the callers of `process' on a handle while in scope */
+class reader_guard {
+   public:
+    explicit reader_guard(fec_handle *f) : f_(f), readers_(++f->readers) {}
+    ~reader_guard() { --f_->readers; }
+
+    int readers() const { return readers_; }
+
+   private:
+    fec_handle *f_;
+    int readers_;
+};
+
 /* thread function  */
 static void * __process(void *cookie)
 {
@@ -51,7 +64,10 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
         return 0;
     }
 
-    int threads = sysconf(_SC_NPROCESSORS_ONLN);
+    /* concurrent callers on the same handle share the processors instead of
+       each starting a thread per processor */
+    reader_guard guard(f);
+    int threads = sysconf(_SC_NPROCESSORS_ONLN) / guard.readers();
 
     if (threads < WORK_MIN_THREADS) {
         threads = WORK_MIN_THREADS;
@@ -76,6 +92,20 @@ ssize_t process(fec_handle *f, uint8_t *buf, size_t count, uint64_t offset,
     debug("%d threads, %zu bytes per thread (total %zu)", threads,
         count_per_thread, count);
 
+    /* not worth starting a thread for a single range */
+    if (threads == 1) {
+        size_t errors = 0;
+        ssize_t rc = func(f, buf, count, offset, &errors);
+
+        if (rc == -1) {
+            errno = EIO;
+            return -1;
+        }
+
+        f->errors += errors;
+        return rc;
+    }
+
     std::vector<pthread_t> handles;
     process_info info[threads];
     ssize_t rc = 0;
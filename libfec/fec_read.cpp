@@ -85,7 +85,7 @@ static inline bool is_erasure(fec_handle *f, uint64_t offset,
 /* check if `offset' is within a block expected to contain zeros */
 static inline bool is_zero(fec_handle *f, uint64_t offset)
 {
-    auto hashtree = f->hashtree();
+    const hashtree_info &hashtree = f->hashtree();
 
     if (hashtree.hash_data.empty() || unlikely(offset >= f->data_size)) {
         return false;
@@ -289,25 +289,24 @@ static ssize_t verity_read(fec_handle *f, uint8_t *dest, size_t count,
     check(dest);
     check(offset < f->data_size);
     check(offset + count <= f->data_size);
-    check(!f->hashtree().hash_data.empty());
     check(errors);
 
+    const hashtree_info &hashtree = f->hashtree();
+    check(!hashtree.hash_data.empty());
+
     debug("[%" PRIu64 ", %" PRIu64 ")", offset, offset + count);
 
+    /* the decoder is only set up once a corrupted block is found */
     rs_unique_ptr rs(NULL, free_rs_char);
     std::unique_ptr<uint8_t[]> ecc_data;
 
-    if (f->ecc.start && ecc_init(f, rs, ecc_data) == -1) {
-        return -1;
-    }
-
     uint64_t curr = offset / FEC_BLOCKSIZE;
     size_t coff = (size_t)(offset - curr * FEC_BLOCKSIZE);
     size_t left = count;
     uint8_t data[FEC_BLOCKSIZE];
 
     uint64_t max_hash_block =
-        (f->hashtree().hash_data.size() - SHA256_DIGEST_LENGTH) /
+        (hashtree.hash_data.size() - SHA256_DIGEST_LENGTH) /
         SHA256_DIGEST_LENGTH;
 
     while (left > 0) {
@@ -333,7 +332,7 @@ static ssize_t verity_read(fec_handle *f, uint8_t *dest, size_t count,
             }
         }
 
-        if (likely(f->hashtree().check_block_hash_with_index(curr, data))) {
+        if (likely(hashtree.check_block_hash_with_index(curr, data))) {
             goto valid;
         }
 
@@ -354,18 +353,22 @@ static ssize_t verity_read(fec_handle *f, uint8_t *dest, size_t count,
                 offset, offset + count, curr);
         }
 
+        if (!rs && ecc_init(f, rs, ecc_data) == -1) {
+            return -1;
+        }
+
         /* try to correct without erasures first, because checking for
            erasure locations is slower */
         if (__ecc_read(f, rs.get(), data, curr_offset, false, ecc_data.get(),
                        errors) == FEC_BLOCKSIZE &&
-            f->hashtree().check_block_hash_with_index(curr, data)) {
+            hashtree.check_block_hash_with_index(curr, data)) {
             goto corrected;
         }
 
         /* try to correct with erasures */
         if (__ecc_read(f, rs.get(), data, curr_offset, true, ecc_data.get(),
                        errors) == FEC_BLOCKSIZE &&
-            f->hashtree().check_block_hash_with_index(curr, data)) {
+            hashtree.check_block_hash_with_index(curr, data)) {
             goto corrected;
         }
 
@@ -121,7 +121,7 @@ uint64_t verity_get_size(uint64_t file_size, uint32_t *verity_levels,
     return total * FEC_BLOCKSIZE;
 }
 
-int hashtree_info::get_hash(const uint8_t *block, uint8_t *hash) {
+int hashtree_info::get_hash(const uint8_t *block, uint8_t *hash) const {
     auto md = EVP_get_digestbynid(nid_);
     check(md);
     auto mdctx = EVP_MD_CTX_new();
@@ -155,21 +155,21 @@ int hashtree_info::initialize(uint64_t hash_start, uint64_t data_blocks,
 }
 
 bool hashtree_info::check_block_hash(const uint8_t *expected,
-                                     const uint8_t *block) {
+                                     const uint8_t *block) const {
     check(block);
-    std::vector<uint8_t> hash(digest_length_, 0);
+    uint8_t hash[SHA256_DIGEST_LENGTH]; /* the largest supported digest */
 
-    if (unlikely(get_hash(block, hash.data()) == -1)) {
+    if (unlikely(get_hash(block, hash) == -1)) {
         error("failed to hash");
         return false;
     }
 
     check(expected);
-    return !memcmp(expected, hash.data(), digest_length_);
+    return !memcmp(expected, hash, digest_length_);
 }
 
 bool hashtree_info::check_block_hash_with_index(uint64_t index,
-                                                const uint8_t *block) {
+                                                const uint8_t *block) const {
     check(index < data_blocks);
 
     const uint8_t *expected = &hash_data[index * padded_digest_length_];
@@ -660,3 +660,22 @@ int fec_verity_set_status(struct fec_handle *f, bool enabled)
 
     return 0;
 }
+
+/* checks data block `index' in `block' against the verity hash tree, returns
+   1 if it matches, 0 if it doesn't, and a value <0 if the block is not
+   covered by a hash tree */
+int fec_verity_check_block(struct fec_handle *f, uint64_t index,
+        const uint8_t *block)
+{
+    check(f);
+    check(block);
+
+    const hashtree_info &hashtree = f->hashtree();
+
+    if (hashtree.hash_data.empty() || index >= hashtree.data_blocks) {
+        errno = ERANGE;
+        return -1;
+    }
+
+    return hashtree.check_block_hash_with_index(index, block) ? 1 : 0;
+}
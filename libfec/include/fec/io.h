@@ -81,7 +81,10 @@ struct fec_verity_metadata {
 enum {
     FEC_FS_EXT4 = 1 << 0,
     FEC_FS_SQUASH = 1 << 1,
-    FEC_VERITY_DISABLE = 1 << 8
+    FEC_VERITY_DISABLE = 1 << 8,
+    /* validate the ecc data when fec_ecc_get_metadata is first called
+       instead of in fec_open */
+    FEC_ECC_DEFER_VALIDATION = 1 << 9
 };
 
 struct fec_handle;
@@ -100,12 +103,17 @@ extern int fec_verity_get_metadata(struct fec_handle *f,
 extern int fec_ecc_get_metadata(struct fec_handle *f,
         struct fec_ecc_metadata *data);
 
+extern int fec_verity_check_block(struct fec_handle *f, uint64_t index,
+        const uint8_t *block);
+
 extern int fec_get_status(struct fec_handle *f, struct fec_status *s);
 
 extern int fec_seek(struct fec_handle *f, int64_t offset, int whence);
 
 extern ssize_t fec_read(struct fec_handle *f, void *buf, size_t count);
 
+/* unlike fec_read, fec_pread can be called from several threads at once on
+   the same handle */
 extern ssize_t fec_pread(struct fec_handle *f, void *buf, size_t count,
         uint64_t offset);
 
@@ -185,6 +193,10 @@ namespace fec {
             return !fec_verity_set_status(handle_.get(), enabled);
         }
 
+        int check_block(uint64_t index, const uint8_t *block) {
+            return fec_verity_check_block(handle_.get(), index, block);
+        }
+
     private:
         handle handle_;
     };
@@ -0,0 +1,397 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+#include <openssl/sha.h>
+#include <verity/hash_tree_builder.h>
+
+extern "C" {
+    #include <fec.h>
+}
+
+#include "../fec_private.h"
+#include "fec/ecc.h"
+#include "fec/io.h"
+
+static constexpr uint64_t kMiB = 1024 * 1024;
+
+// An image of `data_size' zero bytes, followed by random encoding data with a
+// valid fec_header in the last block. The data is sparse, so only the ecc
+// region takes space on disk.
+class EccImage {
+   public:
+    explicit EccImage(uint64_t data_size) {
+        uint64_t blocks = data_size / FEC_BLOCKSIZE;
+        uint64_t rounds = (blocks + FEC_RSM - FEC_DEFAULT_ROOTS - 1) /
+                          (FEC_RSM - FEC_DEFAULT_ROOTS);
+        uint32_t fec_size = rounds * FEC_DEFAULT_ROOTS * FEC_BLOCKSIZE;
+
+        std::mt19937 gen(data_size);
+        std::vector<uint8_t> ecc(fec_size);
+        for (auto &b : ecc) {
+            b = gen();
+        }
+
+        fec_header header = {};
+        header.magic = FEC_MAGIC;
+        header.version = FEC_VERSION;
+        header.size = sizeof(fec_header);
+        header.roots = FEC_DEFAULT_ROOTS;
+        header.fec_size = fec_size;
+        header.inp_size = data_size;
+        SHA256(ecc.data(), ecc.size(), header.hash);
+
+        std::vector<uint8_t> block(FEC_BLOCKSIZE, 0);
+        memcpy(block.data(), &header, sizeof(header));
+
+        ok_ = ftruncate(file_.fd, data_size) == 0 &&
+              android::base::WriteFullyAtOffset(file_.fd, ecc.data(),
+                                                ecc.size(), data_size) &&
+              android::base::WriteFullyAtOffset(file_.fd, block.data(),
+                                                block.size(),
+                                                data_size + fec_size) &&
+              fsync(file_.fd) == 0;
+    }
+
+    bool ok() const { return ok_; }
+    const char *path() const { return file_.path; }
+
+    // Drops the image from the page cache, so the next open reads the
+    // encoding data from the device.
+    void drop_caches() const { posix_fadvise(file_.fd, 0, 0, POSIX_FADV_DONTNEED); }
+
+   private:
+    TemporaryFile file_;
+    bool ok_ = false;
+};
+
+// Images are expensive to create, so share them between benchmarks.
+static const EccImage *GetImage(uint64_t data_size) {
+    static std::map<uint64_t, std::unique_ptr<EccImage>> images;
+
+    auto &image = images[data_size];
+    if (!image) {
+        image.reset(new EccImage(data_size));
+    }
+    return image->ok() ? image.get() : nullptr;
+}
+
+// Arguments: data size in MiB, fec_open flags, and whether to start each
+// iteration with a cold page cache.
+static void BM_fec_open(benchmark::State &state) {
+    const EccImage *image = GetImage(state.range(0) * kMiB);
+    int flags = state.range(1);
+    bool cold = state.range(2);
+
+    if (!image) {
+        state.SkipWithError("failed to create image");
+        return;
+    }
+
+    for (auto _ : state) {
+        if (cold) {
+            state.PauseTiming();
+            image->drop_caches();
+            state.ResumeTiming();
+        }
+
+        fec::io fh(image->path(), O_RDONLY, flags);
+        if (!fh) {
+            state.SkipWithError("fec_open failed");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_fec_open)
+    ->ArgNames({"MiB", "flags", "cold"})
+    ->ArgsProduct({{256, 1024, 4096}, {0, FEC_ECC_DEFER_VALIDATION}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// Opens the image and queries the ecc metadata, which forces validation also
+// with FEC_ECC_DEFER_VALIDATION.
+static void BM_fec_open_ecc_metadata(benchmark::State &state) {
+    const EccImage *image = GetImage(state.range(0) * kMiB);
+    int flags = state.range(1);
+
+    if (!image) {
+        state.SkipWithError("failed to create image");
+        return;
+    }
+
+    for (auto _ : state) {
+        fec::io fh(image->path(), O_RDONLY, flags);
+        if (!fh || !fh.has_ecc()) {
+            state.SkipWithError("ecc not available");
+            break;
+        }
+    }
+}
+BENCHMARK(BM_fec_open_ecc_metadata)
+    ->ArgNames({"MiB", "flags"})
+    ->ArgsProduct({{256, 1024, 4096}, {0, FEC_ECC_DEFER_VALIDATION}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+// A legacy verity image with `data_size' bytes of pseudo-random data, its hash
+// tree, verity metadata, and encoding data computed like `fec --encode'. If
+// `corrupt' is set, one data block in every RS block is overwritten, which is
+// as much as FEC_DEFAULT_ROOTS parity bytes can correct without erasures.
+// The data is also written to a separate file without any metadata.
+class VerityImage {
+   public:
+    VerityImage(uint64_t data_size, bool corrupt) {
+        std::mt19937_64 gen(data_size);
+        std::vector<uint8_t> image(data_size);
+        for (size_t i = 0; i < image.size(); i += sizeof(uint64_t)) {
+            uint64_t v = gen();
+            memcpy(&image[i], &v, sizeof(v));
+        }
+
+        ok_ = AppendVerity(&image) && AppendEcc(&image);
+
+        if (ok_ && corrupt) {
+            uint64_t blocks = data_size / FEC_BLOCKSIZE;
+            uint64_t rounds = fec_div_round_up(
+                fec_div_round_up(image.size(), FEC_BLOCKSIZE),
+                FEC_RSM - FEC_DEFAULT_ROOTS);
+
+            for (uint64_t r = 0; r < rounds; ++r) {
+                uint64_t block = ((r * 37) % (FEC_RSM - FEC_DEFAULT_ROOTS)) *
+                                 rounds + r;
+                if (block < blocks) {
+                    memset(&image[block * FEC_BLOCKSIZE], 0xA5, FEC_BLOCKSIZE);
+                }
+            }
+        }
+
+        ok_ = ok_ &&
+              android::base::WriteFully(file_.fd, image.data(), image.size()) &&
+              android::base::WriteFully(raw_.fd, image.data(), data_size);
+    }
+
+    bool ok() const { return ok_; }
+    const char *path() const { return file_.path; }
+    const char *raw_path() const { return raw_.path; }
+
+   private:
+    static bool AppendVerity(std::vector<uint8_t> *image) {
+        uint64_t data_size = image->size();
+        std::vector<uint8_t> salt(32, 10);
+
+        HashTreeBuilder builder(FEC_BLOCKSIZE,
+                                HashTreeBuilder::HashFunction("sha256"));
+        if (!builder.Initialize(data_size, salt) ||
+            !builder.Update(image->data(), data_size) ||
+            !builder.BuildHashTree() ||
+            !builder.WriteHashTree([image](const void *data, size_t size) {
+                auto p = static_cast<const uint8_t *>(data);
+                image->insert(image->end(), p, p + size);
+                return true;
+            })) {
+            return false;
+        }
+
+        std::string blocks = std::to_string(data_size / FEC_BLOCKSIZE);
+        std::string table = android::base::Join(
+            std::vector<std::string>{
+                "1", "fake_block_device", "fake_block_device", "4096", "4096",
+                blocks, blocks, "sha256",
+                HashTreeBuilder::BytesArrayToString(builder.root_hash()),
+                HashTreeBuilder::BytesArrayToString(salt)},
+            ' ');
+
+        verity_header header = {VERITY_MAGIC, VERITY_VERSION, {},
+                                static_cast<uint32_t>(table.size())};
+
+        std::vector<uint8_t> metadata(VERITY_METADATA_SIZE, 0);
+        memcpy(metadata.data(), &header, sizeof(header));
+        memcpy(&metadata[sizeof(header)], table.data(), table.size());
+        image->insert(image->end(), metadata.begin(), metadata.end());
+        return true;
+    }
+
+    static bool AppendEcc(std::vector<uint8_t> *image) {
+        const int rsn = FEC_RSM - FEC_DEFAULT_ROOTS;
+        uint64_t inp_size = image->size();
+        uint64_t rounds =
+            fec_div_round_up(fec_div_round_up(inp_size, FEC_BLOCKSIZE), rsn);
+        uint64_t interleave = rounds * FEC_BLOCKSIZE;
+
+        std::unique_ptr<void, decltype(&free_rs_char)> rs(
+            init_rs_char(FEC_PARAMS(FEC_DEFAULT_ROOTS)), free_rs_char);
+        if (!rs) {
+            return false;
+        }
+
+        std::vector<uint8_t> ecc(interleave * FEC_DEFAULT_ROOTS);
+        uint8_t data[FEC_RSM];
+
+        for (uint64_t c = 0; c < interleave; ++c) {
+            for (int k = 0; k < rsn; ++k) {
+                uint64_t offset = c + k * interleave;
+                data[k] = offset < inp_size ? (*image)[offset] : 0;
+            }
+            encode_rs_char(rs.get(), data, &ecc[c * FEC_DEFAULT_ROOTS]);
+        }
+
+        fec_header header = {};
+        header.magic = FEC_MAGIC;
+        header.version = FEC_VERSION;
+        header.size = sizeof(fec_header);
+        header.roots = FEC_DEFAULT_ROOTS;
+        header.fec_size = ecc.size();
+        header.inp_size = inp_size;
+        SHA256(ecc.data(), ecc.size(), header.hash);
+
+        std::vector<uint8_t> block(FEC_BLOCKSIZE, 0);
+        memcpy(block.data(), &header, sizeof(header));
+
+        image->insert(image->end(), ecc.begin(), ecc.end());
+        image->insert(image->end(), block.begin(), block.end());
+        return true;
+    }
+
+    TemporaryFile file_;
+    TemporaryFile raw_;
+    bool ok_ = false;
+};
+
+static const VerityImage *GetVerityImage(uint64_t data_size, bool corrupt) {
+    static std::map<std::pair<uint64_t, bool>, std::unique_ptr<VerityImage>>
+        images;
+
+    auto &image = images[{data_size, corrupt}];
+    if (!image) {
+        image.reset(new VerityImage(data_size, corrupt));
+    }
+    return image->ok() ? image.get() : nullptr;
+}
+
+enum ReadMode { kReadRaw, kReadEcc, kReadVerity };
+
+static constexpr uint64_t kReadDataSize = 64 * kMiB;
+
+// Arguments: ReadMode, random instead of sequential offsets, corrupted image,
+// and bytes per fec_pread call.
+static void BM_fec_pread(benchmark::State &state) {
+    int mode = state.range(0);
+    bool random = state.range(1);
+    const VerityImage *image = GetVerityImage(kReadDataSize, state.range(2));
+    size_t size = state.range(3);
+
+    if (!image) {
+        state.SkipWithError("failed to create image");
+        return;
+    }
+
+    fec::io fh;
+    if (mode == kReadRaw) {
+        fh.open(image->raw_path());
+    } else {
+        fh.open(image->path(), O_RDONLY,
+                mode == kReadEcc ? FEC_VERITY_DISABLE : 0);
+    }
+
+    fec_status status;
+    if (!fh || !fh.get_status(status) || status.data_size < kReadDataSize) {
+        state.SkipWithError("fec_open failed");
+        return;
+    }
+
+    std::vector<uint8_t> buf(size);
+    std::mt19937_64 gen(0);
+    uint64_t offset = 0;
+
+    for (auto _ : state) {
+        if (random) {
+            offset = (gen() % ((kReadDataSize - size) / FEC_BLOCKSIZE + 1)) *
+                     FEC_BLOCKSIZE;
+        } else if (offset + size > kReadDataSize) {
+            offset = 0;
+        }
+
+        if (fh.pread(buf.data(), size, offset) != (ssize_t)size) {
+            state.SkipWithError("fec_pread failed");
+            break;
+        }
+
+        if (!random) {
+            offset += size;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+}
+BENCHMARK(BM_fec_pread)
+    ->ArgNames({"mode", "random", "corrupt", "size"})
+    ->ArgsProduct({{kReadRaw, kReadEcc, kReadVerity}, {0, 1}, {0, 1},
+                   {4096, 1024 * 1024}})
+    ->UseRealTime();
+
+// Reads random offsets from several threads sharing one handle. Arguments:
+// corrupted image, and bytes per fec_pread call.
+static void BM_fec_pread_shared(benchmark::State &state) {
+    static fec::io fh;
+    const VerityImage *image = GetVerityImage(kReadDataSize, state.range(0));
+    size_t size = state.range(1);
+
+    if (state.thread_index() == 0) {
+        if (!image || !fh.open(image->path())) {
+            state.SkipWithError("fec_open failed");
+        }
+    }
+
+    std::vector<uint8_t> buf(size);
+    std::mt19937_64 gen(state.thread_index());
+
+    for (auto _ : state) {
+        uint64_t offset =
+            (gen() % ((kReadDataSize - size) / FEC_BLOCKSIZE + 1)) *
+            FEC_BLOCKSIZE;
+
+        if (fh.pread(buf.data(), size, offset) != (ssize_t)size) {
+            state.SkipWithError("fec_pread failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+
+    if (state.thread_index() == 0) {
+        fh.close();
+    }
+}
+BENCHMARK(BM_fec_pread_shared)
+    ->ArgNames({"corrupt", "size"})
+    ->ArgsProduct({{0, 1}, {4096, 64 * 1024}})
+    ->ThreadRange(1, 8)
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
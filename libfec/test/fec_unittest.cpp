@@ -217,6 +217,54 @@ TEST_F(FecUnitTest, VerityImage_FecRead) {
     ASSERT_EQ(std::vector<uint8_t>(1024, 255), read_data);
 }
 
+TEST_F(FecUnitTest, VerityImage_CheckBlock) {
+    TemporaryFile verity_image;
+    BuildAndAppendsVerityMetadata();
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, image_.data(),
+                                          image_.size()));
+
+    struct fec_handle *handle = nullptr;
+    ASSERT_EQ(0, fec_open(&handle, verity_image.path, O_RDONLY, FEC_FS_EXT4, 2));
+    std::unique_ptr<fec_handle> guard(handle);
+
+    std::vector<uint8_t> block(image_.begin() + 4096 * 10,
+                               image_.begin() + 4096 * 11);
+    ASSERT_EQ(1, fec_verity_check_block(handle, 10, block.data()));
+    ASSERT_EQ(0, fec_verity_check_block(handle, 11, block.data()));
+    block[100] ^= 1;
+    ASSERT_EQ(0, fec_verity_check_block(handle, 10, block.data()));
+    // The hashtree only covers the 256 data blocks.
+    ASSERT_GT(0, fec_verity_check_block(handle, 256, block.data()));
+}
+
+TEST_F(FecUnitTest, VerityImage_HashRepair) {
+    TemporaryFile verity_image;
+    BuildAndAppendsVerityMetadata();
+    ASSERT_TRUE(android::base::WriteFully(verity_image.fd, image_.data(),
+                                          image_.size()));
+    TemporaryFile ecc_image;
+    BuildAndAppendsEccImage(verity_image.path, ecc_image.path);
+
+    // With 267 blocks and RS(255, 253), there are two rounds, so blocks 0
+    // and 2 are in the same codewords. Two errors per codeword are only
+    // correctable with roots = 2 if they are known erasures.
+    std::vector<uint8_t> corruption(4096, 0xaa);
+    ASSERT_TRUE(android::base::WriteFullyAtOffset(
+        verity_image.fd, corruption.data(), corruption.size(), 0));
+    ASSERT_TRUE(android::base::WriteFullyAtOffset(
+        verity_image.fd, corruption.data(), corruption.size(), 2 * 4096));
+
+    TemporaryFile output;
+    std::vector<std::string> cmd = { "fec",           "--decode",
+                                     "--repair",      verity_image.path,
+                                     ecc_image.path,  output.path };
+    ASSERT_EQ(0, std::system(android::base::Join(cmd, ' ').c_str()));
+
+    std::string content;
+    ASSERT_TRUE(android::base::ReadFileToString(output.path, &content));
+    ASSERT_EQ(std::string(image_.begin(), image_.end()), content);
+}
+
 TEST_F(FecUnitTest, LoadAvbImage_HashtreeFooter) {
     TemporaryFile avb_image;
     ASSERT_TRUE(
@@ -16,6 +16,13 @@
 
 #include "ETMBranchListFile.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
 #include "ETMDecoder.h"
 #include "system/extras/simpleperf/etm_branch_list.pb.h"
 
@@ -229,9 +236,11 @@ class ETMBranchListGeneratorImpl : public ETMBranchListGenerator {
   void SetBinaryFilter(const RegEx* binary_name_regex) override {
     binary_filter_.SetRegex(binary_name_regex);
   }
+  void SetEventAttr(const perf_event_attr&) override {}
 
   bool ProcessRecord(const Record& r, bool& consumed) override;
   BranchListBinaryMap GetBranchListBinaryMap() override;
+  std::map<uint32_t, ETMDecodeStat> GetDecodeStat() override { return stat_map_; }
 
  private:
   struct AuxRecordData {
@@ -258,6 +267,7 @@ class ETMBranchListGeneratorImpl : public ETMBranchListGenerator {
   std::map<uint32_t, PerCpuData> cpu_map_;
   std::unique_ptr<ETMDecoder> etm_decoder_;
   std::unordered_map<Dso*, BranchListBinaryInfo> branch_list_binary_map_;
+  std::map<uint32_t, ETMDecodeStat> stat_map_;
 };
 
 bool ETMBranchListGeneratorImpl::ProcessRecord(const Record& r, bool& consumed) {
@@ -298,6 +308,9 @@ bool ETMBranchListGeneratorImpl::ProcessAuxRecord(const AuxRecord& r) {
   uint64_t start = r.data->aux_offset;
   uint64_t end = result.value;
   PerCpuData& data = cpu_map_[r.Cpu()];
+  if (r.data->flags & PERF_AUX_FLAG_TRUNCATED) {
+    stat_map_[r.Cpu()].truncated_records++;
+  }
   if (start >= data.data_offset && end <= data.data_offset + data.aux_data.size()) {
     // The ETM data is available. Process it now.
     uint8_t* p = data.aux_data.data() + (start - data.data_offset);
@@ -305,6 +318,7 @@ bool ETMBranchListGeneratorImpl::ProcessAuxRecord(const AuxRecord& r) {
       LOG(ERROR) << "ETMDecoder isn't created";
       return false;
     }
+    stat_map_[r.Cpu()].decoded_bytes += size;
     return etm_decoder_->ProcessData(p, size, !r.Unformatted(), r.Cpu());
   }
   // The ETM data isn't available. Put the aux record into queue.
@@ -339,6 +353,9 @@ bool ETMBranchListGeneratorImpl::ProcessAuxTraceRecord(const AuxTraceRecord& r)
       if (!etm_decoder_->ProcessData(p, aux.end - aux.start, aux.formatted, r.Cpu())) {
         return false;
       }
+      stat_map_[r.Cpu()].decoded_bytes += aux.end - aux.start;
+    } else {
+      stat_map_[r.Cpu()].dropped_bytes += aux.end - aux.start;
     }
     data.aux_records.pop();
   }
@@ -375,7 +392,242 @@ BranchListBinaryMap ETMBranchListGeneratorImpl::GetBranchListBinaryMap() {
   return binary_map;
 }
 
-std::unique_ptr<ETMBranchListGenerator> ETMBranchListGenerator::Create(bool dump_maps_from_proc) {
+// Decode ETM data in worker threads. Each worker owns an ETMBranchListGeneratorImpl, having its
+// own thread tree and decoder. Records changing threads and maps are copied to all workers in
+// order, so each worker sees the same thread and map state as decoding in one thread. Aux records
+// of a cpu are always passed to the same worker.
+class ParallelETMBranchListGenerator : public ETMBranchListGenerator {
+ public:
+  ParallelETMBranchListGenerator(bool dump_maps_from_proc, size_t decode_threads,
+                                 size_t max_queued_bytes)
+      : max_queued_bytes_(max_queued_bytes) {
+    for (size_t i = 0; i < decode_threads; i++) {
+      workers_.emplace_back(new Worker);
+      workers_.back()->generator.reset(new ETMBranchListGeneratorImpl(dump_maps_from_proc));
+    }
+    for (auto& worker : workers_) {
+      worker->thread = std::thread([this, w = worker.get()]() { RunWorker(*w); });
+    }
+  }
+
+  ~ParallelETMBranchListGenerator() override { StopWorkers(); }
+
+  // Setters are called before passing any record, when workers are still waiting for tasks.
+  void SetExcludePid(pid_t pid) override {
+    for (auto& worker : workers_) {
+      worker->generator->SetExcludePid(pid);
+    }
+  }
+
+  void SetBinaryFilter(const RegEx* binary_name_regex) override {
+    for (auto& worker : workers_) {
+      worker->generator->SetBinaryFilter(binary_name_regex);
+    }
+  }
+
+  void SetEventAttr(const perf_event_attr& attr) override { attr_ = attr; }
+
+  bool ProcessRecord(const Record& r, bool& consumed) override;
+  BranchListBinaryMap GetBranchListBinaryMap() override;
+  std::map<uint32_t, ETMDecodeStat> GetDecodeStat() override;
+
+ private:
+  struct Task {
+    std::shared_ptr<const Record> record;
+    // The aux data following an AuxTraceRecord.
+    std::vector<char> aux_data;
+    // The cpu generating aux_data.
+    uint32_t cpu = 0;
+  };
+
+  struct Worker {
+    std::unique_ptr<ETMBranchListGeneratorImpl> generator;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable cond;
+    // Notified when the worker finishes decoding tasks, to wake up ProcessRecord() waiting for
+    // queued_bytes to drop.
+    std::condition_variable decoded_cond;
+    std::deque<Task> tasks;
+    // Bytes of aux data in tasks queued or being processed.
+    size_t queued_bytes = 0;
+    // Part of queued_bytes generated by each cpu. A worker can decode data of several cpus.
+    std::map<uint32_t, size_t> queued_bytes_per_cpu;
+    bool finish = false;
+  };
+
+  std::unique_ptr<Record> CopyRecord(const Record& r);
+  size_t AddTask(Worker& worker, Task&& task);
+  void RunWorker(Worker& worker);
+  void StopWorkers();
+
+  const size_t max_queued_bytes_;
+  std::optional<perf_event_attr> attr_;
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::map<uint32_t, size_t> max_queued_bytes_per_cpu_;
+  std::atomic<bool> failed_ = false;
+  bool stopped_ = false;
+};
+
+bool ParallelETMBranchListGenerator::ProcessRecord(const Record& r, bool& consumed) {
+  consumed = true;  // No need to store any records.
+  if (failed_) {
+    return false;
+  }
+  uint32_t type = r.type();
+  if (type == PERF_RECORD_AUX || type == PERF_RECORD_AUXTRACE) {
+    Task task;
+    std::unique_ptr<Record> record = CopyRecord(r);
+    if (!record) {
+      return false;
+    }
+    if (type == PERF_RECORD_AUXTRACE) {
+      const char* aux_data = static_cast<const AuxTraceRecord*>(&r)->location.addr;
+      CHECK(aux_data != nullptr);
+      auto& auxtrace = *static_cast<AuxTraceRecord*>(record.get());
+      task.aux_data.assign(aux_data, aux_data + auxtrace.data->aux_size);
+      auxtrace.location.addr = task.aux_data.data();
+    }
+    task.record = std::move(record);
+    task.cpu = r.Cpu();
+    size_t queued_bytes = AddTask(*workers_[r.Cpu() % workers_.size()], std::move(task));
+    size_t& max_queued_bytes = max_queued_bytes_per_cpu_[r.Cpu()];
+    max_queued_bytes = std::max(max_queued_bytes, queued_bytes);
+    return true;
+  }
+  if (type == PERF_RECORD_AUXTRACE_INFO || type == PERF_RECORD_MMAP ||
+      type == PERF_RECORD_MMAP2 || type == PERF_RECORD_COMM || type == PERF_RECORD_FORK ||
+      type == PERF_RECORD_EXIT) {
+    std::shared_ptr<const Record> record = CopyRecord(r);
+    if (!record) {
+      return false;
+    }
+    for (auto& worker : workers_) {
+      AddTask(*worker, Task{record, {}});
+    }
+  }
+  return true;
+}
+
+std::unique_ptr<Record> ParallelETMBranchListGenerator::CopyRecord(const Record& r) {
+  if (!attr_) {
+    LOG(ERROR) << "event attr isn't set for decoding ETM data";
+    return nullptr;
+  }
+  char* p = new char[r.size()];
+  memcpy(p, r.Binary(), r.size());
+  std::unique_ptr<Record> record = ReadRecordFromBuffer(attr_.value(), r.type(), p, p + r.size());
+  if (!record) {
+    delete[] p;
+    return nullptr;
+  }
+  record->OwnBinary();
+  return record;
+}
+
+// Return bytes of aux data queued for the worker by the cpu of the new task, including the new
+// task.
+size_t ParallelETMBranchListGenerator::AddTask(Worker& worker, Task&& task) {
+  std::unique_lock<std::mutex> lock(worker.mutex);
+  size_t size = task.aux_data.size();
+  // Wait instead of dropping data, so decoding results don't depend on the speed of workers. A
+  // task larger than the limit is still accepted when the worker is idle.
+  worker.decoded_cond.wait(lock, [&]() {
+    return worker.queued_bytes == 0 || worker.queued_bytes + size <= max_queued_bytes_;
+  });
+  worker.queued_bytes += size;
+  size_t& cpu_queued_bytes = worker.queued_bytes_per_cpu[task.cpu];
+  cpu_queued_bytes += size;
+  worker.tasks.emplace_back(std::move(task));
+  worker.cond.notify_one();
+  return cpu_queued_bytes;
+}
+
+void ParallelETMBranchListGenerator::RunWorker(Worker& worker) {
+  std::deque<Task> tasks;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(worker.mutex);
+      worker.cond.wait(lock, [&]() { return worker.finish || !worker.tasks.empty(); });
+      if (worker.tasks.empty()) {
+        return;
+      }
+      tasks.swap(worker.tasks);
+    }
+    size_t decoded_bytes = 0;
+    std::map<uint32_t, size_t> decoded_bytes_per_cpu;
+    for (Task& task : tasks) {
+      bool consumed;
+      if (!failed_ && !worker.generator->ProcessRecord(*task.record, consumed)) {
+        failed_ = true;
+      }
+      decoded_bytes += task.aux_data.size();
+      decoded_bytes_per_cpu[task.cpu] += task.aux_data.size();
+    }
+    tasks.clear();
+    {
+      std::lock_guard<std::mutex> lock(worker.mutex);
+      worker.queued_bytes -= decoded_bytes;
+      for (const auto& [cpu, bytes] : decoded_bytes_per_cpu) {
+        worker.queued_bytes_per_cpu[cpu] -= bytes;
+      }
+    }
+    worker.decoded_cond.notify_one();
+  }
+}
+
+void ParallelETMBranchListGenerator::StopWorkers() {
+  if (stopped_) {
+    return;
+  }
+  stopped_ = true;
+  for (auto& worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    worker->finish = true;
+    worker->cond.notify_one();
+  }
+  for (auto& worker : workers_) {
+    worker->thread.join();
+  }
+}
+
+BranchListBinaryMap ParallelETMBranchListGenerator::GetBranchListBinaryMap() {
+  StopWorkers();
+  if (failed_) {
+    LOG(ERROR) << "failed to decode ETM data";
+  }
+  BranchListBinaryMap binary_map;
+  for (auto& worker : workers_) {
+    for (auto& [key, binary] : worker->generator->GetBranchListBinaryMap()) {
+      if (auto it = binary_map.find(key); it != binary_map.end()) {
+        it->second.Merge(binary);
+      } else {
+        binary_map.emplace(key, std::move(binary));
+      }
+    }
+  }
+  return binary_map;
+}
+
+std::map<uint32_t, ETMDecodeStat> ParallelETMBranchListGenerator::GetDecodeStat() {
+  StopWorkers();
+  std::map<uint32_t, ETMDecodeStat> stat_map;
+  for (auto& worker : workers_) {
+    std::map<uint32_t, ETMDecodeStat> worker_stat = worker->generator->GetDecodeStat();
+    stat_map.insert(worker_stat.begin(), worker_stat.end());
+  }
+  for (const auto& [cpu, max_queued_bytes] : max_queued_bytes_per_cpu_) {
+    stat_map[cpu].max_queued_bytes = max_queued_bytes;
+  }
+  return stat_map;
+}
+
+std::unique_ptr<ETMBranchListGenerator> ETMBranchListGenerator::Create(
+    bool dump_maps_from_proc, size_t decode_threads, size_t max_queued_bytes_per_thread) {
+  if (decode_threads > 0) {
+    return std::unique_ptr<ETMBranchListGenerator>(new ParallelETMBranchListGenerator(
+        dump_maps_from_proc, decode_threads, max_queued_bytes_per_thread));
+  }
   return std::unique_ptr<ETMBranchListGenerator>(
       new ETMBranchListGeneratorImpl(dump_maps_from_proc));
 }
@@ -133,16 +133,40 @@ class BinaryFilter {
   std::unordered_map<Dso*, bool> dso_filter_cache_;
 };
 
+struct ETMDecodeStat {
+  // Bytes of ETM data decoded.
+  uint64_t decoded_bytes = 0;
+  // Bytes of ETM data referred by aux records, but not found in auxtrace records.
+  uint64_t dropped_bytes = 0;
+  // Aux records with PERF_AUX_FLAG_TRUNCATED, meaning the kernel lost ETM data.
+  uint64_t truncated_records = 0;
+  // Max bytes of ETM data of this cpu queued for decoding, not counting data of other cpus sharing
+  // the decode thread. Only set when decoding in worker threads.
+  uint64_t max_queued_bytes = 0;
+};
+
 // Convert ETM data into branch lists while recording.
 class ETMBranchListGenerator {
  public:
-  static std::unique_ptr<ETMBranchListGenerator> Create(bool dump_maps_from_proc);
+  // If decode_threads is zero, ETM data is decoded in ProcessRecord(). Otherwise, ProcessRecord()
+  // only hands off records to decode_threads worker threads. ETM data of a cpu is always decoded
+  // in the same worker thread. ETM data queued for a worker thread is limited to
+  // max_queued_bytes_per_thread. When reaching the limit, ProcessRecord() waits for the worker
+  // thread to decode queued data.
+  static std::unique_ptr<ETMBranchListGenerator> Create(
+      bool dump_maps_from_proc, size_t decode_threads = 0,
+      size_t max_queued_bytes_per_thread = kDefaultMaxQueuedBytesPerThread);
+  static constexpr size_t kDefaultMaxQueuedBytesPerThread = 64 * 1024 * 1024;
 
   virtual ~ETMBranchListGenerator();
   virtual void SetExcludePid(pid_t pid) = 0;
   virtual void SetBinaryFilter(const RegEx* binary_name_regex) = 0;
+  // Set the attr used to parse records. It is needed to copy records passed to worker threads.
+  virtual void SetEventAttr(const perf_event_attr& attr) = 0;
   virtual bool ProcessRecord(const Record& r, bool& consumed) = 0;
   virtual BranchListBinaryMap GetBranchListBinaryMap() = 0;
+  // Return decode stat for each cpu. Should be called after GetBranchListBinaryMap().
+  virtual std::map<uint32_t, ETMDecodeStat> GetDecodeStat() = 0;
 };
 
 // for testing
@@ -33,3 +33,30 @@ TEST(ETMBranchListFile, branch_to_proto_string) {
     ASSERT_EQ(branch, branch2);
   }
 }
+
+TEST(ETMBranchListGenerator, limit_queued_bytes_of_decode_threads) {
+  const size_t max_queued_bytes = 4096;
+  auto generator = ETMBranchListGenerator::Create(false, 1, max_queued_bytes);
+  perf_event_attr attr = {};
+  generator->SetEventAttr(attr);
+  std::vector<char> aux_data(10000);
+  auto add_aux_data = [&](size_t size, uint64_t offset, uint32_t cpu) {
+    AuxTraceRecord r(size, offset, cpu, 0, cpu);
+    r.location.addr = aux_data.data();
+    bool consumed;
+    ASSERT_TRUE(generator->ProcessRecord(r, consumed));
+  };
+  // Data of both cpus is queued for the only decode thread.
+  for (size_t i = 0; i < 100; i++) {
+    add_aux_data(1024, i * 1024, 0);
+    add_aux_data(1024, i * 1024, 1);
+  }
+  // Data larger than the limit is accepted when the decode thread is idle.
+  add_aux_data(10000, 100 * 1024, 1);
+  add_aux_data(1024, 100 * 1024, 0);
+  generator->GetBranchListBinaryMap();
+  std::map<uint32_t, ETMDecodeStat> stat_map = generator->GetDecodeStat();
+  ASSERT_GT(stat_map[0].max_queued_bytes, 0);
+  ASSERT_LE(stat_map[0].max_queued_bytes, max_queued_bytes);
+  ASSERT_EQ(stat_map[1].max_queued_bytes, 10000);
+}
@@ -19,12 +19,14 @@
 #include <sstream>
 
 #include <android-base/expected.h>
+#include <android-base/file.h>
 #include <android-base/logging.h>
 #include <android-base/strings.h>
 #include <llvm/Support/MemoryBuffer.h>
 #include <opencsd.h>
 
 #include "ETMConstants.h"
+#include "utils.h"
 
 namespace simpleperf {
 namespace {
@@ -885,6 +887,27 @@ class BranchDecoder {
     return {};
   }
 
+  // Decode instructions from addr until finding a branch instruction.
+  ETMBasicBlockTable::Block DecodeBlock(uint64_t addr, bool is_thumb) {
+    SetAddr(addr, is_thumb);
+    ETMBasicBlockTable::Block block;
+    if (!FindNextBranch()) {
+      return block;
+    }
+    block.end_addr = instr_info_.instr_addr;
+    block.instr_size = instr_info_.instr_size;
+    if (instr_info_.type == OCSD_INSTR_BR) {
+      block.type = ETMBasicBlockTable::BRANCH_DIRECT;
+      block.branch_to_addr = instr_info_.branch_addr;
+    } else if (instr_info_.type == OCSD_INSTR_BR_INDIRECT) {
+      block.type = ETMBasicBlockTable::BRANCH_INDIRECT;
+    } else {
+      block.type = ETMBasicBlockTable::BRANCH_OTHER;
+    }
+    return block;
+  }
+
+ private:
   void SetAddr(uint64_t addr, bool is_thumb) {
     memset(&instr_info_, 0, sizeof(instr_info_));
     instr_info_.pe_type.arch = ARCH_V8;
@@ -909,9 +932,6 @@ class BranchDecoder {
     return false;
   };
 
-  ocsd_instr_info& InstrInfo() { return instr_info_; }
-
- private:
   bool ReadMem(uint64_t vaddr, size_t size, void* data) {
     for (auto& segment : segments_) {
       if (vaddr >= segment.vaddr && vaddr + size <= segment.vaddr + segment.file_size) {
@@ -930,8 +950,80 @@ class BranchDecoder {
   InstructionDecoder instruction_decoder_;
 };
 
+// The file format of a saved ETMBasicBlockTable:
+//   magic (8 bytes), build_id (20 bytes), block_count (8 bytes),
+//   block_count * (key, end_addr, branch_to_addr (8 bytes each), instr_size, type (1 byte each))
+static constexpr char ETM_BASIC_BLOCK_TABLE_MAGIC[8] = {'B', 'B', 'T', 'A', 'B', 'L', 'E', '1'};
+static constexpr size_t ETM_BASIC_BLOCK_ENTRY_SIZE = 3 * sizeof(uint64_t) + 2;
+
+bool ETMBasicBlockTable::Load(const std::string& path, const BuildId& build_id) {
+  std::string data;
+  if (!android::base::ReadFileToString(path, &data)) {
+    return false;
+  }
+  const size_t header_size =
+      sizeof(ETM_BASIC_BLOCK_TABLE_MAGIC) + BuildId::Size() + sizeof(uint64_t);
+  if (data.size() < header_size ||
+      memcmp(data.data(), ETM_BASIC_BLOCK_TABLE_MAGIC, sizeof(ETM_BASIC_BLOCK_TABLE_MAGIC)) != 0) {
+    LOG(WARNING) << "invalid basic block table file " << path;
+    return false;
+  }
+  const char* p = data.data() + sizeof(ETM_BASIC_BLOCK_TABLE_MAGIC);
+  if (BuildId(p, BuildId::Size()) != build_id) {
+    return false;
+  }
+  p += BuildId::Size();
+  uint64_t count;
+  MoveFromBinaryFormat(count, p);
+  if (count > (data.size() - header_size) / ETM_BASIC_BLOCK_ENTRY_SIZE) {
+    LOG(WARNING) << "invalid basic block table file " << path;
+    return false;
+  }
+  blocks_.reserve(blocks_.size() + count);
+  for (uint64_t i = 0; i < count; i++) {
+    uint64_t key;
+    Block block;
+    uint8_t type;
+    MoveFromBinaryFormat(key, p);
+    MoveFromBinaryFormat(block.end_addr, p);
+    MoveFromBinaryFormat(block.branch_to_addr, p);
+    MoveFromBinaryFormat(block.instr_size, p);
+    MoveFromBinaryFormat(type, p);
+    if (type > BRANCH_OTHER) {
+      LOG(WARNING) << "invalid basic block table file " << path;
+      return false;
+    }
+    block.type = static_cast<BranchType>(type);
+    blocks_[key] = block;
+  }
+  return true;
+}
+
+bool ETMBasicBlockTable::Save(const std::string& path, const BuildId& build_id) const {
+  std::string data(sizeof(ETM_BASIC_BLOCK_TABLE_MAGIC) + BuildId::Size() + sizeof(uint64_t) +
+                       blocks_.size() * ETM_BASIC_BLOCK_ENTRY_SIZE,
+                   '\0');
+  char* p = data.data();
+  MoveToBinaryFormat(ETM_BASIC_BLOCK_TABLE_MAGIC, sizeof(ETM_BASIC_BLOCK_TABLE_MAGIC), p);
+  MoveToBinaryFormat(build_id.Data(), BuildId::Size(), p);
+  MoveToBinaryFormat(static_cast<uint64_t>(blocks_.size()), p);
+  for (const auto& [key, block] : blocks_) {
+    MoveToBinaryFormat(key, p);
+    MoveToBinaryFormat(block.end_addr, p);
+    MoveToBinaryFormat(block.branch_to_addr, p);
+    MoveToBinaryFormat(block.instr_size, p);
+    MoveToBinaryFormat(static_cast<uint8_t>(block.type), p);
+  }
+  if (!android::base::WriteStringToFile(data, path)) {
+    PLOG(WARNING) << "failed to write " << path;
+    return false;
+  }
+  return true;
+}
+
 android::base::expected<void, std::string> ConvertBranchMapToInstrRanges(
-    Dso* dso, const BranchMap& branch_map, const ETMDecoder::InstrRangeCallbackFn& callback) {
+    Dso* dso, const BranchMap& branch_map, const ETMDecoder::InstrRangeCallbackFn& callback,
+    ETMBasicBlockTable* block_table) {
   ETMInstrRange instr_range;
   instr_range.dso = dso;
 
@@ -939,6 +1031,10 @@ android::base::expected<void, std::string> ConvertBranchMapToInstrRanges(
   if (auto result = decoder.Init(dso); !result.ok()) {
     return result;
   }
+  ETMBasicBlockTable local_block_table;
+  if (block_table == nullptr) {
+    block_table = &local_block_table;
+  }
 
   for (const auto& addr_p : branch_map) {
     uint64_t start_addr = addr_p.first & ~1ULL;
@@ -946,20 +1042,27 @@ android::base::expected<void, std::string> ConvertBranchMapToInstrRanges(
     for (const auto& branch_p : addr_p.second) {
       const std::vector<bool>& branch = branch_p.first;
       uint64_t count = branch_p.second;
-      decoder.SetAddr(start_addr, is_thumb);
+      uint64_t addr = start_addr;
+      // The instruction decoder only updates the branch to address for direct branches. Taking
+      // other branches continues from the last direct branch target, so keep it here.
+      uint64_t last_branch_to_addr = 0;
 
       for (bool b : branch) {
-        ocsd_instr_info& instr = decoder.InstrInfo();
-        uint64_t from_addr = instr.instr_addr;
-        if (!decoder.FindNextBranch()) {
+        const ETMBasicBlockTable::Block* block = block_table->Find(addr, is_thumb);
+        if (block == nullptr) {
+          block = &block_table->Add(addr, is_thumb, decoder.DecodeBlock(addr, is_thumb));
+        }
+        if (block->type == ETMBasicBlockTable::BRANCH_NONE) {
           break;
         }
-        bool end_with_branch = instr.type == OCSD_INSTR_BR || instr.type == OCSD_INSTR_BR_INDIRECT;
+        bool end_with_branch = block->type == ETMBasicBlockTable::BRANCH_DIRECT ||
+                               block->type == ETMBasicBlockTable::BRANCH_INDIRECT;
         bool branch_taken = end_with_branch && b;
-        instr_range.start_addr = from_addr;
-        instr_range.end_addr = instr.instr_addr;
-        if (instr.type == OCSD_INSTR_BR) {
-          instr_range.branch_to_addr = instr.branch_addr;
+        instr_range.start_addr = addr;
+        instr_range.end_addr = block->end_addr;
+        if (block->type == ETMBasicBlockTable::BRANCH_DIRECT) {
+          instr_range.branch_to_addr = block->branch_to_addr;
+          last_branch_to_addr = block->branch_to_addr;
         } else {
           instr_range.branch_to_addr = 0;
         }
@@ -969,9 +1072,9 @@ android::base::expected<void, std::string> ConvertBranchMapToInstrRanges(
         callback(instr_range);
 
         if (b) {
-          instr.instr_addr = instr.branch_addr;
+          addr = last_branch_to_addr;
         } else {
-          instr.instr_addr += instr.instr_size;
+          addr = block->end_addr + block->instr_size;
         }
       }
     }
@@ -19,6 +19,7 @@
 #include <functional>
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #include <android-base/expected.h>
 
@@ -92,7 +93,58 @@ class ETMDecoder {
 // addresses.
 using BranchMap = std::map<uint64_t, std::map<std::vector<bool>, uint64_t>>;
 
+// Basic blocks decoded from a binary. A basic block starts at an instruction address and ends at
+// the first branch instruction after it. Converting branch lists to instruction ranges needs to
+// decode the same start addresses again and again, so the decoding results are memoized here. The
+// table only depends on the content of the binary, so it can be saved to a file and reused for
+// binaries with the same build id.
+class ETMBasicBlockTable {
+ public:
+  enum BranchType : uint8_t {
+    // No branch instruction is found after the start address in the binary.
+    BRANCH_NONE,
+    BRANCH_DIRECT,
+    BRANCH_INDIRECT,
+    // Other waypoint instructions, like ISB.
+    BRANCH_OTHER,
+  };
+
+  struct Block {
+    // the address of the last instruction in the block
+    uint64_t end_addr = 0;
+    // the branch to address for a direct branch
+    uint64_t branch_to_addr = 0;
+    // the size of the last instruction in the block
+    uint8_t instr_size = 0;
+    BranchType type = BRANCH_NONE;
+  };
+
+  const Block* Find(uint64_t addr, bool is_thumb) const {
+    auto it = blocks_.find(GetKey(addr, is_thumb));
+    return it != blocks_.end() ? &it->second : nullptr;
+  }
+
+  const Block& Add(uint64_t addr, bool is_thumb, const Block& block) {
+    return blocks_[GetKey(addr, is_thumb)] = block;
+  }
+
+  size_t Size() const { return blocks_.size(); }
+
+  // Load blocks saved for a binary with build_id. Return false if the file doesn't exist or
+  // doesn't match build_id.
+  bool Load(const std::string& path, const BuildId& build_id);
+  bool Save(const std::string& path, const BuildId& build_id) const;
+
+ private:
+  static uint64_t GetKey(uint64_t addr, bool is_thumb) { return addr | (is_thumb ? 1 : 0); }
+
+  std::unordered_map<uint64_t, Block> blocks_;
+};
+
+// Convert branch lists to instruction ranges. If block_table isn't nullptr, it is used to look up
+// basic blocks decoded before, and is filled with newly decoded basic blocks.
 android::base::expected<void, std::string> ConvertBranchMapToInstrRanges(
-    Dso* dso, const BranchMap& branch_map, const ETMDecoder::InstrRangeCallbackFn& callback);
+    Dso* dso, const BranchMap& branch_map, const ETMDecoder::InstrRangeCallbackFn& callback,
+    ETMBasicBlockTable* block_table = nullptr);
 
 }  // namespace simpleperf
\ No newline at end of file
@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <unistd.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include "ETMBranchListFile.h"
+#include "ETMDecoder.h"
+#include "command.h"
+#include "get_test_data.h"
+
+using namespace simpleperf;
+
+namespace {
+
+// Branch lists of binaries in PERF_DATA_ETM_TEST_LOOP, with the dsos used to decode them.
+struct BranchListData {
+  std::vector<std::unique_ptr<Dso>> dsos;
+  std::vector<BranchMap> branch_maps;
+  size_t branch_count = 0;
+};
+
+const BranchListData& GetBranchListData() {
+  static std::unique_ptr<BranchListData> data;
+  if (data) {
+    return *data;
+  }
+  data.reset(new BranchListData);
+  const std::string symdir = GetTestDataDir() + "etm";
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  std::unique_ptr<Command> inject_cmd = CreateCommandInstance("inject");
+  CHECK(inject_cmd->Run({"-i", GetTestData(PERF_DATA_ETM_TEST_LOOP), "--output", "branch-list",
+                         "-o", tmpfile.path, "--symdir", symdir}));
+  std::string s;
+  CHECK(android::base::ReadFileToString(tmpfile.path, &s));
+  BranchListBinaryMap binary_map;
+  CHECK(StringToBranchListBinaryMap(s, binary_map));
+  CHECK(Dso::AddSymbolDir(symdir));
+  for (auto& [key, binary] : binary_map) {
+    if (binary.dso_type == DSO_KERNEL) {
+      continue;
+    }
+    BuildId build_id = key.build_id;
+    std::unique_ptr<Dso> dso = Dso::CreateDsoWithBuildId(binary.dso_type, key.path, build_id);
+    if (!dso) {
+      continue;
+    }
+    data->branch_maps.emplace_back(binary.GetOrderedBranchMap());
+    for (const auto& p : data->branch_maps.back()) {
+      data->branch_count += p.second.size();
+    }
+    data->dsos.emplace_back(std::move(dso));
+  }
+  CHECK(!data->dsos.empty());
+  return *data;
+}
+
+void ConvertAll(const BranchListData& data, std::vector<ETMBasicBlockTable>* block_tables,
+                benchmark::State& state) {
+  uint64_t range_count = 0;
+  auto callback = [&](const ETMInstrRange&) { range_count++; };
+  for (size_t i = 0; i < data.dsos.size(); i++) {
+    ETMBasicBlockTable* block_table = block_tables ? &(*block_tables)[i] : nullptr;
+    auto result = ConvertBranchMapToInstrRanges(data.dsos[i].get(), data.branch_maps[i],
+                                                callback, block_table);
+    if (!result.ok()) {
+      state.SkipWithError(result.error().c_str());
+      return;
+    }
+  }
+  benchmark::DoNotOptimize(range_count);
+}
+
+// Decode every branch list from scratch, sharing basic blocks only within a conversion.
+void BM_ConvertBranchMapColdBlockTable(benchmark::State& state) {
+  const BranchListData& data = GetBranchListData();
+  for (auto _ : state) {
+    ConvertAll(data, nullptr, state);
+  }
+  state.SetItemsProcessed(state.iterations() * data.branch_count);
+}
+BENCHMARK(BM_ConvertBranchMapColdBlockTable);
+
+// Reuse basic blocks decoded in previous conversions, like loading them from --bb-cache-dir.
+void BM_ConvertBranchMapWarmBlockTable(benchmark::State& state) {
+  const BranchListData& data = GetBranchListData();
+  std::vector<ETMBasicBlockTable> block_tables(data.dsos.size());
+  ConvertAll(data, &block_tables, state);
+  for (auto _ : state) {
+    ConvertAll(data, &block_tables, state);
+  }
+  state.SetItemsProcessed(state.iterations() * data.branch_count);
+}
+BENCHMARK(BM_ConvertBranchMapWarmBlockTable);
+
+}  // namespace
@@ -31,12 +31,16 @@
 #include "RegEx.h"
 #include "environment.h"
 #include "event_type.h"
+#include "read_elf.h"
 #include "utils.h"
 
 namespace simpleperf {
 
+using android::base::Basename;
+using android::base::Join;
 using android::base::ParseInt;
 using android::base::ParseUint;
+using android::base::Realpath;
 using android::base::Split;
 using android::base::StringPrintf;
 using android::base::unique_fd;
@@ -44,6 +48,21 @@ using android::base::WriteStringToFd;
 
 static const std::string kKprobeEventPrefix = "kprobes:";
 
+// Parse the event name given in the first arg of a probe cmd, like "p:[GRP/]EVENT".
+static bool ParseGivenEventName(const std::string& arg, ProbeEvent* event) {
+  auto name_reg = RegEx::Create(R"(:([a-zA-Z_][\w_]*/)?([a-zA-Z_][\w_]*))");
+  auto match = name_reg->SearchAll(arg);
+  if (!match->IsValid()) {
+    return false;
+  }
+  if (match->GetField(1).length() > 0) {
+    event->group_name = match->GetField(1);
+    event->group_name.pop_back();
+  }
+  event->event_name = match->GetField(2);
+  return true;
+}
+
 bool ProbeEvents::ParseKprobeEventName(const std::string& kprobe_cmd, ProbeEvent* event) {
   // kprobe_cmd is in formats described in <kernel>/Documentation/trace/kprobetrace.rst:
   //   p[:[GRP/]EVENT] [MOD:]SYM[+offs]|MEMADDR [FETCHARGS]
@@ -55,14 +74,7 @@ bool ProbeEvents::ParseKprobeEventName(const std::string& kprobe_cmd, ProbeEvent
 
   // Parse given name.
   event->group_name = "kprobes";
-  auto name_reg = RegEx::Create(R"(:([a-zA-Z_][\w_]*/)?([a-zA-Z_][\w_]*))");
-  auto match = name_reg->SearchAll(args[0]);
-  if (match->IsValid()) {
-    if (match->GetField(1).length() > 0) {
-      event->group_name = match->GetField(1);
-      event->group_name.pop_back();
-    }
-    event->event_name = match->GetField(2);
+  if (ParseGivenEventName(args[0], event)) {
     return true;
   }
 
@@ -92,19 +104,98 @@ bool ProbeEvents::ParseKprobeEventName(const std::string& kprobe_cmd, ProbeEvent
   return true;
 }
 
+namespace {
+
+// The probed location in a uprobe cmd, in format PATH:SYMBOL[+offs] or PATH:OFFSET.
+struct UprobeLocation {
+  std::string path;
+  // Empty if the location is given as a file offset.
+  std::string symbol;
+  // The offset from the symbol, or the file offset if symbol is empty.
+  uint64_t offset = 0;
+};
+
+}  // namespace
+
+static bool ParseUprobeLocation(const std::string& s, UprobeLocation* location) {
+  size_t split_pos = s.rfind(':');
+  if (split_pos == std::string::npos || split_pos == 0 || split_pos + 1 == s.size()) {
+    return false;
+  }
+  location->path = s.substr(0, split_pos);
+  std::string addr = s.substr(split_pos + 1);
+  location->symbol.clear();
+  if (ParseUint(addr, &location->offset)) {
+    return true;
+  }
+  size_t offs_pos = addr.find('+');
+  if (offs_pos == std::string::npos) {
+    location->symbol = addr;
+    location->offset = 0;
+  } else {
+    location->symbol = addr.substr(0, offs_pos);
+    if (!ParseUint(addr.substr(offs_pos + 1), &location->offset)) {
+      return false;
+    }
+  }
+  return !location->symbol.empty();
+}
+
+bool ProbeEvents::ParseUprobeEventName(const std::string& uprobe_cmd, ProbeEvent* event) {
+  // uprobe_cmd is in formats described in ProbeEvents::AddUprobe().
+  std::vector<std::string> args = Split(uprobe_cmd, " ");
+  if (args.size() < 2 || args[0].empty() || (args[0][0] != 'p' && args[0][0] != 'r')) {
+    return false;
+  }
+  UprobeLocation location;
+  if (!ParseUprobeLocation(args[1], &location)) {
+    return false;
+  }
+
+  // Parse given name.
+  event->group_name = "uprobes";
+  if (ParseGivenEventName(args[0], event)) {
+    return true;
+  }
+
+  // Generate name from PATH:SYMBOL[+offs] or PATH:OFFSET.
+  char probe_type = args[0][0];
+  std::string filename = Basename(location.path);
+  std::string s;
+  if (location.symbol.empty()) {
+    s = StringPrintf("%c_%s_0x%" PRIx64, probe_type, filename.c_str(), location.offset);
+  } else {
+    s = StringPrintf("%c_%s_%s_%" PRIu64, probe_type, filename.c_str(), location.symbol.c_str(),
+                     location.offset);
+  }
+  event->event_name = RegEx::Create(R"([^\w])")->Replace(s, "_").value();
+  return true;
+}
+
+static std::string FindProbeControlPath(const char* filename) {
+  if (const char* tracefs_dir = GetTraceFsDir(); tracefs_dir != nullptr) {
+    std::string path = std::string(tracefs_dir) + "/" + filename;
+    if (IsRegularFile(path)) {
+      return path;
+    }
+  }
+  return "";
+}
+
 bool ProbeEvents::IsKprobeSupported() {
   if (!kprobe_control_path_.has_value()) {
-    kprobe_control_path_ = "";
-    if (const char* tracefs_dir = GetTraceFsDir(); tracefs_dir != nullptr) {
-      std::string path = std::string(tracefs_dir) + "/kprobe_events";
-      if (IsRegularFile(path)) {
-        kprobe_control_path_ = std::move(path);
-      }
-    }
+    kprobe_control_path_ = FindProbeControlPath("kprobe_events");
   }
   return !kprobe_control_path_.value().empty();
 }
 
+bool ProbeEvents::IsUprobeSupported() {
+  if (!uprobe_control_path_.has_value()) {
+    uprobe_control_path_ = FindProbeControlPath("uprobe_events");
+  }
+  return !uprobe_control_path_.value().empty();
+}
+
 bool ProbeEvents::AddKprobe(const std::string& kprobe_cmd) {
   ProbeEvent event;
   if (!ParseKprobeEventName(kprobe_cmd, &event)) {
@@ -118,6 +209,69 @@ bool ProbeEvents::AddKprobe(const std::string& kprobe_cmd) {
   return true;
 }
 
+// Return the file offset of a function symbol in an elf file, which is the location used by
+// uprobes.
+static bool GetFunctionFileOffset(const std::string& path, const std::string& symbol,
+                                  uint64_t* file_offset) {
+  ElfStatus status;
+  auto elf = ElfFile::Open(path, &status);
+  if (!elf) {
+    LOG(ERROR) << "failed to read " << path << ": " << status;
+    return false;
+  }
+  std::optional<uint64_t> vaddr;
+  // ParseSymbols() also reads .dynsym and .gnu_debugdata when .symtab doesn't exist.
+  elf->ParseSymbols([&](const ElfFileSymbol& elf_symbol) {
+    if (!vaddr && elf_symbol.is_func && elf_symbol.name == symbol) {
+      vaddr = elf_symbol.vaddr;
+    }
+  });
+  if (!vaddr) {
+    LOG(ERROR) << "failed to find function " << symbol << " in " << path;
+    return false;
+  }
+  if (!elf->VaddrToOff(vaddr.value(), file_offset)) {
+    LOG(ERROR) << "failed to get file offset of function " << symbol << " in " << path;
+    return false;
+  }
+  return true;
+}
+
+bool ProbeEvents::AddUprobe(const std::string& uprobe_cmd, ProbeEvent* added_event) {
+  ProbeEvent event;
+  std::vector<std::string> args = Split(uprobe_cmd, " ");
+  UprobeLocation location;
+  if (!ParseUprobeEventName(uprobe_cmd, &event) || !ParseUprobeLocation(args[1], &location)) {
+    LOG(ERROR) << "invalid uprobe cmd: " << uprobe_cmd;
+    return false;
+  }
+  std::string path;
+  if (!Realpath(location.path, &path)) {
+    PLOG(ERROR) << "failed to find " << location.path;
+    return false;
+  }
+  uint64_t file_offset = location.offset;
+  if (!location.symbol.empty()) {
+    uint64_t symbol_file_offset;
+    if (!GetFunctionFileOffset(path, location.symbol, &symbol_file_offset)) {
+      return false;
+    }
+    file_offset += symbol_file_offset;
+  }
+  // The kernel only accepts file offsets, so rewrite the name and location args.
+  args[0] = StringPrintf("%c:%s/%s", args[0][0], event.group_name.c_str(),
+                         event.event_name.c_str());
+  args[1] = StringPrintf("%s:0x%" PRIx64, path.c_str(), file_offset);
+  if (!WriteUprobeCmd(Join(args, " "))) {
+    return false;
+  }
+  if (added_event != nullptr) {
+    *added_event = event;
+  }
+  uprobe_events_.emplace_back(std::move(event));
+  return true;
+}
+
 bool ProbeEvents::IsProbeEvent(const std::string& event_name) {
   return android::base::StartsWith(event_name, kKprobeEventPrefix);
 }
@@ -140,24 +294,44 @@ void ProbeEvents::Clear() {
                                                  kprobe_event.event_name);
   }
   kprobe_events_.clear();
+  for (const auto& uprobe_event : uprobe_events_) {
+    if (!WriteUprobeCmd("-:" + uprobe_event.group_name + "/" + uprobe_event.event_name)) {
+      LOG(WARNING) << "failed to delete uprobe event " << uprobe_event.group_name << ":"
+                   << uprobe_event.event_name;
+    }
+    EventTypeManager::Instance().RemoveProbeType(uprobe_event.group_name + ":" +
+                                                 uprobe_event.event_name);
+  }
+  uprobe_events_.clear();
 }
 
-bool ProbeEvents::WriteKprobeCmd(const std::string& kprobe_cmd) {
-  if (!IsKprobeSupported()) {
-    LOG(ERROR) << "kprobe events isn't supported by the kernel.";
-    return false;
-  }
-  const std::string& path = kprobe_control_path_.value();
+static bool WriteProbeCmd(const std::string& path, const std::string& cmd) {
   unique_fd fd(open(path.c_str(), O_APPEND | O_WRONLY | O_CLOEXEC));
   if (!fd.ok()) {
     PLOG(ERROR) << "failed to open " << path;
     return false;
   }
-  if (!WriteStringToFd(kprobe_cmd, fd)) {
-    PLOG(ERROR) << "failed to write '" << kprobe_cmd << "' to " << path;
+  if (!WriteStringToFd(cmd, fd)) {
+    PLOG(ERROR) << "failed to write '" << cmd << "' to " << path;
     return false;
   }
   return true;
 }
 
+bool ProbeEvents::WriteKprobeCmd(const std::string& kprobe_cmd) {
+  if (!IsKprobeSupported()) {
+    LOG(ERROR) << "kprobe events isn't supported by the kernel.";
+    return false;
+  }
+  return WriteProbeCmd(kprobe_control_path_.value(), kprobe_cmd);
+}
+
+bool ProbeEvents::WriteUprobeCmd(const std::string& uprobe_cmd) {
+  if (!IsUprobeSupported()) {
+    LOG(ERROR) << "uprobe events isn't supported by the kernel.";
+    return false;
+  }
+  return WriteProbeCmd(uprobe_control_path_.value(), uprobe_cmd);
+}
+
 }  // namespace simpleperf
@@ -27,28 +27,40 @@ struct ProbeEvent {
   std::string event_name;
 };
 
-// Add kprobe events in /sys/kernel/debug/tracing/kprobe_events, and
-// delete them in ProbeEvents::clear().
+// Add kprobe events in /sys/kernel/debug/tracing/kprobe_events and uprobe events in
+// /sys/kernel/debug/tracing/uprobe_events, and delete them in ProbeEvents::clear().
 class ProbeEvents {
  public:
   ~ProbeEvents() { Clear(); }
 
   static bool ParseKprobeEventName(const std::string& kprobe_cmd, ProbeEvent* event);
+  static bool ParseUprobeEventName(const std::string& uprobe_cmd, ProbeEvent* event);
   bool IsKprobeSupported();
+  bool IsUprobeSupported();
 
   // Accept kprobe cmd as in <linux_kernel>/Documentation/trace/kprobetrace.rst.
   bool AddKprobe(const std::string& kprobe_cmd);
+  // Accept uprobe cmd as in <linux_kernel>/Documentation/trace/uprobetracer.rst. Besides a file
+  // offset, the probed location can be a function symbol in the elf file, which is converted to
+  // a file offset before writing the cmd to the kernel:
+  //   p[:[GRP/]EVENT] PATH:SYMBOL[+offs]|PATH:OFFSET [FETCHARGS]
+  //   r[:[GRP/]EVENT] PATH:SYMBOL[+offs]|PATH:OFFSET [FETCHARGS]
+  // If event isn't nullptr, it is set to the added event.
+  bool AddUprobe(const std::string& uprobe_cmd, ProbeEvent* event = nullptr);
   bool IsProbeEvent(const std::string& event_name);
   // If not exist, add a kprobe tracepoint at the function entry.
   bool CreateProbeEventIfNotExist(const std::string& event_name);
-  bool IsEmpty() const { return kprobe_events_.empty(); }
+  bool IsEmpty() const { return kprobe_events_.empty() && uprobe_events_.empty(); }
   void Clear();
 
  private:
   bool WriteKprobeCmd(const std::string& kprobe_cmd);
+  bool WriteUprobeCmd(const std::string& uprobe_cmd);
 
   std::vector<ProbeEvent> kprobe_events_;
   std::optional<std::string> kprobe_control_path_;
+  std::vector<ProbeEvent> uprobe_events_;
+  std::optional<std::string> uprobe_control_path_;
 };
 
 }  // namespace simpleperf
@@ -49,3 +49,31 @@ TEST(probe_events, ParseKprobeEventName) {
   ASSERT_EQ(event.group_name, "kprobes");
   ASSERT_EQ(event.event_name, "p_0x12345678");
 }
+
+TEST(probe_events, ParseUprobeEventName) {
+  ProbeEvent event;
+  ASSERT_TRUE(ProbeEvents::ParseUprobeEventName("p:myprobe /system/bin/app:main", &event));
+  ASSERT_EQ(event.group_name, "uprobes");
+  ASSERT_EQ(event.event_name, "myprobe");
+
+  ASSERT_TRUE(ProbeEvents::ParseUprobeEventName("r:mygroup/myprobe /system/bin/app:main", &event));
+  ASSERT_EQ(event.group_name, "mygroup");
+  ASSERT_EQ(event.event_name, "myprobe");
+
+  ASSERT_TRUE(ProbeEvents::ParseUprobeEventName("p /system/lib64/libc.so:malloc", &event));
+  ASSERT_EQ(event.group_name, "uprobes");
+  ASSERT_EQ(event.event_name, "p_libc_so_malloc_0");
+
+  ASSERT_TRUE(ProbeEvents::ParseUprobeEventName("r /system/lib64/libc.so:malloc+16", &event));
+  ASSERT_EQ(event.group_name, "uprobes");
+  ASSERT_EQ(event.event_name, "r_libc_so_malloc_16");
+
+  ASSERT_TRUE(ProbeEvents::ParseUprobeEventName("p /system/bin/app:0x1234 %ip", &event));
+  ASSERT_EQ(event.group_name, "uprobes");
+  ASSERT_EQ(event.event_name, "p_app_0x1234");
+
+  ASSERT_FALSE(ProbeEvents::ParseUprobeEventName("p /system/bin/app", &event));
+  ASSERT_FALSE(ProbeEvents::ParseUprobeEventName("p /system/bin/app:", &event));
+  ASSERT_FALSE(ProbeEvents::ParseUprobeEventName("x /system/bin/app:main", &event));
+  ASSERT_FALSE(ProbeEvents::ParseUprobeEventName("p /system/bin/app:main+x", &event));
+}
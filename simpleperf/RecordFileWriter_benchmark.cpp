@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <memory>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <benchmark/benchmark.h>
+
+#include "event_attr.h"
+#include "event_type.h"
+#include "record.h"
+#include "record_file.h"
+
+using namespace simpleperf;
+
+namespace {
+
+// A FILE that discards data, but sleeps while writing to simulate slow storage.
+class ThrottledFile {
+ public:
+  static FILE* Open(uint64_t bytes_per_sec) {
+    cookie_io_functions_t funcs = {};
+    funcs.write = Write;
+    funcs.seek = Seek;
+    funcs.close = Close;
+    return fopencookie(new ThrottledFile(bytes_per_sec), "w", funcs);
+  }
+
+ private:
+  explicit ThrottledFile(uint64_t bytes_per_sec) : bytes_per_sec_(bytes_per_sec) {}
+
+  static ssize_t Write(void* cookie, const char*, size_t size) {
+    auto file = static_cast<ThrottledFile*>(cookie);
+    usleep(size * 1000000 / file->bytes_per_sec_);
+    file->pos_ += size;
+    return size;
+  }
+
+  static int Seek(void* cookie, off64_t* offset, int whence) {
+    auto file = static_cast<ThrottledFile*>(cookie);
+    if (whence == SEEK_SET) {
+      file->pos_ = *offset;
+    } else if (whence == SEEK_CUR) {
+      file->pos_ += *offset;
+    } else {
+      return -1;
+    }
+    *offset = file->pos_;
+    return 0;
+  }
+
+  static int Close(void* cookie) {
+    delete static_cast<ThrottledFile*>(cookie);
+    return 0;
+  }
+
+  const uint64_t bytes_per_sec_;
+  off64_t pos_ = 0;
+};
+
+// Args: storage bandwidth in MB/s, async write buffer size in KB (0 for synchronous writing).
+void BM_WriteRecordsToThrottledFile(benchmark::State& state) {
+  const uint64_t bytes_per_sec = state.range(0) << 20;
+  const size_t async_buffer_size = state.range(1) << 10;
+  std::unique_ptr<EventTypeAndModifier> event_type = ParseEventType("cpu-clock");
+  CHECK(event_type);
+  EventAttrIds attr_ids(1);
+  attr_ids[0].attr = CreateDefaultPerfEventAttr(event_type->event_type);
+  attr_ids[0].attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+  attr_ids[0].ids.push_back(0);
+  // A sample with a 64-frame callchain, around 600 bytes.
+  std::vector<uint64_t> ips(64, 0x1000);
+  SampleRecord sample(attr_ids[0].attr, 0, 0x1000, 1, 1, 0, 0, 1, {}, ips, {}, 0);
+  constexpr size_t SAMPLES_PER_ITERATION = 1000;
+  uint64_t blocked_count = 0;
+
+  for (auto _ : state) {
+    state.PauseTiming();
+    RecordFileWriter writer("throttled_file", ThrottledFile::Open(bytes_per_sec), true);
+    CHECK(writer.WriteAttrSection(attr_ids));
+    if (async_buffer_size != 0) {
+      CHECK(writer.EnableAsyncWrite(async_buffer_size));
+    }
+    state.ResumeTiming();
+    // Only the time spent in the recording thread is measured.
+    for (size_t i = 0; i < SAMPLES_PER_ITERATION; i++) {
+      CHECK(writer.WriteRecord(sample));
+    }
+    state.PauseTiming();
+    CHECK(writer.Close());
+    blocked_count += writer.GetAsyncWriteStat().blocked_count;
+    state.ResumeTiming();
+  }
+  state.SetBytesProcessed(state.iterations() * SAMPLES_PER_ITERATION * sample.size());
+  state.counters["blocked"] = benchmark::Counter(blocked_count, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_WriteRecordsToThrottledFile)
+    ->ArgNames({"MBps", "async_kb"})
+    ->Args({50, 0})
+    ->Args({50, 256})
+    ->Args({50, 1024})
+    ->Args({200, 0})
+    ->Args({200, 1024})
+    ->UseRealTime();
+
+}  // namespace
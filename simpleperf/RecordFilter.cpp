@@ -58,6 +58,9 @@ class TimeRanges {
 
   bool Empty() const { return ranges_.empty(); }
 
+  // Only valid when not empty.
+  uint64_t FirstBeginTime() const { return ranges_.front().first; }
+
   bool InRange(uint64_t timestamp) const {
     auto it = std::upper_bound(ranges_.begin(), ranges_.end(),
                                std::pair<uint64_t, uint64_t>(timestamp, 0));
@@ -111,6 +114,32 @@ class TimeFilter {
     return global_ranges_.Empty() && process_ranges_.empty() && thread_ranges_.empty();
   }
 
+  // Return a time before which no sample can pass the filter.
+  std::optional<uint64_t> GetStartTime() const {
+    // A sample needs to be in the global ranges, its process ranges and its thread ranges if
+    // they are used. So it can't be earlier than the first begin time of any used ranges.
+    std::optional<uint64_t> start_time;
+    auto update_start_time = [&](uint64_t time) {
+      start_time = start_time ? std::max(start_time.value(), time) : time;
+    };
+    if (!global_ranges_.Empty()) {
+      update_start_time(global_ranges_.FirstBeginTime());
+    }
+    for (const auto* ranges_map : {&process_ranges_, &thread_ranges_}) {
+      std::optional<uint64_t> min_time;
+      for (const auto& [_, ranges] : *ranges_map) {
+        if (!ranges.Empty()) {
+          min_time = min_time ? std::min(min_time.value(), ranges.FirstBeginTime())
+                              : ranges.FirstBeginTime();
+        }
+      }
+      if (min_time) {
+        update_start_time(min_time.value());
+      }
+    }
+    return start_time;
+  }
+
   bool Check(const SampleRecord& sample) const {
     uint64_t timestamp = sample.Timestamp();
     if (!global_ranges_.Empty() && !global_ranges_.InRange(timestamp)) {
@@ -196,6 +225,7 @@ class FilterFileReader {
         }
       }
     }
+    time_filter_->NoMoreTimestamp();
     return true;
   }
 
@@ -348,6 +378,10 @@ bool RecordFilter::Check(const SampleRecord* r) {
   return true;
 }
 
+std::optional<uint64_t> RecordFilter::GetStartTime() const {
+  return time_filter_ ? time_filter_->GetStartTime() : std::nullopt;
+}
+
 bool RecordFilter::CheckClock(const std::string& clock) {
   if (time_filter_ && time_filter_->GetClock() != clock) {
     LOG(ERROR) << "clock generating sample timestamps is " << clock
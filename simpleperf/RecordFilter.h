@@ -125,6 +125,9 @@ class RecordFilter {
   // Check if the clock matches the clock for timestamps in the filter file.
   bool CheckClock(const std::string& clock);
 
+  // Return a time before which no sample passes the filter, if the filter file limits it.
+  std::optional<uint64_t> GetStartTime() const;
+
   RecordFilterCondition& GetCondition(bool exclude) {
     return exclude ? exclude_condition_ : include_condition_;
   }
@@ -221,6 +221,22 @@ TEST_F(RecordFilterTest, clock_in_time_filter) {
   ASSERT_FALSE(filter.CheckClock("monotonic"));
 }
 
+TEST_F(RecordFilterTest, start_time_of_time_filter) {
+  ASSERT_FALSE(filter.GetStartTime().has_value());
+  ASSERT_TRUE(
+      SetFilterData("GLOBAL_BEGIN 3000\n"
+                    "GLOBAL_END 4000\n"
+                    "GLOBAL_BEGIN 1000\n"
+                    "GLOBAL_END 2000"));
+  ASSERT_EQ(filter.GetStartTime(), 1000u);
+  // A sample needs to be in both global ranges and process ranges.
+  ASSERT_TRUE(
+      SetFilterData("GLOBAL_BEGIN 1000\n"
+                    "PROCESS_BEGIN 1 3000\n"
+                    "PROCESS_BEGIN 2 2000"));
+  ASSERT_EQ(filter.GetStartTime(), 2000u);
+}
+
 TEST_F(RecordFilterTest, error_in_time_filter) {
   // no timestamp error
   ASSERT_FALSE(SetFilterData("GLOBAL_BEGIN"));
@@ -20,6 +20,7 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <unordered_map>
 
 #include "environment.h"
@@ -389,52 +390,72 @@ bool RecordReadThread::HandleCmd(IOEventLoop& loop) {
   return true;
 }
 
+// Creating a mapped buffer holds the mmap lock of the process while the kernel allocates the
+// buffer, so buffers are created one after another. But redirecting output of other event files
+// to the buffers doesn't, and there is one such file per monitored thread per cpu, so that is done
+// in parallel.
+static constexpr size_t kMinBufferSharesPerJob = 256;
+
 bool RecordReadThread::HandleAddEventFds(IOEventLoop& loop,
                                          const std::vector<EventFd*>& event_fds) {
+  // The first event file on each cpu owns the mapped buffer, others share it.
   std::unordered_map<int, EventFd*> cpu_map;
+  std::vector<EventFd*> owners;
+  std::vector<std::pair<EventFd*, EventFd*>> sharers;
+  for (EventFd* fd : event_fds) {
+    auto it = cpu_map.find(fd->Cpu());
+    if (it == cpu_map.end()) {
+      cpu_map[fd->Cpu()] = fd;
+      owners.push_back(fd);
+    } else {
+      sharers.emplace_back(fd, it->second);
+    }
+  }
+  bool mapped = false;
   for (size_t pages = max_mmap_pages_; pages >= min_mmap_pages_; pages >>= 1) {
     bool success = true;
     bool report_error = pages == min_mmap_pages_;
-    for (EventFd* fd : event_fds) {
-      auto it = cpu_map.find(fd->Cpu());
-      if (it == cpu_map.end()) {
-        if (!fd->CreateMappedBuffer(pages, report_error)) {
-          success = false;
-          break;
-        }
-        if (IsEtmEventType(fd->attr().type)) {
-          if (!fd->CreateAuxBuffer(aux_buffer_size_, report_error)) {
-            fd->DestroyMappedBuffer();
-            success = false;
-            break;
-          }
-        }
-        cpu_map[fd->Cpu()] = fd;
-      } else {
-        if (!fd->ShareMappedBuffer(*(it->second), pages == min_mmap_pages_)) {
+    for (EventFd* fd : owners) {
+      if (!fd->CreateMappedBuffer(pages, report_error)) {
+        success = false;
+        break;
+      }
+      if (IsEtmEventType(fd->attr().type)) {
+        if (!fd->CreateAuxBuffer(aux_buffer_size_, report_error)) {
+          fd->DestroyMappedBuffer();
           success = false;
           break;
         }
       }
     }
+    if (success) {
+      std::atomic<bool> share_success = true;
+      RunInParallel(sharers.size(), kMinBufferSharesPerJob, [&](size_t i) {
+        if (share_success &&
+            !sharers[i].first->ShareMappedBuffer(*sharers[i].second, report_error)) {
+          share_success = false;
+        }
+      });
+      success = share_success;
+    }
     if (success) {
       LOG(VERBOSE) << "Each kernel buffer is " << pages << " pages.";
+      mapped = true;
       break;
     }
-    for (auto& pair : cpu_map) {
-      pair.second->DestroyMappedBuffer();
-      pair.second->DestroyAuxBuffer();
+    for (EventFd* fd : owners) {
+      fd->DestroyMappedBuffer();
+      fd->DestroyAuxBuffer();
     }
-    cpu_map.clear();
   }
-  if (cpu_map.empty()) {
+  if (!mapped || owners.empty()) {
     return false;
   }
-  for (auto& pair : cpu_map) {
-    if (!pair.second->StartPolling(loop, [this]() { return ReadRecordsFromKernelBuffer(); })) {
+  for (EventFd* fd : owners) {
+    if (!fd->StartPolling(loop, [this]() { return ReadRecordsFromKernelBuffer(); })) {
       return false;
     }
-    kernel_record_readers_.emplace_back(pair.second);
+    kernel_record_readers_.emplace_back(fd);
   }
   return true;
 }
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SampleSpeedController.h"
+
+#include <inttypes.h>
+
+#include <algorithm>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+
+namespace simpleperf {
+
+bool SampleSpeedController::Update(uint64_t timestamp, uint64_t throttle_count,
+                                   uint64_t lost_count, double cpu_percent) {
+  double new_ratio = ratio_;
+  if (throttle_count != 0 || lost_count != 0 || cpu_percent > max_cpu_percent_) {
+    new_ratio = std::max(ratio_ / 2, kMinRatio);
+  } else if (cpu_percent < max_cpu_percent_ / 2) {
+    new_ratio = std::min(ratio_ * 1.25, 1.0);
+  }
+  if (new_ratio == ratio_) {
+    return false;
+  }
+  LOG(DEBUG) << "sample speed ratio " << ratio_ << " -> " << new_ratio
+             << ", throttle_count=" << throttle_count << ", lost_count=" << lost_count
+             << ", cpu_percent=" << cpu_percent;
+  ratio_ = new_ratio;
+  changes_.emplace_back(Change{timestamp, ratio_});
+  return true;
+}
+
+std::string SampleSpeedController::ChangesToString() const {
+  std::string s;
+  for (const Change& change : changes_) {
+    if (!s.empty()) {
+      s.push_back(',');
+    }
+    s += android::base::StringPrintf("%" PRIu64 ":%g", change.timestamp, change.ratio);
+  }
+  return s;
+}
+
+}  // namespace simpleperf
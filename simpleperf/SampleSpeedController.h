@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace simpleperf {
+
+// SampleSpeedController decides how to scale the sample speed (frequency or period) of sampling
+// events at runtime, to keep the overhead of recording within a budget. It is updated
+// periodically with what happened in the last period:
+// 1. If the kernel throttled samples, lost records, or the record process used more cpu time than
+//    the budget, the sample speed is halved.
+// 2. If none of the above happened and the cpu usage is far below the budget, the sample speed is
+//    increased gradually, until reaching the speed set by the user.
+class SampleSpeedController {
+ public:
+  struct Change {
+    uint64_t timestamp;
+    double ratio;
+  };
+
+  // max_cpu_percent: the cpu time budget of the record process, in percentage of one cpu.
+  SampleSpeedController(double max_cpu_percent) : max_cpu_percent_(max_cpu_percent) {}
+
+  // Return true if the sample speed ratio changes.
+  bool Update(uint64_t timestamp, uint64_t throttle_count, uint64_t lost_count,
+              double cpu_percent);
+
+  // The sample speed relative to the one set by the user, in (0, 1].
+  double Ratio() const { return ratio_; }
+  const std::vector<Change>& Changes() const { return changes_; }
+  // Format changes as "timestamp:ratio,timestamp:ratio,...", stored in the meta info feature.
+  std::string ChangesToString() const;
+
+  static constexpr double kMinRatio = 1.0 / 64;
+
+ private:
+  const double max_cpu_percent_;
+  double ratio_ = 1.0;
+  std::vector<Change> changes_;
+};
+
+}  // namespace simpleperf
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SampleSpeedController.h"
+
+#include <gtest/gtest.h>
+
+using namespace simpleperf;
+
+TEST(SampleSpeedController, decrease_when_overloaded) {
+  SampleSpeedController controller(10);
+  ASSERT_FALSE(controller.Update(1, 0, 0, 8));
+  ASSERT_EQ(controller.Ratio(), 1.0);
+  // Throttled by the kernel.
+  ASSERT_TRUE(controller.Update(2, 1, 0, 8));
+  ASSERT_EQ(controller.Ratio(), 0.5);
+  // Lost records.
+  ASSERT_TRUE(controller.Update(3, 0, 1, 8));
+  ASSERT_EQ(controller.Ratio(), 0.25);
+  // Over the cpu budget.
+  ASSERT_TRUE(controller.Update(4, 0, 0, 20));
+  ASSERT_EQ(controller.Ratio(), 0.125);
+  ASSERT_EQ(controller.ChangesToString(), "2:0.5,3:0.25,4:0.125");
+  for (int i = 0; i < 10; i++) {
+    controller.Update(5 + i, 1, 0, 20);
+  }
+  ASSERT_EQ(controller.Ratio(), SampleSpeedController::kMinRatio);
+}
+
+TEST(SampleSpeedController, increase_when_idle) {
+  SampleSpeedController controller(10);
+  ASSERT_TRUE(controller.Update(1, 1, 0, 1));
+  ASSERT_EQ(controller.Ratio(), 0.5);
+  // Not far below the budget, keep the ratio.
+  ASSERT_FALSE(controller.Update(2, 0, 0, 8));
+  ASSERT_TRUE(controller.Update(3, 0, 0, 1));
+  ASSERT_EQ(controller.Ratio(), 0.625);
+  for (int i = 0; i < 10; i++) {
+    controller.Update(4 + i, 0, 0, 1);
+  }
+  // Never exceed the speed set by the user.
+  ASSERT_EQ(controller.Ratio(), 1.0);
+  ASSERT_EQ(controller.Changes().size(), 5u);
+  ASSERT_EQ(controller.Changes().back().timestamp, 6u);
+}
@@ -160,11 +160,15 @@ class ProfileSessionImpl {
       : app_data_dir_(app_data_dir), simpleperf_data_dir_(app_data_dir + "/simpleperf_data") {}
   ~ProfileSessionImpl();
   void StartRecording(const std::vector<std::string>& args);
+  void PrepareRecording(const std::vector<std::string>& args);
+  void StartPreparedRecording();
+  uint64_t GetLastStartDelayInNs();
   void PauseRecording();
   void ResumeRecording();
   void StopRecording();
 
  private:
+  void StartSimpleperf(const std::vector<std::string>& args);
   std::string FindSimpleperf();
   std::string FindSimpleperfInTempDir();
   void CheckIfPerfEnabled();
@@ -177,6 +181,7 @@ class ProfileSessionImpl {
 
   enum State {
     NOT_YET_STARTED,
+    PREPARED,
     STARTED,
     PAUSED,
     STOPPED,
@@ -190,6 +195,8 @@ class ProfileSessionImpl {
   int control_fd_ = -1;
   int reply_fd_ = -1;
   bool trace_offcpu_ = false;
+  bool prepared_ = false;
+  uint64_t last_start_delay_in_ns_ = 0;
 };
 
 ProfileSessionImpl::~ProfileSessionImpl() {
@@ -206,6 +213,37 @@ void ProfileSessionImpl::StartRecording(const std::vector<std::string>& args) {
   if (state_ != NOT_YET_STARTED) {
     Abort("startRecording: session in wrong state %d", state_);
   }
+  StartSimpleperf(args);
+  state_ = STARTED;
+}
+
+void ProfileSessionImpl::PrepareRecording(const std::vector<std::string>& args) {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (state_ != NOT_YET_STARTED) {
+    Abort("prepareRecording: session in wrong state %d", state_);
+  }
+  std::vector<std::string> new_args = args;
+  new_args.emplace_back("--start-paused");
+  StartSimpleperf(new_args);
+  prepared_ = true;
+  state_ = PREPARED;
+}
+
+void ProfileSessionImpl::StartPreparedRecording() {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (state_ != PREPARED) {
+    Abort("startPreparedRecording: session in wrong state %d", state_);
+  }
+  SendCmd("resume");
+  state_ = STARTED;
+}
+
+uint64_t ProfileSessionImpl::GetLastStartDelayInNs() {
+  std::lock_guard<std::mutex> guard(lock_);
+  return last_start_delay_in_ns_;
+}
+
+void ProfileSessionImpl::StartSimpleperf(const std::vector<std::string>& args) {
   for (const auto& arg : args) {
     if (arg == "--trace-offcpu") {
       trace_offcpu_ = true;
@@ -215,7 +253,6 @@ void ProfileSessionImpl::StartRecording(const std::vector<std::string>& args) {
   CheckIfPerfEnabled();
   CreateSimpleperfDataDir();
   CreateSimpleperfProcess(simpleperf_path, args);
-  state_ = STARTED;
 }
 
 void ProfileSessionImpl::PauseRecording() {
@@ -241,9 +278,13 @@ void ProfileSessionImpl::ResumeRecording() {
 
 void ProfileSessionImpl::StopRecording() {
   std::lock_guard<std::mutex> guard(lock_);
-  if (state_ != STARTED && state_ != PAUSED) {
+  if (state_ != STARTED && state_ != PAUSED && state_ != PREPARED) {
     Abort("stopRecording: session in wrong state %d", state_);
   }
+  if (prepared_ && state_ == STARTED && !trace_offcpu_) {
+    // Stop generating samples before simpleperf finishes processing records.
+    SendCmd("pause");
+  }
   // Send SIGINT to simpleperf to stop recording.
   if (kill(simpleperf_pid_, SIGINT) == -1) {
     Abort("failed to stop simpleperf: %s", strerror(errno));
@@ -259,8 +300,15 @@ void ProfileSessionImpl::StopRecording() {
   state_ = STOPPED;
 }
 
+static uint64_t GetMonotonicTimeInNs() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 void ProfileSessionImpl::SendCmd(const std::string& cmd) {
   std::string data = cmd + "\n";
+  uint64_t start_time = GetMonotonicTimeInNs();
   if (TEMP_FAILURE_RETRY(write(control_fd_, &data[0], data.size())) !=
       static_cast<ssize_t>(data.size())) {
     Abort("failed to send cmd to simpleperf: %s", strerror(errno));
@@ -268,6 +316,9 @@ void ProfileSessionImpl::SendCmd(const std::string& cmd) {
   if (ReadReply() != "ok") {
     Abort("failed to run cmd in simpleperf: %s", cmd.c_str());
   }
+  if (cmd == "resume") {
+    last_start_delay_in_ns_ = GetMonotonicTimeInNs() - start_time;
+  }
 }
 
 static bool IsExecutableFile(const std::string& path) {
@@ -515,6 +566,22 @@ void ProfileSession::StartRecording(const std::vector<std::string>& record_args)
   impl_->StartRecording(record_args);
 }
 
+void ProfileSession::PrepareRecording(const RecordOptions& options) {
+  PrepareRecording(options.ToRecordArgs());
+}
+
+void ProfileSession::PrepareRecording(const std::vector<std::string>& record_args) {
+  impl_->PrepareRecording(record_args);
+}
+
+void ProfileSession::StartPreparedRecording() {
+  impl_->StartPreparedRecording();
+}
+
+uint64_t ProfileSession::GetLastStartDelayInNs() {
+  return impl_->GetLastStartDelayInNs();
+}
+
 void ProfileSession::PauseRecording() {
   impl_->PauseRecording();
 }
@@ -15,6 +15,7 @@
  */
 
 #pragma once
+#include <stdint.h>
 #include <sys/types.h>
 #include <unistd.h>
 
@@ -109,6 +110,18 @@ class RecordOptions {
  *   sleep(1);
  *   session.StopRecording();
  *
+ * To profile a short code section, use PrepareRecording() ahead of time. It starts
+ * `simpleperf record` with perf events opened but paused. Then StartPreparedRecording() only
+ * needs to enable perf events, which takes much less time than StartRecording().
+ *
+ * Example:
+ *   ProfileSession session;
+ *   session.PrepareRecording(options);
+ *   ...
+ *   session.StartPreparedRecording();
+ *   RunCodeToProfile();
+ *   session.StopRecording();
+ *
  * It aborts when error happens. To read error messages of simpleperf record
  * process, filter logcat with `simpleperf`.
  */
@@ -139,6 +152,31 @@ class ProfileSession {
    */
   void StartRecording(const std::vector<std::string>& record_args);
 
+  /**
+   * Prepare recording. Perf events are opened in paused state, and no samples are generated until
+   * StartPreparedRecording() is called.
+   * @param options RecordOptions
+   */
+  void PrepareRecording(const RecordOptions& options);
+
+  /**
+   * Prepare recording.
+   * @param args arguments for `simpleperf record` cmd.
+   */
+  void PrepareRecording(const std::vector<std::string>& record_args);
+
+  /**
+   * Start a session prepared by PrepareRecording().
+   */
+  void StartPreparedRecording();
+
+  /**
+   * Return the time in nanoseconds taken by the last StartPreparedRecording() or
+   * ResumeRecording(), from sending the cmd to simpleperf until receiving the reply after perf
+   * events are enabled. Return 0 if neither has been called.
+   */
+  uint64_t GetLastStartDelayInNs();
+
   /**
    * Pause recording. No samples are generated in paused state.
    */
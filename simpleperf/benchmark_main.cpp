@@ -0,0 +1,61 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <libgen.h>
+#include <string.h>
+
+#include <string>
+
+#include <android-base/logging.h>
+#include <android-base/strings.h>
+#include <benchmark/benchmark.h>
+
+#include "get_test_data.h"
+#include "utils.h"
+
+using namespace simpleperf;
+
+static std::string testdata_dir;
+
+int main(int argc, char** argv) {
+  android::base::InitLogging(argv, android::base::StderrLogger);
+  android::base::ScopedLogSeverity severity(android::base::WARNING);
+  benchmark::Initialize(&argc, argv);
+  testdata_dir = std::string(dirname(argv[0])) + "/testdata";
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+      testdata_dir = argv[i + 1];
+      i++;
+    }
+  }
+  if (!IsDir(testdata_dir)) {
+    LOG(ERROR) << "testdata wasn't found. Use \"" << argv[0] << " -t <testdata_dir>\"";
+    return 1;
+  }
+  if (!android::base::EndsWith(testdata_dir, OS_PATH_SEPARATOR)) {
+    testdata_dir += OS_PATH_SEPARATOR;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
+
+std::string GetTestData(const std::string& filename) {
+  return testdata_dir + filename;
+}
+
+const std::string& GetTestDataDir() {
+  return testdata_dir;
+}
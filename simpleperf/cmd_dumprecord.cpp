@@ -541,6 +541,14 @@ bool DumpRecordCommand::DumpFeatureSection() {
           PrintIndented(2, "size: %" PRIu64 "\n", file.size);
         }
       }
+    } else if (feature == FEAT_TIME_INDEX) {
+      PrintIndented(1, "time_index:\n");
+      if (auto time_index = record_file_reader_->ReadTimeIndexFeature(); time_index) {
+        for (const TimeIndexEntry& entry : time_index.value()) {
+          PrintIndented(2, "time %" PRIu64 ", cpu %u, offset %" PRIu64 "\n", entry.time,
+                        entry.cpu, entry.offset);
+        }
+      }
     } else if (feature == FEAT_ETM_BRANCH_LIST) {
       std::string data;
       if (!record_file_reader_->ReadFeatureSection(FEAT_ETM_BRANCH_LIST, &data)) {
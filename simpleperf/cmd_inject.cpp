@@ -16,12 +16,16 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
+#include <android-base/file.h>
 #include <android-base/parseint.h>
 #include <android-base/strings.h>
 
@@ -51,6 +55,7 @@ struct AddrPairHash {
 
 enum class OutputFormat {
   AutoFDO,
+  AutoFDOBinary,
   BranchList,
 };
 
@@ -62,14 +67,20 @@ struct AutoFDOBinaryInfo {
   void AddInstrRange(const ETMInstrRange& instr_range) {
     uint64_t total_count = instr_range.branch_taken_count;
     OverflowSafeAdd(total_count, instr_range.branch_not_taken_count);
-    OverflowSafeAdd(range_count_map[AddrPair(instr_range.start_addr, instr_range.end_addr)],
-                    total_count);
+    AddRange(instr_range.start_addr, instr_range.end_addr, total_count);
     if (instr_range.branch_taken_count > 0) {
-      OverflowSafeAdd(branch_count_map[AddrPair(instr_range.end_addr, instr_range.branch_to_addr)],
-                      instr_range.branch_taken_count);
+      AddBranch(instr_range.end_addr, instr_range.branch_to_addr, instr_range.branch_taken_count);
     }
   }
 
+  void AddRange(uint64_t start_addr, uint64_t end_addr, uint64_t count) {
+    OverflowSafeAdd(range_count_map[AddrPair(start_addr, end_addr)], count);
+  }
+
+  void AddBranch(uint64_t from_addr, uint64_t to_addr, uint64_t count) {
+    OverflowSafeAdd(branch_count_map[AddrPair(from_addr, to_addr)], count);
+  }
+
   void Merge(const AutoFDOBinaryInfo& other) {
     for (const auto& p : other.range_count_map) {
       auto res = range_count_map.emplace(p.first, p.second);
@@ -86,6 +97,47 @@ struct AutoFDOBinaryInfo {
   }
 };
 
+struct AddrPairCount {
+  uint64_t first;
+  uint64_t second;
+  uint64_t count;
+};
+
+// Flatten a count map into an array sorted by address pairs. It is much cheaper than building a
+// std::map when there are a lot of instruction ranges.
+static std::vector<AddrPairCount> GetSortedAddrPairCounts(
+    const std::unordered_map<AddrPair, uint64_t, AddrPairHash>& count_map) {
+  std::vector<AddrPairCount> result;
+  result.reserve(count_map.size());
+  for (const auto& [addr_pair, count] : count_map) {
+    result.push_back({addr_pair.first, addr_pair.second, count});
+  }
+  std::sort(result.begin(), result.end(), [](const AddrPairCount& a, const AddrPairCount& b) {
+    return a.first < b.first || (a.first == b.first && a.second < b.second);
+  });
+  return result;
+}
+
+// The binary AutoFDO profile format, which is much more compact and faster to read and write than
+// the text format. All values are little endian.
+//   magic (8 bytes), binary_count (uint32)
+//   for each binary:
+//     path_size (uint32), path, build_id (20 bytes), first_load_segment_addr (uint64)
+//     range_count (uint64), range_count * (start_addr, end_addr, count) (uint64 each)
+//     branch_count (uint64), branch_count * (from_addr, to_addr, count) (uint64 each)
+// Addresses are vaddrs in binaries. Ranges and branches are sorted by addresses.
+static constexpr char AUTOFDO_BINARY_MAGIC[8] = {'A', 'F', 'D', 'O', 'B', 'I', 'N', '1'};
+
+static bool IsAutoFDOBinaryFile(const std::string& filename) {
+  auto fd = FileHelper::OpenReadOnly(filename);
+  if (fd.ok()) {
+    char magic[sizeof(AUTOFDO_BINARY_MAGIC)];
+    return android::base::ReadFully(fd, magic, sizeof(magic)) &&
+           memcmp(magic, AUTOFDO_BINARY_MAGIC, sizeof(magic)) == 0;
+  }
+  return false;
+}
+
 using AutoFDOBinaryCallback = std::function<void(const BinaryKey&, AutoFDOBinaryInfo&)>;
 using BranchListBinaryCallback = std::function<void(const BinaryKey&, BranchListBinaryInfo&)>;
 
@@ -181,6 +233,16 @@ class PerfDataReader {
         thread_tree_.ExcludePid(pid);
       }
     }
+    for (const auto& attr_id : record_file_reader_->AttrSection()) {
+      if (attr_id.attr.sample_type & PERF_SAMPLE_BRANCH_STACK) {
+        has_branch_stack_ = true;
+      }
+    }
+    if (has_branch_stack_ && branch_list_callback_) {
+      LOG(ERROR) << "convert to branch-list format isn't supported on perf.data with branch stack "
+                    "samples";
+      return false;
+    }
     if (!record_file_reader_->LoadBuildIdAndFileFeatures(thread_tree_.GetThreadTree())) {
       return false;
     }
@@ -260,6 +322,8 @@ class PerfDataReader {
         return etm_decoder_->ProcessData(aux_data_buffer_.data(), aux_size, !aux->Unformatted(),
                                          aux->Cpu());
       }
+    } else if (r->type() == PERF_RECORD_SAMPLE && has_branch_stack_ && autofdo_callback_) {
+      ProcessBranchStackSample(*static_cast<SampleRecord*>(r));
     } else if (r->type() == PERF_RECORD_MMAP && r->InKernel()) {
       auto& mmap_r = *static_cast<MmapRecord*>(r);
       if (android::base::StartsWith(mmap_r.filename, DEFAULT_KERNEL_MMAP_NAME)) {
@@ -277,6 +341,53 @@ class PerfDataReader {
     autofdo_binary_map_[instr_range.dso].AddInstrRange(instr_range);
   }
 
+  // Aggregate branch stack (like LBR and BRBE) samples into instruction ranges and branches.
+  void ProcessBranchStackSample(const SampleRecord& r) {
+    if ((r.sample_type & PERF_SAMPLE_BRANCH_STACK) == 0) {
+      return;
+    }
+    const ThreadEntry* thread = thread_tree_.FindThread(r.tid_data.tid);
+    if (thread == nullptr) {
+      return;
+    }
+    const PerfSampleBranchStackType& branch_stack = r.branch_stack_data;
+    // Branch stack entries are ordered from the newest branch to the oldest one. The instructions
+    // from the target of an older branch to the source of the next newer branch are executed
+    // sequentially.
+    for (size_t i = 0; i < branch_stack.stack_nr; i++) {
+      const BranchStackItemType& item = branch_stack.stack[i];
+      Dso* from_dso;
+      uint64_t from_vaddr;
+      if (!IpToVaddrInFile(thread, item.from, from_dso, from_vaddr)) {
+        continue;
+      }
+      Dso* to_dso;
+      uint64_t to_vaddr;
+      if (IpToVaddrInFile(thread, item.to, to_dso, to_vaddr) && to_dso == from_dso) {
+        autofdo_binary_map_[from_dso].AddBranch(from_vaddr, to_vaddr, 1);
+      }
+      if (i + 1 < branch_stack.stack_nr) {
+        Dso* start_dso;
+        uint64_t start_vaddr;
+        if (IpToVaddrInFile(thread, branch_stack.stack[i + 1].to, start_dso, start_vaddr) &&
+            start_dso == from_dso && start_vaddr <= from_vaddr) {
+          autofdo_binary_map_[from_dso].AddRange(start_vaddr, from_vaddr, 1);
+        }
+      }
+    }
+  }
+
+  bool IpToVaddrInFile(const ThreadEntry* thread, uint64_t ip, Dso*& dso, uint64_t& vaddr) {
+    const MapEntry* map = thread_tree_.GetThreadTree().FindMap(thread, ip);
+    if (map == nullptr || thread_tree_.GetThreadTree().IsUnknownDso(map->dso) ||
+        !binary_filter_.Filter(map->dso)) {
+      return false;
+    }
+    dso = map->dso;
+    vaddr = dso->IpToVaddrInFile(ip, map->start_addr, map->pgoff);
+    return true;
+  }
+
   void ProcessBranchList(const ETMBranchList& branch_list) {
     if (!binary_filter_.Filter(branch_list.dso)) {
       return;
@@ -329,6 +440,7 @@ class PerfDataReader {
   std::unique_ptr<RecordFileReader> record_file_reader_;
   ETMThreadTreeWithFilter thread_tree_;
   uint64_t kernel_map_start_addr_ = 0;
+  bool has_branch_stack_ = false;
   // Store results for AutoFDO.
   std::unordered_map<Dso*, AutoFDOBinaryInfo> autofdo_binary_map_;
   // Store results for BranchList.
@@ -369,9 +481,97 @@ class BranchListReader {
   BranchListBinaryCallback callback_;
 };
 
+// Read a file in binary AutoFDO profile format, and generate AutoFDOBinaryInfo.
+class AutoFDOBinaryReader {
+ public:
+  AutoFDOBinaryReader(const std::string& filename, const RegEx* binary_name_regex)
+      : filename_(filename), binary_filter_(binary_name_regex) {}
+
+  void SetCallback(const AutoFDOBinaryCallback& callback) { callback_ = callback; }
+
+  bool Read() {
+    std::string s;
+    if (!android::base::ReadFileToString(filename_, &s)) {
+      PLOG(ERROR) << "failed to read " << filename_;
+      return false;
+    }
+    p_ = s.data();
+    end_ = s.data() + s.size();
+    char magic[sizeof(AUTOFDO_BINARY_MAGIC)];
+    uint32_t binary_count;
+    if (!ReadData(magic, sizeof(magic)) ||
+        memcmp(magic, AUTOFDO_BINARY_MAGIC, sizeof(magic)) != 0 || !ReadValue(binary_count)) {
+      return FormatError();
+    }
+    for (uint32_t i = 0; i < binary_count; i++) {
+      uint32_t path_size;
+      if (!ReadValue(path_size) || path_size > RemainingSize()) {
+        return FormatError();
+      }
+      std::string path(p_, path_size);
+      p_ += path_size;
+      unsigned char build_id_data[BUILD_ID_SIZE];
+      AutoFDOBinaryInfo binary;
+      if (!ReadData(build_id_data, sizeof(build_id_data)) ||
+          !ReadValue(binary.first_load_segment_addr) ||
+          !ReadCountMap(binary.range_count_map) || !ReadCountMap(binary.branch_count_map)) {
+        return FormatError();
+      }
+      if (binary_filter_.Filter(path)) {
+        callback_(BinaryKey(path, BuildId(build_id_data, sizeof(build_id_data))), binary);
+      }
+    }
+    return true;
+  }
+
+ private:
+  size_t RemainingSize() const { return end_ - p_; }
+
+  bool ReadData(void* data, size_t size) {
+    if (size > RemainingSize()) {
+      return false;
+    }
+    MoveFromBinaryFormat(static_cast<char*>(data), size, p_);
+    return true;
+  }
+
+  template <typename T>
+  bool ReadValue(T& value) {
+    return ReadData(&value, sizeof(value));
+  }
+
+  bool ReadCountMap(std::unordered_map<AddrPair, uint64_t, AddrPairHash>& count_map) {
+    uint64_t size;
+    if (!ReadValue(size) || size > RemainingSize() / sizeof(AddrPairCount)) {
+      return false;
+    }
+    count_map.reserve(size);
+    for (uint64_t i = 0; i < size; i++) {
+      AddrPairCount item;
+      ReadData(&item, sizeof(item));
+      count_map.emplace(AddrPair(item.first, item.second), item.count);
+    }
+    return true;
+  }
+
+  bool FormatError() {
+    LOG(ERROR) << "file is in wrong format: " << filename_;
+    return false;
+  }
+
+  const std::string filename_;
+  BinaryFilter binary_filter_;
+  AutoFDOBinaryCallback callback_;
+  const char* p_ = nullptr;
+  const char* end_ = nullptr;
+};
+
 // Convert BranchListBinaryInfo into AutoFDOBinaryInfo.
 class BranchListToAutoFDOConverter {
  public:
+  // Cache decoded basic blocks of binaries in block_cache_dir, keyed by build id.
+  void SetBlockCacheDir(const std::string& block_cache_dir) { block_cache_dir_ = block_cache_dir; }
+
   std::unique_ptr<AutoFDOBinaryInfo> Convert(const BinaryKey& key, BranchListBinaryInfo& binary) {
     BuildId build_id = key.build_id;
     std::unique_ptr<Dso> dso = Dso::CreateDsoWithBuildId(binary.dso_type, key.path, build_id);
@@ -390,13 +590,26 @@ class BranchListToAutoFDOConverter {
       autofdo_binary->AddInstrRange(range);
     };
 
-    auto result =
-        ConvertBranchMapToInstrRanges(dso.get(), binary.GetOrderedBranchMap(), process_instr_range);
+    ETMBasicBlockTable block_table;
+    std::string block_cache_path;
+    if (!block_cache_dir_.empty() && !key.build_id.IsEmpty()) {
+      // Skip the "0x" prefix of the build id string.
+      block_cache_path =
+          block_cache_dir_ + OS_PATH_SEPARATOR + key.build_id.ToString().substr(2) + ".bb";
+      block_table.Load(block_cache_path, key.build_id);
+    }
+    size_t cached_blocks = block_table.Size();
+
+    auto result = ConvertBranchMapToInstrRanges(dso.get(), binary.GetOrderedBranchMap(),
+                                                process_instr_range, &block_table);
     if (!result.ok()) {
       LOG(WARNING) << "failed to build instr ranges for binary " << dso->Path() << ": "
                    << result.error();
       return nullptr;
     }
+    if (!block_cache_path.empty() && block_table.Size() != cached_blocks) {
+      block_table.Save(block_cache_path, key.build_id);
+    }
     return autofdo_binary;
   }
 
@@ -425,12 +638,28 @@ class BranchListToAutoFDOConverter {
     }
     binary.branch_map = std::move(new_branch_map);
   }
+
+  std::string block_cache_dir_;
 };
 
+// Order binaries by path, build id and kernel start addr, to generate stable output.
+static bool CompareBinaryKey(const BinaryKey& key1, const BinaryKey& key2) {
+  if (key1.path != key2.path) {
+    return key1.path < key2.path;
+  }
+  if (key1.build_id != key2.build_id) {
+    return memcmp(key1.build_id.Data(), key2.build_id.Data(), BuildId::Size()) < 0;
+  }
+  return key1.kernel_start_addr < key2.kernel_start_addr;
+}
+
 // Write instruction ranges to a file in AutoFDO text format.
 class AutoFDOWriter {
  public:
-  void AddAutoFDOBinary(const BinaryKey& key, AutoFDOBinaryInfo& binary) {
+  // Addresses in AutoFDOBinaryInfo are always vaddrs in binaries, even for the kernel. So binaries
+  // are merged by path and build id, ignoring the kernel start addr they were recorded with.
+  void AddAutoFDOBinary(const BinaryKey& binary_key, AutoFDOBinaryInfo& binary) {
+    BinaryKey key(binary_key.path, binary_key.build_id);
     auto it = binary_map_.find(key);
     if (it == binary_map_.end()) {
       binary_map_[key] = std::move(binary);
@@ -453,8 +682,7 @@ class AutoFDOWriter {
     for (auto& p : binary_map_) {
       keys.emplace_back(p.first);
     }
-    std::sort(keys.begin(), keys.end(),
-              [](const BinaryKey& key1, const BinaryKey& key2) { return key1.path < key2.path; });
+    std::sort(keys.begin(), keys.end(), CompareBinaryKey);
     if (keys.size() > 1) {
       fprintf(output_fp.get(),
               "// Please split this file. AutoFDO only accepts profile for one binary.\n");
@@ -474,30 +702,22 @@ class AutoFDOWriter {
       };
 
       // Write range_count_map.
-      std::map<AddrPair, uint64_t> range_count_map(binary.range_count_map.begin(),
-                                                   binary.range_count_map.end());
-      fprintf(output_fp.get(), "%zu\n", range_count_map.size());
-      for (const auto& pair2 : range_count_map) {
-        const AddrPair& addr_range = pair2.first;
-        uint64_t count = pair2.second;
-
-        fprintf(output_fp.get(), "%" PRIx64 "-%" PRIx64 ":%" PRIu64 "\n",
-                to_offset(addr_range.first), to_offset(addr_range.second), count);
+      std::vector<AddrPairCount> range_counts = GetSortedAddrPairCounts(binary.range_count_map);
+      fprintf(output_fp.get(), "%zu\n", range_counts.size());
+      for (const auto& range : range_counts) {
+        fprintf(output_fp.get(), "%" PRIx64 "-%" PRIx64 ":%" PRIu64 "\n", to_offset(range.first),
+                to_offset(range.second), range.count);
       }
 
       // Write addr_count_map.
       fprintf(output_fp.get(), "0\n");
 
       // Write branch_count_map.
-      std::map<AddrPair, uint64_t> branch_count_map(binary.branch_count_map.begin(),
-                                                    binary.branch_count_map.end());
-      fprintf(output_fp.get(), "%zu\n", branch_count_map.size());
-      for (const auto& pair2 : branch_count_map) {
-        const AddrPair& branch = pair2.first;
-        uint64_t count = pair2.second;
-
+      std::vector<AddrPairCount> branch_counts = GetSortedAddrPairCounts(binary.branch_count_map);
+      fprintf(output_fp.get(), "%zu\n", branch_counts.size());
+      for (const auto& branch : branch_counts) {
         fprintf(output_fp.get(), "%" PRIx64 "->%" PRIx64 ":%" PRIu64 "\n", to_offset(branch.first),
-                to_offset(branch.second), count);
+                to_offset(branch.second), branch.count);
       }
 
       // Write the binary path in comment.
@@ -507,6 +727,47 @@ class AutoFDOWriter {
     return true;
   }
 
+  // Write instruction ranges to a file in binary AutoFDO profile format.
+  bool WriteBinary(const std::string& output_filename) {
+    std::unique_ptr<FILE, decltype(&fclose)> output_fp(fopen(output_filename.c_str(), "wb"),
+                                                      fclose);
+    if (!output_fp) {
+      PLOG(ERROR) << "failed to write to " << output_filename;
+      return false;
+    }
+    std::vector<const BinaryKey*> keys;
+    for (auto& p : binary_map_) {
+      keys.emplace_back(&p.first);
+    }
+    std::sort(keys.begin(), keys.end(), [](const BinaryKey* key1, const BinaryKey* key2) {
+      return CompareBinaryKey(*key1, *key2);
+    });
+    FILE* fp = output_fp.get();
+    auto write = [&](const void* data, size_t size) { return fwrite(data, size, 1, fp) == 1; };
+    uint32_t binary_count = keys.size();
+    bool ok = write(AUTOFDO_BINARY_MAGIC, sizeof(AUTOFDO_BINARY_MAGIC)) &&
+              write(&binary_count, sizeof(binary_count));
+    for (size_t i = 0; ok && i < keys.size(); i++) {
+      const BinaryKey& key = *keys[i];
+      const AutoFDOBinaryInfo& binary = binary_map_[key];
+      uint32_t path_size = key.path.size();
+      ok = write(&path_size, sizeof(path_size)) && write(key.path.data(), path_size) &&
+           write(key.build_id.Data(), BuildId::Size()) &&
+           write(&binary.first_load_segment_addr, sizeof(binary.first_load_segment_addr));
+      for (const auto* count_map : {&binary.range_count_map, &binary.branch_count_map}) {
+        std::vector<AddrPairCount> counts = GetSortedAddrPairCounts(*count_map);
+        uint64_t size = counts.size();
+        ok = ok && write(&size, sizeof(size)) &&
+             (counts.empty() || write(counts.data(), counts.size() * sizeof(AddrPairCount)));
+      }
+    }
+    if (!ok || fflush(fp) != 0) {
+      PLOG(ERROR) << "failed to write to " << output_filename;
+      return false;
+    }
+    return true;
+  }
+
  private:
   std::unordered_map<BinaryKey, AutoFDOBinaryInfo, BinaryKeyHash> binary_map_;
 };
@@ -551,18 +812,28 @@ class BranchListWriter {
 class InjectCommand : public Command {
  public:
   InjectCommand()
-      : Command("inject", "parse etm instruction tracing data",
+      : Command("inject", "parse etm instruction tracing data or branch stack samples",
                 // clang-format off
 "Usage: simpleperf inject [options]\n"
+"--bb-cache-dir <dir>         When converting branch lists to autofdo format, save basic blocks\n"
+"                             decoded from binaries in dir, and reuse them for binaries with\n"
+"                             the same build id in later conversions.\n"
 "--binary binary_name         Generate data only for binaries matching binary_name regex.\n"
 "-i file1,file2,...           Input files. Default is perf.data. Support below formats:\n"
-"                               1. perf.data generated by recording cs-etm event type.\n"
+"                               1. perf.data generated by recording cs-etm event type, or\n"
+"                                  recording with branch stack sampling (-b or -j). Branch\n"
+"                                  stack samples can only be converted to autofdo formats.\n"
 "                               2. branch_list file generated by `inject --output branch-list`.\n"
+"                               3. autofdo binary file generated by\n"
+"                                  `inject --output autofdo-binary`.\n"
 "                             If a file name starts with @, it contains a list of input files.\n"
 "-o <file>                    output file. Default is perf_inject.data.\n"
 "--output <format>            Select output file format:\n"
 "                               autofdo      -- text format accepted by TextSampleReader\n"
 "                                               of AutoFDO\n"
+"                               autofdo-binary -- compact binary format of autofdo, which is\n"
+"                                               faster to write and merge. It can be\n"
+"                                               converted to autofdo by inject later.\n"
 "                               branch-list  -- protobuf file in etm_branch_list.proto\n"
 "                             Default is autofdo.\n"
 "--dump-etm type1,type2,...   Dump etm data. A type is one of raw, packet and element.\n"
@@ -589,13 +860,24 @@ class InjectCommand : public Command {
     if (IsPerfDataFile(input_filenames_[0])) {
       switch (output_format_) {
         case OutputFormat::AutoFDO:
+        case OutputFormat::AutoFDOBinary:
           return ConvertPerfDataToAutoFDO();
         case OutputFormat::BranchList:
           return ConvertPerfDataToBranchList();
       }
+    } else if (IsAutoFDOBinaryFile(input_filenames_[0])) {
+      switch (output_format_) {
+        case OutputFormat::AutoFDO:
+        case OutputFormat::AutoFDOBinary:
+          return ConvertAutoFDOBinaryToAutoFDO();
+        case OutputFormat::BranchList:
+          LOG(ERROR) << "autofdo binary files can't be converted to branch-list format";
+          return false;
+      }
     } else {
       switch (output_format_) {
         case OutputFormat::AutoFDO:
+        case OutputFormat::AutoFDOBinary:
           return ConvertBranchListToAutoFDO();
         case OutputFormat::BranchList:
           return ConvertBranchListToBranchList();
@@ -606,6 +888,7 @@ class InjectCommand : public Command {
  private:
   bool ParseOptions(const std::vector<std::string>& args) {
     const OptionFormatMap option_formats = {
+        {"--bb-cache-dir", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--binary", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--dump-etm", {OptionValueType::STRING, OptionType::SINGLE}},
         {"--exclude-perf", {OptionValueType::NONE, OptionType::SINGLE}},
@@ -620,6 +903,13 @@ class InjectCommand : public Command {
       return false;
     }
 
+    if (auto value = options.PullValue("--bb-cache-dir"); value) {
+      block_cache_dir_ = *value->str_value;
+      if (!IsDir(block_cache_dir_)) {
+        LOG(ERROR) << "Invalid --bb-cache-dir: " << block_cache_dir_;
+        return false;
+      }
+    }
     if (auto value = options.PullValue("--binary"); value) {
       binary_name_regex_ = RegEx::Create(*value->str_value);
       if (binary_name_regex_ == nullptr) {
@@ -653,6 +943,8 @@ class InjectCommand : public Command {
       const std::string& output = *value->str_value;
       if (output == "autofdo") {
         output_format_ = OutputFormat::AutoFDO;
+      } else if (output == "autofdo-binary") {
+        output_format_ = OutputFormat::AutoFDOBinary;
       } else if (output == "branch-list") {
         output_format_ = OutputFormat::BranchList;
       } else {
@@ -697,7 +989,7 @@ class InjectCommand : public Command {
         return false;
       }
     }
-    return autofdo_writer.Write(output_filename_);
+    return WriteAutoFDO(autofdo_writer);
   }
 
   bool ConvertPerfDataToBranchList() {
@@ -734,18 +1026,39 @@ class InjectCommand : public Command {
     // Step2: Convert BranchListBinaryInfo to AutoFDOBinaryInfo.
     AutoFDOWriter autofdo_writer;
     BranchListToAutoFDOConverter converter;
+    converter.SetBlockCacheDir(block_cache_dir_);
     for (auto& p : branch_list_merger.binary_map) {
       const BinaryKey& key = p.first;
       BranchListBinaryInfo& binary = p.second;
       std::unique_ptr<AutoFDOBinaryInfo> autofdo_binary = converter.Convert(key, binary);
       if (autofdo_binary) {
-        // Create new BinaryKey with kernel_start_addr = 0. Because AutoFDO output doesn't care
-        // kernel_start_addr.
-        autofdo_writer.AddAutoFDOBinary(BinaryKey(key.path, key.build_id), *autofdo_binary);
+        autofdo_writer.AddAutoFDOBinary(key, *autofdo_binary);
       }
     }
 
     // Step3: Write AutoFDOBinaryInfo.
+    return WriteAutoFDO(autofdo_writer);
+  }
+
+  bool ConvertAutoFDOBinaryToAutoFDO() {
+    AutoFDOWriter autofdo_writer;
+    auto callback = [&](const BinaryKey& key, AutoFDOBinaryInfo& binary) {
+      autofdo_writer.AddAutoFDOBinary(key, binary);
+    };
+    for (const auto& input_filename : input_filenames_) {
+      AutoFDOBinaryReader reader(input_filename, binary_name_regex_.get());
+      reader.SetCallback(callback);
+      if (!reader.Read()) {
+        return false;
+      }
+    }
+    return WriteAutoFDO(autofdo_writer);
+  }
+
+  bool WriteAutoFDO(AutoFDOWriter& autofdo_writer) {
+    if (output_format_ == OutputFormat::AutoFDOBinary) {
+      return autofdo_writer.WriteBinary(output_filename_);
+    }
     return autofdo_writer.Write(output_filename_);
   }
 
@@ -767,6 +1080,7 @@ class InjectCommand : public Command {
     return branch_list_writer.Write(output_filename_, branch_list_merger.binary_map);
   }
 
+  std::string block_cache_dir_;
   std::unique_ptr<RegEx> binary_name_regex_;
   bool exclude_perf_ = false;
   std::vector<std::string> input_filenames_;
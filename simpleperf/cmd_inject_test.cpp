@@ -224,3 +224,59 @@ TEST(cmd_inject, accept_missing_aux_data) {
   close(tmpfile.release());
   ASSERT_TRUE(RunInjectCmd({"--output", "branch-list", "-i", perf_data, "-o", tmpfile.path}));
 }
+
+TEST(cmd_inject, bb_cache_dir_option) {
+  TemporaryFile branch_list_file;
+  close(branch_list_file.release());
+  ASSERT_TRUE(RunInjectCmd({"--output", "branch-list", "-o", branch_list_file.path}));
+  TemporaryDir cache_dir;
+  // The first conversion fills the cache, and the second one reads it. Both should generate the
+  // same output as not using the cache.
+  for (size_t i = 0; i < 2; i++) {
+    std::string autofdo_data;
+    ASSERT_TRUE(RunInjectCmd({"-i", branch_list_file.path, "--bb-cache-dir", cache_dir.path},
+                             &autofdo_data));
+    CheckMatchingExpectedData(autofdo_data);
+    ASSERT_FALSE(GetEntriesInDir(cache_dir.path).empty());
+  }
+  ASSERT_FALSE(RunInjectCmd({"-i", branch_list_file.path, "--bb-cache-dir", "not_exist_dir"}));
+}
+
+TEST(cmd_inject, autofdo_binary_output) {
+  TemporaryFile binary_file;
+  close(binary_file.release());
+  ASSERT_TRUE(RunInjectCmd({"--output", "autofdo-binary", "-o", binary_file.path}));
+  // Convert autofdo binary file to autofdo text.
+  std::string autofdo_data;
+  ASSERT_TRUE(RunInjectCmd({"-i", binary_file.path, "--output", "autofdo"}, &autofdo_data));
+  CheckMatchingExpectedData(autofdo_data);
+
+  // Merge autofdo binary files.
+  TemporaryFile merged_file;
+  close(merged_file.release());
+  ASSERT_TRUE(RunInjectCmd({"-i", std::string(binary_file.path) + "," + binary_file.path,
+                            "--output", "autofdo-binary", "-o", merged_file.path}));
+  ASSERT_TRUE(RunInjectCmd({"-i", merged_file.path}, &autofdo_data));
+  ASSERT_NE(autofdo_data.find("106c->1074:400"), std::string::npos);
+
+  // Can't convert autofdo binary files to branch lists.
+  ASSERT_FALSE(RunInjectCmd({"-i", binary_file.path, "--output", "branch-list"}, nullptr));
+}
+
+TEST(cmd_inject, branch_stack_samples) {
+  // perf_b.data is recorded with branch stack sampling (-b).
+  TemporaryFile tmpfile;
+  close(tmpfile.release());
+  ASSERT_TRUE(InjectCmd()->Run({"-i", GetTestData(BRANCH_PERF_DATA), "-o", tmpfile.path,
+                                "--symdir", GetTestDataDir()}));
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(tmpfile.path, &data));
+  // Both instruction ranges and branches are generated. In the loop of testdata/elf, the range
+  // 0x4004ed-0x400501 is followed by the branch 0x400501->0x400518.
+  ASSERT_NE(data.find("\n4ed-501:745\n"), std::string::npos);
+  ASSERT_NE(data.find("\n501->518:833\n"), std::string::npos);
+
+  // Branch stack samples can't be converted to branch lists.
+  ASSERT_FALSE(InjectCmd()->Run({"-i", GetTestData(BRANCH_PERF_DATA), "-o", tmpfile.path,
+                                 "--output", "branch-list"}));
+}
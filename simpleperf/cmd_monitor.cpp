@@ -21,6 +21,7 @@
 #include <sys/utsname.h>
 #include <time.h>
 #include <unistd.h>
+#include <array>
 #include <optional>
 #include <set>
 #include <string>
@@ -41,6 +42,7 @@
 #include "IOEventLoop.h"
 #include "MapRecordReader.h"
 #include "OfflineUnwinder.h"
+#include "ProbeEvents.h"
 #include "RecordFilter.h"
 #include "command.h"
 #include "dso.h"
@@ -67,6 +69,23 @@ struct SymbolInfo {
   uint64_t vaddr_in_file;
 };
 
+// Calls and entry-to-return latency of a function added by --uprobe-latency.
+struct UprobeLatency {
+  std::string function;
+  uint64_t calls = 0;
+  uint64_t returns = 0;
+  // Returns without a matching entry, like calls entered before monitoring.
+  uint64_t unmatched_returns = 0;
+  uint64_t total_latency_in_ns = 0;
+  uint64_t min_latency_in_ns = UINT64_MAX;
+  uint64_t max_latency_in_ns = 0;
+  // histogram[i] counts latencies in [2^i, 2^(i+1)) ns, histogram[0] also counts 0 ns.
+  std::array<uint64_t, 64> histogram = {};
+  // Entry timestamps of calls not returned yet for each thread. It is a stack to support
+  // recursive calls.
+  std::unordered_map<pid_t, std::vector<uint64_t>> pending_calls;
+};
+
 // The max size of records dumped by kernel is 65535, and dump stack size
 // should be a multiply of 8, so MAX_DUMP_STACK_SIZE is 65528.
 constexpr uint32_t MAX_DUMP_STACK_SIZE = 65528;
@@ -131,6 +150,14 @@ class MonitorCommand : public Command {
 "Sample filter options:\n"
 "--exclude-perf                Exclude samples for simpleperf process.\n"
 RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
+"\n"
+"Function latency options:\n"
+"--uprobe-latency binary1:function1,binary2:function2,...\n"
+"             Add uprobes at the entry and return of the functions. Instead of\n"
+"             printing each sample of these uprobes, count calls and entry-to-return\n"
+"             latencies of each function, and print them with a latency histogram\n"
+"             when monitoring stops. For example:\n"
+"               --uprobe-latency /system/lib64/libc.so:malloc\n"
 "\n"
                 // clang-format on
                 ),
@@ -168,6 +195,9 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   bool DumpMapsForRecord(Record* record);
   void UpdateRecord(Record* record);
   bool UnwindRecord(SampleRecord& r);
+  bool AddUprobeLatencyEvents(const std::string& function);
+  void ProcessUprobeLatencySample(const SampleRecord& r, UprobeLatency& latency, bool is_entry);
+  void DumpUprobeLatencies();
 
   uint64_t max_sample_freq_ = DEFAULT_SAMPLE_FREQ_FOR_NONTRACEPOINT_EVENT;
   size_t cpu_time_max_percent_ = 25;
@@ -180,6 +210,9 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   bool unwind_dwarf_callchain_;
   std::unique_ptr<OfflineUnwinder> offline_unwinder_;
   double duration_in_sec_;
+  // Declared before event_selection_set_, because probe events can only be deleted after
+  // closing event files using them.
+  ProbeEvents probe_events_;
   EventSelectionSet event_selection_set_;
   std::pair<size_t, size_t> mmap_page_range_;
   ThreadTree thread_tree_;
@@ -190,6 +223,11 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   bool exclude_perf_ = false;
   RecordFilter record_filter_;
   std::unordered_map<uint64_t, std::string> event_names_;
+  std::vector<UprobeLatency> uprobe_latencies_;
+  // Map from event name to the index in uprobe_latencies_ and whether it is the entry event.
+  std::unordered_map<std::string, std::pair<size_t, bool>> uprobe_latency_events_;
+  // Same as uprobe_latency_events_, but map from event id.
+  std::unordered_map<uint64_t, std::pair<size_t, bool>> uprobe_latency_event_ids_;
 
   std::optional<MapRecordReader> map_record_reader_;
 };
@@ -249,6 +287,11 @@ bool MonitorCommand::PrepareMonitoring() {
 
   // Keep track of the event names per id.
   event_names_ = event_selection_set_.GetEventNamesById();
+  for (const auto& [id, name] : event_names_) {
+    if (auto it = uprobe_latency_events_.find(name); it != uprobe_latency_events_.end()) {
+      uprobe_latency_event_ids_[id] = it->second;
+    }
+  }
 
   // Use first perf_event_attr and first event id to dump mmap and comm records.
   EventAttrWithId dumping_attr_id = event_selection_set_.GetEventAttrWithId()[0];
@@ -299,6 +342,7 @@ bool MonitorCommand::DoMonitoring() {
   if (!event_selection_set_.FinishReadMmapEventData()) {
     return false;
   }
+  DumpUprobeLatencies();
   LOG(ERROR) << "Processed samples: " << sample_record_count_;
   return true;
 }
@@ -317,6 +361,8 @@ inline const OptionFormatMap& GetMonitorCmdOptionFormats() {
         {"-f", {OptionValueType::UINT, OptionType::ORDERED, AppRunnerType::ALLOWED}},
         {"-g", {OptionValueType::NONE, OptionType::ORDERED, AppRunnerType::ALLOWED}},
         {"-t", {OptionValueType::STRING, OptionType::MULTIPLE, AppRunnerType::ALLOWED}},
+        {"--uprobe-latency",
+         {OptionValueType::STRING, OptionType::MULTIPLE, AppRunnerType::NOT_ALLOWED}},
     };
     OptionFormatMap record_filter_options = GetRecordFilterOptionFormats(true);
     option_formats.insert(record_filter_options.begin(), record_filter_options.end());
@@ -348,6 +394,14 @@ bool MonitorCommand::ParseOptions(const std::vector<std::string>& args) {
     return false;
   }
 
+  for (const auto& s : options.PullStringValues("--uprobe-latency")) {
+    for (const auto& function : android::base::Split(s, ",")) {
+      if (!AddUprobeLatencyEvents(function)) {
+        return false;
+      }
+    }
+  }
+
   CHECK(options.values.empty());
 
   // Process ordered options.
@@ -511,6 +565,13 @@ bool MonitorCommand::ProcessRecord(Record* record) {
       return true;
     }
 
+    if (auto it = uprobe_latency_event_ids_.find(r.id_data.id);
+        it != uprobe_latency_event_ids_.end()) {
+      ProcessUprobeLatencySample(r, uprobe_latencies_[it->second.first], it->second.second);
+      sample_record_count_++;
+      return true;
+    }
+
     // AdjustCallChainGeneratedByKernel() should go before UnwindRecord().
     // Because we don't want to adjust callchains generated by dwarf unwinder.
     if (fp_callchain_sampling_ || dwarf_callchain_sampling_) {
@@ -616,6 +677,88 @@ bool MonitorCommand::UnwindRecord(SampleRecord& r) {
   }
   return true;
 }
+
+bool MonitorCommand::AddUprobeLatencyEvents(const std::string& function) {
+  UprobeLatency& latency = uprobe_latencies_.emplace_back();
+  latency.function = function;
+  size_t index = uprobe_latencies_.size() - 1;
+  for (bool is_entry : {true, false}) {
+    ProbeEvent event;
+    std::string cmd = std::string(is_entry ? "p " : "r ") + function;
+    if (!probe_events_.AddUprobe(cmd, &event)) {
+      return false;
+    }
+    std::string event_name = event.group_name + ":" + event.event_name;
+    size_t group_id;
+    if (!event_selection_set_.AddEventType(event_name, &group_id)) {
+      return false;
+    }
+    // Each call needs a sample to measure its latency.
+    event_selection_set_.SetSampleSpeed(group_id, SampleSpeed(0, 1));
+    uprobe_latency_events_[event_name] = std::make_pair(index, is_entry);
+  }
+  return true;
+}
+
+void MonitorCommand::ProcessUprobeLatencySample(const SampleRecord& r, UprobeLatency& latency,
+                                                bool is_entry) {
+  pid_t tid = static_cast<pid_t>(r.tid_data.tid);
+  uint64_t time = r.time_data.time;
+  if (is_entry) {
+    latency.calls++;
+    latency.pending_calls[tid].push_back(time);
+    return;
+  }
+  latency.returns++;
+  auto it = latency.pending_calls.find(tid);
+  if (it == latency.pending_calls.end() || it->second.empty()) {
+    latency.unmatched_returns++;
+    return;
+  }
+  uint64_t entry_time = it->second.back();
+  it->second.pop_back();
+  if (it->second.empty()) {
+    latency.pending_calls.erase(it);
+  }
+  uint64_t latency_in_ns = time > entry_time ? time - entry_time : 0;
+  latency.total_latency_in_ns += latency_in_ns;
+  latency.min_latency_in_ns = std::min(latency.min_latency_in_ns, latency_in_ns);
+  latency.max_latency_in_ns = std::max(latency.max_latency_in_ns, latency_in_ns);
+  size_t bucket = latency_in_ns == 0 ? 0 : 63 - __builtin_clzll(latency_in_ns);
+  latency.histogram[bucket]++;
+}
+
+void MonitorCommand::DumpUprobeLatencies() {
+  for (const UprobeLatency& latency : uprobe_latencies_) {
+    uint64_t matched_returns = latency.returns - latency.unmatched_returns;
+    uint64_t unfinished_calls = 0;
+    for (const auto& pair : latency.pending_calls) {
+      unfinished_calls += pair.second.size();
+    }
+    std::string output("uprobe_latency");
+    StringAppendF(&output, " function=%s", latency.function.c_str());
+    StringAppendF(&output, " calls=%" PRIu64 " returns=%" PRIu64, latency.calls, latency.returns);
+    StringAppendF(&output, " unmatched_returns=%" PRIu64 " unfinished_calls=%" PRIu64,
+                  latency.unmatched_returns, unfinished_calls);
+    if (matched_returns > 0) {
+      StringAppendF(&output, " min_ns=%" PRIu64 " avg_ns=%" PRIu64 " max_ns=%" PRIu64,
+                    latency.min_latency_in_ns, latency.total_latency_in_ns / matched_returns,
+                    latency.max_latency_in_ns);
+    }
+    printf("%s\n", output.c_str());
+    for (size_t i = 0; i < latency.histogram.size(); ++i) {
+      if (latency.histogram[i] != 0) {
+        uint64_t low = i == 0 ? 0 : (1ULL << i);
+        uint64_t high = i + 1 < latency.histogram.size() ? (1ULL << (i + 1)) : UINT64_MAX;
+        printf("uprobe_latency_histogram function=%s range_ns=[%" PRIu64 ",%" PRIu64
+               ") count=%" PRIu64 "\n",
+               latency.function.c_str(), low, high, latency.histogram[i]);
+      }
+    }
+  }
+  fflush(stdout);
+}
+
 }  // namespace
 
 void RegisterMonitorCommand() {
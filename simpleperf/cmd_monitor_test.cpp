@@ -16,13 +16,18 @@
 
 #include <gtest/gtest.h>
 
+#include <unistd.h>
+
 #include <android-base/strings.h>
 #if defined(__ANDROID__)
 #include <android-base/properties.h>
 #endif
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
+#include "ProbeEvents.h"
 #include "command.h"
 #include "test_util.h"
 
@@ -136,3 +141,37 @@ TEST(monitor_cmd, record_filter_options) {
                      "processB", "--include-thread-name", "threadB", "--include-uid", "5,6"},
                     output));
 }
+
+extern "C" __attribute__((noinline)) int MonitorCmdUprobeLatencyTarget(int n) {
+  volatile int sum = 0;
+  for (int i = 0; i < n; i++) {
+    sum += i;
+  }
+  return sum;
+}
+
+TEST(monitor_cmd, uprobe_latency) {
+  TEST_REQUIRE_ROOT();
+  ProbeEvents probe_events;
+  if (!probe_events.IsUprobeSupported()) {
+    GTEST_LOG_(INFO) << "Skip this test as uprobe isn't supported by the kernel.";
+    return;
+  }
+  std::atomic<bool> stop(false);
+  std::thread thread([&]() {
+    while (!stop) {
+      MonitorCmdUprobeLatencyTarget(1000);
+      usleep(1000);
+    }
+  });
+  std::string function = "/proc/self/exe:MonitorCmdUprobeLatencyTarget";
+  std::string output;
+  bool result = RunMonitorCmd({"-a", "--uprobe-latency", function}, output);
+  stop = true;
+  thread.join();
+  ASSERT_TRUE(result);
+  ASSERT_NE(output.find("uprobe_latency function=" + function), std::string::npos);
+  ASSERT_NE(output.find("uprobe_latency_histogram function=" + function), std::string::npos);
+  ASSERT_FALSE(RunMonitorCmd({"-a", "--uprobe-latency", "/proc/self/exe:not_exist_function"},
+                             output));
+}
@@ -57,6 +57,7 @@
 #include "OfflineUnwinder.h"
 #include "ProbeEvents.h"
 #include "RecordFilter.h"
+#include "SampleSpeedController.h"
 #include "cmd_record_impl.h"
 #include "command.h"
 #include "environment.h"
@@ -115,6 +116,12 @@ static constexpr size_t kDefaultAuxBufferSize = 4 * kMegabyte;
 // So make default period to 100ms.
 static constexpr double kDefaultEtmDataFlushPeriodInSec = 0.1;
 
+// Max number of threads decoding ETM data by default, used for --decode-etm.
+static constexpr size_t kDefaultEtmDecodeThreads = 4;
+
+// Period to check recording overhead and adjust sample speed for --adaptive-sample-speed.
+static constexpr double kAdaptiveSampleSpeedPeriodInSec = 1;
+
 struct TimeStat {
   uint64_t prepare_recording_time = 0;
   uint64_t start_recording_time = 0;
@@ -169,6 +176,12 @@ class RecordCommand : public Command {
 "                      Record events on existing processes. Processes are searched either by pid\n"
 "                      or process name regex. Mutually exclusive with -a.\n"
 "-t tid1,tid2,... Record events on existing threads. Mutually exclusive with -a.\n"
+"--cgroup cgroup_dir\n"
+"                      Record events on threads in a cgroup, given as a cgroup v2 directory\n"
+"                      (or a perf_event cgroup v1 directory), like\n"
+"                      /sys/fs/cgroup/system.slice. Event files are opened per cpu, like -a.\n"
+"                      Only one cgroup is accepted, since samples don't record which cgroup\n"
+"                      they come from. Mutually exclusive with -a, -p and -t.\n"
 "\n"
 "Select monitored event types:\n"
 "-e event1[:modifier1],event2[:modifier2],...\n"
@@ -177,6 +190,7 @@ class RecordCommand : public Command {
 "               2) a raw PMU event in rN format. N is a hex number.\n"
 "                  For example, r1b selects event number 0x1b.\n"
 "               3) a kprobe event added by --kprobe option.\n"
+"               4) a uprobe event added by --uprobe option.\n"
 "             Modifiers can be added to define how the event should be\n"
 "             monitored. Possible modifiers are:\n"
 "                u - monitor user space events only\n"
@@ -192,6 +206,14 @@ class RecordCommand : public Command {
 "             Documentation/trace/kprobetrace.rst in the kernel. Examples:\n"
 "               'p:myprobe do_sys_open $arg2:string'   - add event kprobes:myprobe\n"
 "               'r:myretprobe do_sys_open $retval:s64' - add event kprobes:myretprobe\n"
+"--uprobe uprobe_event1,uprobe_event2,...\n"
+"             Add uprobe events during recording. The uprobe_event format is in\n"
+"             Documentation/trace/uprobetracer.rst in the kernel, except that\n"
+"             the probed location can also be a function name in the binary.\n"
+"             Examples:\n"
+"               'p:myprobe /system/lib64/libc.so:malloc'   - add event uprobes:myprobe\n"
+"               'r:myretprobe /system/lib64/libc.so:malloc' - add event uprobes:myretprobe\n"
+"               'p /system/bin/app:0x1234' - add event uprobes:p_app_0x1234\n"
 "--add-counter event1,event2,...     Add additional event counts in record samples. For example,\n"
 "                                    we can use `-e cpu-cycles --add-counter instructions` to\n"
 "                                    get samples for cpu-cycles event, while having instructions\n"
@@ -240,9 +262,19 @@ class RecordCommand : public Command {
 "                will be used.\n"
 "--user-buffer-size <buffer_size> Set buffer size in userspace to cache sample data.\n"
 "                                 By default, it is %s.\n"
+"--async-write-buffer-size <buffer_size>  Write the record file in a separate thread, using\n"
+"                 two buffers of buffer_size bytes. It prevents slow storage from blocking\n"
+"                 processing records. By default, the record file is written synchronously.\n"
 "--no-inherit  Don't record created child threads/processes.\n"
 "--cpu-percent <percent>  Set the max percent of cpu time used for recording.\n"
 "                         percent is in range [1-100], default is 25.\n"
+"--adaptive-sample-speed <percent>  Adjust the sample frequency/period of non-tracepoint events\n"
+"                         at runtime, to keep the cpu time used by simpleperf below percent of\n"
+"                         one cpu. The sample speed is halved when the kernel throttles or\n"
+"                         loses samples, or the cpu budget is exceeded. And it is slowly\n"
+"                         restored when there is overhead headroom, never going above the speed\n"
+"                         set by -f/-c. Each sample still carries its period, so reports stay\n"
+"                         correctly weighted. Changes are recorded in the meta info feature.\n"
 "\n"
 "--tp-filter filter_string    Set filter_string for the previous tracepoint event.\n"
 "                             Format is in Documentation/trace/events.rst in the kernel.\n"
@@ -287,6 +319,9 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
 "--symfs <dir>    Look for files with symbols relative to this directory.\n"
 "                 This option is used to provide files with symbol table and\n"
 "                 debug information, which are used for unwinding and dumping symbols.\n"
+"--time-index-interval <ms>    Add a time index to the recording file, with one entry per cpu\n"
+"                              every <ms> milliseconds. It lets report tools seek to a time\n"
+"                              without reading records before it.\n"
 "--add-meta-info key=value     Add extra meta info, which will be stored in the recording file.\n"
 "\n"
 "ETM recording options:\n"
@@ -311,6 +346,10 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
 "                                 Used memory size is (buffer_size * (cpu_count + 1).\n"
 "                                 Default is 4M.\n"
 "--decode-etm                     Convert ETM data into branch lists while recording.\n"
+"--decode-etm-threads <count>     Used with --decode-etm to set the number of threads decoding\n"
+"                                 ETM data. ETM data of each cpu is decoded in the same thread.\n"
+"                                 Default is min(cpu_count, 4). If 0, decode ETM data in the\n"
+"                                 thread processing records.\n"
 "--binary binary_name             Used with --decode-etm to only generate data for binaries\n"
 "                                 matching binary_name regex.\n"
 "\n"
@@ -320,6 +359,10 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
 "--start_profiling_fd fd_no    After starting profiling, write \"STARTED\" to\n"
 "                              <fd_no>, then close <fd_no>.\n"
 "--stdio-controls-profiling    Use stdin/stdout to pause/resume profiling.\n"
+"--start-paused                Used with --stdio-controls-profiling. Open perf event files and\n"
+"                              mapped buffers, but don't generate samples until receiving a\n"
+"                              resume cmd. It reduces the latency of starting profiling.\n"
+"--print-setup-stat            Print time spent in opening and mapping perf event files.\n"
 #if defined(__ANDROID__)
 "--in-app                      We are already running in the app's context.\n"
 "--tracepoint-events file_name   Read tracepoint events from [file_name] instead of tracefs.\n"
@@ -395,6 +438,8 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   bool SaveRecordWithoutUnwinding(Record* record);
   bool ProcessJITDebugInfo(const std::vector<JITDebugInfo>& debug_info, bool sync_kernel_records);
   bool ProcessControlCmd(IOEventLoop* loop);
+  bool SetEventsPaused(bool paused);
+  bool AdjustSampleSpeed();
   void UpdateRecord(Record* record);
   bool UnwindRecord(SampleRecord& r);
   bool KeepFailedUnwindingResult(const SampleRecord& r, const std::vector<uint64_t>& ips,
@@ -435,6 +480,8 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   std::pair<size_t, size_t> mmap_page_range_;
   std::optional<size_t> user_buffer_size_;
   size_t aux_buffer_size_ = kDefaultAuxBufferSize;
+  size_t async_write_buffer_size_ = 0;
+  uint64_t time_index_interval_in_ns_ = 0;
 
   ThreadTree thread_tree_;
   std::string record_filename_;
@@ -445,6 +492,10 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
   uint64_t sample_record_count_;
   android::base::unique_fd start_profiling_fd_;
   bool stdio_controls_profiling_ = false;
+  bool start_paused_ = false;
+  bool print_setup_stat_ = false;
+  // Set when events are disabled by --start-paused or a pause cmd.
+  bool events_paused_ = false;
 
   std::string app_package_name_;
   bool in_app_context_;
@@ -478,6 +529,16 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_RECORDING
 
   std::unique_ptr<ETMBranchListGenerator> etm_branch_list_generator_;
   std::unique_ptr<RegEx> binary_name_regex_;
+
+  // For --adaptive-sample-speed
+  size_t adaptive_sample_speed_cpu_percent_ = 0;
+  std::unique_ptr<SampleSpeedController> sample_speed_controller_;
+  uint64_t throttle_record_count_ = 0;
+  uint64_t kernel_lost_record_count_ = 0;
+  uint64_t last_throttle_record_count_ = 0;
+  uint64_t last_kernel_lost_record_count_ = 0;
+  uint64_t last_cpu_time_in_ns_ = 0;
+  uint64_t last_wall_time_in_ns_ = 0;
 };
 
 std::string RecordCommand::LongHelpString() const {
@@ -621,11 +682,14 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
   // 4. Add monitored targets.
   bool need_to_check_targets = false;
   if (system_wide_collection_) {
-    event_selection_set_.AddMonitoredThreads({-1});
+    if (!event_selection_set_.HasMonitoredCgroups()) {
+      event_selection_set_.AddMonitoredThreads({-1});
+    }
   } else if (!event_selection_set_.HasMonitoredTarget()) {
     if (workload != nullptr) {
       event_selection_set_.AddMonitoredProcesses({workload->GetPid()});
-      event_selection_set_.SetEnableOnExec(true);
+      // With --start-paused, events are enabled by a resume cmd instead of the workload exec.
+      event_selection_set_.SetEnableOnExec(!start_paused_);
     } else if (!app_package_name_.empty()) {
       // If app process is not created, wait for it. This allows simpleperf starts before
       // app process. In this way, we can have a better support of app start-up time profiling.
@@ -659,6 +723,9 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
   if (!event_selection_set_.OpenEventFiles(cpus_)) {
     return false;
   }
+  if (start_paused_ && !SetEventsPaused(true)) {
+    return false;
+  }
   size_t record_buffer_size = 0;
   if (user_buffer_size_.has_value()) {
     record_buffer_size = user_buffer_size_.value();
@@ -678,6 +745,12 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
   if (!event_selection_set_.PrepareToReadMmapEventData(callback)) {
     return false;
   }
+  std::string setup_stat = event_selection_set_.GetSetupStat().ToString();
+  if (print_setup_stat_) {
+    LOG(INFO) << "Event setup: " << setup_stat;
+  } else {
+    LOG(DEBUG) << "Event setup: " << setup_stat;
+  }
 
   // 6. Create perf.data.
   if (!CreateAndInitRecordFile()) {
@@ -749,16 +822,18 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
     // disabled.
     // If ETM data isn't dumped to kernel buffer in time, overflow parts will be dropped. This
     // makes less than expected data, especially in system wide recording. So add a periodic event
-    // to flush etm data by temporarily disable all perf events.
+    // to flush etm data by temporarily disable all perf events. Paused events are already
+    // disabled, and shouldn't be enabled by the flush.
     auto etm_flush = [this]() {
-      return event_selection_set_.SetEnableEvents(false) &&
-             event_selection_set_.SetEnableEvents(true);
+      return events_paused_ || (event_selection_set_.SetEnableEvents(false) &&
+                                event_selection_set_.SetEnableEvents(true));
     };
     if (!loop->AddPeriodicEvent(SecondToTimeval(kDefaultEtmDataFlushPeriodInSec), etm_flush)) {
       return false;
     }
 
     if (etm_branch_list_generator_) {
+      etm_branch_list_generator_->SetEventAttr(event_selection_set_.GetEventAttrWithId()[0].attr);
       if (exclude_perf_) {
         etm_branch_list_generator_->SetExcludePid(getpid());
       }
@@ -767,6 +842,15 @@ bool RecordCommand::PrepareRecording(Workload* workload) {
       }
     }
   }
+  if (adaptive_sample_speed_cpu_percent_ != 0) {
+    sample_speed_controller_.reset(new SampleSpeedController(adaptive_sample_speed_cpu_percent_));
+    last_cpu_time_in_ns_ = GetProcessCpuTimeInNs();
+    last_wall_time_in_ns_ = GetSystemClock();
+    if (!loop->AddPeriodicEvent(SecondToTimeval(kAdaptiveSampleSpeedPeriodInSec),
+                                [this]() { return AdjustSampleSpeed(); })) {
+      return false;
+    }
+  }
   return true;
 }
 
@@ -854,6 +938,7 @@ bool RecordCommand::PostProcessRecording(const std::vector<std::string>& args) {
   if (!DumpAdditionalFeatures(args)) {
     return false;
   }
+  AsyncWriteStat async_write_stat = record_file_writer_->GetAsyncWriteStat();
   if (!record_file_writer_->Close()) {
     return false;
   }
@@ -870,6 +955,22 @@ bool RecordCommand::PostProcessRecording(const std::vector<std::string>& args) {
       LOG(INFO) << "Aux data lost in user space: " << record_stat.lost_aux_data_size
                 << ", consider increasing userspace buffer size(--user-buffer-size).";
     }
+    if (etm_branch_list_generator_) {
+      bool lost_etm_data = false;
+      for (const auto& [cpu, stat] : etm_branch_list_generator_->GetDecodeStat()) {
+        LOG(DEBUG) << "ETM decode stat on cpu " << cpu << ": decoded " << stat.decoded_bytes
+                   << " bytes, dropped " << stat.dropped_bytes << " bytes, "
+                   << stat.truncated_records << " truncated aux records, max queued "
+                   << stat.max_queued_bytes << " bytes";
+        if (stat.dropped_bytes != 0 || stat.truncated_records != 0) {
+          lost_etm_data = true;
+        }
+      }
+      if (lost_etm_data) {
+        LOG(WARNING) << "Some ETM data was lost before decoding, consider increasing aux buffer "
+                     << "size(--aux-buffer-size) or decoding threads(--decode-etm-threads).";
+      }
+    }
   } else {
     // Here we report all lost records as samples. This isn't accurate. Because records like
     // MmapRecords are not samples. But It's easier for users to understand.
@@ -928,6 +1029,17 @@ bool RecordCommand::PostProcessRecording(const std::vector<std::string>& args) {
       callchain_joiner_->DumpStat();
     }
   }
+  if (async_write_buffer_size_ != 0) {
+    LOG(DEBUG) << "Async write stat: buffers written=" << async_write_stat.buffer_count
+               << ", blocked count=" << async_write_stat.blocked_count
+               << ", blocked time=" << async_write_stat.blocked_time_in_ns / 1e9 << " s";
+    if (async_write_stat.blocked_count != 0) {
+      LOG(WARNING) << "Writing the record file blocked processing records "
+                   << async_write_stat.blocked_count << " times ("
+                   << async_write_stat.blocked_time_in_ns / 1e9 << " s), "
+                   << "consider increasing --async-write-buffer-size.";
+    }
+  }
   LOG(DEBUG) << "Prepare recording time "
              << (time_stat_.start_recording_time - time_stat_.prepare_recording_time) / 1e9
              << " s, recording time "
@@ -952,6 +1064,23 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
 
   // Process options.
   system_wide_collection_ = options.PullBoolValue("-a");
+  if (auto value = options.PullValue("--cgroup"); value) {
+    if (system_wide_collection_) {
+      LOG(ERROR) << "-a and --cgroup can't be used at the same time.";
+      return false;
+    }
+    const std::string& cgroup = *value->str_value;
+    if (cgroup.find(',') != std::string::npos) {
+      LOG(ERROR) << "record only accepts one cgroup in --cgroup: " << cgroup;
+      return false;
+    }
+    if (!event_selection_set_.AddMonitoredCgroups({cgroup})) {
+      return false;
+    }
+    // Cgroup recording opens per-cpu event files, and samples can come from any process joining
+    // the cgroups. So it is recorded like system wide collection.
+    system_wide_collection_ = true;
+  }
 
   if (auto value = options.PullValue("--add-counter"); value) {
     add_counters_ = android::base::Split(*value->str_value, ",");
@@ -1029,9 +1158,21 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
   if (!options.PullUintValue("--cpu-percent", &cpu_time_max_percent_, 1, 100)) {
     return false;
   }
+  if (!options.PullUintValue("--adaptive-sample-speed", &adaptive_sample_speed_cpu_percent_, 1,
+                             100)) {
+    return false;
+  }
 
   if (options.PullBoolValue("--decode-etm")) {
-    etm_branch_list_generator_ = ETMBranchListGenerator::Create(system_wide_collection_);
+    size_t decode_threads = std::min<size_t>(GetOnlineCpus().size(), kDefaultEtmDecodeThreads);
+    if (!options.PullUintValue("--decode-etm-threads", &decode_threads)) {
+      return false;
+    }
+    etm_branch_list_generator_ =
+        ETMBranchListGenerator::Create(system_wide_collection_, decode_threads);
+  } else if (options.PullValue("--decode-etm-threads")) {
+    LOG(ERROR) << "--decode-etm-threads should be used with --decode-etm";
+    return false;
   }
 
   if (!options.PullDoubleValue("--duration", &duration_in_sec_, 1e-9)) {
@@ -1074,6 +1215,14 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
       }
     }
   }
+  for (const OptionValue& value : options.PullValues("--uprobe")) {
+    std::vector<std::string> cmds = android::base::Split(*value.str_value, ",");
+    for (const auto& cmd : cmds) {
+      if (!probe_events->AddUprobe(cmd)) {
+        return false;
+      }
+    }
+  }
 
   if (auto value = options.PullValue("-m"); value) {
     if (!IsPowerOfTwo(value->uint_value) ||
@@ -1133,6 +1282,15 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
     user_buffer_size_ = static_cast<size_t>(v);
   }
 
+  if (auto value = options.PullValue("--async-write-buffer-size"); value) {
+    uint64_t v = value->uint_value;
+    if (v > std::numeric_limits<size_t>::max() || v == 0) {
+      LOG(ERROR) << "invalid async write buffer size: " << v;
+      return false;
+    }
+    async_write_buffer_size_ = static_cast<size_t>(v);
+  }
+
   if (!options.PullUintValue("--size-limit", &size_limit_in_bytes_, 1)) {
     return false;
   }
@@ -1142,6 +1300,12 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
   }
 
   stdio_controls_profiling_ = options.PullBoolValue("--stdio-controls-profiling");
+  start_paused_ = options.PullBoolValue("--start-paused");
+  print_setup_stat_ = options.PullBoolValue("--print-setup-stat");
+  if (start_paused_ && !stdio_controls_profiling_) {
+    LOG(ERROR) << "--start-paused should be used with --stdio-controls-profiling";
+    return false;
+  }
 
   if (auto value = options.PullValue("--stop-signal-fd"); value) {
     stop_signal_fd_.reset(static_cast<int>(value->uint_value));
@@ -1161,6 +1325,14 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
     }
   }
 
+  if (auto value = options.PullValue("--time-index-interval"); value) {
+    if (value->uint_value == 0) {
+      LOG(ERROR) << "invalid time index interval: 0";
+      return false;
+    }
+    time_index_interval_in_ns_ = value->uint_value * 1000000;
+  }
+
   trace_offcpu_ = options.PullBoolValue("--trace-offcpu");
 
   if (auto value = options.PullValue("--tracepoint-events"); value) {
@@ -1296,6 +1468,11 @@ bool RecordCommand::ParseOptions(const std::vector<std::string>& args,
     }
   }
 
+  if (event_selection_set_.HasMonitoredCgroups() && event_selection_set_.HasMonitoredTarget()) {
+    LOG(ERROR) << "--cgroup can't be used with -p or -t.";
+    return false;
+  }
+
   if (system_wide_collection_ && event_selection_set_.HasMonitoredTarget()) {
     LOG(ERROR) << "Record system wide and existing processes/threads can't be "
                   "used at the same time.";
@@ -1414,6 +1591,10 @@ bool RecordCommand::CreateAndInitRecordFile() {
   if (record_file_writer_ == nullptr) {
     return false;
   }
+  if (async_write_buffer_size_ != 0 &&
+      !record_file_writer_->EnableAsyncWrite(async_write_buffer_size_)) {
+    return false;
+  }
   // Use first perf_event_attr and first event id to dump mmap and comm records.
   CHECK(!attrs.empty());
   dumping_attr_id_ = attrs[0];
@@ -1525,6 +1706,13 @@ bool RecordCommand::ProcessRecord(Record* record) {
     return false;
   }
   last_record_timestamp_ = std::max(last_record_timestamp_, record->Timestamp());
+  if (sample_speed_controller_) {
+    if (record->type() == PERF_RECORD_THROTTLE) {
+      throttle_record_count_++;
+    } else if (record->type() == PERF_RECORD_LOST) {
+      kernel_lost_record_count_ += static_cast<LostRecord*>(record)->lost;
+    }
+  }
   // In system wide recording, maps are dumped when they are needed by records.
   if (system_wide_collection_ && !DumpMapsForRecord(record)) {
     return false;
@@ -1554,6 +1742,28 @@ bool RecordCommand::ProcessRecord(Record* record) {
   return SaveRecordWithoutUnwinding(record);
 }
 
+bool RecordCommand::AdjustSampleSpeed() {
+  uint64_t cpu_time_in_ns = GetProcessCpuTimeInNs();
+  uint64_t wall_time_in_ns = GetSystemClock();
+  double cpu_percent = 0;
+  if (wall_time_in_ns > last_wall_time_in_ns_) {
+    cpu_percent = (cpu_time_in_ns - last_cpu_time_in_ns_) * 100.0 /
+                  (wall_time_in_ns - last_wall_time_in_ns_);
+  }
+  uint64_t throttle_count = throttle_record_count_ - last_throttle_record_count_;
+  uint64_t lost_count = kernel_lost_record_count_ - last_kernel_lost_record_count_;
+  last_cpu_time_in_ns_ = cpu_time_in_ns;
+  last_wall_time_in_ns_ = wall_time_in_ns;
+  last_throttle_record_count_ = throttle_record_count_;
+  last_kernel_lost_record_count_ = kernel_lost_record_count_;
+
+  if (sample_speed_controller_->Update(last_record_timestamp_, throttle_count, lost_count,
+                                       cpu_percent)) {
+    return event_selection_set_.SetSampleSpeedRatio(sample_speed_controller_->Ratio());
+  }
+  return true;
+}
+
 bool RecordCommand::DumpAuxTraceInfo() {
   if (event_selection_set_.HasAuxTrace()) {
     AuxTraceInfoRecord auxtrace_info = ETMRecorder::GetInstance().CreateAuxTraceInfoRecord();
@@ -1695,9 +1905,9 @@ bool RecordCommand::ProcessControlCmd(IOEventLoop* loop) {
   LOG(DEBUG) << "process control cmd: " << cmd;
   bool result = false;
   if (cmd == "pause") {
-    result = event_selection_set_.SetEnableEvents(false);
+    result = SetEventsPaused(true);
   } else if (cmd == "resume") {
-    result = event_selection_set_.SetEnableEvents(true);
+    result = SetEventsPaused(false);
   } else {
     LOG(ERROR) << "unknown control cmd: " << cmd;
   }
@@ -1706,6 +1916,14 @@ bool RecordCommand::ProcessControlCmd(IOEventLoop* loop) {
   return result;
 }
 
+bool RecordCommand::SetEventsPaused(bool paused) {
+  if (!event_selection_set_.SetEnableEvents(!paused)) {
+    return false;
+  }
+  events_paused_ = paused;
+  return true;
+}
+
 template <class RecordType>
 void UpdateMmapRecordForEmbeddedPath(RecordType& r, bool has_prot, uint32_t prot) {
   if (r.InKernel()) {
@@ -1979,9 +2197,16 @@ bool RecordCommand::DumpAdditionalFeatures(const std::vector<std::string>& args)
   std::vector<uint64_t> auxtrace_offset;
   std::unordered_set<Dso*> debug_unwinding_files;
   bool failed_unwinding_sample = false;
+  std::unique_ptr<TimeIndexBuilder> time_index_builder;
+  if (time_index_interval_in_ns_ != 0) {
+    time_index_builder.reset(new TimeIndexBuilder(time_index_interval_in_ns_));
+  }
 
   auto callback = [&](const Record* r) {
     thread_tree_.Update(*r);
+    if (time_index_builder) {
+      time_index_builder->AddRecord(*r);
+    }
     if (r->type() == PERF_RECORD_SAMPLE) {
       auto sample = reinterpret_cast<const SampleRecord*>(r);
       // Symbol map files are available after recording. Load one for the process.
@@ -2019,6 +2244,9 @@ bool RecordCommand::DumpAdditionalFeatures(const std::vector<std::string>& args)
   if (etm_branch_list_generator_) {
     feature_count++;
   }
+  if (time_index_builder) {
+    feature_count++;
+  }
   if (!record_file_writer_->BeginWriteFeatures(feature_count)) {
     return false;
   }
@@ -2064,6 +2292,10 @@ bool RecordCommand::DumpAdditionalFeatures(const std::vector<std::string>& args)
   if (etm_branch_list_generator_ && !DumpETMBranchListFeature()) {
     return false;
   }
+  if (time_index_builder &&
+      !record_file_writer_->WriteTimeIndexFeature(time_index_builder->GetTimeIndex())) {
+    return false;
+  }
 
   if (!record_file_writer_->EndWriteFeatures()) {
     return false;
@@ -2109,6 +2341,9 @@ bool RecordCommand::DumpMetaInfoFeature(bool kernel_symbols_available) {
   std::unordered_map<std::string, std::string> info_map = extra_meta_info_;
   info_map["simpleperf_version"] = GetSimpleperfVersion();
   info_map["system_wide_collection"] = system_wide_collection_ ? "true" : "false";
+  if (event_selection_set_.HasMonitoredCgroups()) {
+    info_map["cgroups"] = android::base::Join(event_selection_set_.GetMonitoredCgroups(), ",");
+  }
   info_map["trace_offcpu"] = trace_offcpu_ ? "true" : "false";
   // By storing event types information in perf.data, the readers of perf.data have the same
   // understanding of event types, even if they are on another machine.
@@ -2151,6 +2386,12 @@ bool RecordCommand::DumpMetaInfoFeature(bool kernel_symbols_available) {
       sample_record_count_, record_stat.kernelspace_lost_records,
       record_stat.userspace_lost_samples, record_stat.userspace_lost_non_samples,
       record_stat.userspace_cut_stack_samples);
+  if (sample_speed_controller_) {
+    // Format: timestamp1:ratio1,timestamp2:ratio2,...
+    // The ratio is the sample frequency (or 1 / sample period) relative to the one set by the
+    // user, taking effect for samples after the timestamp.
+    info_map["sample_speed_changes"] = sample_speed_controller_->ChangesToString();
+  }
 
   return record_file_writer_->WriteMetaInfoFeature(info_map);
 }
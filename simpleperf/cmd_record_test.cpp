@@ -645,6 +645,18 @@ TEST(record_cmd, size_limit_option) {
   ASSERT_FALSE(RunRecordCmd({"--size-limit", "0"}));
 }
 
+TEST(record_cmd, time_index_interval_option) {
+  TemporaryFile tmpfile;
+  ASSERT_TRUE(RunRecordCmd({"--time-index-interval", "10"}, tmpfile.path));
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile.path);
+  ASSERT_TRUE(reader);
+  std::optional<TimeIndexFeature> time_index = reader->ReadTimeIndexFeature();
+  ASSERT_TRUE(time_index.has_value());
+  ASSERT_FALSE(time_index.value().empty());
+  ASSERT_TRUE(reader->SeekToTime(time_index.value().back().time));
+  ASSERT_FALSE(RunRecordCmd({"--time-index-interval", "0"}));
+}
+
 TEST(record_cmd, support_mmap2) {
   // mmap2 is supported in kernel >= 3.16. If not supported, please cherry pick below kernel
   // patches:
@@ -714,6 +726,97 @@ TEST(record_cmd, cpu_percent_option) {
   ASSERT_FALSE(RunRecordCmd({"--cpu-percent", "101"}));
 }
 
+TEST(record_cmd, adaptive_sample_speed_option) {
+  TemporaryFile tmpfile;
+  ASSERT_TRUE(RunRecordCmd({"--adaptive-sample-speed", "1"}, tmpfile.path));
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile.path);
+  ASSERT_TRUE(reader);
+  auto& info_map = reader->GetMetaInfoFeature();
+  ASSERT_NE(info_map.find("sample_speed_changes"), info_map.end());
+  ASSERT_FALSE(RunRecordCmd({"--adaptive-sample-speed", "0"}));
+  ASSERT_FALSE(RunRecordCmd({"--adaptive-sample-speed", "101"}));
+}
+
+TEST(record_cmd, start_paused_option) {
+  // --start-paused needs a way to resume recording.
+  ASSERT_FALSE(RunRecordCmd({"--start-paused"}));
+}
+
+TEST(record_cmd, print_setup_stat_option) {
+  CapturedStderr capture;
+  ASSERT_TRUE(RunRecordCmd({"--print-setup-stat"}));
+  capture.Stop();
+  ASSERT_NE(capture.str().find("Event setup: prepare threads"), std::string::npos);
+}
+
+TEST(record_cmd, cgroup_option) {
+  TEST_REQUIRE_ROOT();
+  // Samples don't record which cgroup they come from, so record only accepts one cgroup.
+  ASSERT_FALSE(RunRecordCmd({"--cgroup", "/sys/fs/cgroup,/sys/fs/cgroup"}));
+  if (access("/sys/fs/cgroup", R_OK) != 0) {
+    GTEST_LOG_(INFO) << "Skip this test as /sys/fs/cgroup isn't available.";
+    return;
+  }
+  CapturedStderr capture;
+  ASSERT_FALSE(RunRecordCmd({"--cgroup", "/sys/fs/cgroup", "-p", std::to_string(getpid())}));
+  capture.Stop();
+  ASSERT_NE(capture.str().find("--cgroup can't be used with -p or -t"), std::string::npos);
+}
+
+TEST(record_cmd, resume_after_start_paused) {
+  if (!IsSettingClockIdSupported()) {
+    GTEST_LOG_(INFO) << "Omit this test as setting clockid isn't supported";
+    return;
+  }
+  std::atomic<int> tid(0);
+  std::atomic<bool> stop_thread(false);
+  std::thread thread([&]() {
+    tid = gettid();
+    while (!stop_thread) {
+    }
+  });
+  while (tid == 0)
+    ;
+  // Send control cmds through stdin.
+  int pipefd[2];
+  ASSERT_EQ(0, pipe(pipefd));
+  int saved_stdin = dup(STDIN_FILENO);
+  ASSERT_NE(saved_stdin, -1);
+  ASSERT_NE(dup2(pipefd[0], STDIN_FILENO), -1);
+  close(pipefd[0]);
+  uint64_t resume_time_in_ns = 0;
+  std::thread control_thread([&]() {
+    sleep(1);
+    resume_time_in_ns = GetSystemClock();
+    ASSERT_TRUE(android::base::WriteStringToFd("resume\n", pipefd[1]));
+  });
+  TemporaryFile tmpfile;
+  bool result = RecordCmd()->Run({"-o", tmpfile.path, "-t", std::to_string(tid), "-e",
+                                  "task-clock", "--clockid", "monotonic",
+                                  "--stdio-controls-profiling", "--start-paused", "--duration",
+                                  "2"});
+  control_thread.join();
+  close(pipefd[1]);
+  dup2(saved_stdin, STDIN_FILENO);
+  close(saved_stdin);
+  stop_thread = true;
+  thread.join();
+  ASSERT_TRUE(result);
+
+  // Samples are only generated after the resume cmd.
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile.path);
+  ASSERT_TRUE(reader);
+  size_t sample_count = 0;
+  ASSERT_TRUE(reader->ReadDataSection([&](std::unique_ptr<Record> r) {
+    if (r->type() == PERF_RECORD_SAMPLE) {
+      sample_count++;
+      EXPECT_GE(r->Timestamp(), resume_time_in_ns);
+    }
+    return true;
+  }));
+  ASSERT_GT(sample_count, 0u);
+}
+
 class RecordingAppHelper {
  public:
   bool InstallApk(const std::string& apk_path, const std::string& package_name) {
@@ -1068,6 +1171,22 @@ TEST(record_cmd, decode_etm_option) {
   ASSERT_TRUE(RunRecordCmd({"-e", "cs-etm", "--decode-etm", "--exclude-perf"}));
 }
 
+TEST(record_cmd, decode_etm_threads_option) {
+  ASSERT_FALSE(RunRecordCmd({"--decode-etm-threads", "2"}));
+  if (!ETMRecorder::GetInstance().CheckEtmSupport().ok()) {
+    GTEST_LOG_(INFO) << "Omit this test since etm isn't supported on this device";
+    return;
+  }
+  for (const char* threads : {"0", "1", "2"}) {
+    TemporaryFile tmpfile;
+    ASSERT_TRUE(RunRecordCmd({"-e", "cs-etm", "--decode-etm", "--decode-etm-threads", threads},
+                             tmpfile.path));
+    std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile.path);
+    ASSERT_TRUE(reader);
+    ASSERT_TRUE(reader->HasFeature(PerfFileFormat::FEAT_ETM_BRANCH_LIST));
+  }
+}
+
 TEST(record_cmd, binary_option) {
   if (!ETMRecorder::GetInstance().CheckEtmSupport().ok()) {
     GTEST_LOG_(INFO) << "Omit this test since etm isn't supported on this device";
@@ -1283,6 +1402,11 @@ TEST(record_cmd, user_buffer_size_option) {
   ASSERT_TRUE(RunRecordCmd({"--user-buffer-size", "256M"}));
 }
 
+TEST(record_cmd, async_write_buffer_size_option) {
+  ASSERT_TRUE(RunRecordCmd({"--async-write-buffer-size", "4k"}));
+  ASSERT_FALSE(RunRecordCmd({"--async-write-buffer-size", "0"}));
+}
+
 TEST(record_cmd, record_process_name) {
   TemporaryFile tmpfile;
   ASSERT_TRUE(RecordCmd()->Run({"-e", GetDefaultEvent(), "-o", tmpfile.path, "sleep", SLEEP_SEC}));
@@ -30,6 +30,8 @@
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
+#include "system/extras/simpleperf/pprof_profile.pb.h"
+
 #include "RecordFilter.h"
 #include "command.h"
 #include "event_attr.h"
@@ -37,6 +39,7 @@
 #include "perf_regs.h"
 #include "record.h"
 #include "record_file.h"
+#include "report_utils.h"
 #include "sample_tree.h"
 #include "thread_tree.h"
 #include "tracing.h"
@@ -396,6 +399,225 @@ class ReportCmdCallgraphDisplayerWithVaddrInFile : public ReportCmdCallgraphDisp
   }
 };
 
+enum class ReportOutputFormat {
+  Text,
+  Folded,
+  Pprof,
+};
+
+// Aggregate callchains of samples into unique stacks, used to generate flamegraph (collapsed
+// stack) and pprof reports. The memory used is bounded by the number of unique stacks, not by the
+// number of samples.
+class CallChainStackAggregator {
+ public:
+  CallChainStackAggregator(ThreadTree& thread_tree, size_t event_count)
+      : callchain_report_builder_(thread_tree), event_count_(event_count) {}
+
+  void AddSample(const ThreadEntry* thread, const std::vector<uint64_t>& ips,
+                 size_t kernel_ip_count, size_t event_index, uint64_t period) {
+    std::vector<CallChainReportEntry> callchain =
+        callchain_report_builder_.Build(thread, ips, kernel_ip_count);
+    if (callchain.empty()) {
+      return;
+    }
+    key_.thread_name = GetThreadNameId(thread->comm);
+    key_.frames.clear();
+    for (const CallChainReportEntry& entry : callchain) {
+      key_.frames.emplace_back(GetFrameId(entry));
+    }
+    auto it = stacks_.find(key_);
+    if (it == stacks_.end()) {
+      it = stacks_.emplace(key_, std::vector<uint64_t>(1 + event_count_, 0)).first;
+    }
+    // values[0] is the sample count, values[i + 1] is the period of event i.
+    it->second[0]++;
+    it->second[event_index + 1] += period;
+  }
+
+  // Write stacks in the collapsed stack format read by flamegraph.pl:
+  //   thread_name;root_function;...;leaf_function sample_count
+  bool WriteFolded(FILE* fp) {
+    std::vector<std::string> lines;
+    lines.reserve(stacks_.size());
+    for (const auto& [key, values] : stacks_) {
+      std::string line = thread_names_[key.thread_name];
+      for (auto it = key.frames.rbegin(); it != key.frames.rend(); ++it) {
+        line.push_back(';');
+        line.append(frames_[*it].name);
+      }
+      line += " " + std::to_string(values[0]) + "\n";
+      lines.emplace_back(std::move(line));
+    }
+    // Sort lines to make the output stable.
+    std::sort(lines.begin(), lines.end());
+    for (const std::string& line : lines) {
+      if (fwrite(line.data(), line.size(), 1, fp) != 1) {
+        PLOG(ERROR) << "failed to write report";
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool WritePprof(FILE* fp, const std::vector<std::string>& event_names) {
+    perftools::profiles::Profile profile;
+    std::unordered_map<std::string, int64_t> string_map;
+    auto add_string = [&](const std::string& s) -> int64_t {
+      auto it = string_map.find(s);
+      if (it != string_map.end()) {
+        return it->second;
+      }
+      int64_t id = profile.string_table_size();
+      profile.add_string_table(s);
+      string_map.emplace(s, id);
+      return id;
+    };
+    add_string("");
+
+    auto add_value_type = [&](const std::string& type, const std::string& unit) {
+      auto value_type = profile.add_sample_type();
+      value_type->set_type(add_string(type));
+      value_type->set_unit(add_string(unit));
+    };
+    add_value_type("samples", "count");
+    for (const std::string& name : event_names) {
+      add_value_type(name, "count");
+    }
+
+    std::unordered_map<const Dso*, uint64_t> mapping_ids;
+    for (size_t i = 0; i < frames_.size(); ++i) {
+      const Frame& frame = frames_[i];
+      uint64_t& mapping_id = mapping_ids[frame.dso];
+      if (mapping_id == 0) {
+        mapping_id = profile.mapping_size() + 1;
+        auto mapping = profile.add_mapping();
+        mapping->set_id(mapping_id);
+        mapping->set_filename(add_string(frame.dso_name));
+        mapping->set_has_functions(true);
+      }
+      uint64_t id = i + 1;
+      auto function = profile.add_function();
+      function->set_id(id);
+      function->set_name(add_string(frame.name));
+      function->set_system_name(function->name());
+      function->set_filename(add_string(frame.dso_name));
+      auto location = profile.add_location();
+      location->set_id(id);
+      location->set_mapping_id(mapping_id);
+      location->set_address(frame.vaddr_in_file);
+      location->add_line()->set_function_id(id);
+    }
+
+    int64_t thread_key = add_string("thread");
+    for (const auto& [key, values] : stacks_) {
+      auto sample = profile.add_sample();
+      for (uint32_t frame_id : key.frames) {
+        sample->add_location_id(frame_id + 1);
+      }
+      for (uint64_t value : values) {
+        sample->add_value(static_cast<int64_t>(value));
+      }
+      auto label = sample->add_label();
+      label->set_key(thread_key);
+      label->set_str(add_string(thread_names_[key.thread_name]));
+    }
+
+    std::string data;
+    if (!profile.SerializeToString(&data)) {
+      LOG(ERROR) << "failed to serialize pprof profile";
+      return false;
+    }
+    if (fwrite(data.data(), data.size(), 1, fp) != 1) {
+      PLOG(ERROR) << "failed to write report";
+      return false;
+    }
+    return true;
+  }
+
+ private:
+  struct Frame {
+    const Dso* dso;
+    const Symbol* symbol;
+    std::string name;
+    std::string dso_name;
+    uint64_t vaddr_in_file;
+  };
+
+  struct FrameKey {
+    const Dso* dso;
+    const Symbol* symbol;
+
+    bool operator==(const FrameKey& other) const {
+      return dso == other.dso && symbol == other.symbol;
+    }
+  };
+
+  struct FrameKeyHash {
+    size_t operator()(const FrameKey& key) const {
+      size_t seed = 0;
+      HashCombine(seed, key.dso);
+      HashCombine(seed, key.symbol);
+      return seed;
+    }
+  };
+
+  struct StackKey {
+    uint32_t thread_name;
+    // Frame ids, from the leaf to the root.
+    std::vector<uint32_t> frames;
+
+    bool operator==(const StackKey& other) const {
+      return thread_name == other.thread_name && frames == other.frames;
+    }
+  };
+
+  struct StackKeyHash {
+    size_t operator()(const StackKey& key) const {
+      size_t seed = 0;
+      HashCombine(seed, key.thread_name);
+      for (uint32_t frame : key.frames) {
+        HashCombine(seed, frame);
+      }
+      return seed;
+    }
+  };
+
+  uint32_t GetThreadNameId(const char* thread_name) {
+    auto it = thread_name_map_.find(thread_name);
+    if (it != thread_name_map_.end()) {
+      return it->second;
+    }
+    uint32_t id = thread_names_.size();
+    thread_names_.emplace_back(thread_name);
+    thread_name_map_.emplace(thread_names_.back(), id);
+    return id;
+  }
+
+  uint32_t GetFrameId(const CallChainReportEntry& entry) {
+    FrameKey key{entry.dso, entry.symbol};
+    auto it = frame_map_.find(key);
+    if (it != frame_map_.end()) {
+      return it->second;
+    }
+    uint32_t id = frames_.size();
+    std::string dso_name = entry.dso_name ? entry.dso_name : entry.dso->GetReportPath().data();
+    frames_.emplace_back(Frame{entry.dso, entry.symbol, entry.symbol->DemangledName(), dso_name,
+                               entry.symbol->addr});
+    frame_map_.emplace(key, id);
+    return id;
+  }
+
+  CallChainReportBuilder callchain_report_builder_;
+  const size_t event_count_;
+  std::vector<std::string> thread_names_;
+  std::unordered_map<std::string, uint32_t> thread_name_map_;
+  std::vector<Frame> frames_;
+  std::unordered_map<FrameKey, uint32_t, FrameKeyHash> frame_map_;
+  std::unordered_map<StackKey, std::vector<uint64_t>, StackKeyHash> stacks_;
+  // Reused for each sample to avoid allocations.
+  StackKey key_;
+};
+
 class ReportCommand : public Command {
  public:
   ReportCommand()
@@ -425,6 +647,14 @@ class ReportCommand : public Command {
 "--no-demangle         Don't demangle symbol names.\n"
 "--no-show-ip          Don't show vaddr in file for unknown symbols.\n"
 "-o report_file_name   Set report file name, default is stdout.\n"
+"--output-format <format>  Set the format of the report file. Possible formats are:\n"
+"                            text    -- the default human readable report.\n"
+"                            folded  -- collapsed stacks, which can be used by flamegraph.pl\n"
+"                                       to generate flamegraphs. Each line is a callchain\n"
+"                                       (root first) followed by its sample count.\n"
+"                            pprof   -- an uncompressed protobuf file in pprof format.\n"
+"                          Callchains are aggregated by unique stacks. Options only affecting\n"
+"                          the text format (like --sort, -g) are ignored.\n"
 "--percent-limit <percent>  Set min percentage in report entries and call graphs.\n"
 "--print-event-count   Print event counts for each item. Additional events can be added by\n"
 "                      --add-counter in record cmd.\n"
@@ -486,9 +716,11 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
   bool ReadFeaturesFromRecordFile();
   bool ReadSampleTreeFromRecordFile();
   bool ProcessRecord(std::unique_ptr<Record> record);
+  void ProcessSampleRecordForStackReport(const SampleRecord& r, size_t attr_id);
   void ProcessSampleRecordInTraceOffCpuMode(std::unique_ptr<Record> record, size_t attr_id);
   bool ProcessTracingData(const std::vector<char>& data);
   bool PrintReport();
+  bool PrintStackReport(FILE* report_fp);
   void PrintReportContext(FILE* fp);
 
   std::string record_filename_;
@@ -521,6 +753,8 @@ RECORD_FILTER_OPTION_HELP_MSG_FOR_REPORTING
   bool print_event_count_ = false;
   std::vector<std::string> sort_keys_;
   std::string report_filename_;
+  ReportOutputFormat output_format_ = ReportOutputFormat::Text;
+  std::unique_ptr<CallChainStackAggregator> stack_aggregator_;
   RecordFilter record_filter_;
 };
 
@@ -579,6 +813,7 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
       {"--no-demangle", {OptionValueType::NONE, OptionType::SINGLE}},
       {"--no-show-ip", {OptionValueType::NONE, OptionType::SINGLE}},
       {"-o", {OptionValueType::STRING, OptionType::SINGLE}},
+      {"--output-format", {OptionValueType::STRING, OptionType::SINGLE}},
       {"--percent-limit", {OptionValueType::DOUBLE, OptionType::SINGLE}},
       {"--pids", {OptionValueType::STRING, OptionType::MULTIPLE}},
       {"--print-event-count", {OptionValueType::NONE, OptionType::SINGLE}},
@@ -658,6 +893,19 @@ bool ReportCommand::ParseOptions(const std::vector<std::string>& args) {
   }
 
   options.PullStringValue("-o", &report_filename_);
+  if (auto value = options.PullValue("--output-format"); value) {
+    const std::string& format = *value->str_value;
+    if (format == "text") {
+      output_format_ = ReportOutputFormat::Text;
+    } else if (format == "folded") {
+      output_format_ = ReportOutputFormat::Folded;
+    } else if (format == "pprof") {
+      output_format_ = ReportOutputFormat::Pprof;
+    } else {
+      LOG(ERROR) << "unknown format in --output-format: " << format;
+      return false;
+    }
+  }
   if (!options.PullDoubleValue("--percent-limit", &percent_limit_, 0)) {
     return false;
   }
@@ -867,6 +1115,13 @@ bool ReportCommand::ReadEventAttrFromRecordFile() {
     }
     event_attrs_.emplace_back(attr);
   }
+  if (output_format_ != ReportOutputFormat::Text) {
+    if (trace_offcpu_) {
+      LOG(ERROR) << "--output-format isn't supported for records with --trace-offcpu.";
+      return false;
+    }
+    stack_aggregator_.reset(new CallChainStackAggregator(thread_tree_, event_attrs_.size()));
+  }
   if (use_branch_address_) {
     bool has_branch_stack = true;
     for (const auto& attr : event_attrs_) {
@@ -958,7 +1213,9 @@ bool ReportCommand::ProcessRecord(std::unique_ptr<Record> record) {
       return true;
     }
     size_t attr_id = record_file_reader_->GetAttrIndexOfRecord(record.get());
-    if (!trace_offcpu_) {
+    if (stack_aggregator_) {
+      ProcessSampleRecordForStackReport(*static_cast<SampleRecord*>(record.get()), attr_id);
+    } else if (!trace_offcpu_) {
       sample_tree_builder_[attr_id]->ReportCmdProcessSampleRecord(
           *static_cast<SampleRecord*>(record.get()));
     } else {
@@ -991,6 +1248,36 @@ void ReportCommand::ProcessSampleRecordInTraceOffCpuMode(std::unique_ptr<Record>
   }
 }
 
+void ReportCommand::ProcessSampleRecordForStackReport(const SampleRecord& r, size_t attr_id) {
+  const auto& cpu_filter = sample_tree_builder_options_.cpu_filter;
+  if (!cpu_filter.empty() && cpu_filter.count(r.cpu_data.cpu) == 0) {
+    return;
+  }
+  const ThreadEntry* thread = thread_tree_.FindThreadOrNew(r.tid_data.pid, r.tid_data.tid);
+  const auto& comm_filter = sample_tree_builder_options_.comm_filter;
+  if (!comm_filter.empty() && comm_filter.count(thread->comm) == 0) {
+    return;
+  }
+  const auto& dso_filter = sample_tree_builder_options_.dso_filter;
+  const auto& symbol_filter = sample_tree_builder_options_.symbol_filter;
+  if (!dso_filter.empty() || !symbol_filter.empty()) {
+    // Like SampleTreeBuilder, filter samples by the dso and symbol of the sampled ip.
+    const MapEntry* map = thread_tree_.FindMap(thread, r.ip_data.ip, r.InKernel());
+    if (!dso_filter.empty() && dso_filter.count(map->dso->GetReportPath().data()) == 0) {
+      return;
+    }
+    if (!symbol_filter.empty()) {
+      const Symbol* symbol = thread_tree_.FindSymbol(map, r.ip_data.ip, nullptr);
+      if (symbol_filter.count(symbol->DemangledName()) == 0) {
+        return;
+      }
+    }
+  }
+  size_t kernel_ip_count;
+  std::vector<uint64_t> ips = r.GetCallChain(&kernel_ip_count);
+  stack_aggregator_->AddSample(thread, ips, kernel_ip_count, attr_id, r.period_data.period);
+}
+
 bool ReportCommand::ProcessTracingData(const std::vector<char>& data) {
   auto tracing = Tracing::Create(data);
   if (!tracing) {
@@ -1016,6 +1303,9 @@ bool ReportCommand::PrintReport() {
     }
     file_handler.reset(report_fp);
   }
+  if (stack_aggregator_) {
+    return PrintStackReport(report_fp);
+  }
   PrintReportContext(report_fp);
   for (size_t i = 0; i < event_attrs_.size(); ++i) {
     if (trace_offcpu_ && i == sched_switch_attr_id_) {
@@ -1045,6 +1335,30 @@ bool ReportCommand::PrintReport() {
   return true;
 }
 
+bool ReportCommand::PrintStackReport(FILE* report_fp) {
+  bool result;
+  if (output_format_ == ReportOutputFormat::Folded) {
+    if (event_attrs_.size() > 1) {
+      LOG(WARNING) << "Multiple events are found in " << record_filename_
+                   << ", sample counts of all events are merged in folded output.";
+    }
+    result = stack_aggregator_->WriteFolded(report_fp);
+  } else {
+    std::vector<std::string> event_names(attr_names_.begin(),
+                                         attr_names_.begin() + event_attrs_.size());
+    result = stack_aggregator_->WritePprof(report_fp, event_names);
+  }
+  if (!result) {
+    return false;
+  }
+  fflush(report_fp);
+  if (ferror(report_fp) != 0) {
+    PLOG(ERROR) << "print report failed";
+    return false;
+  }
+  return true;
+}
+
 void ReportCommand::PrintReportContext(FILE* report_fp) {
   if (!record_cmdline_.empty()) {
     fprintf(report_fp, "Cmdline: %s\n", record_cmdline_.c_str());
@@ -176,6 +176,76 @@ TEST_F(ReportCommandTest, callgraph_option) {
   ASSERT_TRUE(CheckCallerMode(lines));
 }
 
+TEST_F(ReportCommandTest, output_format_folded) {
+  Report(CALLGRAPH_FP_PERF_DATA);
+  ASSERT_TRUE(success);
+  size_t sample_count = GetSampleCount();
+  Report(CALLGRAPH_FP_PERF_DATA, {"--output-format", "folded"});
+  ASSERT_TRUE(success);
+  size_t folded_sample_count = 0;
+  bool has_callchain = false;
+  for (const std::string& line : lines) {
+    // Each line is "thread_name;root;...;leaf count".
+    size_t pos = line.rfind(' ');
+    ASSERT_NE(pos, std::string::npos);
+    size_t count;
+    ASSERT_TRUE(android::base::ParseUint(line.substr(pos + 1), &count));
+    folded_sample_count += count;
+    if (android::base::Split(line.substr(0, pos), ";").size() > 2) {
+      has_callchain = true;
+    }
+  }
+  ASSERT_EQ(folded_sample_count, sample_count);
+  ASSERT_TRUE(has_callchain);
+  ASSERT_NE(content.find("GlobalFunc"), std::string::npos);
+}
+
+TEST_F(ReportCommandTest, output_format_folded_with_filters) {
+  Report(CALLGRAPH_FP_PERF_DATA, {"--symbols", "GlobalFunc"});
+  ASSERT_TRUE(success);
+  size_t sample_count = GetSampleCount();
+  ASSERT_GT(sample_count, 0u);
+
+  TemporaryFile tmp_file;
+  ASSERT_TRUE(ReportCmd()->Run({"-i", GetTestData(CALLGRAPH_FP_PERF_DATA), "--symfs",
+                                GetTestDataDir(), "-o", tmp_file.path, "--output-format", "folded",
+                                "--symbols", "GlobalFunc"}));
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(tmp_file.path, &data));
+  size_t folded_sample_count = 0;
+  for (const std::string& line : android::base::Split(android::base::Trim(data), "\n")) {
+    size_t pos = line.rfind(' ');
+    ASSERT_NE(pos, std::string::npos);
+    // Only stacks having GlobalFunc as the leaf are kept.
+    ASSERT_EQ(android::base::Split(line.substr(0, pos), ";").back(), "GlobalFunc");
+    size_t count;
+    ASSERT_TRUE(android::base::ParseUint(line.substr(pos + 1), &count));
+    folded_sample_count += count;
+  }
+  ASSERT_EQ(folded_sample_count, sample_count);
+
+  // No sample is in /t1.
+  ASSERT_TRUE(ReportCmd()->Run({"-i", GetTestData(CALLGRAPH_FP_PERF_DATA), "--symfs",
+                                GetTestDataDir(), "-o", tmp_file.path, "--output-format", "folded",
+                                "--dsos", "/t1"}));
+  ASSERT_TRUE(android::base::ReadFileToString(tmp_file.path, &data));
+  ASSERT_EQ(data.find("GlobalFunc"), std::string::npos);
+}
+
+TEST_F(ReportCommandTest, output_format_pprof) {
+  TemporaryFile tmp_file;
+  ASSERT_TRUE(ReportCmd()->Run({"-i", GetTestData(CALLGRAPH_FP_PERF_DATA), "--symfs",
+                                GetTestDataDir(), "-o", tmp_file.path, "--output-format",
+                                "pprof"}));
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(tmp_file.path, &data));
+  // Strings are stored in the string table of the profile.
+  ASSERT_NE(data.find("samples"), std::string::npos);
+  ASSERT_NE(data.find("GlobalFunc"), std::string::npos);
+  ASSERT_FALSE(ReportCmd()->Run({"-i", GetTestData(CALLGRAPH_FP_PERF_DATA), "-o", tmp_file.path,
+                                 "--output-format", "unknown"}));
+}
+
 static bool AllItemsWithString(std::vector<std::string>& lines,
                                const std::vector<std::string>& strs) {
   size_t line_index = 0;
@@ -30,10 +30,12 @@
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/scopeguard.h>
 #include <android-base/strings.h>
 #include <android-base/unique_fd.h>
 
 #include "IOEventLoop.h"
+#include "ProbeEvents.h"
 #include "cmd_stat_impl.h"
 #include "command.h"
 #include "environment.h"
@@ -93,9 +95,11 @@ static const std::unordered_map<std::string_view, std::pair<std::string_view, st
 
 const CounterSummary* CounterSummaries::FindSummary(const std::string& type_name,
                                                     const std::string& modifier,
-                                                    const ThreadInfo* thread, int cpu) {
+                                                    const ThreadInfo* thread, int cpu,
+                                                    const std::string& cgroup) {
   for (const auto& s : summaries_) {
-    if (s.type_name == type_name && s.modifier == modifier && s.thread == thread && s.cpu == cpu) {
+    if (s.type_name == type_name && s.modifier == modifier && s.thread == thread && s.cpu == cpu &&
+        s.cgroup == cgroup) {
       return &s;
     }
   }
@@ -106,11 +110,13 @@ void CounterSummaries::AutoGenerateSummaries() {
   for (size_t i = 0; i < summaries_.size(); ++i) {
     const CounterSummary& s = summaries_[i];
     if (s.modifier == "u") {
-      const CounterSummary* other = FindSummary(s.type_name, "k", s.thread, s.cpu);
+      const CounterSummary* other = FindSummary(s.type_name, "k", s.thread, s.cpu, s.cgroup);
       if (other != nullptr && other->IsMonitoredAtTheSameTime(s)) {
-        if (FindSummary(s.type_name, "", s.thread, s.cpu) == nullptr) {
+        if (FindSummary(s.type_name, "", s.thread, s.cpu, s.cgroup) == nullptr) {
+          std::string cgroup = s.cgroup;
           summaries_.emplace_back(s.type_name, "", s.group_id, s.thread, s.cpu,
                                   s.count + other->count, s.runtime_in_ns, s.scale, true, csv_);
+          summaries_.back().cgroup = std::move(cgroup);
         }
       }
     }
@@ -126,15 +132,19 @@ void CounterSummaries::GenerateComments(double duration_in_sec) {
 void CounterSummaries::Show(FILE* fp) {
   bool show_thread = !summaries_.empty() && summaries_[0].thread != nullptr;
   bool show_cpu = !summaries_.empty() && summaries_[0].cpu != -1;
+  bool show_cgroup = !summaries_.empty() && !summaries_[0].cgroup.empty();
   if (csv_) {
-    ShowCSV(fp, show_thread, show_cpu);
+    ShowCSV(fp, show_thread, show_cpu, show_cgroup);
   } else {
-    ShowText(fp, show_thread, show_cpu);
+    ShowText(fp, show_thread, show_cpu, show_cgroup);
   }
 }
 
-void CounterSummaries::ShowCSV(FILE* fp, bool show_thread, bool show_cpu) {
+void CounterSummaries::ShowCSV(FILE* fp, bool show_thread, bool show_cpu, bool show_cgroup) {
   for (auto& s : summaries_) {
+    if (show_cgroup) {
+      fprintf(fp, "%s,", s.cgroup.c_str());
+    }
     if (show_thread) {
       fprintf(fp, "%s,%d,%d,", s.thread->name.c_str(), s.thread->pid, s.thread->tid);
     }
@@ -146,11 +156,14 @@ void CounterSummaries::ShowCSV(FILE* fp, bool show_thread, bool show_cpu) {
   }
 }
 
-void CounterSummaries::ShowText(FILE* fp, bool show_thread, bool show_cpu) {
+void CounterSummaries::ShowText(FILE* fp, bool show_thread, bool show_cpu, bool show_cgroup) {
   std::vector<std::string> titles;
 
+  if (show_cgroup) {
+    titles.emplace_back("cgroup");
+  }
   if (show_thread) {
-    titles = {"thread_name", "pid", "tid"};
+    titles.insert(titles.end(), {"thread_name", "pid", "tid"});
   }
   if (show_cpu) {
     titles.emplace_back("cpu");
@@ -170,6 +183,9 @@ void CounterSummaries::ShowText(FILE* fp, bool show_thread, bool show_cpu) {
 
   for (auto& s : summaries_) {
     size_t i = 0;
+    if (show_cgroup) {
+      adjust_width(width[i++], s.cgroup.size());
+    }
     if (show_thread) {
       adjust_width(width[i++], s.thread->name.size());
       adjust_width(width[i++], std::to_string(s.thread->pid).size());
@@ -198,6 +214,9 @@ void CounterSummaries::ShowText(FILE* fp, bool show_thread, bool show_cpu) {
 
   for (auto& s : summaries_) {
     size_t i = 0;
+    if (show_cgroup) {
+      fprintf(fp, "  %-*s", static_cast<int>(width[i++]), s.cgroup.c_str());
+    }
     if (show_thread) {
       fprintf(fp, "  %-*s", static_cast<int>(width[i++]), s.thread->name.c_str());
       fprintf(fp, "  %-*d", static_cast<int>(width[i++]), s.thread->pid);
@@ -236,7 +255,7 @@ std::string CounterSummaries::GetCommentForSummary(const CounterSummary& s,
     return android::base::StringPrintf("%f%cGHz", ghz, sap_mid);
   }
   if (s.type_name == "instructions" && s.count != 0) {
-    const CounterSummary* other = FindSummary("cpu-cycles", s.modifier, s.thread, s.cpu);
+    const CounterSummary* other = FindSummary("cpu-cycles", s.modifier, s.thread, s.cpu, s.cgroup);
     if (other != nullptr && other->IsMonitoredAtTheSameTime(s)) {
       double cpi = static_cast<double>(other->count) / s.count;
       return android::base::StringPrintf("%f%ccycles per instruction", cpi, sap_mid);
@@ -282,7 +301,7 @@ std::string CounterSummaries::GetRateComment(const CounterSummary& s, char sep)
     rate_desc = "miss rate";
   }
   if (!event_name.empty()) {
-    const CounterSummary* other = FindSummary(event_name, s.modifier, s.thread, s.cpu);
+    const CounterSummary* other = FindSummary(event_name, s.modifier, s.thread, s.cpu, s.cgroup);
     if (other != nullptr && other->IsMonitoredAtTheSameTime(s) && other->count != 0) {
       double miss_rate = static_cast<double>(s.count) / other->count;
       return android::base::StringPrintf("%f%%%c%s", miss_rate * 100, sep, rate_desc.c_str());
@@ -350,6 +369,11 @@ class StatCommand : public Command {
 "                      On non-rooted devices, the app must be debuggable,\n"
 "                      because we use run-as to switch to the app's context.\n"
 #endif
+"--cgroup cgroup_dir1,cgroup_dir2,...\n"
+"                 Collect information of threads in cgroups, given as cgroup v2\n"
+"                 directories (or perf_event cgroup v1 directories). Counters are\n"
+"                 opened per cpu, like -a, and reported per cgroup. Mutually\n"
+"                 exclusive with -a, -p, -t and --per-thread.\n"
 "--cpu cpu_item1,cpu_item2,...\n"
 "                 Collect information only on the selected cpus. cpu_item can\n"
 "                 be a cpu number like 1, or a cpu range like 0-3.\n"
@@ -368,6 +392,7 @@ class StatCommand : public Command {
 "                   1) an event name listed in `simpleperf list`;\n"
 "                   2) a raw PMU event in rN format. N is a hex number.\n"
 "                      For example, r1b selects event number 0x1b.\n"
+"                   3) a uprobe event added by --uprobe option.\n"
 "                 Modifiers can be added to define how the event should be\n"
 "                 monitored. Possible modifiers are:\n"
 "                   u - monitor user space events only\n"
@@ -385,6 +410,12 @@ class StatCommand : public Command {
 "                      or process name regex. Mutually exclusive with -a.\n"
 "-t tid1,tid2,...      Stat events on existing threads. Mutually exclusive with -a.\n"
 "--print-hw-counter    Test and print CPU PMU hardware counters available on the device.\n"
+"--print-setup-stat    Print time spent in opening perf event files.\n"
+"--uprobe uprobe_event1,uprobe_event2,...\n"
+"                 Add uprobe events during counting. The format is the same as\n"
+"                 the --uprobe option of the record command. For example, use\n"
+"                 `--uprobe 'p:mycall /system/bin/app:func' -e uprobes:mycall` to\n"
+"                 count calls of func in app.\n"
 "--sort key1,key2,...  Select keys used to sort the report, used when --per-thread\n"
 "                      or --per-core appears. The appearance order of keys decides\n"
 "                      the order of keys used to sort the report.\n"
@@ -434,7 +465,7 @@ class StatCommand : public Command {
 
  private:
   bool ParseOptions(const std::vector<std::string>& args,
-                    std::vector<std::string>* non_option_args);
+                    std::vector<std::string>* non_option_args, ProbeEvents* probe_events);
   void PrintHardwareCounters();
   bool AddDefaultMeasuredEventTypes();
   void SetEventSelectionFlags();
@@ -469,6 +500,7 @@ class StatCommand : public Command {
   std::vector<std::string> sort_keys_;
   std::optional<SummaryComparator> summary_comparator_;
   bool print_hw_counter_ = false;
+  bool print_setup_stat_ = false;
 };
 
 bool StatCommand::Run(const std::vector<std::string>& args) {
@@ -479,7 +511,15 @@ bool StatCommand::Run(const std::vector<std::string>& args) {
 
   // 1. Parse options, and use default measured event types if not given.
   std::vector<std::string> workload_args;
-  if (!ParseOptions(args, &workload_args)) {
+  ProbeEvents probe_events;
+  auto clear_probe_events_guard = android::base::make_scope_guard([this, &probe_events] {
+    if (!probe_events.IsEmpty()) {
+      // probe events can be deleted only when no perf event file is using them.
+      event_selection_set_.CloseEventFiles();
+      probe_events.Clear();
+    }
+  });
+  if (!ParseOptions(args, &workload_args, &probe_events)) {
     return false;
   }
   if (print_hw_counter_) {
@@ -517,7 +557,7 @@ bool StatCommand::Run(const std::vector<std::string>& args) {
   if (system_wide_collection_) {
     if (report_per_thread_) {
       event_selection_set_.AddMonitoredProcesses(GetAllProcesses());
-    } else {
+    } else if (!event_selection_set_.HasMonitoredCgroups()) {
       event_selection_set_.AddMonitoredThreads({-1});
     }
   } else if (!event_selection_set_.HasMonitoredTarget()) {
@@ -543,6 +583,12 @@ bool StatCommand::Run(const std::vector<std::string>& args) {
   if (!event_selection_set_.OpenEventFiles(cpus_)) {
     return false;
   }
+  std::string setup_stat = event_selection_set_.GetSetupStat().ToString();
+  if (print_setup_stat_) {
+    LOG(INFO) << "Event setup: " << setup_stat;
+  } else {
+    LOG(DEBUG) << "Event setup: " << setup_stat;
+  }
   std::unique_ptr<FILE, decltype(&fclose)> fp_holder(nullptr, fclose);
   if (!output_filename_.empty()) {
     fp_holder.reset(fopen(output_filename_.c_str(), "we"));
@@ -632,7 +678,8 @@ bool StatCommand::Run(const std::vector<std::string>& args) {
 }
 
 bool StatCommand::ParseOptions(const std::vector<std::string>& args,
-                               std::vector<std::string>* non_option_args) {
+                               std::vector<std::string>* non_option_args,
+                               ProbeEvents* probe_events) {
   OptionValueMap options;
   std::vector<std::pair<OptionName, OptionValue>> ordered_options;
 
@@ -647,6 +694,23 @@ bool StatCommand::ParseOptions(const std::vector<std::string>& args,
   if (auto value = options.PullValue("--app"); value) {
     app_package_name_ = *value->str_value;
   }
+  if (auto strs = options.PullStringValues("--cgroup"); !strs.empty()) {
+    if (system_wide_collection_) {
+      LOG(ERROR) << "-a and --cgroup can't be used at the same time.";
+      return false;
+    }
+    std::vector<std::string> cgroups;
+    for (const auto& s : strs) {
+      for (const auto& cgroup : Split(s, ",")) {
+        cgroups.push_back(cgroup);
+      }
+    }
+    if (!event_selection_set_.AddMonitoredCgroups(cgroups)) {
+      return false;
+    }
+    // Cgroup counters are opened per cpu, and count any thread running in the cgroups.
+    system_wide_collection_ = true;
+  }
   if (auto value = options.PullValue("--cpu"); value) {
     if (auto cpus = GetCpusFromString(*value->str_value); cpus) {
       cpus_.assign(cpus->begin(), cpus->end());
@@ -665,6 +729,14 @@ bool StatCommand::ParseOptions(const std::vector<std::string>& args,
   }
   interval_only_values_ = options.PullBoolValue("--interval-only-values");
 
+  for (const OptionValue& value : options.PullValues("--uprobe")) {
+    for (const auto& cmd : Split(*value.str_value, ",")) {
+      if (!probe_events->AddUprobe(cmd)) {
+        return false;
+      }
+    }
+  }
+
   for (const OptionValue& value : options.PullValues("-e")) {
     for (const auto& event_type : Split(*value.str_value, ",")) {
       if (!event_selection_set_.AddEventType(event_type)) {
@@ -700,6 +772,7 @@ bool StatCommand::ParseOptions(const std::vector<std::string>& args,
     }
   }
   print_hw_counter_ = options.PullBoolValue("--print-hw-counter");
+  print_setup_stat_ = options.PullBoolValue("--print-setup-stat");
 
   if (auto value = options.PullValue("--sort"); value) {
     sort_keys_ = Split(*value->str_value, ",");
@@ -729,6 +802,10 @@ bool StatCommand::ParseOptions(const std::vector<std::string>& args,
   CHECK(options.values.empty());
   CHECK(ordered_options.empty());
 
+  if (event_selection_set_.HasMonitoredCgroups() && event_selection_set_.HasMonitoredTarget()) {
+    LOG(ERROR) << "--cgroup can't be used with -p or -t.";
+    return false;
+  }
   if (system_wide_collection_ && event_selection_set_.HasMonitoredTarget()) {
     LOG(ERROR) << "Stat system wide and existing processes/threads can't be "
                   "used at the same time.";
@@ -738,6 +815,10 @@ bool StatCommand::ParseOptions(const std::vector<std::string>& args,
     LOG(ERROR) << "System wide profiling needs root privilege.";
     return false;
   }
+  if (event_selection_set_.HasMonitoredCgroups() && report_per_thread_) {
+    LOG(ERROR) << "--cgroup and --per-thread can't be used at the same time.";
+    return false;
+  }
 
   if (report_per_core_ || report_per_thread_) {
     summary_comparator_ = BuildSummaryComparator(sort_keys_, report_per_thread_, report_per_core_);
@@ -20,6 +20,7 @@
 #include <sys/types.h>
 
 #include <algorithm>
+#include <map>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -78,7 +79,8 @@ struct CounterSummary {
   std::string modifier;
   uint32_t group_id;
   const ThreadInfo* thread;
-  int cpu;  // -1 represents all cpus
+  int cpu;             // -1 represents all cpus
+  std::string cgroup;  // empty if not monitoring cgroups
   uint64_t count;
   uint64_t runtime_in_ns;
   double scale;
@@ -212,7 +214,8 @@ class CounterSummaryBuilder {
         summary_comparator_(comparator) {}
 
   void AddCountersForOneEventType(const CountersInfo& info) {
-    std::unordered_map<uint64_t, CounterSum> sum_map;
+    // Counters of different cgroups are always reported separately.
+    std::map<std::string, std::unordered_map<uint64_t, CounterSum>> sum_maps;
     for (const auto& counter : info.counters) {
       uint64_t key = 0;
       if (report_per_thread_) {
@@ -221,20 +224,22 @@ class CounterSummaryBuilder {
       if (report_per_core_) {
         key |= static_cast<uint64_t>(counter.cpu) << 32;
       }
-      CounterSum& sum = sum_map[key];
+      CounterSum& sum = sum_maps[counter.cgroup][key];
       CounterSum add;
       add.FromCounter(counter.counter);
       sum = sum + add;
     }
-    size_t pre_sum_count = summaries_.size();
-    for (const auto& pair : sum_map) {
-      pid_t tid = report_per_thread_ ? static_cast<pid_t>(pair.first & UINT32_MAX) : 0;
-      int cpu = report_per_core_ ? static_cast<int>(pair.first >> 32) : -1;
-      const CounterSum& sum = pair.second;
-      AddSummary(info, tid, cpu, sum);
-    }
-    if (report_per_thread_ || report_per_core_) {
-      SortSummaries(summaries_.begin() + pre_sum_count, summaries_.end());
+    for (const auto& [cgroup, sum_map] : sum_maps) {
+      size_t pre_sum_count = summaries_.size();
+      for (const auto& pair : sum_map) {
+        pid_t tid = report_per_thread_ ? static_cast<pid_t>(pair.first & UINT32_MAX) : 0;
+        int cpu = report_per_core_ ? static_cast<int>(pair.first >> 32) : -1;
+        const CounterSum& sum = pair.second;
+        AddSummary(info, cgroup, tid, cpu, sum);
+      }
+      if (report_per_thread_ || report_per_core_) {
+        SortSummaries(summaries_.begin() + pre_sum_count, summaries_.end());
+      }
     }
   }
 
@@ -245,7 +250,8 @@ class CounterSummaryBuilder {
   }
 
  private:
-  void AddSummary(const CountersInfo& info, pid_t tid, int cpu, const CounterSum& sum) {
+  void AddSummary(const CountersInfo& info, const std::string& cgroup, pid_t tid, int cpu,
+                  const CounterSum& sum) {
     double scale = 1.0;
     if (sum.time_running < sum.time_enabled && sum.time_running != 0) {
       scale = static_cast<double>(sum.time_enabled) / sum.time_running;
@@ -262,6 +268,7 @@ class CounterSummaryBuilder {
     }
     summaries_.emplace_back(info.event_name, info.event_modifier, info.group_id, thread, cpu,
                             sum.value, sum.time_running, scale, false, csv_);
+    summaries_.back().cgroup = cgroup;
   }
 
   void SortSummaries(std::vector<CounterSummary>::iterator begin,
@@ -301,7 +308,7 @@ class CounterSummaries {
   const std::vector<CounterSummary>& Summaries() { return summaries_; }
 
   const CounterSummary* FindSummary(const std::string& type_name, const std::string& modifier,
-                                    const ThreadInfo* thread, int cpu);
+                                    const ThreadInfo* thread, int cpu, const std::string& cgroup);
 
   // If we have two summaries monitoring the same event type at the same time,
   // that one is for user space only, and the other is for kernel space only;
@@ -316,8 +323,8 @@ class CounterSummaries {
   std::string GetCommentForSummary(const CounterSummary& s, double duration_in_sec);
   std::string GetRateComment(const CounterSummary& s, char sep);
   bool FindRunningTimeForSummary(const CounterSummary& summary, double* running_time_in_sec);
-  void ShowCSV(FILE* fp, bool show_thread, bool show_core);
-  void ShowText(FILE* fp, bool show_thread, bool show_core);
+  void ShowCSV(FILE* fp, bool show_thread, bool show_core, bool show_cgroup);
+  void ShowText(FILE* fp, bool show_thread, bool show_core, bool show_cgroup);
 
  private:
   std::vector<CounterSummary> summaries_;
@@ -328,6 +335,7 @@ inline const OptionFormatMap& GetStatCmdOptionFormats() {
   static const OptionFormatMap option_formats = {
       {"-a", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::NOT_ALLOWED}},
       {"--app", {OptionValueType::STRING, OptionType::SINGLE, AppRunnerType::NOT_ALLOWED}},
+      {"--cgroup", {OptionValueType::STRING, OptionType::MULTIPLE, AppRunnerType::NOT_ALLOWED}},
       {"--cpu", {OptionValueType::STRING, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--csv", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--duration", {OptionValueType::DOUBLE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
@@ -344,11 +352,13 @@ inline const OptionFormatMap& GetStatCmdOptionFormats() {
       {"--per-core", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--per-thread", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--print-hw-counter", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
+      {"--print-setup-stat", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--sort", {OptionValueType::STRING, OptionType::SINGLE, AppRunnerType::ALLOWED}},
       {"--stop-signal-fd", {OptionValueType::UINT, OptionType::SINGLE, AppRunnerType::CHECK_FD}},
       {"-t", {OptionValueType::STRING, OptionType::MULTIPLE, AppRunnerType::ALLOWED}},
       {"--tracepoint-events",
        {OptionValueType::STRING, OptionType::SINGLE, AppRunnerType::CHECK_PATH}},
+      {"--uprobe", {OptionValueType::STRING, OptionType::MULTIPLE, AppRunnerType::NOT_ALLOWED}},
       {"--use-devfreq-counters",
        {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::NOT_ALLOWED}},
       {"--verbose", {OptionValueType::NONE, OptionType::SINGLE, AppRunnerType::ALLOWED}},
@@ -16,10 +16,17 @@
 
 #include <gtest/gtest.h>
 
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
 #include <android-base/file.h>
+#include <android-base/scopeguard.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/test_utils.h>
 
+#include <map>
 #include <thread>
 
 #include "cmd_stat_impl.h"
@@ -382,6 +389,101 @@ TEST(stat_cmd, print_hw_counter_option) {
   ASSERT_TRUE(StatCmd()->Run({"--print-hw-counter"}));
 }
 
+TEST(stat_cmd, print_setup_stat_option) {
+  CapturedStderr capture;
+  ASSERT_TRUE(StatCmd()->Run({"--print-setup-stat", "sleep", "1"}));
+  capture.Stop();
+  ASSERT_NE(capture.str().find("Event setup: prepare threads"), std::string::npos);
+}
+
+static std::string FindCgroupV2Root() {
+  std::string mounts;
+  if (android::base::ReadFileToString("/proc/mounts", &mounts)) {
+    for (const auto& line : android::base::Split(mounts, "\n")) {
+      std::vector<std::string> fields = android::base::Split(line, " ");
+      if (fields.size() > 2 && fields[2] == "cgroup2") {
+        return fields[1];
+      }
+    }
+  }
+  return "";
+}
+
+TEST(stat_cmd, cgroup_option) {
+  TEST_REQUIRE_ROOT();
+  std::string cgroup_root = FindCgroupV2Root();
+  if (cgroup_root.empty()) {
+    GTEST_LOG_(INFO) << "Skip this test as cgroup v2 isn't mounted.";
+    return;
+  }
+  std::string cgroup = cgroup_root + "/simpleperf_test_" + std::to_string(getpid());
+  if (mkdir(cgroup.c_str(), 0755) != 0) {
+    GTEST_LOG_(INFO) << "Skip this test as we can't create cgroup " << cgroup;
+    return;
+  }
+  auto remove_cgroup = android::base::make_scope_guard([&]() { rmdir(cgroup.c_str()); });
+  std::string idle_cgroup = cgroup + "_idle";
+  ASSERT_EQ(mkdir(idle_cgroup.c_str(), 0755), 0);
+  auto remove_idle_cgroup =
+      android::base::make_scope_guard([&]() { rmdir(idle_cgroup.c_str()); });
+  // Run a busy process in the cgroup.
+  pid_t pid = fork();
+  ASSERT_NE(pid, -1);
+  if (pid == 0) {
+    while (true) {
+    }
+  }
+  auto kill_child = android::base::make_scope_guard([&]() {
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+  });
+  ASSERT_TRUE(android::base::WriteStringToFile(std::to_string(pid), cgroup + "/cgroup.procs"));
+
+  EventSelectionSet set(true);
+  ASSERT_TRUE(set.AddEventType("task-clock"));
+  ASSERT_TRUE(set.AddMonitoredCgroups({cgroup}));
+  ASSERT_TRUE(set.OpenEventFiles({}));
+  usleep(100000);
+  std::vector<CountersInfo> counters;
+  ASSERT_TRUE(set.ReadCounters(&counters));
+  // One counter per cpu, no matter how many threads are in the cgroup.
+  ASSERT_EQ(counters.size(), 1u);
+  ASSERT_EQ(counters[0].counters.size(), GetOnlineCpus().size());
+  uint64_t task_clock = 0;
+  for (const auto& counter : counters[0].counters) {
+    ASSERT_EQ(counter.cgroup, cgroup);
+    task_clock += counter.counter.value;
+  }
+  ASSERT_GT(task_clock, 0u);
+
+  // Each cgroup is reported in its own row.
+  TemporaryFile tmp_file;
+  ASSERT_TRUE(StatCmd()->Run({"--cgroup", cgroup + "," + idle_cgroup, "-e", "task-clock", "--csv",
+                              "--duration", "0.1", "-o", tmp_file.path}));
+  std::string output;
+  ASSERT_TRUE(android::base::ReadFileToString(tmp_file.path, &output));
+  std::map<std::string, double> task_clock_per_cgroup;
+  for (const auto& line : android::base::Split(output, "\n")) {
+    std::vector<std::string> fields = android::base::Split(line, ",");
+    if (fields.size() > 2 && fields[2] == "task-clock") {
+      task_clock_per_cgroup[fields[0]] = std::stod(fields[1]);
+    }
+  }
+  ASSERT_EQ(task_clock_per_cgroup.size(), 2u);
+  ASSERT_GT(task_clock_per_cgroup[cgroup], 0);
+  ASSERT_EQ(task_clock_per_cgroup[idle_cgroup], 0);
+
+  ASSERT_FALSE(StatCmd()->Run({"--cgroup", cgroup, "-a", "--duration", "0.1"}));
+  {
+    CapturedStderr capture;
+    ASSERT_FALSE(StatCmd()->Run(
+        {"--cgroup", cgroup, "-p", std::to_string(getpid()), "--duration", "0.1"}));
+    capture.Stop();
+    ASSERT_NE(capture.str().find("--cgroup can't be used with -p or -t"), std::string::npos);
+  }
+  ASSERT_FALSE(StatCmd()->Run({"--cgroup", cgroup_root + "/not_exist", "--duration", "0.1"}));
+}
+
 class StatCmdSummaryBuilderTest : public ::testing::Test {
  protected:
   struct CounterArg {
@@ -391,6 +493,7 @@ class StatCmdSummaryBuilderTest : public ::testing::Test {
     int value = 1;
     int time_enabled = 1;
     int time_running = 1;
+    const char* cgroup = "";
   };
 
   void SetUp() override { sort_keys_ = {"count_per_thread", "tid", "cpu", "count"}; }
@@ -411,6 +514,7 @@ class StatCmdSummaryBuilderTest : public ::testing::Test {
     CounterInfo& counter = info.counters.back();
     counter.tid = arg.tid;
     counter.cpu = arg.cpu;
+    counter.cgroup = arg.cgroup;
     counter.counter.id = 0;
     counter.counter.value = arg.value;
     counter.counter.time_enabled = arg.time_enabled;
@@ -516,6 +620,27 @@ TEST_F(StatCmdSummaryBuilderTest, per_thread_core_aggregate) {
   ASSERT_NEAR(summaries[3].scale, 1.0, 1e-5);
 }
 
+TEST_F(StatCmdSummaryBuilderTest, per_cgroup_aggregate) {
+  AddCounter({.tid = -1, .cpu = 0, .value = 1, .cgroup = "/b"});
+  AddCounter({.tid = -1, .cpu = 1, .value = 2, .cgroup = "/b"});
+  AddCounter({.tid = -1, .cpu = 0, .value = 4, .cgroup = "/a"});
+  std::vector<CounterSummary> summaries = BuildSummary(false, false);
+  ASSERT_EQ(summaries.size(), 2);
+  ASSERT_EQ(summaries[0].cgroup, "/a");
+  ASSERT_EQ(summaries[0].count, 4);
+  ASSERT_EQ(summaries[1].cgroup, "/b");
+  ASSERT_EQ(summaries[1].count, 3);
+
+  summaries = BuildSummary(false, true);
+  ASSERT_EQ(summaries.size(), 3);
+  ASSERT_EQ(summaries[0].cgroup, "/a");
+  ASSERT_EQ(summaries[0].cpu, 0);
+  ASSERT_EQ(summaries[1].cgroup, "/b");
+  ASSERT_EQ(summaries[1].cpu, 0);
+  ASSERT_EQ(summaries[2].cgroup, "/b");
+  ASSERT_EQ(summaries[2].cpu, 1);
+}
+
 TEST_F(StatCmdSummaryBuilderTest, sort_key_count) {
   sort_keys_ = {"count"};
   AddCounter({.tid = 0, .cpu = 0, .value = 1});
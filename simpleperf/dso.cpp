@@ -18,16 +18,23 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <filesystem>
+#include <functional>
 #include <limits>
 #include <memory>
 #include <optional>
 #include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
 
 #include "JITDebugReader.h"
@@ -89,19 +96,211 @@ bool DebugElfFileFinder::AddSymbolDir(const std::string& symbol_dir) {
   return true;
 }
 
-void DebugElfFileFinder::CollectBuildIdInDir(const std::string& dir) {
+// Build ids of files in a symbol dir are stored in an index file, so later runs only need to read
+// build ids of new or changed files. Index files are kept in a cache dir rather than in symbol
+// dirs, which may be read-only or under version control. The first line is kBuildIdIndexHeader
+// followed by the real path of the symbol dir. Each following line is
+// "<size> <mtime in ns> <inode> <build_id or -> <path relative to the symbol dir>".
+static const char* kBuildIdIndexHeader = "simpleperf_build_id_index 2";
+// Reading a build id maps the file and parses elf headers, so a few files are enough for a job.
+static constexpr size_t kMinBuildIdReadsPerJob = 16;
+
+struct BuildIdIndexEntry {
+  uint64_t size = 0;
+  uint64_t mtime_ns = 0;
+  uint64_t inode = 0;
+  // Empty for files without a build id, including non elf files.
+  std::string build_id;
+
+  bool SameFile(const BuildIdIndexEntry& other) const {
+    return size == other.size && mtime_ns == other.mtime_ns && inode == other.inode;
+  }
+};
+
+using BuildIdIndex = std::vector<std::pair<std::string, BuildIdIndexEntry>>;
+
+static std::string GetDefaultBuildIdIndexDir() {
+#if defined(__ANDROID__)
+  // Symbol dirs are rarely used on device, and there is no cache dir shared by all users.
+  return "";
+#elif defined(_WIN32)
+  const char* dir = getenv("LOCALAPPDATA");
+  return (dir != nullptr && dir[0] != '\0') ? std::string(dir) + "\\simpleperf" : "";
+#else
+  if (const char* dir = getenv("XDG_CACHE_HOME"); dir != nullptr && dir[0] != '\0') {
+    return std::string(dir) + "/simpleperf";
+  }
+  if (const char* dir = getenv("HOME"); dir != nullptr && dir[0] != '\0') {
+    return std::string(dir) + "/.cache/simpleperf";
+  }
+  return "";
+#endif
+}
+
+static uint64_t GetMtimeInNs(const struct stat& st) {
+#if defined(__APPLE__)
+  const struct timespec& mtime = st.st_mtimespec;
+#elif defined(_WIN32)
+  struct timespec mtime = {st.st_mtime, 0};
+#else
+  const struct timespec& mtime = st.st_mtim;
+#endif
+  return static_cast<uint64_t>(mtime.tv_sec) * 1000000000 + static_cast<uint64_t>(mtime.tv_nsec);
+}
+
+static std::unordered_map<std::string, BuildIdIndexEntry> ReadBuildIdIndex(
+    const std::string& index_path, const std::string& header) {
+  std::unordered_map<std::string, BuildIdIndexEntry> index;
+  std::string content;
+  if (!android::base::ReadFileToString(index_path, &content)) {
+    return index;
+  }
+  std::vector<std::string> lines = android::base::Split(content, "\n");
+  // The header also rejects index files of other symbol dirs with the same name hash.
+  if (lines.empty() || lines[0] != header) {
+    return index;
+  }
+  for (size_t i = 1; i < lines.size(); ++i) {
+    const std::string& line = lines[i];
+    // Split the four leading fields. The path is the rest of the line, and may contain spaces.
+    std::vector<std::string> fields;
+    size_t start = 0;
+    while (fields.size() < 4) {
+      size_t end = line.find(' ', start);
+      if (end == std::string::npos) {
+        break;
+      }
+      fields.emplace_back(line.substr(start, end - start));
+      start = end + 1;
+    }
+    if (fields.size() < 4) {
+      continue;
+    }
+    BuildIdIndexEntry entry;
+    if (!android::base::ParseUint(fields[0], &entry.size) ||
+        !android::base::ParseUint(fields[1], &entry.mtime_ns) ||
+        !android::base::ParseUint(fields[2], &entry.inode)) {
+      continue;
+    }
+    if (fields[3] != "-") {
+      entry.build_id = fields[3];
+    }
+    index[line.substr(start)] = std::move(entry);
+  }
+  return index;
+}
+
+static void WriteBuildIdIndex(const std::string& index_path, const std::string& header,
+                              const BuildIdIndex& index) {
+  std::string content = header + "\n";
+  for (const auto& [path, entry] : index) {
+    content += std::to_string(entry.size) + " " + std::to_string(entry.mtime_ns) + " " +
+               std::to_string(entry.inode) + " " +
+               (entry.build_id.empty() ? "-" : entry.build_id) + " " + path + "\n";
+  }
+  // Write to a unique temp file and rename it, so concurrent runs never see a partial index or
+  // write to the same temp file.
+  std::error_code ec;
+  std::string dir = std::filesystem::path(index_path).parent_path().string();
+  if (std::filesystem::create_directories(dir, ec); ec) {
+    LOG(DEBUG) << "failed to create " << dir << ": " << ec.message();
+    return;
+  }
+  TemporaryFile tmp_file(dir);
+  if (tmp_file.fd == -1) {
+    // The cache dir may be read-only, in which case build ids are read again in later runs.
+    PLOG(DEBUG) << "failed to create a temp file in " << dir;
+    return;
+  }
+  bool written = android::base::WriteStringToFd(content, tmp_file.fd);
+  close(tmp_file.fd);
+  tmp_file.fd = -1;
+  if (!written) {
+    PLOG(DEBUG) << "failed to write " << tmp_file.path;
+  } else if (std::filesystem::rename(tmp_file.path, index_path, ec); ec) {
+    LOG(DEBUG) << "failed to rename " << tmp_file.path << " to " << index_path << ": "
+               << ec.message();
+  } else {
+    tmp_file.DoNotRemove();
+  }
+}
+
+// Add regular files in dir to index, with paths relative to the symbol dir.
+static void ListFilesInDir(const std::string& symbol_dir, const std::string& relative_dir,
+                           BuildIdIndex* index) {
+  std::string dir =
+      relative_dir.empty() ? symbol_dir : symbol_dir + OS_PATH_SEPARATOR + relative_dir;
   for (const std::string& entry : GetEntriesInDir(dir)) {
+    std::string relative_path =
+        relative_dir.empty() ? entry : relative_dir + OS_PATH_SEPARATOR + entry;
     std::string path = dir + OS_PATH_SEPARATOR + entry;
-    if (IsDir(path)) {
-      CollectBuildIdInDir(path);
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+      continue;
+    }
+    if (S_ISDIR(st.st_mode)) {
+      ListFilesInDir(symbol_dir, relative_path, index);
+    } else if (S_ISREG(st.st_mode)) {
+      BuildIdIndexEntry index_entry;
+      index_entry.size = static_cast<uint64_t>(st.st_size);
+      index_entry.mtime_ns = GetMtimeInNs(st);
+      index_entry.inode = static_cast<uint64_t>(st.st_ino);
+      index->emplace_back(relative_path, std::move(index_entry));
+    }
+  }
+}
+
+void DebugElfFileFinder::CollectBuildIdInDir(const std::string& dir) {
+  // 1. List files in the dir, and reuse build ids of files not changed since the last scan.
+  // Index files are named by a hash of the real path of the symbol dir.
+  std::string index_dir = build_id_index_dir_.value_or(GetDefaultBuildIdIndexDir());
+  std::string index_path;
+  std::string header;
+  std::unordered_map<std::string, BuildIdIndexEntry> old_index;
+  if (!index_dir.empty()) {
+    std::error_code ec;
+    std::string real_dir = std::filesystem::canonical(dir, ec).string();
+    if (!ec) {
+      index_path = index_dir + OS_PATH_SEPARATOR +
+                   android::base::StringPrintf("build_id_index_%zx",
+                                               std::hash<std::string>()(real_dir));
+      header = std::string(kBuildIdIndexHeader) + " " + real_dir;
+      old_index = ReadBuildIdIndex(index_path, header);
+    }
+  }
+  BuildIdIndex index;
+  ListFilesInDir(dir, "", &index);
+  std::vector<size_t> files_to_read;
+  for (size_t i = 0; i < index.size(); ++i) {
+    auto& [path, entry] = index[i];
+    auto it = old_index.find(path);
+    if (it != old_index.end() && it->second.SameFile(entry)) {
+      entry.build_id = it->second.build_id;
     } else {
-      BuildId build_id;
-      ElfStatus status;
-      auto elf = ElfFile::Open(path, &status);
-      if (status == ElfStatus::NO_ERROR && elf->GetBuildId(&build_id) == ElfStatus::NO_ERROR) {
-        build_id_to_file_map_[build_id.ToString()] = path;
-      }
+      files_to_read.push_back(i);
+    }
+  }
+
+  // 2. Read build ids of new and changed files in parallel. ElfFile::Open() checks the elf magic
+  // before mapping the file, so non elf files are rejected cheaply.
+  RunInParallel(files_to_read.size(), kMinBuildIdReadsPerJob, [&](size_t i) {
+    auto& [path, entry] = index[files_to_read[i]];
+    BuildId build_id;
+    ElfStatus status;
+    auto elf = ElfFile::Open(dir + OS_PATH_SEPARATOR + path, &status);
+    if (status == ElfStatus::NO_ERROR && elf->GetBuildId(&build_id) == ElfStatus::NO_ERROR) {
+      entry.build_id = build_id.ToString();
     }
+  });
+
+  // 3. Add build ids in the order of files in the dir, and update the index if needed.
+  for (const auto& [path, entry] : index) {
+    if (!entry.build_id.empty()) {
+      build_id_to_file_map_[entry.build_id] = dir + OS_PATH_SEPARATOR + path;
+    }
+  }
+  if (!index_path.empty() && (!files_to_read.empty() || index.size() != old_index.size())) {
+    WriteBuildIdIndex(index_path, header, index);
   }
 }
 
@@ -258,7 +457,7 @@ bool Dso::demangle_ = true;
 std::string Dso::vmlinux_;
 std::string Dso::kallsyms_;
 std::unordered_map<std::string, BuildId> Dso::build_id_map_;
-size_t Dso::dso_count_;
+std::atomic<size_t> Dso::dso_count_;
 uint32_t Dso::g_dump_id_;
 simpleperf_dso_impl::DebugElfFileFinder Dso::debug_elf_file_finder_;
 
@@ -17,6 +17,7 @@
 #ifndef SIMPLE_PERF_DSO_H_
 #define SIMPLE_PERF_DSO_H_
 
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <string>
@@ -44,6 +45,9 @@ class DebugElfFileFinder {
   std::string FindDebugFile(const std::string& dso_path, bool force_64bit, BuildId& build_id);
   // Only for testing
   std::string GetPathInSymFsDir(const std::string& path);
+  // Only for testing. By default, build id indexes of symbol dirs are kept in a per-user cache
+  // dir.
+  void SetBuildIdIndexDir(const std::string& dir) { build_id_index_dir_ = dir; }
 
  private:
   void CollectBuildIdInDir(const std::string& dir);
@@ -52,6 +56,7 @@ class DebugElfFileFinder {
   std::string vdso_32bit_;
   std::string symfs_dir_;
   std::unordered_map<std::string, std::string> build_id_to_file_map_;
+  std::optional<std::string> build_id_index_dir_;
 };
 
 }  // namespace simpleperf_dso_impl
@@ -197,7 +202,8 @@ class Dso {
   static std::string vmlinux_;
   static std::string kallsyms_;
   static std::unordered_map<std::string, BuildId> build_id_map_;
-  static size_t dso_count_;
+  // Dsos can be created in multiple threads, like when decoding ETM data in worker threads.
+  static std::atomic<size_t> dso_count_;
   static uint32_t g_dump_id_;
   static simpleperf_dso_impl::DebugElfFileFinder debug_elf_file_finder_;
 
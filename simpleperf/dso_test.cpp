@@ -18,6 +18,11 @@
 
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <filesystem>
+
 #include <android-base/file.h>
 #include <android-base/stringprintf.h>
 #include <android-base/test_utils.h>
@@ -94,6 +99,95 @@ TEST(DebugElfFileFinder, add_symbol_dir) {
             symfs_dir + OS_PATH_SEPARATOR + "elf_for_build_id_check");
 }
 
+static std::string ReadBuildIdIndex(const std::string& index_dir) {
+  std::vector<std::string> entries = GetEntriesInDir(index_dir);
+  std::string index;
+  if (entries.size() == 1u) {
+    android::base::ReadFileToString(index_dir + OS_PATH_SEPARATOR + entries[0], &index);
+  }
+  return index;
+}
+
+TEST(DebugElfFileFinder, build_id_index) {
+  TemporaryDir tmpdir;
+  TemporaryDir index_dir;
+  std::string symbol_dir = tmpdir.path;
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(GetTestData(ELF_FILE), &data));
+  std::string elf_path = symbol_dir + OS_PATH_SEPARATOR + "elf";
+  ASSERT_TRUE(android::base::WriteStringToFile(data, elf_path));
+  ASSERT_TRUE(android::base::WriteStringToFile("text", symbol_dir + OS_PATH_SEPARATOR + "text"));
+
+  // Build ids are stored in an index file in the index dir, not in the symbol dir.
+  DebugElfFileFinder finder;
+  finder.SetBuildIdIndexDir(index_dir.path);
+  ASSERT_TRUE(finder.AddSymbolDir(symbol_dir));
+  BuildId build_id(ELF_FILE_BUILD_ID);
+  ASSERT_EQ(finder.FindDebugFile("elf", false, build_id), elf_path);
+  ASSERT_EQ(GetEntriesInDir(symbol_dir).size(), 2u);
+  std::string index = ReadBuildIdIndex(index_dir.path);
+  ASSERT_NE(index.find(" " + build_id.ToString() + " elf\n"), std::string::npos);
+  ASSERT_NE(index.find(" - text\n"), std::string::npos);
+
+  // The index is updated for moved files.
+  std::string subdir = symbol_dir + OS_PATH_SEPARATOR + "subdir";
+  ASSERT_TRUE(std::filesystem::create_directory(subdir));
+  std::string new_elf_path = subdir + OS_PATH_SEPARATOR + "elf";
+  ASSERT_TRUE(android::base::WriteStringToFile(data, new_elf_path));
+  ASSERT_EQ(remove(elf_path.c_str()), 0);
+  finder.Reset();
+  ASSERT_TRUE(finder.AddSymbolDir(symbol_dir));
+  ASSERT_EQ(finder.FindDebugFile("elf", false, build_id), new_elf_path);
+  index = ReadBuildIdIndex(index_dir.path);
+  ASSERT_EQ(index.find(" " + build_id.ToString() + " elf\n"), std::string::npos);
+  ASSERT_NE(index.find(" " + build_id.ToString() + " subdir" + OS_PATH_SEPARATOR + "elf\n"),
+            std::string::npos);
+}
+
+#if defined(__linux__)
+TEST(DebugElfFileFinder, build_id_index_reused_for_unchanged_files) {
+  TemporaryDir tmpdir;
+  TemporaryDir index_dir;
+  std::string symbol_dir = tmpdir.path;
+  std::string data;
+  ASSERT_TRUE(android::base::ReadFileToString(GetTestData(ELF_FILE), &data));
+  std::string elf_path = symbol_dir + OS_PATH_SEPARATOR + "elf";
+  ASSERT_TRUE(android::base::WriteStringToFile(data, elf_path));
+  BuildId build_id(ELF_FILE_BUILD_ID);
+  DebugElfFileFinder finder;
+  finder.SetBuildIdIndexDir(index_dir.path);
+  ASSERT_TRUE(finder.AddSymbolDir(symbol_dir));
+
+  // Plant an entry with the size, mtime and inode of elf, but a different build id. If the warm
+  // run reuses the entry without reopening elf, elf isn't found by its real build id.
+  std::vector<std::string> entries = GetEntriesInDir(index_dir.path);
+  ASSERT_EQ(entries.size(), 1u);
+  std::string index_path = std::string(index_dir.path) + OS_PATH_SEPARATOR + entries[0];
+  std::string index;
+  ASSERT_TRUE(android::base::ReadFileToString(index_path, &index));
+  std::string real_build_id = " " + build_id.ToString() + " ";
+  size_t pos = index.find(real_build_id);
+  ASSERT_NE(pos, std::string::npos);
+  std::string planted_build_id = " " + BuildId("0123456789abcdef").ToString() + " ";
+  index.replace(pos, real_build_id.size(), planted_build_id);
+  ASSERT_TRUE(android::base::WriteStringToFile(index, index_path));
+  std::string not_found_path = "/not_exist/elf";
+  finder.Reset();
+  ASSERT_TRUE(finder.AddSymbolDir(symbol_dir));
+  ASSERT_EQ(finder.FindDebugFile(not_found_path, false, build_id), not_found_path);
+
+  // A change of mtime in nanoseconds makes the entry stale, and elf is read again.
+  struct stat st;
+  ASSERT_EQ(stat(elf_path.c_str(), &st), 0);
+  struct timespec times[2] = {st.st_atim, st.st_mtim};
+  times[1].tv_nsec = (times[1].tv_nsec + 1) % 1000000000;
+  ASSERT_EQ(utimensat(AT_FDCWD, elf_path.c_str(), times, 0), 0);
+  finder.Reset();
+  ASSERT_TRUE(finder.AddSymbolDir(symbol_dir));
+  ASSERT_EQ(finder.FindDebugFile(not_found_path, false, build_id), elf_path);
+}
+#endif  // defined(__linux__)
+
 TEST(DebugElfFileFinder, build_id_list) {
   DebugElfFileFinder finder;
   // Find file in symfs dir with correct build_id_list.
@@ -17,14 +17,20 @@
 #include "environment.h"
 
 #include <inttypes.h>
+#include <linux/cn_proc.h>
+#include <linux/connector.h>
+#include <linux/netlink.h>
+#include <poll.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/resource.h>
+#include <sys/socket.h>
 #include <sys/utsname.h>
 #include <unistd.h>
 
+#include <functional>
 #include <limits>
 #include <set>
 #include <unordered_map>
@@ -35,6 +41,7 @@
 #include <android-base/parseint.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
 #include <procinfo/process.h>
 #include <procinfo/process_map.h>
 
@@ -492,36 +499,250 @@ static bool HasOpenedAppApkFile(int pid) {
   return false;
 }
 
-std::set<pid_t> WaitForAppProcesses(const std::string& package_name) {
+static bool IsProcessOfPackage(pid_t pid, const std::string& package_name) {
+  std::string process_name = GetCompleteProcessName(pid);
+  if (process_name.empty()) {
+    return false;
+  }
+  // The app may have multiple processes, with process name like
+  // com.google.android.googlequicksearchbox:search.
+  size_t split_pos = process_name.find(':');
+  if (split_pos != std::string::npos) {
+    process_name = process_name.substr(0, split_pos);
+  }
+  return process_name == package_name;
+}
+
+// If a debuggable app with wrap.sh runs on Android O, the app will be started with
+// logwrapper as below:
+// 1. Zygote forks a child process, rename it to package_name.
+// 2. The child process execute sh, which starts a child process running
+//    /system/bin/logwrapper.
+// 3. logwrapper starts a child process running sh, which interprets wrap.sh.
+// 4. wrap.sh starts a child process running the app.
+// The problem here is we want to profile the process started in step 4, but sometimes we
+// run into the process started in step 1. To solve it, we can check if the process has
+// opened an apk file in some app dirs.
+static bool IsAppProcess(pid_t pid, const std::string& package_name) {
+  return IsProcessOfPackage(pid, package_name) && HasOpenedAppApkFile(pid);
+}
+
+static bool use_process_events = true;
+
+void SetProcessEventsForTesting(bool enable) {
+  use_process_events = enable;
+}
+
+namespace {
+
+// Older uapi headers nest the event type enum in proc_event, newer ones define it at file scope.
+using ProcEventType = decltype(proc_event::what);
+
+// Receives fork/exec/comm/exit events of all processes from the netlink process connector.
+// Listening needs CAP_NET_ADMIN (and SELinux permission on Android), so callers need a fallback.
+class ProcessEventListener {
+ public:
+  bool Open() {
+    fd_.reset(socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR));
+    if (fd_ == -1) {
+      PLOG(DEBUG) << "failed to create netlink connector socket";
+      return false;
+    }
+    sockaddr_nl addr = {};
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = CN_IDX_PROC;
+    if (bind(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+      PLOG(DEBUG) << "failed to bind netlink connector socket";
+      return false;
+    }
+    alignas(nlmsghdr) char buf[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))] = {};
+    nlmsghdr* nlh = reinterpret_cast<nlmsghdr*>(buf);
+    nlh->nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_cn_mcast_op));
+    nlh->nlmsg_type = NLMSG_DONE;
+    cn_msg* msg = reinterpret_cast<cn_msg*>(NLMSG_DATA(nlh));
+    msg->id.idx = CN_IDX_PROC;
+    msg->id.val = CN_VAL_PROC;
+    msg->len = sizeof(proc_cn_mcast_op);
+    proc_cn_mcast_op op = PROC_CN_MCAST_LISTEN;
+    memcpy(msg->data, &op, sizeof(op));
+    if (TEMP_FAILURE_RETRY(send(fd_, buf, nlh->nlmsg_len, 0)) != nlh->nlmsg_len) {
+      PLOG(DEBUG) << "failed to send PROC_CN_MCAST_LISTEN";
+      return false;
+    }
+    // The kernel acks the listen request. Without the ack we can't tell whether events will
+    // be delivered, so treat it as a failure.
+    int err = -1;
+    uint64_t deadline = GetSystemClock() + 100 * 1000000ULL;
+    while (err == -1) {
+      uint64_t now = GetSystemClock();
+      if (now >= deadline) {
+        LOG(DEBUG) << "no ack for PROC_CN_MCAST_LISTEN";
+        return false;
+      }
+      int timeout_ms = static_cast<int>((deadline - now + 999999) / 1000000);
+      auto callback = [&](const proc_event& event) {
+        if (event.what == ProcEventType::PROC_EVENT_NONE) {
+          err = event.event_data.ack.err;
+        }
+      };
+      if (ReadEvents(timeout_ms, callback) == ReadStatus::kError) {
+        return false;
+      }
+    }
+    if (err != 0) {
+      LOG(DEBUG) << "PROC_CN_MCAST_LISTEN failed: " << strerror(err);
+      return false;
+    }
+    return true;
+  }
+
+  enum class ReadStatus {
+    kOk,
+    kError,
+    // The socket buffer overflowed and events were dropped.
+    kLostEvents,
+  };
+
+  // Waits up to timeout_ms (-1 means forever) for events, and calls callback for each of them.
+  ReadStatus ReadEvents(int timeout_ms, const std::function<void(const proc_event&)>& callback) {
+    pollfd pfd = {.fd = fd_.get(), .events = POLLIN};
+    int ret = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeout_ms));
+    if (ret <= 0) {
+      return ret == 0 ? ReadStatus::kOk : ReadStatus::kError;
+    }
+    while (true) {
+      alignas(nlmsghdr) char buf[4096];
+      ssize_t len = TEMP_FAILURE_RETRY(recv(fd_, buf, sizeof(buf), MSG_DONTWAIT));
+      if (len < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          return ReadStatus::kOk;
+        }
+        if (errno == ENOBUFS) {
+          return ReadStatus::kLostEvents;
+        }
+        PLOG(DEBUG) << "failed to read netlink connector socket";
+        return ReadStatus::kError;
+      }
+      for (nlmsghdr* nlh = reinterpret_cast<nlmsghdr*>(buf); NLMSG_OK(nlh, len);
+           nlh = NLMSG_NEXT(nlh, len)) {
+        if (nlh->nlmsg_type != NLMSG_DONE) {
+          continue;
+        }
+        cn_msg* msg = reinterpret_cast<cn_msg*>(NLMSG_DATA(nlh));
+        if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC ||
+            msg->len < sizeof(proc_event)) {
+          continue;
+        }
+        proc_event event;
+        memcpy(&event, msg->data, sizeof(event));
+        callback(event);
+      }
+    }
+  }
+
+ private:
+  android::base::unique_fd fd_;
+};
+
+}  // namespace
+
+// Instead of scanning /proc every 1 ms, only look at processes the kernel reports as forked,
+// exec'd or renamed. A reported process is rechecked until it gets the package name or
+// kRecheckNameNs passes, since its cmdline may be updated after the event. A process with
+// the package name is rechecked until it opens the apk or exits.
+static std::optional<std::set<pid_t>> WaitForAppProcessesWithEvents(
+    const std::string& package_name) {
+  constexpr uint64_t kRecheckNameNs = 1000000000ULL;
+  ProcessEventListener listener;
+  if (!listener.Open()) {
+    return std::nullopt;
+  }
+  std::unordered_map<pid_t, uint64_t> pending;  // pid -> deadline to get the package name
+  std::set<pid_t> candidates;                   // have the package name, not the apk
+  auto scan_all_processes = [&]() {
+    for (pid_t pid : GetAllProcesses()) {
+      if (IsProcessOfPackage(pid, package_name)) {
+        candidates.insert(pid);
+      }
+    }
+  };
+  // Processes existing before we started listening.
+  scan_all_processes();
+
   std::set<pid_t> result;
   size_t loop_count = 0;
   while (true) {
-    std::vector<pid_t> pids = GetAllProcesses();
-    for (pid_t pid : pids) {
-      std::string process_name = GetCompleteProcessName(pid);
-      if (process_name.empty()) {
-        continue;
+    uint64_t now = GetSystemClock();
+    for (auto it = pending.begin(); it != pending.end();) {
+      if (IsProcessOfPackage(it->first, package_name)) {
+        candidates.insert(it->first);
+        it = pending.erase(it);
+      } else if (now >= it->second) {
+        it = pending.erase(it);
+      } else {
+        ++it;
       }
-      // The app may have multiple processes, with process name like
-      // com.google.android.googlequicksearchbox:search.
-      size_t split_pos = process_name.find(':');
-      if (split_pos != std::string::npos) {
-        process_name = process_name.substr(0, split_pos);
+    }
+    for (pid_t pid : candidates) {
+      if (HasOpenedAppApkFile(pid)) {
+        if (loop_count > 0u) {
+          LOG(INFO) << "Got process " << pid << " for package " << package_name;
+        }
+        result.insert(pid);
       }
-      if (process_name != package_name) {
-        continue;
+    }
+    if (!result.empty()) {
+      return result;
+    }
+    if (++loop_count == 1u) {
+      LOG(INFO) << "Waiting for process of app " << package_name;
+    }
+    int timeout_ms = (pending.empty() && candidates.empty()) ? -1 : 1;
+    auto callback = [&](const proc_event& event) {
+      pid_t pid;
+      switch (event.what) {
+        case ProcEventType::PROC_EVENT_FORK:
+          pid = event.event_data.fork.child_tgid;
+          break;
+        case ProcEventType::PROC_EVENT_EXEC:
+          pid = event.event_data.exec.process_tgid;
+          break;
+        case ProcEventType::PROC_EVENT_COMM:
+          pid = event.event_data.comm.process_tgid;
+          break;
+        case ProcEventType::PROC_EVENT_EXIT:
+          if (event.event_data.exit.process_pid == event.event_data.exit.process_tgid) {
+            pending.erase(event.event_data.exit.process_tgid);
+            candidates.erase(event.event_data.exit.process_tgid);
+          }
+          return;
+        default:
+          return;
+      }
+      if (candidates.count(pid) == 0) {
+        pending[pid] = GetSystemClock() + kRecheckNameNs;
       }
-      // If a debuggable app with wrap.sh runs on Android O, the app will be started with
-      // logwrapper as below:
-      // 1. Zygote forks a child process, rename it to package_name.
-      // 2. The child process execute sh, which starts a child process running
-      //    /system/bin/logwrapper.
-      // 3. logwrapper starts a child process running sh, which interprets wrap.sh.
-      // 4. wrap.sh starts a child process running the app.
-      // The problem here is we want to profile the process started in step 4, but sometimes we
-      // run into the process started in step 1. To solve it, we can check if the process has
-      // opened an apk file in some app dirs.
-      if (!HasOpenedAppApkFile(pid)) {
+    };
+    switch (listener.ReadEvents(timeout_ms, callback)) {
+      case ProcessEventListener::ReadStatus::kOk:
+        break;
+      case ProcessEventListener::ReadStatus::kLostEvents:
+        LOG(DEBUG) << "lost process events, rescanning /proc";
+        scan_all_processes();
+        break;
+      case ProcessEventListener::ReadStatus::kError:
+        return std::nullopt;
+    }
+  }
+}
+
+static std::set<pid_t> PollForAppProcesses(const std::string& package_name) {
+  std::set<pid_t> result;
+  size_t loop_count = 0;
+  while (true) {
+    std::vector<pid_t> pids = GetAllProcesses();
+    for (pid_t pid : pids) {
+      if (!IsAppProcess(pid, package_name)) {
         continue;
       }
       if (loop_count > 0u) {
@@ -539,6 +760,16 @@ std::set<pid_t> WaitForAppProcesses(const std::string& package_name) {
   }
 }
 
+std::set<pid_t> WaitForAppProcesses(const std::string& package_name) {
+  if (use_process_events) {
+    if (auto result = WaitForAppProcessesWithEvents(package_name); result) {
+      return std::move(result.value());
+    }
+    LOG(DEBUG) << "process events aren't available, polling /proc instead";
+  }
+  return PollForAppProcesses(package_name);
+}
+
 namespace {
 
 bool IsAppDebuggable(int user_id, const std::string& package_name) {
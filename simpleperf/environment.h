@@ -91,6 +91,7 @@ ArchType GetMachineArch();
 void PrepareVdsoFile();
 
 std::set<pid_t> WaitForAppProcesses(const std::string& package_name);
+void SetProcessEventsForTesting(bool enable);  // for testing only
 void SetRunInAppToolForTesting(bool run_as, bool simpleperf_app_runner);  // for testing only
 bool RunInAppContext(const std::string& app_package_name, const std::string& cmd,
                      const std::vector<std::string>& args, size_t workload_args_size,
@@ -143,6 +144,13 @@ static inline uint64_t GetSystemClock() {
   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
 }
 
+// Return cpu time used by all threads in the current process.
+static inline uint64_t GetProcessCpuTimeInNs() {
+  timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
 #if defined(__ANDROID__)
 bool IsInAppUid();
 #endif
@@ -16,6 +16,11 @@
 
 #include <gtest/gtest.h>
 
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
 #include <filesystem>
 
 #include <android-base/file.h>
@@ -142,3 +147,46 @@ TEST(environment, GetMemorySize) {
   ASSERT_TRUE(value);
   ASSERT_GT(value.value(), 0);
 }
+
+TEST(environment, WaitForAppProcesses) {
+  // Simulate an app start: a child process opens an apk file, then execs a program under the
+  // package name. Report how long detection takes after the exec, and the cpu time spent waiting.
+  TemporaryDir tmpdir;
+  std::string apk_path = std::string(tmpdir.path) + "/app_test.apk";
+  ASSERT_TRUE(android::base::WriteStringToFile("apk", apk_path));
+  const std::string package_name = "com.android.simpleperf.wait_test";
+#if defined(__ANDROID__)
+  const char* sleep_path = "/system/bin/sleep";
+#else
+  const char* sleep_path = "/bin/sleep";
+#endif
+  void* shared = mmap(nullptr, sizeof(uint64_t), PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  ASSERT_NE(shared, MAP_FAILED);
+  auto exec_time = static_cast<volatile uint64_t*>(shared);
+
+  for (bool use_process_events : {true, false}) {
+    SetProcessEventsForTesting(use_process_events);
+    pid_t pid = fork();
+    ASSERT_NE(pid, -1);
+    if (pid == 0) {
+      usleep(100000);
+      open(apk_path.c_str(), O_RDONLY);
+      *exec_time = GetSystemClock();
+      execl(sleep_path, package_name.c_str(), "10", nullptr);
+      _exit(1);
+    }
+    uint64_t cpu_time = GetProcessCpuTimeInNs();
+    std::set<pid_t> pids = WaitForAppProcesses(package_name);
+    uint64_t detect_time = GetSystemClock();
+    cpu_time = GetProcessCpuTimeInNs() - cpu_time;
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+    ASSERT_EQ(pids, std::set<pid_t>({pid}));
+    GTEST_LOG_(INFO) << "use_process_events " << use_process_events << ": detected after "
+                     << (detect_time - *exec_time) / 1000 << " us, cpu time "
+                     << cpu_time / 1000 << " us";
+  }
+  SetProcessEventsForTesting(true);
+  munmap(shared, sizeof(uint64_t));
+}
@@ -47,7 +47,8 @@ static int perf_event_open(const perf_event_attr& attr, pid_t pid, int cpu, int
 
 std::unique_ptr<EventFd> EventFd::OpenEventFile(const perf_event_attr& attr, pid_t tid, int cpu,
                                                 EventFd* group_event_fd,
-                                                const std::string& event_name, bool report_error) {
+                                                const std::string& event_name, bool report_error,
+                                                int cgroup_fd) {
   int group_fd = -1;
   if (group_event_fd != nullptr) {
     group_fd = group_event_fd->perf_event_fd_;
@@ -56,22 +57,30 @@ std::unique_ptr<EventFd> EventFd::OpenEventFile(const perf_event_attr& attr, pid
   if (attr.freq) {
     uint64_t max_sample_freq;
     if (GetMaxSampleFrequency(&max_sample_freq) && max_sample_freq < attr.sample_freq) {
-      static bool warned = false;
-      if (!warned) {
-        warned = true;
+      // Event files can be opened on multiple threads.
+      static std::atomic<bool> warned = false;
+      if (!warned.exchange(true)) {
         LOG(INFO) << "Adjust sample freq to max allowed sample freq " << max_sample_freq;
       }
       real_attr.sample_freq = max_sample_freq;
     }
   }
-  int perf_event_fd = perf_event_open(real_attr, tid, cpu, group_fd, 0);
+  int perf_event_fd;
+  if (cgroup_fd != -1) {
+    CHECK_EQ(tid, -1);
+    perf_event_fd = perf_event_open(real_attr, cgroup_fd, cpu, group_fd, PERF_FLAG_PID_CGROUP);
+  } else {
+    perf_event_fd = perf_event_open(real_attr, tid, cpu, group_fd, 0);
+  }
   if (perf_event_fd == -1) {
     if (report_error) {
       PLOG(ERROR) << "open perf_event_file (event " << event_name << ", tid " << tid << ", cpu "
-                  << cpu << ", group_fd " << group_fd << ") failed";
+                  << cpu << ", group_fd " << group_fd << ", cgroup_fd " << cgroup_fd
+                  << ") failed";
     } else {
       PLOG(DEBUG) << "open perf_event_file (event " << event_name << ", tid " << tid << ", cpu "
-                  << cpu << ", group_fd " << group_fd << ") failed";
+                  << cpu << ", group_fd " << group_fd << ", cgroup_fd " << cgroup_fd
+                  << ") failed";
     }
     return nullptr;
   }
@@ -85,7 +94,8 @@ std::unique_ptr<EventFd> EventFd::OpenEventFile(const perf_event_attr& attr, pid
     }
     return nullptr;
   }
-  return std::unique_ptr<EventFd>(new EventFd(real_attr, perf_event_fd, event_name, tid, cpu));
+  return std::unique_ptr<EventFd>(
+      new EventFd(real_attr, perf_event_fd, event_name, tid, cpu, cgroup_fd));
 }
 
 EventFd::~EventFd() {
@@ -131,6 +141,14 @@ bool EventFd::SetFilter(const std::string& filter) {
   return success;
 }
 
+bool EventFd::SetSampleSpeed(uint64_t freq_or_period) {
+  if (ioctl(perf_event_fd_, PERF_EVENT_IOC_PERIOD, &freq_or_period) < 0) {
+    PLOG(ERROR) << "failed to set sample speed for " << Name();
+    return false;
+  }
+  return true;
+}
+
 bool EventFd::InnerReadCounter(PerfCounter* counter) const {
   CHECK(counter != nullptr);
   if (!android::base::ReadFully(perf_event_fd_, counter, sizeof(*counter))) {
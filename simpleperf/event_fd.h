@@ -40,10 +40,12 @@ struct PerfCounter {
 // EventFd represents an opened perf_event_file.
 class EventFd {
  public:
+  // If cgroup_fd isn't -1, tid should be -1, and the event file monitors threads in the cgroup
+  // opened as cgroup_fd on the cpu.
   static std::unique_ptr<EventFd> OpenEventFile(const perf_event_attr& attr, pid_t tid, int cpu,
                                                 EventFd* group_event_fd,
                                                 const std::string& event_name,
-                                                bool report_error = true);
+                                                bool report_error = true, int cgroup_fd = -1);
 
   virtual ~EventFd();
 
@@ -56,12 +58,17 @@ class EventFd {
 
   int Cpu() const { return cpu_; }
 
+  // Return the cgroup_fd passed to OpenEventFile(), or -1 if not monitoring a cgroup.
+  int CgroupFd() const { return cgroup_fd_; }
+
   const perf_event_attr& attr() const { return attr_; }
 
   // It tells the kernel to start counting and recording events specified by
   // this file.
   bool SetEnableEvent(bool enable);
   bool SetFilter(const std::string& filter);
+  // Change the sample frequency (for events using freq) or sample period at runtime.
+  bool SetSampleSpeed(uint64_t freq_or_period);
 
   bool ReadCounter(PerfCounter* counter);
 
@@ -110,13 +117,14 @@ class EventFd {
 
  protected:
   EventFd(const perf_event_attr& attr, int perf_event_fd, const std::string& event_name, pid_t tid,
-          int cpu)
+          int cpu, int cgroup_fd = -1)
       : attr_(attr),
         perf_event_fd_(perf_event_fd),
         id_(0),
         event_name_(event_name),
         tid_(tid),
         cpu_(cpu),
+        cgroup_fd_(cgroup_fd),
         mmap_addr_(nullptr),
         mmap_len_(0),
         mmap_metadata_page_(nullptr),
@@ -133,6 +141,7 @@ class EventFd {
   const std::string event_name_;
   pid_t tid_;
   int cpu_;
+  int cgroup_fd_;
 
   void* mmap_addr_;
   size_t mmap_len_;
@@ -16,6 +16,8 @@
 
 #include "event_selection_set.h"
 
+#include <fcntl.h>
+
 #include <algorithm>
 #include <atomic>
 #include <thread>
@@ -170,6 +172,13 @@ bool IsSwitchRecordSupported() {
   return version && version.value() >= std::make_pair(4, 3);
 }
 
+std::string EventSetupStat::ToString() const {
+  return StringPrintf(
+      "prepare threads %.3f s, open %zu event files %.3f s, apply filters %.3f s, mmap %.3f s",
+      prepare_threads_time_in_ns / 1e9, event_file_count, open_files_time_in_ns / 1e9,
+      apply_filters_time_in_ns / 1e9, mmap_time_in_ns / 1e9);
+}
+
 std::string AddrFilter::ToString() const {
   switch (type) {
     case FILE_RANGE:
@@ -604,6 +613,29 @@ bool EventSelectionSet::SetTracepointFilter(const std::string& filter) {
   return true;
 }
 
+bool EventSelectionSet::AddMonitoredCgroups(const std::vector<std::string>& cgroup_paths) {
+  for (const auto& path : cgroup_paths) {
+    if (cgroups_.count(path) != 0) {
+      continue;
+    }
+    android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    if (fd == -1) {
+      PLOG(ERROR) << "failed to open cgroup " << path;
+      return false;
+    }
+    cgroups_.emplace(path, std::move(fd));
+  }
+  return true;
+}
+
+std::vector<std::string> EventSelectionSet::GetMonitoredCgroups() const {
+  std::vector<std::string> paths;
+  for (const auto& [path, _] : cgroups_) {
+    paths.push_back(path);
+  }
+  return paths;
+}
+
 static bool CheckIfCpusOnline(const std::vector<int>& cpus) {
   std::vector<int> online_cpus = GetOnlineCpus();
   for (const auto& cpu : cpus) {
@@ -615,28 +647,28 @@ static bool CheckIfCpusOnline(const std::vector<int>& cpus) {
   return true;
 }
 
-bool EventSelectionSet::OpenEventFilesOnGroup(EventSelectionGroup& group, pid_t tid, int cpu,
+bool EventSelectionSet::OpenEventFilesOnGroup(const EventSelectionGroup& group, pid_t tid, int cpu,
+                                              int cgroup_fd,
+                                              std::vector<std::unique_ptr<EventFd>>* event_fds,
                                               std::string* failed_event_type) {
-  std::vector<std::unique_ptr<EventFd>> event_fds;
-  // Given a tid and cpu, events on the same group should be all opened
+  // Given a tid (or cgroup) and cpu, events on the same group should be all opened
   // successfully or all failed to open.
   EventFd* group_fd = nullptr;
   for (auto& selection : group) {
-    std::unique_ptr<EventFd> event_fd = EventFd::OpenEventFile(
-        selection.event_attr, tid, cpu, group_fd, selection.event_type_modifier.name, false);
+    std::unique_ptr<EventFd> event_fd =
+        EventFd::OpenEventFile(selection.event_attr, tid, cpu, group_fd,
+                               selection.event_type_modifier.name, false, cgroup_fd);
     if (!event_fd) {
       *failed_event_type = selection.event_type_modifier.name;
+      event_fds->clear();
       return false;
     }
     LOG(VERBOSE) << "OpenEventFile for " << event_fd->Name();
-    event_fds.push_back(std::move(event_fd));
+    event_fds->push_back(std::move(event_fd));
     if (group_fd == nullptr) {
-      group_fd = event_fds.back().get();
+      group_fd = event_fds->back().get();
     }
   }
-  for (size_t i = 0; i < group.size(); ++i) {
-    group[i].event_fds.push_back(std::move(event_fds[i]));
-  }
   return true;
 }
 
@@ -650,6 +682,12 @@ static std::set<pid_t> PrepareThreads(const std::set<pid_t>& processes,
   return result;
 }
 
+// Opening a perf event file takes tens of microseconds, and recording a process with thousands of
+// threads on a many-core device opens tens of thousands of them. So each group is opened on a
+// worker pool, and the opened files are added to the group in the same (tid, cpu) order as opening
+// them serially. Groups are still opened one after another.
+static constexpr size_t kMinEventFileOpensPerJob = 64;
+
 bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
   std::vector<int> monitored_cpus;
   if (cpus.empty()) {
@@ -662,29 +700,76 @@ bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
     }
     monitored_cpus = cpus;
   }
-  std::set<pid_t> threads = PrepareThreads(processes_, threads_);
+  if (!cgroups_.empty() && monitored_cpus.size() == 1 && monitored_cpus[0] == -1) {
+    // Cgroup events can only be opened per cpu.
+    monitored_cpus = GetOnlineCpus();
+  }
+  uint64_t start_time = GetSystemClock();
+  std::set<pid_t> threads;
+  if (cgroups_.empty()) {
+    threads = PrepareThreads(processes_, threads_);
+  }
+  uint64_t open_start_time = GetSystemClock();
+  setup_stat_.prepare_threads_time_in_ns += open_start_time - start_time;
   for (auto& group : groups_) {
-    size_t success_count = 0;
-    std::string failed_event_type;
+    const std::vector<int>* pcpus = &monitored_cpus;
+    if (!group[0].allowed_cpus.empty()) {
+      // override cpu list if event's PMU has a cpumask as those PMUs are
+      // agnostic to cpu and it's meaningless to specify cpus for them.
+      pcpus = &group[0].allowed_cpus;
+    }
+    struct OpenTarget {
+      pid_t tid;
+      int cpu;
+      int cgroup_fd;
+    };
+    std::vector<OpenTarget> targets;
     for (const auto tid : threads) {
-      const std::vector<int>* pcpus = &monitored_cpus;
-      if (!group[0].allowed_cpus.empty()) {
-        // override cpu list if event's PMU has a cpumask as those PMUs are
-        // agnostic to cpu and it's meaningless to specify cpus for them.
-        pcpus = &group[0].allowed_cpus;
+      for (const auto& cpu : *pcpus) {
+        targets.push_back({tid, cpu, -1});
       }
+    }
+    for (const auto& [path, cgroup_fd] : cgroups_) {
       for (const auto& cpu : *pcpus) {
-        if (OpenEventFilesOnGroup(group, tid, cpu, &failed_event_type)) {
-          success_count++;
-        }
+        targets.push_back({-1, cpu, cgroup_fd.get()});
       }
     }
+    struct OpenResult {
+      std::vector<std::unique_ptr<EventFd>> event_fds;
+      std::string failed_event_type;
+      int error_number = 0;
+    };
+    std::vector<OpenResult> results(targets.size());
+    RunInParallel(targets.size(), kMinEventFileOpensPerJob, [&](size_t i) {
+      OpenResult& result = results[i];
+      const OpenTarget& target = targets[i];
+      if (!OpenEventFilesOnGroup(group, target.tid, target.cpu, target.cgroup_fd,
+                                 &result.event_fds, &result.failed_event_type)) {
+        result.error_number = errno;
+      }
+    });
+
+    size_t success_count = 0;
+    std::string failed_event_type;
+    int error_number = 0;
+    for (OpenResult& result : results) {
+      if (result.event_fds.empty()) {
+        failed_event_type = result.failed_event_type;
+        error_number = result.error_number;
+        continue;
+      }
+      for (size_t i = 0; i < group.size(); ++i) {
+        group[i].event_fds.push_back(std::move(result.event_fds[i]));
+      }
+      setup_stat_.event_file_count += group.size();
+      success_count++;
+    }
     // We can't guarantee to open perf event file successfully for each thread on each cpu.
     // Because threads may exit between PrepareThreads() and OpenEventFilesOnGroup(), and
     // cpus may be offlined between GetOnlineCpus() and OpenEventFilesOnGroup().
     // So we only check that we can at least monitor one thread for each event group.
     if (success_count == 0) {
-      int error_number = errno;
+      errno = error_number;
       PLOG(ERROR) << "failed to open perf event file for event_type " << failed_event_type;
       if (error_number == EMFILE) {
         LOG(ERROR) << "Please increase hard limit of open file numbers.";
@@ -692,7 +777,11 @@ bool EventSelectionSet::OpenEventFiles(const std::vector<int>& cpus) {
       return false;
     }
   }
-  return ApplyFilters();
+  uint64_t filter_start_time = GetSystemClock();
+  setup_stat_.open_files_time_in_ns += filter_start_time - open_start_time;
+  bool result = ApplyFilters();
+  setup_stat_.apply_filters_time_in_ns += GetSystemClock() - filter_start_time;
+  return result;
 }
 
 bool EventSelectionSet::ApplyFilters() {
@@ -770,6 +859,10 @@ static bool ReadCounter(EventFd* event_fd, CounterInfo* counter) {
 
 bool EventSelectionSet::ReadCounters(std::vector<CountersInfo>* counters) {
   counters->clear();
+  std::unordered_map<int, const std::string*> cgroup_paths;
+  for (const auto& [path, fd] : cgroups_) {
+    cgroup_paths[fd.get()] = &path;
+  }
   for (size_t i = 0; i < groups_.size(); ++i) {
     for (auto& selection : groups_[i]) {
       CountersInfo counters_info;
@@ -782,7 +875,10 @@ bool EventSelectionSet::ReadCounters(std::vector<CountersInfo>* counters) {
         if (!ReadCounter(event_fd.get(), &counter)) {
           return false;
         }
-        counters_info.counters.push_back(counter);
+        if (auto it = cgroup_paths.find(event_fd->CgroupFd()); it != cgroup_paths.end()) {
+          counter.cgroup = *it->second;
+        }
+        counters_info.counters.push_back(std::move(counter));
       }
       counters->push_back(counters_info);
     }
@@ -814,7 +910,10 @@ bool EventSelectionSet::PrepareToReadMmapEventData(const std::function<bool(Reco
       }
     }
   }
-  return record_read_thread_->AddEventFds(event_fds);
+  uint64_t start_time = GetSystemClock();
+  bool result = record_read_thread_->AddEventFds(event_fds);
+  setup_stat_.mmap_time_in_ns += GetSystemClock() - start_time;
+  return result;
 }
 
 bool EventSelectionSet::SyncKernelBuffer() {
@@ -888,6 +987,30 @@ bool EventSelectionSet::HasSampler() {
   return false;
 }
 
+bool EventSelectionSet::SetSampleSpeedRatio(double ratio) {
+  for (auto& group : groups_) {
+    for (auto& sel : group) {
+      const perf_event_attr& attr = sel.event_attr;
+      if (attr.type == PERF_TYPE_TRACEPOINT || IsEtmEventType(attr.type) ||
+          (!attr.freq && attr.sample_period == INFINITE_SAMPLE_PERIOD)) {
+        continue;
+      }
+      uint64_t value;
+      if (attr.freq) {
+        value = std::max<uint64_t>(static_cast<uint64_t>(attr.sample_freq * ratio), 1);
+      } else {
+        value = std::max<uint64_t>(static_cast<uint64_t>(attr.sample_period / ratio), 1);
+      }
+      for (auto& fd : sel.event_fds) {
+        if (!fd->SetSampleSpeed(value)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
 bool EventSelectionSet::SetEnableEvents(bool enable) {
   for (auto& group : groups_) {
     for (auto& sel : group) {
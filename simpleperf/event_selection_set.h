@@ -24,6 +24,7 @@
 #include <vector>
 
 #include <android-base/macros.h>
+#include <android-base/unique_fd.h>
 
 #include "IOEventLoop.h"
 #include "RecordReadThread.h"
@@ -42,6 +43,7 @@ constexpr uint64_t DEFAULT_SAMPLE_PERIOD_FOR_TRACEPOINT_EVENT = 1;
 struct CounterInfo {
   pid_t tid;
   int cpu;
+  std::string cgroup;  // empty if not monitoring cgroups
   PerfCounter counter;
 };
 
@@ -52,6 +54,17 @@ struct CountersInfo {
   std::vector<CounterInfo> counters;
 };
 
+// Time spent in each phase of setting up event files, to find out why recording starts slowly.
+struct EventSetupStat {
+  uint64_t prepare_threads_time_in_ns = 0;
+  uint64_t open_files_time_in_ns = 0;
+  uint64_t apply_filters_time_in_ns = 0;
+  uint64_t mmap_time_in_ns = 0;
+  size_t event_file_count = 0;
+
+  std::string ToString() const;
+};
+
 struct SampleSpeed {
   // There are two ways to set sample speed:
   // 1. sample_freq: take [sample_freq] samples every second.
@@ -152,10 +165,18 @@ class EventSelectionSet {
   void ClearMonitoredTargets() {
     processes_.clear();
     threads_.clear();
+    cgroups_.clear();
   }
 
   bool HasMonitoredTarget() const { return !processes_.empty() || !threads_.empty(); }
 
+  // Monitor threads in cgroups, given as cgroup directories (of cgroup v2, or of the perf_event
+  // controller in cgroup v1). Event files are opened per cpu for each cgroup, so the number of
+  // files doesn't depend on the number of threads. Can't be used with processes or threads.
+  bool AddMonitoredCgroups(const std::vector<std::string>& cgroup_paths);
+  bool HasMonitoredCgroups() const { return !cgroups_.empty(); }
+  std::vector<std::string> GetMonitoredCgroups() const;
+
   IOEventLoop* GetIOEventLoop() { return loop_.get(); }
 
   // If cpus = {}, monitor on all cpus, with a perf event file for each cpu.
@@ -171,12 +192,17 @@ class EventSelectionSet {
   void CloseEventFiles();
 
   const simpleperf::RecordStat& GetRecordStat() { return record_read_thread_->GetStat(); }
+  const EventSetupStat& GetSetupStat() const { return setup_stat_; }
 
   // Stop profiling if all monitored processes/threads don't exist.
   bool StopWhenNoMoreTargets(
       double check_interval_in_sec = DEFAULT_PERIOD_TO_CHECK_MONITORED_TARGETS_IN_SEC);
 
   bool SetEnableEvents(bool enable);
+  // Scale the sample speed of sampling events at runtime. The new sample frequency is the one in
+  // event_attr multiplied by ratio, or the new sample period is the one in event_attr divided by
+  // ratio. Tracepoint events and counters added by AddCounters() aren't affected.
+  bool SetSampleSpeedRatio(double ratio);
 
  private:
   struct EventSelection {
@@ -193,7 +219,8 @@ class EventSelectionSet {
   bool BuildAndCheckEventSelection(const std::string& event_name, bool first_event,
                                    EventSelection* selection);
   void UnionSampleType();
-  bool OpenEventFilesOnGroup(EventSelectionGroup& group, pid_t tid, int cpu,
+  bool OpenEventFilesOnGroup(const EventSelectionGroup& group, pid_t tid, int cpu, int cgroup_fd,
+                             std::vector<std::unique_ptr<EventFd>>* event_fds,
                              std::string* failed_event_type);
   bool ApplyFilters();
   bool ApplyAddrFilters();
@@ -208,6 +235,7 @@ class EventSelectionSet {
   std::vector<EventSelectionGroup> groups_;
   std::set<pid_t> processes_;
   std::set<pid_t> threads_;
+  std::map<std::string, android::base::unique_fd> cgroups_;
 
   std::unique_ptr<IOEventLoop> loop_;
   std::function<bool(Record*)> record_callback_;
@@ -216,6 +244,7 @@ class EventSelectionSet {
 
   bool has_aux_trace_ = false;
   std::vector<AddrFilter> addr_filters_;
+  EventSetupStat setup_stat_;
 
   DISALLOW_COPY_AND_ASSIGN(EventSelectionSet);
 };
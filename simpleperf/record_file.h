@@ -70,6 +70,41 @@ struct DebugUnwindFile {
 
 using DebugUnwindFeature = std::vector<DebugUnwindFile>;
 
+struct TimeIndexEntry {
+  uint64_t time;
+  uint32_t cpu;
+  // offset of a record in the data section
+  uint64_t offset;
+};
+
+using TimeIndexFeature = std::vector<TimeIndexEntry>;
+
+// TimeIndexBuilder builds the time_index feature while records in the data section are visited
+// in file order. For each cpu, it adds an entry for the first record in each interval.
+class TimeIndexBuilder {
+ public:
+  TimeIndexBuilder(uint64_t interval_in_ns) : interval_in_ns_(interval_in_ns) {}
+
+  void AddRecord(const Record& record);
+  const TimeIndexFeature& GetTimeIndex() const { return time_index_; }
+
+ private:
+  const uint64_t interval_in_ns_;
+  // offset of the next record in the data section
+  uint64_t offset_ = 0;
+  // map from cpu to the time of the last entry
+  std::unordered_map<uint32_t, uint64_t> last_time_map_;
+  TimeIndexFeature time_index_;
+};
+
+struct AsyncWriteStat {
+  // the number of buffers handed to the writer thread
+  uint64_t buffer_count = 0;
+  // times the recording thread waited for a free buffer
+  uint64_t blocked_count = 0;
+  uint64_t blocked_time_in_ns = 0;
+};
+
 // RecordFileWriter writes to a perf record file, like perf.data.
 // User should call RecordFileWriter::Close() to finish writing the file, otherwise the file will
 // be removed in RecordFileWriter::~RecordFileWriter().
@@ -82,6 +117,13 @@ class RecordFileWriter {
   ~RecordFileWriter();
 
   bool WriteAttrSection(const EventAttrIds& attr_ids);
+  // Write the data section in a separate writer thread. Records are copied into buffer_count
+  // buffers of buffer_size bytes, and full buffers are handed to the writer thread. When all
+  // buffers are waiting to be written, WriteRecord() blocks until one of them is free.
+  // Async writing stops when the data section is finished, like in ReadDataSection() or
+  // BeginWriteFeatures().
+  bool EnableAsyncWrite(size_t buffer_size, size_t buffer_count = 2);
+  AsyncWriteStat GetAsyncWriteStat() const { return async_write_stat_; }
   bool WriteRecord(const Record& record);
   bool WriteData(const void* buf, size_t len);
 
@@ -98,6 +140,7 @@ class RecordFileWriter {
   bool WriteFileFeature(const FileFeature& file);
   bool WriteMetaInfoFeature(const std::unordered_map<std::string, std::string>& info_map);
   bool WriteDebugUnwindFeature(const DebugUnwindFeature& debug_unwind);
+  bool WriteTimeIndexFeature(const TimeIndexFeature& time_index);
   bool WriteFeature(int feature, const char* data, size_t size);
   bool EndWriteFeatures();
 
@@ -107,7 +150,10 @@ class RecordFileWriter {
   void GetHitModulesInBuffer(const char* p, const char* end,
                              std::vector<std::string>* hit_kernel_modules,
                              std::vector<std::string>* hit_user_files);
+  class AsyncWriter;
+
   bool WriteFileHeader();
+  bool FinishAsyncWrite();
   bool Write(const void* buf, size_t len);
   bool Read(void* buf, size_t len);
   bool GetFilePos(uint64_t* file_pos);
@@ -129,13 +175,20 @@ class RecordFileWriter {
   std::map<int, PerfFileFormat::SectionDesc> features_;
   size_t feature_count_;
 
+  std::unique_ptr<AsyncWriter> async_writer_;
+  AsyncWriteStat async_write_stat_;
+
   DISALLOW_COPY_AND_ASSIGN(RecordFileWriter);
 };
 
 // RecordFileReader read contents from a perf record file, like perf.data.
 class RecordFileReader {
  public:
-  static std::unique_ptr<RecordFileReader> CreateInstance(const std::string& filename);
+  // If use_recording_environment is false, the arch and event types of the recording aren't set
+  // as process globals. It is for reading multiple record files in parallel, where the caller sets
+  // the recording environment once.
+  static std::unique_ptr<RecordFileReader> CreateInstance(const std::string& filename,
+                                                          bool use_recording_environment = true);
 
   ~RecordFileReader();
 
@@ -167,6 +220,15 @@ class RecordFileReader {
   // Otherwise return false.
   bool ReadRecord(std::unique_ptr<Record>& record);
 
+  // Use the time_index feature to move the read position of ReadRecord() and ReadDataSection()
+  // to a place before all records with timestamps >= [time]. If [skipped_record_callback] is
+  // null, all records before that place are skipped, including mmap records of existing
+  // threads. Otherwise, sample records before that place are skipped without being parsed, and
+  // other records are passed to the callback. This needs the read position to be before that
+  // place.
+  bool SeekToTime(uint64_t time, const std::function<bool(std::unique_ptr<Record>)>&
+                                     skipped_record_callback = nullptr);
+
   size_t GetAttrIndexOfRecord(const Record* record);
 
   std::vector<std::string> ReadCmdlineFeature();
@@ -185,6 +247,7 @@ class RecordFileReader {
   const std::unordered_map<std::string, std::string>& GetMetaInfoFeature() { return meta_info_; }
   std::string GetClockId();
   std::optional<DebugUnwindFeature> ReadDebugUnwindFeature();
+  std::optional<TimeIndexFeature> ReadTimeIndexFeature();
 
   bool LoadBuildIdAndFileFeatures(ThreadTree& thread_tree);
 
@@ -85,6 +85,18 @@ file2 feature section (used to replace file feature section):
 
 etm_branch_list feature section:
   ETMBranchList etm_branch_list;  // from etm_branch_list.proto
+
+time_index feature section:
+  struct time_index_entry {
+    uint64_t time;
+    uint32_t cpu;
+    uint32_t reserved;
+    uint64_t offset;  // offset of a record in the data section
+  } entries[];
+
+  It is a sparse index of the data section. For each cpu, an entry is added for the first record
+  in each time interval. Records of a cpu are written in time order, so readers can start reading
+  from an entry to get all records of that cpu with timestamps >= entry.time.
 */
 
 namespace simpleperf {
@@ -120,6 +132,7 @@ enum {
   FEAT_DEBUG_UNWIND_FILE,
   FEAT_FILE2,
   FEAT_ETM_BRANCH_LIST,
+  FEAT_TIME_INDEX,
   FEAT_MAX_NUM = 256,
 };
 
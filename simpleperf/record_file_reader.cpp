@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <string.h>
 
+#include <algorithm>
 #include <set>
 #include <string_view>
 #include <vector>
@@ -61,6 +62,7 @@ static const std::map<int, std::string> feature_name_map = {
     {FEAT_DEBUG_UNWIND_FILE, "debug_unwind_file"},
     {FEAT_FILE2, "file2"},
     {FEAT_ETM_BRANCH_LIST, "etm_branch_list"},
+    {FEAT_TIME_INDEX, "time_index"},
 };
 
 std::string GetFeatureName(int feature_id) {
@@ -79,7 +81,8 @@ int GetFeatureId(const std::string& feature_name) {
 
 }  // namespace PerfFileFormat
 
-std::unique_ptr<RecordFileReader> RecordFileReader::CreateInstance(const std::string& filename) {
+std::unique_ptr<RecordFileReader> RecordFileReader::CreateInstance(const std::string& filename,
+                                                                   bool use_recording_environment) {
   std::string mode = std::string("rb") + CLOSE_ON_EXEC_MODE;
   FILE* fp = fopen(filename.c_str(), mode.c_str());
   if (fp == nullptr) {
@@ -91,7 +94,9 @@ std::unique_ptr<RecordFileReader> RecordFileReader::CreateInstance(const std::st
       !reader->ReadFeatureSectionDescriptors() || !reader->ReadMetaInfoFeature()) {
     return nullptr;
   }
-  reader->UseRecordingEnvironment();
+  if (use_recording_environment) {
+    reader->UseRecordingEnvironment();
+  }
   return reader;
 }
 
@@ -298,6 +303,67 @@ bool RecordFileReader::ReadRecord(std::unique_ptr<Record>& record) {
   return true;
 }
 
+bool RecordFileReader::SeekToTime(
+    uint64_t time, const std::function<bool(std::unique_ptr<Record>)>& skipped_record_callback) {
+  std::optional<TimeIndexFeature> time_index = ReadTimeIndexFeature();
+  if (!time_index) {
+    LOG(ERROR) << "no time index in " << filename_;
+    return false;
+  }
+  // For each cpu, start from the last entry with time <= [time]. If there isn't one, start from
+  // the first entry of that cpu.
+  std::unordered_map<uint32_t, uint64_t> cpu_offset_map;
+  for (const TimeIndexEntry& entry : time_index.value()) {
+    if (entry.time <= time || cpu_offset_map.count(entry.cpu) == 0) {
+      cpu_offset_map[entry.cpu] = entry.offset;
+    }
+  }
+  uint64_t offset = header_.data.size;
+  for (const auto& [cpu, cpu_offset] : cpu_offset_map) {
+    offset = std::min(offset, cpu_offset);
+  }
+  if (!skipped_record_callback) {
+    if (fseek(record_fp_, header_.data.offset + offset, SEEK_SET) != 0) {
+      PLOG(ERROR) << "fseek() failed";
+      return false;
+    }
+    read_record_size_ = offset;
+    return true;
+  }
+  if (read_record_size_ > offset) {
+    LOG(ERROR) << "can't seek backward to time " << time << " in " << filename_;
+    return false;
+  }
+  if (read_record_size_ == 0 && fseek(record_fp_, header_.data.offset, SEEK_SET) != 0) {
+    PLOG(ERROR) << "fseek() failed";
+    return false;
+  }
+  while (read_record_size_ < offset) {
+    char header_buf[Record::header_size()];
+    RecordHeader header;
+    if (!Read(header_buf, Record::header_size()) || !header.Parse(header_buf)) {
+      return false;
+    }
+    if (header.type == PERF_RECORD_SAMPLE) {
+      if (fseek(record_fp_, header.size - Record::header_size(), SEEK_CUR) != 0) {
+        PLOG(ERROR) << "fseek() failed";
+        return false;
+      }
+      read_record_size_ += header.size;
+      continue;
+    }
+    if (fseek(record_fp_, -static_cast<long>(Record::header_size()), SEEK_CUR) != 0) {
+      PLOG(ERROR) << "fseek() failed";
+      return false;
+    }
+    std::unique_ptr<Record> record;
+    if (!ReadRecord(record) || !record || !skipped_record_callback(std::move(record))) {
+      return false;
+    }
+  }
+  return true;
+}
+
 std::unique_ptr<Record> RecordFileReader::ReadRecord() {
   char header_buf[Record::header_size()];
   RecordHeader header;
@@ -735,6 +801,35 @@ std::optional<DebugUnwindFeature> RecordFileReader::ReadDebugUnwindFeature() {
   return std::nullopt;
 }
 
+std::optional<TimeIndexFeature> RecordFileReader::ReadTimeIndexFeature() {
+  if (!HasFeature(FEAT_TIME_INDEX)) {
+    return std::nullopt;
+  }
+  std::vector<char> buf;
+  if (!ReadFeatureSection(FEAT_TIME_INDEX, &buf)) {
+    return std::nullopt;
+  }
+  BinaryReader reader(buf.data(), buf.size());
+  TimeIndexFeature time_index;
+  while (!reader.error && reader.LeftSize() > 0u) {
+    TimeIndexEntry entry;
+    uint32_t reserved;
+    reader.Read(entry.time);
+    reader.Read(entry.cpu);
+    reader.Read(reserved);
+    reader.Read(entry.offset);
+    if (!reader.error && entry.offset >= header_.data.size) {
+      reader.error = true;
+    }
+    time_index.push_back(entry);
+  }
+  if (reader.error) {
+    LOG(ERROR) << "invalid time index in " << filename_;
+    return std::nullopt;
+  }
+  return time_index;
+}
+
 bool RecordFileReader::LoadBuildIdAndFileFeatures(ThreadTree& thread_tree) {
   std::vector<BuildIdRecord> records = ReadBuildIdFeature();
   std::vector<std::pair<std::string, BuildId>> build_ids;
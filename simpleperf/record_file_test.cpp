@@ -102,6 +102,34 @@ TEST_F(RecordFileTest, smoke) {
   ASSERT_TRUE(reader->Close());
 }
 
+TEST_F(RecordFileTest, async_write) {
+  std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(writer != nullptr);
+  AddEventType("cpu-cycles");
+  ASSERT_TRUE(writer->WriteAttrSection(attr_ids_));
+
+  // Use small buffers to test records crossing buffers and waiting for free buffers.
+  ASSERT_TRUE(writer->EnableAsyncWrite(64, 2));
+  std::vector<std::unique_ptr<Record>> records;
+  for (int i = 0; i < 100; i++) {
+    records.emplace_back(new MmapRecord(attr_ids_[0].attr, true, 1, 1, 0x1000 * i, 0x1000, 0,
+                                        "mmap_record_" + std::to_string(i), attr_ids_[0].ids[0]));
+    ASSERT_TRUE(writer->WriteRecord(*records.back()));
+  }
+  ASSERT_TRUE(writer->BeginWriteFeatures(0));
+  ASSERT_TRUE(writer->EndWriteFeatures());
+  ASSERT_TRUE(writer->Close());
+  ASSERT_GT(writer->GetAsyncWriteStat().buffer_count, 0u);
+
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(reader != nullptr);
+  std::vector<std::unique_ptr<Record>> read_records = reader->DataSection();
+  ASSERT_EQ(read_records.size(), records.size());
+  for (size_t i = 0; i < records.size(); i++) {
+    CheckRecordEqual(*records[i], *read_records[i]);
+  }
+}
+
 TEST_F(RecordFileTest, record_more_than_one_attr) {
   // Write to a record file.
   std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(tmpfile_.path);
@@ -254,4 +282,77 @@ TEST_F(RecordFileTest, write_file2_feature_section) {
   }
   ASSERT_FALSE(error);
   ASSERT_EQ(file_id, files.size());
-}
\ No newline at end of file
+}
+
+TEST_F(RecordFileTest, time_index_feature_section) {
+  std::unique_ptr<RecordFileWriter> writer = RecordFileWriter::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(writer != nullptr);
+  AddEventType("cpu-clock");
+  ASSERT_TRUE(writer->WriteAttrSection(attr_ids_));
+
+  // Write samples with timestamps 1 to 100, alternating between cpu 0 and 1.
+  TimeIndexBuilder builder(10);
+  MmapRecord mmap_record(attr_ids_[0].attr, true, 1, 1, 0x1000, 0x2000, 0x3000,
+                         "mmap_record_example", attr_ids_[0].ids[0]);
+  ASSERT_TRUE(writer->WriteRecord(mmap_record));
+  builder.AddRecord(mmap_record);
+  for (uint64_t time = 1; time <= 100; time++) {
+    SampleRecord r(attr_ids_[0].attr, attr_ids_[0].ids[0], 0x1000, 1, 1, time, time % 2, 1, {},
+                   {}, {}, 0);
+    ASSERT_TRUE(writer->WriteRecord(r));
+    builder.AddRecord(r);
+  }
+  ASSERT_TRUE(writer->BeginWriteFeatures(1));
+  ASSERT_TRUE(writer->WriteTimeIndexFeature(builder.GetTimeIndex()));
+  ASSERT_TRUE(writer->EndWriteFeatures());
+  ASSERT_TRUE(writer->Close());
+
+  std::unique_ptr<RecordFileReader> reader = RecordFileReader::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(reader != nullptr);
+  std::optional<TimeIndexFeature> time_index = reader->ReadTimeIndexFeature();
+  ASSERT_TRUE(time_index.has_value());
+  // Each cpu has an entry every 10 ns: 1, 11, ..., 91 for cpu 1 and 2, 12, ..., 92 for cpu 0.
+  ASSERT_EQ(time_index.value().size(), 20u);
+  for (const TimeIndexEntry& entry : time_index.value()) {
+    ASSERT_EQ(entry.time % 10, entry.cpu == 0 ? 2u : 1u);
+  }
+
+  // Seeking skips most records before the time, but keeps all records after it.
+  ASSERT_TRUE(reader->SeekToTime(50));
+  std::vector<uint64_t> times;
+  ASSERT_TRUE(reader->ReadDataSection([&](std::unique_ptr<Record> r) {
+    times.push_back(r->Timestamp());
+    return true;
+  }));
+  ASSERT_FALSE(times.empty());
+  ASSERT_LE(times.front(), 50u);
+  ASSERT_GT(times.front(), 40u);
+  ASSERT_EQ(times.back(), 100u);
+  ASSERT_EQ(times.size(), 100u - times.front() + 1);
+
+  // With a callback, non-sample records before the time are passed to it, and samples before
+  // the time are skipped.
+  reader = RecordFileReader::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(reader != nullptr);
+  std::vector<std::unique_ptr<Record>> skipped_records;
+  ASSERT_TRUE(reader->SeekToTime(50, [&](std::unique_ptr<Record> r) {
+    skipped_records.emplace_back(std::move(r));
+    return true;
+  }));
+  ASSERT_EQ(skipped_records.size(), 1u);
+  ASSERT_EQ(skipped_records[0]->type(), PERF_RECORD_MMAP);
+  std::unique_ptr<Record> record;
+  ASSERT_TRUE(reader->ReadRecord(record));
+  ASSERT_TRUE(record);
+  ASSERT_EQ(record->type(), PERF_RECORD_SAMPLE);
+  ASSERT_EQ(record->Timestamp(), times.front());
+
+  // Seeking fails without a time index.
+  writer = RecordFileWriter::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(writer != nullptr);
+  ASSERT_TRUE(writer->WriteAttrSection(attr_ids_));
+  ASSERT_TRUE(writer->Close());
+  reader = RecordFileReader::CreateInstance(tmpfile_.path);
+  ASSERT_TRUE(reader != nullptr);
+  ASSERT_FALSE(reader->SeekToTime(50));
+}
@@ -21,8 +21,13 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -40,6 +45,160 @@ namespace simpleperf {
 
 using namespace PerfFileFormat;
 
+// Writes data to the record file in a separate thread, using a fixed number of buffers.
+class RecordFileWriter::AsyncWriter {
+ public:
+  AsyncWriter(FILE* fp, const std::string& filename, size_t buffer_size, size_t buffer_count,
+              AsyncWriteStat& stat)
+      : fp_(fp), filename_(filename), buffer_size_(buffer_size), stat_(stat) {
+    buffers_.resize(buffer_count);
+    for (auto& buffer : buffers_) {
+      buffer.data.reset(new char[buffer_size]);
+      free_buffers_.push_back(&buffer);
+    }
+    thread_ = std::thread([this]() { WriteThreadMain(); });
+  }
+
+  ~AsyncWriter() { Finish(); }
+
+  bool Write(const void* buf, size_t len) {
+    const char* p = static_cast<const char*>(buf);
+    while (len > 0) {
+      if (current_ == nullptr && !GetFreeBuffer()) {
+        return false;
+      }
+      size_t n = std::min(len, buffer_size_ - current_->size);
+      memcpy(current_->data.get() + current_->size, p, n);
+      current_->size += n;
+      p += n;
+      len -= n;
+      if (current_->size == buffer_size_) {
+        SubmitBuffer();
+      }
+    }
+    return true;
+  }
+
+  // Write all buffered data and stop the writer thread.
+  bool Finish() {
+    if (!thread_.joinable()) {
+      return !failed_;
+    }
+    if (current_ != nullptr && current_->size > 0) {
+      SubmitBuffer();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+    return !failed_;
+  }
+
+ private:
+  struct Buffer {
+    std::unique_ptr<char[]> data;
+    size_t size = 0;
+  };
+
+  bool GetFreeBuffer() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (free_buffers_.empty() && !failed_) {
+      // All buffers are waiting to be written. Block the recording thread until the writer thread
+      // frees one.
+      auto start_time = std::chrono::steady_clock::now();
+      cond_.wait(lock, [this]() { return !free_buffers_.empty() || failed_; });
+      stat_.blocked_count++;
+      stat_.blocked_time_in_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                      std::chrono::steady_clock::now() - start_time)
+                                      .count();
+    }
+    if (failed_) {
+      return false;
+    }
+    current_ = free_buffers_.front();
+    free_buffers_.pop_front();
+    current_->size = 0;
+    return true;
+  }
+
+  void SubmitBuffer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      full_buffers_.push_back(current_);
+      stat_.buffer_count++;
+    }
+    current_ = nullptr;
+    cond_.notify_all();
+  }
+
+  void WriteThreadMain() {
+    while (true) {
+      Buffer* buffer;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this]() { return !full_buffers_.empty() || stop_; });
+        if (full_buffers_.empty()) {
+          return;
+        }
+        buffer = full_buffers_.front();
+        full_buffers_.pop_front();
+      }
+      bool result = failed_ || fwrite(buffer->data.get(), buffer->size, 1, fp_) == 1;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!result && !failed_) {
+          PLOG(ERROR) << "failed to write to record file '" << filename_ << "'";
+          failed_ = true;
+        }
+        free_buffers_.push_back(buffer);
+      }
+      cond_.notify_all();
+    }
+  }
+
+  FILE* fp_;
+  const std::string filename_;
+  const size_t buffer_size_;
+  AsyncWriteStat& stat_;
+  std::vector<Buffer> buffers_;
+  // Only accessed by the recording thread.
+  Buffer* current_ = nullptr;
+
+  // Protected by mutex_.
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<Buffer*> free_buffers_;
+  std::deque<Buffer*> full_buffers_;
+  bool stop_ = false;
+  bool failed_ = false;
+
+  std::thread thread_;
+};
+
+void TimeIndexBuilder::AddRecord(const Record& record) {
+  uint64_t offset = offset_;
+  offset_ += record.size();
+  if (record.type() == PERF_RECORD_AUXTRACE) {
+    offset_ += static_cast<const AuxTraceRecord&>(record).data->aux_size;
+  }
+  // Only kernel records have reliable timestamps and cpus.
+  if (record.type() >= PERF_RECORD_USER_DEFINED_TYPE_START) {
+    return;
+  }
+  uint64_t time = record.Timestamp();
+  if (time == 0) {
+    return;
+  }
+  uint32_t cpu = record.Cpu();
+  auto it = last_time_map_.find(cpu);
+  if (it == last_time_map_.end() || time >= it->second + interval_in_ns_) {
+    last_time_map_[cpu] = time;
+    time_index_.emplace_back(TimeIndexEntry{time, cpu, offset});
+  }
+}
+
 std::unique_ptr<RecordFileWriter> RecordFileWriter::CreateInstance(const std::string& filename) {
   // Remove old perf.data to avoid file ownership problems.
   std::string err;
@@ -68,6 +227,7 @@ RecordFileWriter::RecordFileWriter(const std::string& filename, FILE* fp, bool o
       feature_count_(0) {}
 
 RecordFileWriter::~RecordFileWriter() {
+  async_writer_.reset();
   if (record_fp_ != nullptr && own_fp_) {
     fclose(record_fp_);
     unlink(filename_.c_str());
@@ -125,6 +285,30 @@ bool RecordFileWriter::WriteAttrSection(const EventAttrIds& attr_ids) {
   return true;
 }
 
+bool RecordFileWriter::EnableAsyncWrite(size_t buffer_size, size_t buffer_count) {
+  if (buffer_size == 0 || buffer_count == 0) {
+    LOG(ERROR) << "invalid async write buffer size " << buffer_size << ", count " << buffer_count;
+    return false;
+  }
+  // Flush data written synchronously before, to keep the order of records.
+  if (fflush(record_fp_) != 0) {
+    PLOG(ERROR) << "failed to write to record file '" << filename_ << "'";
+    return false;
+  }
+  async_writer_.reset(
+      new AsyncWriter(record_fp_, filename_, buffer_size, buffer_count, async_write_stat_));
+  return true;
+}
+
+bool RecordFileWriter::FinishAsyncWrite() {
+  if (!async_writer_) {
+    return true;
+  }
+  bool result = async_writer_->Finish();
+  async_writer_.reset();
+  return result;
+}
+
 bool RecordFileWriter::WriteRecord(const Record& record) {
   // linux-tools-perf only accepts records with size <= 65535 bytes. To make
   // perf.data generated by simpleperf be able to be parsed by linux-tools-perf,
@@ -168,7 +352,11 @@ bool RecordFileWriter::WriteRecord(const Record& record) {
 }
 
 bool RecordFileWriter::WriteData(const void* buf, size_t len) {
-  if (!Write(buf, len)) {
+  if (async_writer_) {
+    if (!async_writer_->Write(buf, len)) {
+      return false;
+    }
+  } else if (!Write(buf, len)) {
     return false;
   }
   data_section_size_ += len;
@@ -192,6 +380,9 @@ bool RecordFileWriter::Read(void* buf, size_t len) {
 }
 
 bool RecordFileWriter::ReadDataSection(const std::function<void(const Record*)>& callback) {
+  if (!FinishAsyncWrite()) {
+    return false;
+  }
   if (fseek(record_fp_, data_section_offset_, SEEK_SET) == -1) {
     PLOG(ERROR) << "fseek() failed";
     return false;
@@ -241,6 +432,9 @@ bool RecordFileWriter::GetFilePos(uint64_t* file_pos) {
 }
 
 bool RecordFileWriter::BeginWriteFeatures(size_t feature_count) {
+  if (!FinishAsyncWrite()) {
+    return false;
+  }
   feature_section_offset_ = data_section_offset_ + data_section_size_;
   feature_count_ = feature_count;
   uint64_t feature_header_size = feature_count * sizeof(SectionDesc);
@@ -435,6 +629,19 @@ bool RecordFileWriter::WriteDebugUnwindFeature(const DebugUnwindFeature& debug_u
   return WriteFeature(FEAT_DEBUG_UNWIND, s.data(), s.size());
 }
 
+bool RecordFileWriter::WriteTimeIndexFeature(const TimeIndexFeature& time_index) {
+  std::vector<char> buf(time_index.size() * (sizeof(uint64_t) * 3));
+  char* p = buf.data();
+  for (const TimeIndexEntry& entry : time_index) {
+    uint32_t reserved = 0;
+    MoveToBinaryFormat(entry.time, p);
+    MoveToBinaryFormat(entry.cpu, p);
+    MoveToBinaryFormat(reserved, p);
+    MoveToBinaryFormat(entry.offset, p);
+  }
+  return WriteFeature(FEAT_TIME_INDEX, buf.data(), buf.size());
+}
+
 bool RecordFileWriter::WriteFeature(int feature, const char* data, size_t size) {
   return WriteFeatureBegin(feature) && Write(data, size) && WriteFeatureEnd(feature);
 }
@@ -507,7 +714,7 @@ bool RecordFileWriter::WriteFileHeader() {
 
 bool RecordFileWriter::Close() {
   CHECK(record_fp_ != nullptr);
-  bool result = true;
+  bool result = FinishAsyncWrite();
 
   // Write file header. We gather enough information to write file header only after
   // writing data section and feature section.
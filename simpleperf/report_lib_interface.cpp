@@ -14,9 +14,14 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <memory>
 #include <optional>
 #include <queue>
+#include <thread>
+#include <tuple>
+#include <unordered_set>
 #include <utility>
 
 #include <android-base/file.h>
@@ -28,6 +33,7 @@
 #include "dso.h"
 #include "event_attr.h"
 #include "event_type.h"
+#include "perf_regs.h"
 #include "record_file.h"
 #include "report_utils.h"
 #include "thread_tree.h"
@@ -97,6 +103,20 @@ struct FeatureSection {
   uint32_t data_size;
 };
 
+struct AggregatedSampleEntry {
+  uint32_t file_index;
+  const char* event_name;
+  const char* dso_name;
+  const char* symbol_name;
+  uint64_t sample_count;
+  uint64_t period;
+};
+
+struct AggregatedSamples {
+  uint32_t nr;
+  AggregatedSampleEntry* entries;
+};
+
 }  // extern "C"
 
 namespace simpleperf {
@@ -162,6 +182,289 @@ struct TraceOffCpuData {
   std::unordered_map<pid_t, std::unique_ptr<SampleRecord>> thread_map;
 };
 
+static bool ParseSampleFilter(const std::vector<std::string>& args, RecordFilter& record_filter) {
+  OptionFormatMap option_formats = GetRecordFilterOptionFormats(false);
+  OptionValueMap options;
+  std::vector<std::pair<OptionName, OptionValue>> ordered_options;
+  if (!ConvertArgsToOptions(args, option_formats, "", &options, &ordered_options, nullptr)) {
+    return false;
+  }
+  return record_filter.ParseOptions(options);
+}
+
+struct FileSampleEntry {
+  std::string event_name;
+  std::string dso_name;
+  std::string symbol_name;
+  uint64_t sample_count = 0;
+  uint64_t period = 0;
+};
+
+// The arch and event types of a recording. RecordFileReader sets them as process globals.
+struct RecordingEnvironment {
+  std::string arch;
+  std::string event_type_info;
+
+  bool operator==(const RecordingEnvironment& other) const {
+    return arch == other.arch && event_type_info == other.event_type_info;
+  }
+};
+
+// Set the recording environment in the current scope, like
+// RecordFileReader::UseRecordingEnvironment().
+class ScopedRecordingEnvironment {
+ public:
+  explicit ScopedRecordingEnvironment(const RecordingEnvironment& env) {
+    if (!env.arch.empty()) {
+      scoped_arch_.reset(new ScopedCurrentArch(GetArchType(env.arch)));
+    }
+    if (!env.event_type_info.empty() && EventTypeManager::Instance().GetScopedFinder() == nullptr) {
+      scoped_event_types_.reset(new ScopedEventTypes(env.event_type_info));
+    }
+  }
+
+ private:
+  std::unique_ptr<ScopedCurrentArch> scoped_arch_;
+  std::unique_ptr<ScopedEventTypes> scoped_event_types_;
+};
+
+// Dsos shared by FileSampleAggregators of all record files, so symbols of a dso hit in many files
+// are loaded once. An elf file is shared when all files mapping it recorded the same non-empty
+// build id for it. Kernel and kernel module dsos aren't shared, because their addresses depend
+// on the boot.
+class SharedDsos {
+ public:
+  explicit SharedDsos(bool show_ip_for_unknown_symbol) {
+    if (show_ip_for_unknown_symbol) {
+      thread_tree_.ShowIpForUnknownSymbol();
+    }
+  }
+
+  static bool CanBeShared(DsoType dso_type, const std::string& path) {
+    return dso_type == DSO_ELF_FILE && !JITDebugReader::IsPathInJITSymFile(path);
+  }
+
+  // Called for each elf file mapped by a record file, with the build id recorded in that file.
+  void AddMappedFile(const std::string& path, const BuildId& build_id) {
+    if (build_id.IsEmpty()) {
+      conflicting_paths_.insert(path);
+      return;
+    }
+    auto [it, inserted] = build_ids_.emplace(path, build_id);
+    if (!inserted && it->second != build_id) {
+      conflicting_paths_.insert(path);
+    }
+  }
+
+  // Should be called after AddMappedFile() is called for all record files.
+  bool IsShared(const std::string& path) const {
+    return build_ids_.count(path) != 0 && conflicting_paths_.count(path) == 0;
+  }
+
+  bool AddDsoInfo(FileFeature& file) {
+    // Files with the same build id have the same dso info.
+    if (!paths_with_info_.insert(file.path).second) {
+      return true;
+    }
+    return thread_tree_.AddDsoInfo(file);
+  }
+
+  // Return nullptr if the map isn't for a shared dso.
+  const Symbol* FindSymbol(const MapEntry* map, uint64_t ip, Dso** pdso) {
+    if ((map->flags & map_flags::PROT_JIT_SYMFILE_MAP) ||
+        !CanBeShared(map->dso->type(), map->dso->Path()) || !IsShared(map->dso->Path())) {
+      return nullptr;
+    }
+    MapEntry shared_map = *map;
+    shared_map.dso = thread_tree_.FindUserDsoOrNew(map->dso->Path(), map->start_addr);
+    return thread_tree_.FindSymbol(&shared_map, ip, nullptr, pdso);
+  }
+
+ private:
+  // Only used to own dsos and find symbols in them.
+  ThreadTree thread_tree_;
+  std::unordered_map<std::string, BuildId> build_ids_;
+  std::unordered_set<std::string> conflicting_paths_;
+  std::unordered_set<std::string> paths_with_info_;
+};
+
+// Aggregate samples in a record file by event, dso and symbol. Dso and Symbol use global states
+// (like the build id map, the debug file finder and the symbol name allocator), so only
+// ReadSamples() can run in parallel with other aggregators. It uses the aggregator's own reader
+// and ThreadTree, and aggregates samples by map and ip without finding symbols. Other methods
+// run on the calling thread.
+class FileSampleAggregator {
+ public:
+  explicit FileSampleAggregator(const std::string& filename) : filename_(filename) {}
+
+  const std::string& Filename() const { return filename_; }
+  const RecordingEnvironment& GetRecordingEnvironment() const { return env_; }
+
+  bool OpenReader() {
+    reader_ = RecordFileReader::CreateInstance(filename_, false);
+    if (!reader_) {
+      return false;
+    }
+    env_.arch = reader_->ReadFeatureString(PerfFileFormat::FEAT_ARCH);
+    auto& meta_info = reader_->GetMetaInfoFeature();
+    if (auto it = meta_info.find("event_type_info"); it != meta_info.end()) {
+      env_.event_type_info = it->second;
+    }
+    for (auto& r : reader_->ReadBuildIdFeature()) {
+      build_ids_.emplace_back(r.filename, r.build_id);
+      build_id_map_[r.filename] = r.build_id;
+    }
+    return true;
+  }
+
+  // Should be called with the recording environment of the file.
+  bool Prepare(const std::vector<std::string>& filter_args, bool show_ip_for_unknown_symbol) {
+    Dso::SetBuildIds(build_ids_);
+    thread_tree_.reset(new ThreadTree);
+    if (show_ip_for_unknown_symbol) {
+      thread_tree_->ShowIpForUnknownSymbol();
+    }
+    // Creating the kernel dso finds its debug file, so don't leave it to ReadSamples().
+    thread_tree_->FindKernelDsoOrNew();
+    auto file_feature = std::make_unique<FileFeature>();
+    uint64_t read_pos = 0;
+    bool error = false;
+    while (reader_->ReadFileFeature(read_pos, *file_feature, error)) {
+      if (SharedDsos::CanBeShared(file_feature->type, file_feature->path) &&
+          !FindBuildId(file_feature->path).IsEmpty()) {
+        // Whether the dso is shared isn't known until all files are read. So create the dso as
+        // it would be created with the dso info, and delay adding the info to Symbolize().
+        thread_tree_->FindUserDsoOrNew(file_feature->path, 0, file_feature->type);
+        delayed_file_features_.emplace_back(std::move(file_feature));
+        file_feature = std::make_unique<FileFeature>();
+      } else if (!thread_tree_->AddDsoInfo(*file_feature)) {
+        return false;
+      }
+    }
+    if (error) {
+      return false;
+    }
+    record_filter_.reset(new RecordFilter(*thread_tree_));
+    if (!filter_args.empty() && !ParseSampleFilter(filter_args, *record_filter_)) {
+      return false;
+    }
+    if (!record_filter_->CheckClock(reader_->GetClockId())) {
+      LOG(ERROR) << "Recording file " << filename_ << " doesn't match the clock of filter.";
+      return false;
+    }
+    for (const auto& attr_id : reader_->AttrSection()) {
+      event_names_.emplace_back(GetEventNameByAttr(attr_id.attr));
+    }
+    return true;
+  }
+
+  bool ReadSamples() {
+    std::unique_ptr<Record> record;
+    while (true) {
+      if (!reader_->ReadRecord(record)) {
+        return false;
+      }
+      if (record == nullptr) {
+        break;
+      }
+      if (record->type() == SIMPLE_PERF_RECORD_KERNEL_SYMBOL) {
+        // Dso::SetKallsyms() changes a global state, so delay it to Symbolize().
+        auto r = static_cast<const KernelSymbolRecord*>(record.get());
+        kallsyms_.assign(r->kallsyms, r->kallsyms_size);
+        continue;
+      }
+      if (record->type() != PERF_RECORD_SAMPLE) {
+        thread_tree_->Update(*record);
+        continue;
+      }
+      auto sample = static_cast<SampleRecord*>(record.get());
+      if (!record_filter_->Check(sample)) {
+        continue;
+      }
+      const ThreadEntry* thread =
+          thread_tree_->FindThreadOrNew(sample->tid_data.pid, sample->tid_data.tid);
+      const MapEntry* map = thread_tree_->FindMap(thread, sample->ip_data.ip, sample->InKernel());
+      size_t attr_index = reader_->GetAttrIndexOfRecord(sample);
+      auto& value = sample_map_[std::make_tuple(attr_index, map, sample->ip_data.ip)];
+      value.first++;
+      value.second += sample->period_data.period;
+    }
+    reader_.reset();
+    return true;
+  }
+
+  void AddMappedFiles(SharedDsos& shared_dsos) {
+    std::unordered_set<const Dso*> dsos;
+    for (const auto& [key, value] : sample_map_) {
+      const Dso* dso = std::get<1>(key)->dso;
+      if (SharedDsos::CanBeShared(dso->type(), dso->Path()) && dsos.insert(dso).second) {
+        shared_dsos.AddMappedFile(dso->Path(), FindBuildId(dso->Path()));
+      }
+    }
+  }
+
+  // Should be called after AddMappedFiles() is called for all aggregators.
+  bool Symbolize(SharedDsos& shared_dsos, std::vector<FileSampleEntry>& entries) {
+    Dso::SetBuildIds(build_ids_);
+    if (!kallsyms_.empty()) {
+      Dso::SetKallsyms(std::move(kallsyms_));
+    }
+    for (auto& file_feature : delayed_file_features_) {
+      bool result = shared_dsos.IsShared(file_feature->path)
+                        ? shared_dsos.AddDsoInfo(*file_feature)
+                        : thread_tree_->AddDsoInfo(*file_feature);
+      if (!result) {
+        return false;
+      }
+    }
+    delayed_file_features_.clear();
+    // Key: (attr index, dso, symbol), value: (sample count, period).
+    std::map<std::tuple<size_t, const Dso*, const Symbol*>, std::pair<uint64_t, uint64_t>>
+        symbol_map;
+    for (const auto& [key, value] : sample_map_) {
+      const MapEntry* map = std::get<1>(key);
+      uint64_t ip = std::get<2>(key);
+      Dso* dso;
+      const Symbol* symbol = shared_dsos.FindSymbol(map, ip, &dso);
+      if (symbol == nullptr) {
+        symbol = thread_tree_->FindSymbol(map, ip, nullptr, &dso);
+      }
+      auto& symbol_value = symbol_map[std::make_tuple(std::get<0>(key), dso, symbol)];
+      symbol_value.first += value.first;
+      symbol_value.second += value.second;
+    }
+    for (const auto& [key, value] : symbol_map) {
+      FileSampleEntry& entry = entries.emplace_back();
+      entry.event_name = event_names_[std::get<0>(key)];
+      entry.dso_name = std::get<1>(key)->GetReportPath();
+      entry.symbol_name = std::get<2>(key)->DemangledName();
+      entry.sample_count = value.first;
+      entry.period = value.second;
+    }
+    return true;
+  }
+
+ private:
+  BuildId FindBuildId(const std::string& path) const {
+    auto it = build_id_map_.find(path);
+    return it != build_id_map_.end() ? it->second : BuildId();
+  }
+
+  const std::string filename_;
+  RecordingEnvironment env_;
+  std::vector<std::pair<std::string, BuildId>> build_ids_;
+  std::unordered_map<std::string, BuildId> build_id_map_;
+  std::unique_ptr<RecordFileReader> reader_;
+  std::unique_ptr<ThreadTree> thread_tree_;
+  std::unique_ptr<RecordFilter> record_filter_;
+  std::vector<std::string> event_names_;
+  std::vector<std::unique_ptr<FileFeature>> delayed_file_features_;
+  std::string kallsyms_;
+  // Key: (attr index, map, ip), value: (sample count, period).
+  std::map<std::tuple<size_t, const MapEntry*, uint64_t>, std::pair<uint64_t, uint64_t>>
+      sample_map_;
+};
+
 }  // namespace
 
 class ReportLib {
@@ -188,7 +491,10 @@ class ReportLib {
 
   bool SetKallsymsFile(const char* kallsyms_file);
 
-  void ShowIpForUnknownSymbol() { thread_tree_.ShowIpForUnknownSymbol(); }
+  void ShowIpForUnknownSymbol() {
+    thread_tree_.ShowIpForUnknownSymbol();
+    show_ip_for_unknown_symbol_ = true;
+  }
   void ShowArtFrames(bool show) {
     bool remove_art_frame = !show;
     callchain_report_builder_.SetRemoveArtFrame(remove_art_frame);
@@ -211,9 +517,13 @@ class ReportLib {
   const char* GetBuildIdForPath(const char* path);
   FeatureSection* GetFeatureSection(const char* feature_name);
 
+  AggregatedSamples* AggregateSamplesInRecordFiles(const char** record_files,
+                                                   int record_files_len, int jobs);
+
  private:
   void ProcessSampleRecord(std::unique_ptr<Record> r);
   void ProcessSwitchRecord(std::unique_ptr<Record> r);
+  bool ProcessTracingDataRecord(const Record& record);
   void AddSampleRecordToQueue(SampleRecord* r);
   void SetCurrentSample(const SampleRecord& r);
   const EventInfo* FindEventOfCurrentSample();
@@ -244,6 +554,11 @@ class ReportLib {
   ThreadReportBuilder thread_report_builder_;
   std::unique_ptr<Tracing> tracing_;
   RecordFilter record_filter_;
+  std::vector<std::string> sample_filter_args_;
+  bool show_ip_for_unknown_symbol_ = false;
+  std::vector<AggregatedSampleEntry> aggregated_entries_;
+  std::unordered_set<std::string> aggregated_strings_;
+  AggregatedSamples aggregated_samples_;
 };
 
 bool ReportLib::SetLogSeverity(const char* log_level) {
@@ -303,13 +618,12 @@ bool ReportLib::SetSampleFilter(const char** filters, int filters_len) {
   for (int i = 0; i < filters_len; i++) {
     args.emplace_back(filters[i]);
   }
-  OptionFormatMap option_formats = GetRecordFilterOptionFormats(false);
-  OptionValueMap options;
-  std::vector<std::pair<OptionName, OptionValue>> ordered_options;
-  if (!ConvertArgsToOptions(args, option_formats, "", &options, &ordered_options, nullptr)) {
+  if (!ParseSampleFilter(args, record_filter_)) {
     return false;
   }
-  return record_filter_.ParseOptions(options);
+  // Keep the options to filter samples in AggregateSamplesInRecordFiles().
+  sample_filter_args_.insert(sample_filter_args_.end(), args.begin(), args.end());
+  return true;
 }
 
 bool ReportLib::AggregateThreads(const char** thread_name_regex, int thread_name_regex_len) {
@@ -349,6 +663,18 @@ bool ReportLib::OpenRecordFileIfNecessary() {
       LOG(ERROR) << "Recording file " << record_filename_ << " doesn't match the clock of filter.";
       return false;
     }
+    // If the filter file starts after the beginning of the recording, use the time index to skip
+    // samples before it. Other records are still needed to build the thread tree.
+    if (auto start_time = record_filter_.GetStartTime();
+        start_time && record_file_reader_->HasFeature(PerfFileFormat::FEAT_TIME_INDEX)) {
+      auto callback = [this](std::unique_ptr<Record> r) {
+        thread_tree_.Update(*r);
+        return ProcessTracingDataRecord(*r);
+      };
+      if (!record_file_reader_->SeekToTime(start_time.value(), callback)) {
+        return false;
+      }
+    }
   }
   return true;
 }
@@ -371,19 +697,26 @@ Sample* ReportLib::GetNextSample() {
     } else if (record->type() == PERF_RECORD_SWITCH ||
                record->type() == PERF_RECORD_SWITCH_CPU_WIDE) {
       ProcessSwitchRecord(std::move(record));
-    } else if (record->type() == PERF_RECORD_TRACING_DATA ||
-               record->type() == SIMPLE_PERF_RECORD_TRACING_DATA) {
-      const auto& r = *static_cast<TracingDataRecord*>(record.get());
-      tracing_ = Tracing::Create(std::vector<char>(r.data, r.data + r.data_size));
-      if (!tracing_) {
-        return nullptr;
-      }
+    } else if (!ProcessTracingDataRecord(*record)) {
+      return nullptr;
     }
   }
   SetCurrentSample(*sample_record_queue_.front());
   return &current_sample_;
 }
 
+bool ReportLib::ProcessTracingDataRecord(const Record& record) {
+  if (record.type() == PERF_RECORD_TRACING_DATA ||
+      record.type() == SIMPLE_PERF_RECORD_TRACING_DATA) {
+    const auto& r = static_cast<const TracingDataRecord&>(record);
+    tracing_ = Tracing::Create(std::vector<char>(r.data, r.data + r.data_size));
+    if (!tracing_) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void ReportLib::ProcessSampleRecord(std::unique_ptr<Record> r) {
   auto sr = static_cast<SampleRecord*>(r.get());
   if (!trace_offcpu_.mode) {
@@ -589,6 +922,124 @@ FeatureSection* ReportLib::GetFeatureSection(const char* feature_name) {
   return &feature_section_;
 }
 
+AggregatedSamples* ReportLib::AggregateSamplesInRecordFiles(const char** record_files,
+                                                             int record_files_len, int jobs) {
+  if (jobs <= 0) {
+    jobs = std::max(1u, std::thread::hardware_concurrency());
+  }
+  jobs = std::min(jobs, std::max(record_files_len, 1));
+
+  SharedDsos shared_dsos(show_ip_for_unknown_symbol_);
+  std::vector<std::unique_ptr<FileSampleAggregator>> aggregators;
+  for (int i = 0; i < record_files_len; i++) {
+    auto& aggregator = aggregators.emplace_back(new FileSampleAggregator(record_files[i]));
+    if (!aggregator->OpenReader()) {
+      return nullptr;
+    }
+  }
+  // The recording environment is a process global. So it is set once for all files, or files
+  // with different environments are read one by one.
+  bool same_env = std::all_of(aggregators.begin(), aggregators.end(), [&](const auto& aggregator) {
+    return aggregator->GetRecordingEnvironment() == aggregators[0]->GetRecordingEnvironment();
+  });
+  std::unique_ptr<ScopedRecordingEnvironment> scoped_env;
+  if (same_env && !aggregators.empty()) {
+    scoped_env.reset(new ScopedRecordingEnvironment(aggregators[0]->GetRecordingEnvironment()));
+  } else if (jobs > 1) {
+    LOG(WARNING) << "Record files have different archs or event types, read them in one thread.";
+    jobs = 1;
+  }
+  auto prepare = [&](FileSampleAggregator& aggregator) {
+    return aggregator.Prepare(sample_filter_args_, show_ip_for_unknown_symbol_);
+  };
+  if (jobs == 1) {
+    for (auto& aggregator : aggregators) {
+      std::unique_ptr<ScopedRecordingEnvironment> file_env;
+      if (!same_env) {
+        file_env.reset(new ScopedRecordingEnvironment(aggregator->GetRecordingEnvironment()));
+      }
+      if (!prepare(*aggregator) || !aggregator->ReadSamples()) {
+        LOG(ERROR) << "failed to aggregate samples in " << aggregator->Filename();
+        return nullptr;
+      }
+    }
+  } else {
+    for (auto& aggregator : aggregators) {
+      if (!prepare(*aggregator)) {
+        LOG(ERROR) << "failed to aggregate samples in " << aggregator->Filename();
+        return nullptr;
+      }
+    }
+    std::atomic<size_t> next_file = 0;
+    std::atomic<bool> failed = false;
+    auto worker = [&]() {
+      while (!failed) {
+        size_t i = next_file++;
+        if (i >= aggregators.size()) {
+          break;
+        }
+        if (!aggregators[i]->ReadSamples()) {
+          LOG(ERROR) << "failed to aggregate samples in " << aggregators[i]->Filename();
+          failed = true;
+        }
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int i = 1; i < jobs; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    if (failed) {
+      return nullptr;
+    }
+  }
+
+  std::vector<std::vector<FileSampleEntry>> file_entries(aggregators.size());
+  for (auto& aggregator : aggregators) {
+    aggregator->AddMappedFiles(shared_dsos);
+  }
+  for (size_t i = 0; i < aggregators.size(); i++) {
+    if (!aggregators[i]->Symbolize(shared_dsos, file_entries[i])) {
+      LOG(ERROR) << "failed to aggregate samples in " << aggregators[i]->Filename();
+      return nullptr;
+    }
+  }
+  if (record_file_reader_) {
+    // Symbolize() changed the global build id map. Restore it for the record file of the instance.
+    std::vector<std::pair<std::string, BuildId>> build_ids;
+    for (auto& r : record_file_reader_->ReadBuildIdFeature()) {
+      build_ids.emplace_back(r.filename, r.build_id);
+    }
+    Dso::SetBuildIds(build_ids);
+  }
+
+  aggregated_entries_.clear();
+  aggregated_strings_.clear();
+  auto get_str = [&](const std::string& s) { return aggregated_strings_.insert(s).first->c_str(); };
+  for (size_t i = 0; i < file_entries.size(); i++) {
+    std::vector<FileSampleEntry>& entries = file_entries[i];
+    std::sort(entries.begin(), entries.end(),
+              [](const FileSampleEntry& e1, const FileSampleEntry& e2) {
+                return e1.period > e2.period;
+              });
+    for (const FileSampleEntry& entry : entries) {
+      AggregatedSampleEntry& aggregated_entry = aggregated_entries_.emplace_back();
+      aggregated_entry.file_index = i;
+      aggregated_entry.event_name = get_str(entry.event_name);
+      aggregated_entry.dso_name = get_str(entry.dso_name);
+      aggregated_entry.symbol_name = get_str(entry.symbol_name);
+      aggregated_entry.sample_count = entry.sample_count;
+      aggregated_entry.period = entry.period;
+    }
+  }
+  aggregated_samples_.nr = aggregated_entries_.size();
+  aggregated_samples_.entries = aggregated_entries_.data();
+  return &aggregated_samples_;
+}
+
 }  // namespace simpleperf
 
 using ReportLib = simpleperf::ReportLib;
@@ -626,6 +1077,13 @@ const char* GetTracingDataOfCurrentSample(ReportLib* report_lib) EXPORT;
 
 const char* GetBuildIdForPath(ReportLib* report_lib, const char* path) EXPORT;
 FeatureSection* GetFeatureSection(ReportLib* report_lib, const char* feature_name) EXPORT;
+
+// Read record files in [jobs] threads, and aggregate samples in each file by event, dso and
+// symbol. If jobs <= 0, use one thread per cpu. Files with different archs or event types are
+// read in one thread. Sample filters and ShowIpForUnknownSymbol() set on the instance are
+// applied. The result is valid until the next call.
+AggregatedSamples* AggregateSamplesInRecordFiles(ReportLib* report_lib, const char** record_files,
+                                                 int record_files_len, int jobs) EXPORT;
 }
 
 // Exported methods working with a client created instance
@@ -713,3 +1171,8 @@ const char* GetBuildIdForPath(ReportLib* report_lib, const char* path) {
 FeatureSection* GetFeatureSection(ReportLib* report_lib, const char* feature_name) {
   return report_lib->GetFeatureSection(feature_name);
 }
+
+AggregatedSamples* AggregateSamplesInRecordFiles(ReportLib* report_lib, const char** record_files,
+                                                 int record_files_len, int jobs) {
+  return report_lib->AggregateSamplesInRecordFiles(record_files, record_files_len, jobs);
+}
@@ -233,6 +233,40 @@ class FeatureSectionStructure(ct.Structure):
                 ('data_size', ct.c_uint32)]
 
 
+class AggregatedSampleEntryStructure(ct.Structure):
+    """ Samples of a symbol in a record file, aggregated by AggregateSamplesInRecordFiles().
+        file_index: index of the record file in the record file list.
+        event_name: name of the event generating the samples.
+        dso_name: path of the shared library containing the symbol.
+        symbol_name: name of the function hit by the samples.
+        sample_count: number of samples.
+        period: sum of periods of the samples.
+    """
+    _fields_ = [('file_index', ct.c_uint32),
+                ('_event_name', ct.c_char_p),
+                ('_dso_name', ct.c_char_p),
+                ('_symbol_name', ct.c_char_p),
+                ('sample_count', ct.c_uint64),
+                ('period', ct.c_uint64)]
+
+    @property
+    def event_name(self) -> str:
+        return _char_pt_to_str(self._event_name)
+
+    @property
+    def dso_name(self) -> str:
+        return _char_pt_to_str(self._dso_name)
+
+    @property
+    def symbol_name(self) -> str:
+        return _char_pt_to_str(self._symbol_name)
+
+
+class AggregatedSamplesStructure(ct.Structure):
+    _fields_ = [('nr', ct.c_uint32),
+                ('entries', ct.POINTER(AggregatedSampleEntryStructure))]
+
+
 class ReportLibStructure(ct.Structure):
     _fields_ = []
 
@@ -280,6 +314,8 @@ class ReportLib(object):
         self._GetBuildIdForPathFunc.restype = ct.c_char_p
         self._GetFeatureSection = self._lib.GetFeatureSection
         self._GetFeatureSection.restype = ct.POINTER(FeatureSectionStructure)
+        self._AggregateSamplesInRecordFilesFunc = self._lib.AggregateSamplesInRecordFiles
+        self._AggregateSamplesInRecordFilesFunc.restype = ct.POINTER(AggregatedSamplesStructure)
         self._instance = self._CreateReportLibFunc()
         assert not _is_null(self._instance)
 
@@ -458,6 +494,24 @@ class ReportLib(object):
         assert not _is_null(build_id)
         return _char_pt_to_str(build_id)
 
+    def AggregateSamplesInRecordFiles(
+            self, record_files: List[str],
+            jobs: int = 0) -> List[AggregatedSampleEntryStructure]:
+        """ Read record files in parallel, and aggregate samples in each file by event, dso and
+            symbol. Each file is read with its own thread tree, so it doesn't need SetRecordFile().
+            Sample filters and ShowIpForUnknownSymbol() set before are applied. Files recorded
+            with different archs or event types are read one by one.
+            jobs: number of threads to read files. If jobs <= 0, use one thread per cpu.
+            Return a list of entries, each tagged with the index of its file in record_files.
+        """
+        file_array = (ct.c_char_p * len(record_files))()
+        file_array[:] = [_char_pt(f) for f in record_files]
+        result = self._AggregateSamplesInRecordFilesFunc(
+            self.getInstance(), file_array, len(record_files), jobs)
+        _check(not _is_null(result),
+               f'Failed to call AggregateSamplesInRecordFiles({record_files})')
+        return [result[0].entries[i] for i in range(result[0].nr)]
+
     def GetRecordCmd(self) -> str:
         if self.record_cmd is not None:
             return self.record_cmd
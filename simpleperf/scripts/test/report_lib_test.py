@@ -14,9 +14,11 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+import logging
 import os
 import tempfile
-from typing import Dict, List, Optional, Set
+import time
+from typing import Dict, List, Optional, Set, Tuple
 
 from simpleperf_report_lib import ReportLib
 from . test_utils import TestBase, TestHelper
@@ -332,3 +334,71 @@ class TestReportLib(TestBase):
         self.assertEqual(thread_names['AsyncTask.*'], 19)
         self.assertNotIn('AsyncTask #3', thread_names)
         self.assertNotIn('AsyncTask #4', thread_names)
+
+    def get_aggregated_samples(
+            self, record_file: str) -> Dict[Tuple[str, str, str], Tuple[int, int]]:
+        report_lib = ReportLib()
+        report_lib.SetRecordFile(record_file)
+        samples = {}
+        while report_lib.GetNextSample():
+            sample = report_lib.GetCurrentSample()
+            event = report_lib.GetEventOfCurrentSample()
+            symbol = report_lib.GetSymbolOfCurrentSample()
+            key = (event.name, symbol.dso_name, symbol.symbol_name)
+            count, period = samples.get(key, (0, 0))
+            samples[key] = (count + 1, period + sample.period)
+        report_lib.Close()
+        return samples
+
+    def aggregate_samples_in_record_files(
+            self, record_files: List[str],
+            jobs: int) -> List[Dict[Tuple[str, str, str], Tuple[int, int]]]:
+        result = [{} for _ in record_files]
+        for entry in self.report_lib.AggregateSamplesInRecordFiles(record_files, jobs):
+            key = (entry.event_name, entry.dso_name, entry.symbol_name)
+            result[entry.file_index][key] = (entry.sample_count, entry.period)
+        return result
+
+    def test_aggregate_samples_in_record_files(self):
+        """ Test using ReportLib.AggregateSamplesInRecordFiles(). """
+        record_files = [TestHelper.testdata_path('perf_with_symbols.data'),
+                        TestHelper.testdata_path('perf.data')]
+        result = self.aggregate_samples_in_record_files(record_files, 2)
+        for file_index, record_file in enumerate(record_files):
+            self.assertEqual(result[file_index], self.get_aggregated_samples(record_file))
+
+    def test_aggregate_samples_in_many_record_files(self):
+        """ Reading files sharing dsos in parallel gets the same result as reading them one by
+            one.
+        """
+        names = ['perf_with_symbols.data', 'perf.data', 'perf_with_kernel_symbol.data',
+                 'perf_with_two_event_types.data']
+        record_files = [TestHelper.testdata_path(name) for name in names] * 4
+        start_time = time.time()
+        result = self.aggregate_samples_in_record_files(record_files, 1)
+        sequential_time = time.time() - start_time
+        for file_index, record_file in enumerate(record_files[:len(names)]):
+            self.assertEqual(result[file_index], self.get_aggregated_samples(record_file))
+        for file_index in range(len(names), len(record_files)):
+            self.assertEqual(result[file_index], result[file_index % len(names)])
+
+        start_time = time.time()
+        self.assertEqual(self.aggregate_samples_in_record_files(record_files, 4), result)
+        parallel_time = time.time() - start_time
+        logging.info('aggregate samples in %d files: %.3fs with 1 job, %.3fs with 4 jobs',
+                     len(record_files), sequential_time, parallel_time)
+
+        # /vendor/lib64/egl/libGLESv2_adreno.so has no build id and different dumped symbols in
+        # the two files, so it isn't shared.
+        record_files = [TestHelper.testdata_path('perf_with_interpreter_frames.data'),
+                        TestHelper.testdata_path('perf_with_kernel_symbols_available_false.data')]
+        result = self.aggregate_samples_in_record_files(record_files, 2)
+        for file_index, record_file in enumerate(record_files):
+            self.assertEqual(result[file_index], self.get_aggregated_samples(record_file))
+
+        # Files with different archs are read one by one.
+        record_files = [TestHelper.testdata_path('perf_with_arm_regs.data'),
+                        TestHelper.testdata_path('perf.data')]
+        result = self.aggregate_samples_in_record_files(record_files, 2)
+        for file_index, record_file in enumerate(record_files):
+            self.assertEqual(result[file_index], self.get_aggregated_samples(record_file))
@@ -141,10 +141,10 @@ class ThreadTree {
   std::vector<Dso*> GetAllDsos() const;
   Dso* FindUserDsoOrNew(const std::string& filename, uint64_t start_addr = 0,
                         DsoType dso_type = DSO_ELF_FILE);
+  Dso* FindKernelDsoOrNew();
 
  private:
   ThreadEntry* CreateThread(int pid, int tid);
-  Dso* FindKernelDsoOrNew();
   Dso* FindKernelModuleDsoOrNew(const std::string& filename, uint64_t memory_start,
                                 uint64_t memory_end);
 
@@ -26,8 +26,10 @@
 #include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <string>
+#include <thread>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
@@ -498,4 +500,24 @@ void OverflowSafeAdd(uint64_t& dest, uint64_t add) {
   }
 }
 
+void RunInParallel(size_t count, size_t min_tasks_per_job,
+                   const std::function<void(size_t)>& task) {
+  size_t jobs = std::max<size_t>(1, count / std::max<size_t>(1, min_tasks_per_job));
+  jobs = std::min<size_t>(jobs, std::max(1u, std::thread::hardware_concurrency()));
+  std::atomic<size_t> next_task = 0;
+  auto worker = [&]() {
+    for (size_t i = next_task++; i < count; i = next_task++) {
+      task(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < jobs; i++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
 }  // namespace simpleperf
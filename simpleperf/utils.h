@@ -290,6 +290,10 @@ struct OverflowResult {
 OverflowResult SafeAdd(uint64_t a, uint64_t b);
 void OverflowSafeAdd(uint64_t& dest, uint64_t add);
 
+// Calls task(i) for each i in [0, count). Uses one thread per min_tasks_per_job tasks, up to the
+// number of cpus, and the calling thread is one of them. Tasks are handed out in index order.
+void RunInParallel(size_t count, size_t min_tasks_per_job, const std::function<void(size_t)>& task);
+
 }  // namespace simpleperf
 
 #endif  // SIMPLE_PERF_UTILS_H_
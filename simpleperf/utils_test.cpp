@@ -18,6 +18,8 @@
 
 #include <gtest/gtest.h>
 
+#include <atomic>
+
 #include <android-base/file.h>
 
 #include "environment.h"
@@ -105,3 +107,13 @@ TEST(utils, LineReader) {
   ASSERT_EQ(*line, "line2");
   ASSERT_TRUE(reader.ReadLine() == nullptr);
 }
+
+TEST(utils, RunInParallel) {
+  for (size_t count : {0, 1, 1000}) {
+    std::vector<std::atomic<int>> calls(count);
+    RunInParallel(count, 10, [&](size_t i) { calls[i]++; });
+    for (size_t i = 0; i < count; i++) {
+      ASSERT_EQ(calls[i], 1) << "task " << i;
+    }
+  }
+}
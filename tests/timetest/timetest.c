@@ -1,7 +1,14 @@
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <sys/limits.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <time.h>
 #include <errno.h>
@@ -55,6 +62,264 @@ static struct timespec ts_max(struct timespec a, struct timespec b)
         return a;
 }
 
+static const struct {
+    int id;
+    const char *name;
+} clocks[] = {
+    { CLOCK_REALTIME, "REALTIME" },
+    { CLOCK_MONOTONIC, "MONOTONIC" },
+    { CLOCK_PROCESS_CPUTIME_ID, "PROCESS_CPUTIME_ID" },
+    { CLOCK_THREAD_CPUTIME_ID, "THREAD_CPUTIME_ID" },
+    { CLOCK_MONOTONIC_RAW, "MONOTONIC_RAW" },
+    { CLOCK_REALTIME_COARSE, "REALTIME_COARSE" },
+    { CLOCK_MONOTONIC_COARSE, "MONOTONIC_COARSE" },
+    { CLOCK_BOOTTIME, "BOOTTIME" },
+    { CLOCK_REALTIME_ALARM, "REALTIME_ALARM" },
+    { CLOCK_BOOTTIME_ALARM, "BOOTTIME_ALARM" },
+    { CLOCK_TAI, "TAI" },
+};
+
+#define NCLOCKS (int)(sizeof(clocks) / sizeof(clocks[0]))
+
+static long long ts_ns(struct timespec t)
+{
+    return ((long long) t.tv_sec) * 1000000000LL + t.tv_nsec;
+}
+
+static int libc_gettime(int clock_id, struct timespec *t)
+{
+    return clock_gettime(clock_id, t);
+}
+
+/* libc serves most clocks from the vDSO; this always enters the kernel. */
+static int syscall_gettime(int clock_id, struct timespec *t)
+{
+    return syscall(__NR_clock_gettime, clock_id, t);
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *) a, y = *(const long long *) b;
+    return x < y ? -1 : x > y;
+}
+
+static long long percentile(const long long *sorted, int n, double p)
+{
+    int i = (int) (p * (n - 1));
+    return sorted[i];
+}
+
+/*
+ * Reads clock_id n times back to back with gettime and reports the mean cost
+ * per call (measured against CLOCK_MONOTONIC), the smallest non-zero step the
+ * clock made, how often it did not advance or went backwards, and the
+ * distribution of the deltas between consecutive reads.
+ */
+static int measure_clock(int clock_id, const char *path,
+                         int (*gettime)(int, struct timespec *),
+                         long long *deltas, int n, int histogram)
+{
+    struct timespec start, end, prev, t;
+    long long minp = 0;
+    int i, zero = 0, backwards = 0;
+
+    if(gettime(clock_id, &prev)) {
+        printf("  %-8s unsupported (%s)\n", path, strerror(errno));
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(i = 0; i < n; i++) {
+        gettime(clock_id, &t);
+        deltas[i] = ts_ns(t) - ts_ns(prev);
+        prev = t;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for(i = 0; i < n; i++) {
+        if(deltas[i] == 0)
+            zero++;
+        else if(deltas[i] < 0)
+            backwards++;
+        else if(minp == 0 || deltas[i] < minp)
+            minp = deltas[i];
+    }
+    qsort(deltas, n, sizeof(deltas[0]), cmp_ll);
+    printf("  %-8s %6.1f ns/call, minp %lld ns, zero %d, backwards %d, "
+           "delta p50 %lld p99 %lld p99.9 %lld max %lld ns\n",
+           path, (double) (ts_ns(end) - ts_ns(start)) / n, minp, zero, backwards,
+           percentile(deltas, n, 0.5), percentile(deltas, n, 0.99),
+           percentile(deltas, n, 0.999), deltas[n - 1]);
+
+    if(histogram) {
+        /* log2 buckets: bucket b holds deltas in [2^(b-1), 2^b). */
+        int buckets[64] = { 0 };
+        for(i = 0; i < n; i++) {
+            int b = 0;
+            long long d = deltas[i];
+            if(d < 0)
+                continue;
+            while(d) {
+                b++;
+                d >>= 1;
+            }
+            buckets[b]++;
+        }
+        for(i = 0; i < 64; i++) {
+            if(buckets[i])
+                printf("    < %12lld ns: %d\n", 1LL << i, buckets[i]);
+        }
+    }
+    return 0;
+}
+
+static void characterize_clocks(int n, int histogram)
+{
+    long long *deltas = malloc(n * sizeof(deltas[0]));
+    int i;
+
+    if(!deltas) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for(i = 0; i < NCLOCKS; i++) {
+        struct timespec res;
+        if(clock_getres(clocks[i].id, &res)) {
+            printf("%s (%d): unsupported (%s)\n", clocks[i].name, clocks[i].id,
+                   strerror(errno));
+            continue;
+        }
+        printf("%s (%d): resolution %lld ns\n", clocks[i].name, clocks[i].id, ts_ns(res));
+        measure_clock(clocks[i].id, "libc", libc_gettime, deltas, n,
+                      histogram);
+        measure_clock(clocks[i].id, "syscall", syscall_gettime, deltas, n, histogram);
+    }
+    free(deltas);
+}
+
+/*
+ * Cross-CPU skew: two threads pinned to different CPUs take turns reading the
+ * clock and handing the value over. Each handover gives d = t(reader) -
+ * t(writer), which is the handover latency plus the clock offset between the
+ * two CPUs, so the minimum over both directions bounds the offset:
+ * (min_ab - min_ba) / 2. A negative d means the clock went backwards when a
+ * timestamp moved between CPUs.
+ */
+struct skew_ctx {
+    int clock_id;
+    int n;
+    atomic_int turn;
+    atomic_llong stamp;
+    long long min_d[2];
+    int backwards[2];
+    int unpinned;
+};
+
+struct skew_arg {
+    struct skew_ctx *ctx;
+    int cpu;
+    int side;
+};
+
+static int pin_to_cpu(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+
+static void *skew_thread(void *p)
+{
+    struct skew_arg *arg = p;
+    struct skew_ctx *ctx = arg->ctx;
+    struct timespec t;
+    int i;
+
+    /* Keep going even if pinning fails so the other side is not left spinning. */
+    if(pin_to_cpu(arg->cpu))
+        ctx->unpinned = 1;
+    for(i = 0; i < ctx->n; i++) {
+        /* turn counts handovers; side 0 owns even turns, side 1 odd ones. */
+        int turn = 2 * i + arg->side;
+        while(atomic_load_explicit(&ctx->turn, memory_order_acquire) != turn)
+            ;
+        clock_gettime(ctx->clock_id, &t);
+        if(turn > 0) {
+            long long d = ts_ns(t) - atomic_load_explicit(&ctx->stamp, memory_order_relaxed);
+            if(d < ctx->min_d[arg->side])
+                ctx->min_d[arg->side] = d;
+            if(d < 0)
+                ctx->backwards[arg->side]++;
+        }
+        atomic_store_explicit(&ctx->stamp, ts_ns(t), memory_order_relaxed);
+        atomic_store_explicit(&ctx->turn, turn + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+static void measure_skew(int clock_id, int n)
+{
+    int ncpus = sysconf(_SC_NPROCESSORS_CONF);
+    int cpu;
+    cpu_set_t allowed;
+
+    if(sched_getaffinity(0, sizeof(allowed), &allowed)) {
+        fprintf(stderr, "sched_getaffinity failed: %s\n", strerror(errno));
+        return;
+    }
+
+    printf("cross-CPU skew of clock %d against cpu0 (%d round trips)\n", clock_id, n);
+    if(ncpus < 2)
+        printf("  only one CPU\n");
+    for(cpu = 1; cpu < ncpus; cpu++) {
+        struct skew_ctx ctx;
+        struct skew_arg args[2] = { { &ctx, 0, 0 }, { &ctx, cpu, 1 } };
+        pthread_t threads[2];
+        int i;
+
+        if(!CPU_ISSET(0, &allowed) || !CPU_ISSET(cpu, &allowed)) {
+            printf("  cpu%d: not available\n", cpu);
+            continue;
+        }
+
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.clock_id = clock_id;
+        ctx.n = n;
+        ctx.min_d[0] = ctx.min_d[1] = LLONG_MAX;
+        for(i = 0; i < 2; i++)
+            pthread_create(&threads[i], NULL, skew_thread, &args[i]);
+        for(i = 0; i < 2; i++)
+            pthread_join(threads[i], NULL);
+        if(ctx.unpinned) {
+            printf("  cpu%d: cannot pin (offline?)\n", cpu);
+            continue;
+        }
+        /* min_d[1] is cpu0 -> cpuN, min_d[0] is cpuN -> cpu0. */
+        printf("  cpu%d: min 0->%d %lld ns, min %d->0 %lld ns, offset %+lld ns, "
+               "backwards %d/%d\n",
+               cpu, cpu, ctx.min_d[1], cpu, ctx.min_d[0],
+               (ctx.min_d[1] - ctx.min_d[0]) / 2, ctx.backwards[1], ctx.backwards[0]);
+    }
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [clock_id]\n"
+            "       %s -c [-n count] [-H]\n"
+            "       %s -s [-k clock_id] [-n count]\n"
+            "\n"
+            "  With no options, read clock_id (default CLOCK_MONOTONIC) in a loop\n"
+            "  and print the min/max deltas every 50000 reads.\n"
+            "  -c  characterize every clock id: resolution, vDSO and syscall cost,\n"
+            "      non-advancing and backwards reads, delta percentiles\n"
+            "  -H  with -c, also print a log2 histogram of the deltas\n"
+            "  -s  measure monotonicity and offset between cpu0 and every other CPU\n"
+            "  -k  clock id used by -s (default CLOCK_MONOTONIC)\n"
+            "  -n  reads per clock for -c, round trips per CPU for -s\n",
+            prog, prog, prog);
+}
+
 int main(int argc, char **argv)
 {
     long long tnow, tlast;
@@ -70,8 +335,41 @@ int main(int argc, char **argv)
     dtmax.tv_nsec = 0;
     tlast = 0;
 
-    if(argc == 2) {
-        clock_id = atoi(argv[1]);
+    int c, characterize = 0, skew = 0, histogram = 0, count = 0;
+    int skew_clock = CLOCK_MONOTONIC;
+
+    while((c = getopt(argc, argv, "cHhk:n:s")) != -1) {
+        switch(c) {
+        case 'c':
+            characterize = 1;
+            break;
+        case 'H':
+            histogram = 1;
+            break;
+        case 'k':
+            skew_clock = atoi(optarg);
+            break;
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 's':
+            skew = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if(characterize || skew) {
+        if(characterize)
+            characterize_clocks(count > 0 ? count : 1000000, histogram);
+        if(skew)
+            measure_skew(skew_clock, count > 0 ? count : 100000);
+        return 0;
+    }
+
+    if(optind < argc) {
+        clock_id = atoi(argv[optind]);
         printf("using clock %d\n", clock_id);
     }
     clock_gettime(clock_id, &t1);
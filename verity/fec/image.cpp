@@ -21,6 +21,7 @@ extern "C" {
     #include <fec.h>
 }
 
+#include <algorithm>
 #include <assert.h>
 #include <android-base/file.h>
 #include <errno.h>
@@ -46,6 +47,7 @@ extern "C" {
 void image_init(image *ctx)
 {
     memset(ctx, 0, sizeof(*ctx));
+    ctx->out_fd = -1;
 }
 
 void image_free(image *ctx)
@@ -60,6 +62,25 @@ void image_free(image *ctx)
         delete[] ctx->fec;
     }
 
+    if (ctx->window) {
+        delete[] ctx->window;
+    }
+
+    for (size_t i = 0; i < ctx->stream_count; ++i) {
+        if (ctx->stream_files[i].fd == ctx->out_fd) {
+            ctx->out_fd = -1;
+        }
+        close(ctx->stream_files[i].fd);
+    }
+
+    if (ctx->stream_files) {
+        delete[] ctx->stream_files;
+    }
+
+    if (ctx->out_fd != -1) {
+        close(ctx->out_fd);
+    }
+
     image_init(ctx);
 }
 
@@ -142,6 +163,128 @@ static void file_image_load(const std::vector<int>& fds, image *ctx)
     }
 }
 
+static int create_temp_file()
+{
+    const char *dir = getenv("TMPDIR");
+    std::string path = std::string(dir ? dir : "/tmp") + "/fec-XXXXXX";
+    int fd = mkstemp(&path[0]);
+
+    if (fd < 0) {
+        FATAL("failed to create a temporary file in '%s': %s\n",
+            dir ? dir : "/tmp", strerror(errno));
+    }
+
+    unlink(path.c_str());
+    return fd;
+}
+
+static void stream_image_load(const std::vector<int>& fds, image *ctx)
+{
+    uint64_t size = 0;
+
+    ctx->stream_files = new image_stream_file[fds.size()];
+    ctx->stream_count = 0;
+
+    for (auto fd : fds) {
+        image_stream_file *f = &ctx->stream_files[ctx->stream_count++];
+        struct sparse_file *file = sparse_file_import(fd, false, false);
+
+        if (file) {
+            /* expand sparse files to disk instead of memory, skipped
+               chunks end up as holes */
+            f->fd = create_temp_file();
+            f->size = sparse_file_len(file, false, false);
+
+            if (ctx->verbose) {
+                INFO("expanding %" PRIu64 " bytes of sparse input to a "
+                    "temporary file\n", f->size);
+            }
+
+            if (sparse_file_write(file, f->fd, false, false, false) < 0) {
+                FATAL("failed to expand sparse input\n");
+            }
+
+            sparse_file_destroy(file);
+            close(fd);
+        } else if (ctx->sparse) {
+            FATAL("failed to read file %s\n", ctx->fec_filename);
+        } else {
+            off64_t len = lseek64(fd, 0, SEEK_END);
+
+            if (len < 0) {
+                FATAL("failed to get input size: %s\n", strerror(errno));
+            }
+
+            f->fd = fd;
+            f->size = len;
+        }
+
+        f->start = size;
+        size += f->size;
+    }
+
+    calculate_rounds(size, ctx);
+
+    /* the window needs room for one stripe in each of the rs_n columns */
+    uint64_t column_size = ctx->rounds * FEC_BLOCKSIZE;
+    uint64_t window_size = ctx->mem_limit / ctx->rs_n / FEC_BLOCKSIZE *
+        FEC_BLOCKSIZE;
+
+    if (window_size == 0) {
+        FATAL("memory limit must be at least %u bytes\n",
+            ctx->rs_n * FEC_BLOCKSIZE);
+    }
+
+    ctx->window_size = std::min(window_size, column_size);
+
+    if (ctx->verbose) {
+        INFO("allocating %" PRIu64 " bytes of memory\n",
+            ctx->window_size * ctx->rs_n);
+    }
+
+    ctx->window = new uint8_t[ctx->window_size * ctx->rs_n];
+}
+
+/* read [offset, offset + len) of the image, past its end reads as zeros */
+static void stream_read(image *ctx, uint64_t offset, uint8_t *buf,
+        uint64_t len)
+{
+    memset(buf, 0, len);
+
+    for (size_t i = 0; i < ctx->stream_count && len > 0; ++i) {
+        image_stream_file *f = &ctx->stream_files[i];
+
+        if (offset >= f->start + f->size) {
+            continue;
+        }
+
+        uint64_t n = std::min(len, f->start + f->size - offset);
+
+        if (!android::base::ReadFullyAtOffset(f->fd, buf, n,
+                offset - f->start)) {
+            FATAL("failed to read input: %s\n", strerror(errno));
+        }
+
+        buf += n;
+        offset += n;
+        len -= n;
+    }
+}
+
+static void stream_write(image *ctx, uint64_t offset, const uint8_t *buf,
+        uint64_t len)
+{
+    if (offset >= ctx->inp_size) {
+        return;
+    }
+
+    len = std::min(len, ctx->inp_size - offset);
+
+    if (!android::base::WriteFullyAtOffset(ctx->out_fd, buf, len, offset)) {
+        FATAL("failed to write to output: %s\n", strerror(errno));
+    }
+}
+
 bool image_load(const std::vector<std::string>& filenames, image *ctx)
 {
     assert(ctx->roots > 0 && ctx->roots < FEC_RSM);
@@ -165,13 +308,51 @@ bool image_load(const std::vector<std::string>& filenames, image *ctx)
         fds.push_back(fd);
     }
 
-    file_image_load(fds, ctx);
+    if (ctx->mem_limit) {
+        stream_image_load(fds, ctx);
+    } else {
+        file_image_load(fds, ctx);
+    }
+
+    return true;
+}
+
+/* when streaming, corrected data is written out window by window, so the
+   output must be opened before image_process */
+bool image_open_output(const std::string& filename, image *ctx)
+{
+    assert(ctx->mem_limit && ctx->stream_count > 0);
+
+    if (ctx->inplace) {
+        ctx->out_fd = ctx->stream_files[0].fd;
+        return true;
+    }
+
+    ctx->out_fd = TEMP_FAILURE_RETRY(open(filename.c_str(),
+                O_WRONLY | O_CREAT | O_TRUNC, 0666));
+
+    if (ctx->out_fd < 0) {
+        FATAL("failed to open file '%s: %s'\n", filename.c_str(),
+            strerror(errno));
+    }
+
+    if (ftruncate64(ctx->out_fd, ctx->inp_size) < 0) {
+        FATAL("failed to resize output: %s\n", strerror(errno));
+    }
 
     return true;
 }
 
 bool image_save(const std::string& filename, image *ctx)
 {
+    if (ctx->window) {
+        /* already written by image_process */
+        if (fsync(ctx->out_fd) < 0) {
+            FATAL("failed to sync output: %s\n", strerror(errno));
+        }
+        return true;
+    }
+
     /* TODO: support saving as a sparse file */
     int fd = TEMP_FAILURE_RETRY(open(filename.c_str(),
                 O_WRONLY | O_CREAT | O_TRUNC, 0666));
@@ -350,41 +531,20 @@ static void * process(void *cookie)
     return nullptr;
 }
 
-bool image_process(image_proc_func func, image *ctx)
+/* runs func on codewords [first, first + count) */
+static void process_range(image_proc_func func, image *ctx, int threads,
+        image_proc_ctx *args, uint64_t first, uint64_t count)
 {
-    int threads = ctx->threads;
-
-    if (threads < IMAGE_MIN_THREADS) {
-        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t current = first;
+    uint64_t end = (first + count) * ctx->rs_n;
+    uint64_t rs_blocks_per_thread = fec_div_round_up(count, threads);
 
-        if (threads < IMAGE_MIN_THREADS) {
-            threads = IMAGE_MIN_THREADS;
-        }
-    }
-
-    assert(ctx->rounds > 0);
-
-    if ((uint64_t)threads > ctx->rounds) {
-        threads = (int)ctx->rounds;
-    }
-    if (threads > IMAGE_MAX_THREADS) {
-        threads = IMAGE_MAX_THREADS;
-    }
-
-    if (ctx->verbose) {
-        INFO("starting %d threads to compute RS(255, %d)\n", threads,
-            ctx->rs_n);
-    }
+    /* don't start threads with nothing left to do */
+    threads = (int)fec_div_round_up(count, rs_blocks_per_thread);
 
     pthread_t pthreads[threads];
-    image_proc_ctx args[threads];
-
-    uint64_t current = 0;
-    uint64_t end = ctx->rounds * ctx->rs_n * FEC_BLOCKSIZE;
-    uint64_t rs_blocks_per_thread =
-        fec_div_round_up(ctx->rounds * FEC_BLOCKSIZE, threads);
 
-    if (ctx->verbose) {
+    if (ctx->verbose && !ctx->window) {
         INFO("computing %" PRIu64 " codes per thread\n", rs_blocks_per_thread);
     }
 
@@ -397,20 +557,11 @@ bool image_process(image_proc_func func, image *ctx)
         args[i].start = current * ctx->rs_n;
         args[i].end = (current + rs_blocks_per_thread) * ctx->rs_n;
 
-        args[i].rs = init_rs_char(FEC_PARAMS(ctx->roots));
-
-        if (!args[i].rs) {
-            FATAL("failed to initialize encoder for thread %d\n", i);
-        }
-
         if (args[i].end > end) {
             args[i].end = end;
-        } else if (i == threads && args[i].end + rs_blocks_per_thread *
-                                        ctx->rs_n > end) {
-            args[i].end = end;
         }
 
-        if (ctx->verbose) {
+        if (ctx->verbose && !ctx->window) {
             INFO("thread %d: [%" PRIu64 ", %" PRIu64 ")\n",
                 i, args[i].start, args[i].end);
         }
@@ -425,19 +576,104 @@ bool image_process(image_proc_func func, image *ctx)
         current += rs_blocks_per_thread;
     }
 
-    ctx->rv = 0;
-
     for (int i = 0; i < threads; ++i) {
         if (pthread_join(pthreads[i], nullptr) != 0) {
             FATAL("failed to join thread %d: %s\n", i, strerror(errno));
         }
 
         ctx->rv += args[i].rv;
+    }
+}
+
+/* streams the input through the window, with codeword c of the interleaved
+   layout reading byte c of each of the rs_n columns */
+static void process_windows(image_proc_func func, image *ctx, int threads,
+        image_proc_ctx *args)
+{
+    uint64_t column_size = ctx->rounds * FEC_BLOCKSIZE;
+    uint64_t stripe_size = ctx->window_size;
+
+    for (uint64_t start = 0; start < column_size; start += stripe_size) {
+        uint64_t count = std::min(stripe_size, column_size - start);
+        uint64_t rv = ctx->rv;
+
+        /* the window layout follows the width of the current window */
+        ctx->window_start = start;
+        ctx->window_size = count;
 
-        if (args[i].rs) {
-            free_rs_char(args[i].rs);
-            args[i].rs = nullptr;
+        for (int j = 0; j < ctx->rs_n; ++j) {
+            stream_read(ctx, j * column_size + start,
+                &ctx->window[j * count], count);
         }
+
+        process_range(func, ctx, std::min((uint64_t)threads, count), args,
+            start, count);
+
+        /* in place, only windows with corrections need to be written */
+        if (ctx->out_fd != -1 && (!ctx->inplace || ctx->rv != rv)) {
+            for (int j = 0; j < ctx->rs_n; ++j) {
+                stream_write(ctx, j * column_size + start,
+                    &ctx->window[j * count], count);
+            }
+        }
+    }
+
+    ctx->window_size = stripe_size;
+}
+
+bool image_process(image_proc_func func, image *ctx)
+{
+    int threads = ctx->threads;
+
+    if (threads < IMAGE_MIN_THREADS) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+
+        if (threads < IMAGE_MIN_THREADS) {
+            threads = IMAGE_MIN_THREADS;
+        }
+    }
+
+    assert(ctx->rounds > 0);
+
+    if ((uint64_t)threads > ctx->rounds) {
+        threads = (int)ctx->rounds;
+    }
+    if (threads > IMAGE_MAX_THREADS) {
+        threads = IMAGE_MAX_THREADS;
+    }
+
+    if (ctx->verbose) {
+        INFO("starting %d threads to compute RS(255, %d)\n", threads,
+            ctx->rs_n);
+    }
+
+    image_proc_ctx args[threads];
+
+    for (int i = 0; i < threads; ++i) {
+        args[i].rs = init_rs_char(FEC_PARAMS(ctx->roots));
+
+        if (!args[i].rs) {
+            FATAL("failed to initialize encoder for thread %d\n", i);
+        }
+    }
+
+    ctx->rv = 0;
+
+    if (ctx->window) {
+        if (ctx->verbose) {
+            INFO("streaming input through a %" PRIu64 " byte window\n",
+                ctx->window_size * ctx->rs_n);
+        }
+
+        process_windows(func, ctx, threads, args);
+    } else {
+        process_range(func, ctx, threads, args, 0,
+            ctx->rounds * FEC_BLOCKSIZE);
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        free_rs_char(args[i].rs);
+        args[i].rs = nullptr;
     }
 
     return true;
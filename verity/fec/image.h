@@ -35,6 +35,14 @@
 
 #define unlikely(x)    __builtin_expect(!!(x), 0)
 
+/* a raw input file (or an expanded copy of a sparse one) used when
+   streaming, covering bytes [start, start + size) of the image */
+struct image_stream_file {
+    int fd;
+    uint64_t start;
+    uint64_t size;
+};
+
 struct image {
     /* if true, decode file in place instead of creating a new output file */
     bool inplace;
@@ -61,6 +69,18 @@ struct image {
     uint8_t *fec;
     uint8_t *input;
     uint8_t *output;
+    /* if non-zero, don't load the input into memory, but stream it through
+       a window of at most this many bytes */
+    uint64_t mem_limit;
+    image_stream_file *stream_files;
+    size_t stream_count;
+    int out_fd;
+    /* the window holds rs_n stripes of window_size bytes, stripe j holding
+       bytes [window_start, window_start + window_size) of column j of the
+       interleaved layout */
+    uint8_t *window;
+    uint64_t window_start;
+    uint64_t window_size;
 };
 
 struct image_proc_ctx;
@@ -78,6 +98,7 @@ struct image_proc_ctx {
 };
 
 extern bool image_load(const std::vector<std::string>& filename, image *ctx);
+extern bool image_open_output(const std::string& filename, image *ctx);
 extern bool image_save(const std::string& filename, image *ctx);
 
 extern bool image_ecc_new(const std::string& filename, image *ctx);
@@ -89,8 +110,19 @@ extern bool image_process(image_proc_func f, image *ctx);
 extern void image_init(image *ctx);
 extern void image_free(image *ctx);
 
+inline uint64_t image_get_window_offset(uint64_t i, image *ctx)
+{
+    return (i % ctx->rs_n) * ctx->window_size +
+        (i / ctx->rs_n - ctx->window_start);
+}
+
 inline uint8_t image_get_interleaved_byte(uint64_t i, image *ctx)
 {
+    if (ctx->window) {
+        /* bytes past the end of the input are zero in the window */
+        return ctx->window[image_get_window_offset(i, ctx)];
+    }
+
     uint64_t offset = fec_ecc_interleave(i, ctx->rs_n, ctx->rounds);
 
     if (unlikely(offset >= ctx->inp_size)) {
@@ -107,6 +139,8 @@ inline void image_set_interleaved_byte(uint64_t i, image *ctx,
 
     if (unlikely(offset >= ctx->inp_size)) {
         assert(value == 0);
+    } else if (ctx->window) {
+        ctx->window[image_get_window_offset(i, ctx)] = value;
     } else if (ctx->output && ctx->output[offset] != value) {
         ctx->output[offset] = value;
     }
@@ -28,6 +28,9 @@ extern "C" {
 #include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
+#include <vector>
+
 #include <android-base/file.h>
 #include "image.h"
 
@@ -89,6 +92,261 @@ static void decode_rs(struct image_proc_ctx *ctx)
     }
 }
 
+enum {
+    BLOCK_GOOD,
+    BLOCK_BAD,
+    BLOCK_UNVERIFIED
+};
+
+struct repair_ctx {
+    image *ctx;
+    fec::io *fh;
+    /* BLOCK_* for each block of the input */
+    std::vector<uint8_t> *state;
+    /* rows of RS codewords to decode, see repair_rows(), and whether
+       each of them had corrections */
+    const std::vector<uint64_t> *rows;
+    std::vector<uint8_t> *corrected;
+    uint64_t start;
+    uint64_t end;
+    uint64_t rv;
+    void *rs;
+};
+
+static void *verify_blocks(void *cookie)
+{
+    repair_ctx *rctx = (repair_ctx *)cookie;
+    image *ctx = rctx->ctx;
+
+    for (uint64_t i = rctx->start; i < rctx->end; ++i) {
+        int rc = rctx->fh->check_block(i, &ctx->input[i * FEC_BLOCKSIZE]);
+
+        if (rc > 0) {
+            (*rctx->state)[i] = BLOCK_GOOD;
+        } else if (rc == 0) {
+            (*rctx->state)[i] = BLOCK_BAD;
+        } else {
+            (*rctx->state)[i] = BLOCK_UNVERIFIED;
+        }
+    }
+
+    return nullptr;
+}
+
+/*
+ * With the interleaved layout, codeword c reads byte c of each column of
+ * rounds blocks, so the FEC_BLOCKSIZE codewords of row r (codewords
+ * [r * FEC_BLOCKSIZE, (r + 1) * FEC_BLOCKSIZE)) cover exactly blocks
+ * r, rounds + r, 2 * rounds + r, ... Blocks known to be bad are passed to
+ * the decoder as erasures, which it can correct up to roots of instead of
+ * roots / 2 errors.
+ */
+static void *repair_rows(void *cookie)
+{
+    repair_ctx *rctx = (repair_ctx *)cookie;
+    image *ctx = rctx->ctx;
+    uint8_t data[FEC_RSM];
+    int eras_pos[FEC_RSM];
+
+    for (uint64_t n = rctx->start; n < rctx->end; ++n) {
+        uint64_t r = (*rctx->rows)[n];
+        int no_eras = 0;
+
+        for (int j = 0; j < ctx->rs_n; ++j) {
+            uint64_t block = j * ctx->rounds + r;
+
+            if (block < ctx->blocks && (*rctx->state)[block] == BLOCK_BAD) {
+                eras_pos[no_eras++] = j;
+            }
+        }
+
+        if (no_eras > ctx->roots) {
+            /* too many to be erasures, hope the damage is partial */
+            no_eras = 0;
+        }
+
+        uint64_t rv = rctx->rv;
+
+        for (uint64_t c = r * FEC_BLOCKSIZE; c < (r + 1) * FEC_BLOCKSIZE;
+                ++c) {
+            uint64_t i = c * ctx->rs_n;
+
+            for (int j = 0; j < ctx->rs_n; ++j) {
+                data[j] = image_get_interleaved_byte(i + j, ctx);
+            }
+
+            memcpy(&data[ctx->rs_n], &ctx->fec[c * ctx->roots], ctx->roots);
+            int rc = decode_rs_char(rctx->rs, data, no_eras ? eras_pos :
+                                    nullptr, no_eras);
+
+            if (rc < 0) {
+                FATAL("failed to recover [%" PRIu64 ", %" PRIu64 ")\n",
+                    i, i + ctx->rs_n);
+            } else if (rc > 0) {
+                for (int j = 0; j < ctx->rs_n; ++j) {
+                    image_set_interleaved_byte(i + j, ctx, data[j]);
+                }
+
+                rctx->rv += rc;
+            }
+        }
+
+        (*rctx->corrected)[n] = (rctx->rv != rv);
+    }
+
+    return nullptr;
+}
+
+/* runs func over [0, count) split between the threads */
+static void repair_run(image& ctx, repair_ctx& base, void *(*func)(void *),
+        uint64_t count)
+{
+    int threads = ctx.threads;
+
+    if (threads < IMAGE_MIN_THREADS) {
+        threads = std::max((int)sysconf(_SC_NPROCESSORS_ONLN),
+            IMAGE_MIN_THREADS);
+    }
+
+    threads = (int)std::min<uint64_t>(std::min(threads, IMAGE_MAX_THREADS),
+        std::max<uint64_t>(count, 1));
+
+    uint64_t per_thread = fec_div_round_up(count, threads);
+    pthread_t pthreads[threads];
+    repair_ctx args[threads];
+
+    for (int i = 0; i < threads; ++i) {
+        args[i] = base;
+        args[i].start = std::min(count, i * per_thread);
+        args[i].end = std::min(count, (i + 1) * per_thread);
+        args[i].rs = init_rs_char(FEC_PARAMS(ctx.roots));
+
+        if (!args[i].rs) {
+            FATAL("failed to initialize decoder for thread %d\n", i);
+        }
+
+        if (pthread_create(&pthreads[i], nullptr, func, &args[i]) != 0) {
+            FATAL("failed to create thread %d\n", i);
+        }
+    }
+
+    for (int i = 0; i < threads; ++i) {
+        if (pthread_join(pthreads[i], nullptr) != 0) {
+            FATAL("failed to join thread %d: %s\n", i, strerror(errno));
+        }
+
+        base.rv += args[i].rv;
+        free_rs_char(args[i].rs);
+    }
+}
+
+/*
+ * Checks the data blocks against the verity hash tree and decodes only the
+ * rows of codewords that touch blocks that failed the check. Blocks the hash
+ * tree doesn't cover (the tree itself and the verity metadata) are left
+ * alone: they sit at the end of the input and so in every row, and opening
+ * the input already validated the tree against its root hash. Returns the
+ * rows with corrections, or false if the input has no usable hash tree.
+ */
+static bool hash_repair(image& ctx, const std::string& inp_filename,
+        std::vector<uint64_t>& corrected)
+{
+    fec::io fh(inp_filename, O_RDONLY);
+
+    if (!fh || fh.check_block(0, ctx.input) < 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> state(ctx.blocks, BLOCK_UNVERIFIED);
+    repair_ctx base = {};
+
+    base.ctx = &ctx;
+    base.fh = &fh;
+    base.state = &state;
+    repair_run(ctx, base, verify_blocks, ctx.blocks);
+
+    /* the rows that need decoding */
+    std::vector<bool> touched(ctx.rounds, false);
+    uint64_t bad = 0;
+
+    for (uint64_t b = 0; b < ctx.blocks; ++b) {
+        if (state[b] == BLOCK_BAD) {
+            touched[b % ctx.rounds] = true;
+            ++bad;
+        }
+    }
+
+    std::vector<uint64_t> rows;
+
+    for (uint64_t r = 0; r < ctx.rounds; ++r) {
+        if (touched[r]) {
+            rows.push_back(r);
+        }
+    }
+
+    INFO("%" PRIu64 " blocks failed verification, decoding %zu of %" PRIu64
+        " rows\n", bad, rows.size(), ctx.rounds);
+
+    std::vector<uint8_t> row_corrected(rows.size(), 0);
+
+    base.rows = &rows;
+    base.corrected = &row_corrected;
+    repair_run(ctx, base, repair_rows, rows.size());
+    ctx.rv = base.rv;
+
+    corrected.clear();
+
+    for (size_t n = 0; n < rows.size(); ++n) {
+        if (row_corrected[n]) {
+            corrected.push_back(rows[n]);
+        }
+    }
+
+    for (auto r : rows) {
+        for (int j = 0; j < ctx.rs_n; ++j) {
+            uint64_t block = j * ctx.rounds + r;
+
+            if (block < ctx.blocks && state[block] == BLOCK_BAD &&
+                    fh.check_block(block, &ctx.input[block * FEC_BLOCKSIZE])
+                        != 1) {
+                FATAL("failed to repair block %" PRIu64 "\n", block);
+            }
+        }
+    }
+
+    return true;
+}
+
+/* writes back the blocks of the corrected rows */
+static void hash_repair_save(image& ctx, const std::string& filename,
+        const std::vector<uint64_t>& corrected)
+{
+    int fd = TEMP_FAILURE_RETRY(open(filename.c_str(), O_WRONLY));
+
+    if (fd < 0) {
+        FATAL("failed to open file '%s': %s\n", filename.c_str(),
+            strerror(errno));
+    }
+
+    for (auto r : corrected) {
+        for (int j = 0; j < ctx.rs_n; ++j) {
+            uint64_t offset = (j * ctx.rounds + r) * FEC_BLOCKSIZE;
+
+            if (offset < ctx.inp_size &&
+                    !android::base::WriteFullyAtOffset(fd, &ctx.input[offset],
+                        FEC_BLOCKSIZE, offset)) {
+                FATAL("failed to write to output: %s\n", strerror(errno));
+            }
+        }
+    }
+
+    if (fsync(fd) < 0) {
+        FATAL("failed to sync output: %s\n", strerror(errno));
+    }
+
+    close(fd);
+}
+
 static int usage()
 {
     printf("fec: a tool for encoding and decoding files using RS(255, N).\n"
@@ -106,10 +364,17 @@ static int usage()
            "  -r, --roots=<bytes>               number of parity bytes\n"
            "  -j, --threads=<threads>           number of threads to use\n"
            "  -S                                treat data as a sparse file\n"
+           "  -m, --memory-limit=<bytes>        stream data through at most\n"
+           "                                    <bytes> of memory instead of\n"
+           "                                    loading it (sparse data is\n"
+           "                                    expanded to $TMPDIR)\n"
            "encoding options:\n"
            "  -p, --padding=<bytes>             add padding after ECC data\n"
            "decoding options:\n"
            "  -i, --inplace                     correct <data> in place\n"
+           "  -R, --repair                      only decode codewords with\n"
+           "                                    blocks that fail verity hash\n"
+           "                                    checks\n"
         );
 
     return 1;
@@ -212,7 +477,8 @@ static int encode(image& ctx, const std::vector<std::string>& inp_filenames,
 }
 
 static int decode(image& ctx, const std::vector<std::string>& inp_filenames,
-        const std::string& fec_filename, std::string& out_filename)
+        const std::string& fec_filename, std::string& out_filename,
+        bool repair)
 {
     const std::string& inp_filename = inp_filenames.front();
 
@@ -225,6 +491,11 @@ static int decode(image& ctx, const std::vector<std::string>& inp_filenames,
         FATAL("invalid parameters: padding is only relevant when encoding\n");
     }
 
+    if (repair && ctx.mem_limit) {
+        FATAL("invalid parameters: repair cannot be used with a memory "
+            "limit\n");
+    }
+
     if (!image_ecc_load(fec_filename, &ctx) ||
             !image_load(inp_filenames, &ctx)) {
         FATAL("failed to read input\n");
@@ -242,13 +513,26 @@ static int decode(image& ctx, const std::vector<std::string>& inp_filenames,
             fec_filename.c_str());
     }
 
+    if (ctx.mem_limit && !out_filename.empty() &&
+            !image_open_output(out_filename, &ctx)) {
+        FATAL("failed to open output\n");
+    }
+
     if (ctx.verbose) {
         INFO("\traw fec size: %u\n", ctx.fec_size);
         INFO("\tblocks: %" PRIu64 "\n", ctx.blocks);
         INFO("\trounds: %" PRIu64 "\n", ctx.rounds);
     }
 
-    if (!image_process(decode_rs, &ctx)) {
+    std::vector<uint64_t> corrected;
+
+    if (repair && !hash_repair(ctx, inp_filename, corrected)) {
+        INFO("no usable hash tree in '%s', decoding all of it\n",
+            inp_filename.c_str());
+        repair = false;
+    }
+
+    if (!repair && !image_process(decode_rs, &ctx)) {
         FATAL("failed to process input\n");
     }
 
@@ -258,7 +542,10 @@ static int decode(image& ctx, const std::vector<std::string>& inp_filenames,
         INFO("no errors found\n");
     }
 
-    if (!out_filename.empty() && !image_save(out_filename, &ctx)) {
+    if (repair && ctx.inplace) {
+        /* only the corrected blocks changed */
+        hash_repair_save(ctx, out_filename, corrected);
+    } else if (!out_filename.empty() && !image_save(out_filename, &ctx)) {
         FATAL("failed to write output\n");
     }
 
@@ -272,6 +559,7 @@ int main(int argc, char **argv)
     std::string out_filename;
     std::vector<std::string> inp_filenames;
     int mode = MODE_ENCODE;
+    bool repair = false;
     image ctx;
 
     image_init(&ctx);
@@ -285,15 +573,17 @@ int main(int argc, char **argv)
             {"sparse", no_argument, nullptr, 'S'},
             {"roots", required_argument, nullptr, 'r'},
             {"inplace", no_argument, nullptr, 'i'},
+            {"repair", no_argument, nullptr, 'R'},
             {"threads", required_argument, nullptr, 'j'},
             {"print-fec-size", required_argument, nullptr, 's'},
             {"get-ecc-start", required_argument, nullptr, 'E'},
             {"get-verity-start", required_argument, nullptr, 'V'},
             {"padding", required_argument, nullptr, 'p'},
+            {"memory-limit", required_argument, nullptr, 'm'},
             {"verbose", no_argument, nullptr, 'v'},
             {nullptr, 0, nullptr, 0}
         };
-        int c = getopt_long(argc, argv, "hedSr:ij:s:E:V:p:v", long_options, nullptr);
+        int c = getopt_long(argc, argv, "hedSr:iRj:s:E:V:p:m:v", long_options, nullptr);
         if (c < 0) {
             break;
         }
@@ -321,6 +611,9 @@ int main(int argc, char **argv)
         case 'i':
             ctx.inplace = true;
             break;
+        case 'R':
+            repair = true;
+            break;
         case 'j':
             ctx.threads = (int)parse_arg(optarg, "threads", IMAGE_MAX_THREADS);
             break;
@@ -351,6 +644,12 @@ int main(int argc, char **argv)
                 FATAL("padding must be multiple of %u\n", FEC_BLOCKSIZE);
             }
             break;
+        case 'm':
+            ctx.mem_limit = parse_arg(optarg, "memory-limit", UINT64_MAX);
+            if (!ctx.mem_limit) {
+                FATAL("memory limit must be non-zero\n");
+            }
+            break;
         case 'v':
             ctx.verbose = true;
             break;
@@ -402,7 +701,7 @@ int main(int argc, char **argv)
     case MODE_ENCODE:
         return encode(ctx, inp_filenames, fec_filename);
     case MODE_DECODE:
-        return decode(ctx, inp_filenames, fec_filename, out_filename);
+        return decode(ctx, inp_filenames, fec_filename, out_filename, repair);
     default:
         abort();
     }
@@ -19,9 +19,11 @@ import shutil
 import subprocess
 import sys
 import tempfile
+import time
 
 blocksize = 4096
 roots = 2
+memory_limit = 4 * 1024 * 1024
 
 def corrupt(image, offset, length):
     print "corrupting %d bytes at offset %d" % (length, offset)
@@ -41,12 +43,23 @@ def corruptmax(image, roots):
 
     corrupt(image, offset, max_errors)
 
-def encode(image, fec, roots):
-    if subprocess.call([ "fec", "--roots= " + str(roots), image, fec ]) != 0:
+def measure(args, size):
+    start = time.time()
+    p = subprocess.Popen(args)
+    _, status, rusage = os.wait4(p.pid, 0)
+    elapsed = time.time() - start
+    print "%s: peak RSS %d KiB, %.1f MiB/s" % (" ".join(args[:-2]),
+        rusage.ru_maxrss, size / (1024.0 * 1024.0) / max(elapsed, 1e-6))
+    return status
+
+def encode(image, fec, roots, options=[]):
+    args = [ "fec", "--roots=" + str(roots) ] + options + [ image, fec ]
+    if measure(args, os.stat(image).st_size) != 0:
         raise Exception("encoding failed")
 
-def decode(image, fec, output):
-    return subprocess.call([ "fec", "--decode", image, fec, output ])
+def decode(image, fec, output, options=[]):
+    args = [ "fec", "--decode" ] + options + [ image, fec, output ]
+    return measure(args, os.stat(image).st_size)
 
 def compare(a, b):
     return subprocess.call([ "cmp", "-s", a, b ])
@@ -63,11 +76,21 @@ def main(argv):
     temp_cor = tempfile.NamedTemporaryFile()
     temp_fec = tempfile.NamedTemporaryFile()
     temp_out = tempfile.NamedTemporaryFile()
+    temp_stream_fec = tempfile.NamedTemporaryFile()
+    temp_stream_out = tempfile.NamedTemporaryFile()
+    stream = [ "--memory-limit=" + str(memory_limit) ]
 
     simg2img(image, temp_img.name)
     simg2img(image, temp_cor.name)
 
     encode(image, temp_fec.name, roots)
+    encode(image, temp_stream_fec.name, roots, stream)
+
+    if compare(temp_fec.name, temp_stream_fec.name) != 0:
+        raise Exception("FAILED: streamed ecc data not identical")
+    else:
+        print "streamed ecc data matches"
+
     corruptmax(temp_cor.name, roots)
 
     if decode(temp_cor.name, temp_fec.name, temp_out.name) != 0:
@@ -78,6 +101,15 @@ def main(argv):
     else:
         print "corrected content matches original"
 
+    if decode(temp_cor.name, temp_fec.name, temp_stream_out.name,
+            stream) != 0:
+        raise Exception("FAILED: failed to correct errors when streaming")
+
+    if compare(temp_img.name, temp_stream_out.name) != 0:
+        raise Exception("FAILED: streamed corrected file not identical")
+    else:
+        print "streamed corrected content matches original"
+
     corrupt(temp_cor.name, 0, blocksize)
 
     if decode(temp_cor.name, temp_fec.name, temp_out.name) == 0: